@@ -13,12 +13,13 @@
 
 #include <Arduino.h>
 #include "ClientProxy.h"
-#include "utility/W5100.h"
+#include "utility/NetBackend.h"
+#include "utility/HttpTrace.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 ClientProxy::ClientProxy()
-: my_sn(W5100::socket_undefined)
+: my_sn(NetBackend::socket_undefined)
 {}
 
 ClientProxy::~ClientProxy()
@@ -26,18 +27,29 @@ ClientProxy::~ClientProxy()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void ClientProxy::setConnection(W5100::socket_e the_sn)
-{ my_sn = the_sn; }
+void ClientProxy::setConnection(NetBackend::socket_e the_sn)
+{ 
+  my_sn = the_sn;
+  if (prv_isValidSn()) HttpTrace_EVENT(ev_connect, my_sn, 0);
+}
 
 bool ClientProxy::closeConnection()
 { 
   if (!prv_isValidSn()) return true;
+  HttpTrace_EVENT(ev_close, my_sn, 0);
   
-  while (!W5100::isClosed(my_sn))
-    if (W5100::close(my_sn) != W5100::rc_ok)
+  // Data may still be queued or in flight: let them complete before closing.
+  // The result is ignored, since the connection is being closed anyway.
+  if (!NetBackend::isClosed(my_sn)) NetBackend::waitSendCompleted(my_sn);
+  
+  while (!NetBackend::isClosed(my_sn))
+    if (NetBackend::close(my_sn) != NetBackend::rc_ok)
       return false;
       
-  my_sn = W5100::socket_undefined;
+  // A byte pushed back must not be read by the next connection on this socket
+  my_sn = NetBackend::socket_undefined;
+  my_mode = mode_request;
+  my_unreadByteAvail = false;
 
   return true;
 }
@@ -45,7 +57,7 @@ bool ClientProxy::closeConnection()
 bool ClientProxy::isConnected() const
 {
   if (!prv_isValidSn()) return false;
-  return W5100::isConnected(my_sn);
+  return NetBackend::isConnected(my_sn);
 }
 
 void ClientProxy::triggerConnTimeout()
@@ -54,25 +66,28 @@ void ClientProxy::triggerConnTimeout()
 bool ClientProxy::connTimeoutExpired() const
 { return millis() - my_connIdleStart > 5000; }
 
+uint32_t ClientProxy::msIdle() const
+{ return millis() - my_connIdleStart; }
+
 ///////////////////////////////////////////////////////////////////////////////
 
-W5100::socket_e ClientProxy::socket() const
+NetBackend::socket_e ClientProxy::socket() const
 { return my_sn; }
 
 uint16_t ClientProxy::localPort() const
-{ return (prv_isValidSn() ? W5100::read_Sn_R16(my_sn, W5100_Sn_PORT) : 0); }
+{ return (prv_isValidSn() ? NetBackend::localPort(my_sn) : 0); }
 
 uint16_t ClientProxy::remotePort() const
-{ return (prv_isValidSn() ? W5100::read_Sn_R16(my_sn, W5100_Sn_DPORT) : 0); }
+{ return (prv_isValidSn() ? NetBackend::remotePort(my_sn) : 0); }
 
 IPAddress ClientProxy::remoteIpAddr() const
 {
-  W5100::ipv4_address_t ipAddr = prv_isValidSn() ? W5100::ipv4_address_t(my_sn) : W5100::ipv4_address_t(0,0,0,0);
+  NetBackend::ipv4_address_t ipAddr = prv_isValidSn() ? NetBackend::ipv4_address_t(my_sn) : NetBackend::ipv4_address_t(0,0,0,0);
   return IPAddress(ipAddr.ip0(), ipAddr.ip1(), ipAddr.ip2(), ipAddr.ip3());
 }
 
-W5100::mac_address_t ClientProxy::remoteMacAddr() const
-{ return (prv_isValidSn() ? W5100::mac_address_t(my_sn) : W5100::mac_address_t(0,0,0,0,0,0)); }
+NetBackend::mac_address_t ClientProxy::remoteMacAddr() const
+{ return (prv_isValidSn() ? NetBackend::mac_address_t(my_sn) : NetBackend::mac_address_t(0,0,0,0,0,0)); }
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -88,13 +103,13 @@ bool ClientProxy::readByte(uint8_t& the_byte)
     return true;; 
   }
 
-  if (W5100::waitReceivePending(my_sn) != W5100::rc_ok)
+  if (NetBackend::waitReceivePending(my_sn) != NetBackend::rc_ok)
   {
     closeConnection();
     return false;
   }
 
-  uint16_t uRead = W5100::receive(my_sn, &the_byte, 1);
+  uint16_t uRead = NetBackend::receive(my_sn, &the_byte, 1);
   my_totRead += uRead;
   return (uRead == 1);
 }
@@ -114,10 +129,10 @@ uint16_t ClientProxy::readBuffer(uint8_t* the_buffer, uint16_t the_size)
     the_size--;
   }
   
-  if (W5100::waitReceivePending(my_sn) != W5100::rc_ok)
+  if (NetBackend::waitReceivePending(my_sn) != NetBackend::rc_ok)
   { my_totRead += uRead; closeConnection(); return uRead; }
   
-  uRead += W5100::receive(my_sn, the_buffer, the_size);
+  uRead += NetBackend::receive(my_sn, the_buffer, the_size);
   my_totRead += uRead;
   return uRead;
 }
@@ -138,7 +153,7 @@ bool ClientProxy::peekByte(uint8_t& the_byte)
 bool ClientProxy::anyDataReceived() const
 {
   if (!prv_isValidSn()) return false;
-  return (W5100::checkReceivePending(my_sn) == W5100::rc_ok);
+  return (NetBackend::checkReceivePending(my_sn) == NetBackend::rc_ok);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -234,35 +249,93 @@ uint16_t ClientProxy::readToEOL(char * the_buffer, uint16_t the_bufferLen)
 ///////////////////////////////////////////////////////////////////////////////
 
 bool ClientProxy::writeByte(uint8_t the_byte)
-{
-  if (!prv_isValidSn()) return false;
-  if (!W5100::canTransmitData(my_sn)) { closeConnection(); return false; }
-  if (W5100::send(my_sn, &the_byte, 1) != 1) return false;
-  if (W5100::waitSendCompleted(my_sn) != W5100::rc_ok) { closeConnection(); return false; }
-  ++my_totWrite;
-  return true;
-}
+{ return (writeBuffer(&the_byte, 1) == 1); }
 
 uint16_t ClientProxy::writeBuffer(uint8_t * the_buffer, uint16_t the_size)
 {
+  // Data are copied to the tx memory of the socket and sent while previous
+  // data are still in flight: this function waits only when tx memory is full.
+  // Completion of transmission is confirmed by "flush" (or on close).
   if (!prv_isValidSn()) return 0;
-  if (!W5100::canTransmitData(my_sn)) { closeConnection(); return 0; }
-  the_size = W5100::send(my_sn, the_buffer, the_size);
-  if (W5100::waitSendCompleted(my_sn) != W5100::rc_ok) { closeConnection(); return 0; }
-  my_totWrite += the_size;
-  return the_size;
+  
+  uint16_t uWritten = 0;
+  while (uWritten < the_size)
+  {
+    uint16_t u = NetBackend::send(my_sn, the_buffer + uWritten, the_size - uWritten);
+    uWritten += u;
+    if (u) continue;
+    
+    // Nothing written: either the connection has been lost,
+    // or tx memory is full and the chip (or system) must make some progress
+    if (!NetBackend::canTransmitData(my_sn)) { closeConnection(); return 0; }
+    
+    NetBackend::retcode_e rc = NetBackend::waitSendSpace(my_sn);
+    if ((rc != NetBackend::rc_ok) && (rc != NetBackend::rc_send_pending)) { closeConnection(); return 0; }
+  }
+  
+  my_totWrite += uWritten;
+#if HTTPSVR_RESPONSE_CACHE
+  prv_capture(the_buffer, uWritten);
+#endif
+  return uWritten;
 }
 
 void ClientProxy::flush()
 {
-  if (prv_isValidSn()) return;
-  if (W5100::waitSendCompleted(my_sn) != W5100::rc_ok) closeConnection();
+  if (!prv_isValidSn()) return;
+  if (NetBackend::waitSendCompleted(my_sn) != NetBackend::rc_ok) closeConnection();
+}
+
+uint16_t ClientProxy::writeAvailable() const
+{
+  if (!prv_isValidSn()) return 0;
+  if (!NetBackend::canTransmitData(my_sn)) return 0;
+  uint16_t uPending = NetBackend::txSizePending(my_sn);
+  uint16_t uSize    = NetBackend::txMemSize(my_sn);
+  return (uSize > uPending ? uSize - uPending : 0);
+}
+
+void ClientProxy::flush_nonBlk()
+{
+  if (!prv_isValidSn()) return;
+  NetBackend::retcode_e rc = NetBackend::checkSendCompleted(my_sn);
+  if ((rc != NetBackend::rc_ok) && (rc != NetBackend::rc_send_pending)) closeConnection();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_RESPONSE_CACHE
+
+void ClientProxy::beginCapture(uint8_t * the_buffer, uint16_t the_size)
+{
+  my_capture     = the_buffer;
+  my_captureSize = the_size;
+  my_captureUsed = 0;
+  my_captureFull = false;
+}
+
+uint16_t ClientProxy::endCapture()
+{
+  uint16_t uUsed = my_captureFull ? 0 : static_cast<uint16_t>(my_captureUsed);
+  my_capture = 0;
+  return uUsed;
 }
+
+void ClientProxy::prv_capture(const uint8_t * the_data, uint16_t the_size)
+{
+  // Once the buffer has overflowed, the capture is useless anyway
+  if (!my_capture || my_captureFull) return;
+  if (the_size > my_captureSize - my_captureUsed) { my_captureFull = true; return; }
+  memcpy(static_cast<uint8_t *>(my_capture) + my_captureUsed, the_data, the_size);
+  my_captureUsed += the_size;
+}
+
+#endif // #if HTTPSVR_RESPONSE_CACHE
   
 ///////////////////////////////////////////////////////////////////////////////
 
 bool ClientProxy::prv_isValidSn() const
-{ return my_sn != W5100::socket_undefined; }
+{ return my_sn != NetBackend::socket_undefined; }
 
 ///////////////////////////////////////////////////////////////////////////////
 
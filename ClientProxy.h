@@ -17,31 +17,48 @@
 #include <Arduino.h>
 #include <IPAddress.h>
 
-#include "utility/W5100.h"
+#include "HttpSvrConfig.h"
+#include "utility/NetBackend.h"
 #include "utility/vinit.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
 class ClientProxy
 {
+public:
+  // Connection modes: after the response headers, an event stream or a WebSocket
+  // connection is held open, and is no longer served as a sequence of requests
+  enum mode_e
+  {
+    mode_request,
+    mode_eventStream,
+    mode_webSocket
+  };
+
 public:
   ClientProxy();
   virtual ~ClientProxy();
 
 public:
   // Connection management functions
-  void                  setConnection     (W5100::socket_e the_sn);
+  void                  setConnection     (NetBackend::socket_e the_sn);
   bool                  closeConnection   ();
   bool                  isConnected       () const;
   void                  triggerConnTimeout();
   bool                  connTimeoutExpired() const;
+  uint32_t              msIdle            () const;
+  
+  // Connection mode (see HttpSvr::beginEventStream and HttpSvr::acceptWebSocket)
+  void                  setMode           (mode_e the_mode) { my_mode = the_mode; }
+  mode_e                mode              () const { return static_cast<mode_e>(static_cast<uint8_t>(my_mode)); }
+  bool                  isHeldOpen        () const { return my_mode != mode_request; }
   
   // Connection info functions
-  W5100::socket_e       socket            () const;
+  NetBackend::socket_e  socket            () const;
   uint16_t              localPort         () const;
   uint16_t              remotePort        () const;
   IPAddress             remoteIpAddr      () const;
-  W5100::mac_address_t  remoteMacAddr     () const;
+  NetBackend::mac_address_t remoteMacAddr () const;
 
   // Low level read functions
   bool                  readByte          (uint8_t&);
@@ -65,16 +82,41 @@ public:
   void                  flush             ();
   uint32_t              totWrite          () const { return my_totWrite; }
 
+  // Non-blocking write functions
+  // writeAvailable reports how many bytes can be written without waiting;
+  // flush_nonBlk pushes out queued data, if possible, without waiting.
+  uint16_t              writeAvailable    () const;
+  void                  flush_nonBlk      ();
+
+#if HTTPSVR_RESPONSE_CACHE
+  // Capture of written data (see HttpSvr::cacheResponse)
+  // Between beginCapture and endCapture, everything written is also copied to
+  // the given buffer; endCapture returns the number of bytes copied, or 0 if
+  // they did not fit in the buffer.
+  void                  beginCapture      (uint8_t * the_buffer, uint16_t the_size);
+  uint16_t              endCapture        ();
+#endif
+
 private:
   bool                  prv_isValidSn     () const;
+#if HTTPSVR_RESPONSE_CACHE
+  void                  prv_capture       (const uint8_t * the_data, uint16_t the_size);
+#endif
   
 private:
-  W5100::socket_e       my_sn;
+  NetBackend::socket_e  my_sn;
   ext::vinit<uint8_t>   my_unreadByte;
   ext::vinit<bool>      my_unreadByteAvail;
   ext::vinit<uint32_t>  my_totRead;
   ext::vinit<uint32_t>  my_totWrite;
   ext::vinit<uint32_t>  my_connIdleStart;
+  ext::vinit<uint8_t>   my_mode;
+#if HTTPSVR_RESPONSE_CACHE
+  ext::vinit<uint8_t *> my_capture;
+  ext::vinit<uint16_t>  my_captureSize;
+  ext::vinit<uint16_t>  my_captureUsed;
+  ext::vinit<bool>      my_captureFull;
+#endif
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpParams.cpp - Definition of an iterator over url-encoded parameters
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "HttpParams.h"
+#include "utility/crc16.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char local_empty[] = "";
+
+///////////////////////////////////////////////////////////////////////////////
+
+HttpParams::HttpParams()
+: my_pos(0)
+, my_end(0)
+, my_name(local_empty)
+, my_value(local_empty)
+{}
+
+HttpParams::HttpParams(char * the_buffer, uint16_t the_size)
+: my_pos(the_buffer)
+, my_end(the_buffer ? the_buffer + the_size : 0)
+, my_name(local_empty)
+, my_value(local_empty)
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HttpParams::next()
+{
+  while (my_pos < my_end)
+  {
+    // Both name and value are decoded where they are, and terminated at the latest
+    // on the delimiter that follows them, so that decoding never overwrites chars
+    // not yet read
+    char   chStop;
+    char * pName = my_pos;
+    char * pStop = prv_decode(pName, my_end, true, chStop);
+    my_name  = pName;
+    my_value = local_empty;
+
+    if (chStop == '=')
+    {
+      char * pValue = pStop + 1;
+      pStop = prv_decode(pValue, my_end, false, chStop);
+      my_value = pValue;
+    }
+
+    my_pos = pStop + 1;
+
+    // Skip empty pairs, such as those between "&&"
+    if (*my_name || *my_value) return true;
+  }
+
+  my_pos = my_end;
+  my_name = my_value = local_empty;
+  return false;
+}
+
+bool HttpParams::find(const char * the_name)
+{
+  while (next())
+    if (is(the_name)) return true;
+  return false;
+}
+
+bool HttpParams::find(uint16_t the_nameHash)
+{
+  while (next())
+    if (nameHash() == the_nameHash) return true;
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HttpParams::is(const char * the_name) const
+{ return the_name && (strcmp(my_name, the_name) == 0); }
+
+uint16_t HttpParams::nameHash() const
+{ return hash(my_name); }
+
+uint16_t HttpParams::hash(const char * the_name)
+{ return the_name ? crcsum(the_name, strlen(the_name), CRC_INIT) : CRC_INIT; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+long HttpParams::toInt(long the_default) const
+{
+  if (!*my_value) return the_default;
+  char * pEnd;
+  long lValue = strtol(my_value, &pEnd, 10);
+  return (*pEnd ? the_default : lValue);
+}
+
+bool HttpParams::toBool(bool the_default) const
+{
+  static const char * const sTrue [] = { "1", "true",  "on",  "yes" };
+  static const char * const sFalse[] = { "0", "false", "off", "no"  };
+
+  if (toEnum(sTrue,  sizeof(sTrue)  / sizeof(*sTrue))  >= 0) return true;
+  if (toEnum(sFalse, sizeof(sFalse) / sizeof(*sFalse)) >= 0) return false;
+  return the_default;
+}
+
+int8_t HttpParams::toEnum(const char * const * the_names, uint8_t the_count, int8_t the_default) const
+{
+  if (!the_names) return the_default;
+  for (uint8_t u = 0; u < the_count; ++u)
+    if (the_names[u] && (strcasecmp(my_value, the_names[u]) == 0))
+      return static_cast<int8_t>(u);
+  return the_default;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+char * HttpParams::prv_decode(char * the_src, char * the_end, bool the_isName, char& the_stop)
+{
+  // Decodes the chars starting at the_src up to the first delimiter ('&', or
+  // also '=' if a name is being decoded) or the_end, writing them back from
+  // the_src onwards. Returns the position of the delimiter and the delimiter
+  // itself (0 at the_end), since the terminator may be written over it.
+  char * pDst = the_src;
+  char * pSrc = the_src;
+  for (; pSrc < the_end; ++pSrc)
+  {
+    char ch = *pSrc;
+    if ((ch == '&') || (the_isName && (ch == '='))) break;
+
+    if (ch == '+') ch = ' ';
+    else if ((ch == '%') && (the_end - pSrc > 2))
+    {
+      int8_t hi = prv_hexDigit(pSrc[1]);
+      int8_t lo = prv_hexDigit(pSrc[2]);
+      // Invalid sequences, and "%00", are kept as they are
+      if ((hi >= 0) && (lo >= 0) && (hi || lo))
+      {
+        ch = static_cast<char>((hi << 4) | lo);
+        pSrc += 2;
+      }
+    }
+    *pDst++ = ch;
+  }
+
+  the_stop = (pSrc < the_end) ? *pSrc : 0;
+  *pDst = 0;
+  return pSrc;
+}
+
+int8_t HttpParams::prv_hexDigit(char the_ch)
+{
+  if ((the_ch >= '0') && (the_ch <= '9')) return the_ch - '0';
+  if ((the_ch >= 'A') && (the_ch <= 'F')) return the_ch - 'A' + 10;
+  if ((the_ch >= 'a') && (the_ch <= 'f')) return the_ch - 'a' + 10;
+  return -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpParams.h - Definition of an iterator over url-encoded parameters
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HTTPPARAMS_H
+#define HTTPPARAMS_H
+
+#include <Arduino.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// HttpParams walks through the "name=value&name=value..." pairs of a query
+// string or of an application/x-www-form-urlencoded body.
+// No copy is made: names and values are decoded ("%XX" and '+') in place,
+// in the buffer given to the constructor, and null-terminated there, so that
+// name() and value() point into that buffer. Since decoding is destructive,
+// parameters can be visited only once, in the order they appear:
+//    HttpParams aParams(sBuffer, uLength);
+//    while (aParams.next())
+//      if (aParams.is("pin")) iPin = aParams.toInt(-1);
+// Lookup functions (find) move forward from the current parameter as well.
+// A parameter without '=' has an empty value.
+// The buffer must have room for a terminator after its last char (i.e. it
+// must be at least the_size + 1 chars long), as strings usually have.
+
+class HttpParams
+{
+public:
+  HttpParams();
+  HttpParams(char * the_buffer, uint16_t the_size);
+
+public:
+  // Iteration
+  bool                  next      ();
+  bool                  find      (const char * the_name);
+  bool                  find      (uint16_t the_nameHash);
+  bool                  atEnd     () const { return my_pos >= my_end; }
+
+  // Current parameter
+  const char *          name      () const { return my_name; }
+  const char *          value     () const { return my_value; }
+  bool                  is        (const char * the_name) const;
+  uint16_t              nameHash  () const;
+
+  // Typed accessors of the current value; the default is returned when the
+  // value is missing or is not valid
+  long                  toInt     (long the_default = 0) const;
+  bool                  toBool    (bool the_default = false) const;
+  int8_t                toEnum    (const char * const * the_names, uint8_t the_count, int8_t the_default = -1) const;
+
+  // Hash of a name, as returned by nameHash (CRC-16 of the decoded name).
+  // Comparing hashes is cheaper than comparing strings when many names are tested.
+  static uint16_t       hash      (const char * the_name);
+
+private:
+  static char *         prv_decode  (char * the_src, char * the_end, bool the_isName, char& the_stop);
+  static int8_t         prv_hexDigit(char the_ch);
+
+private:
+  char *                my_pos;
+  char *                my_end;
+  const char *          my_name;
+  const char *          my_value;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef HTTPPARAMS_H
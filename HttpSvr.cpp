@@ -19,18 +19,20 @@
 
 #include "HttpSvr.h"
 #include "ClientProxy.h"
-#include "utility/SdSvr.h"
+#include "ResponseWriter.h"
 #include "utility/crc16.h"
-#include "utility/W5100.h"
+#include "utility/NetBackend.h"
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static const uint16_t  local_maxUrlLength        = 128;
-static const uint16_t  local_maxFieldNameLength  =  64;
-static const uint16_t  local_maxFieldValueLength = 256;
+static const uint16_t  local_maxUrlLength        = HttpSvrConfig::maxUrlLength;
+static const uint16_t  local_maxFieldNameLength  = HttpSvrConfig::maxFieldNameLength;
+static const uint16_t  local_maxFieldValueLength = HttpSvrConfig::maxFieldValueLength;
+static const uint8_t   local_noRoute             = 0xFF;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -45,7 +47,7 @@ static uint32_t local_boundedStrLen(const char * the_s, uint32_t the_maxLength)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-bool local_isBoundary(const char *the_buffer, uint16_t the_bufferLen, uint16_t the_boundaryCRC)
+bool local_isBoundary(const char *the_buffer, uint16_t the_bufferLen, uint16_t the_boundaryCRC, uint16_t the_boundaryLen)
 {
   if (!the_buffer) return false;
   if (the_bufferLen < 4) return false;
@@ -57,16 +59,19 @@ bool local_isBoundary(const char *the_buffer, uint16_t the_bufferLen, uint16_t t
   the_bufferLen -= 4;
 
   // Discard the last two hyphens, if any, to handle the last boundary delimiter line
-  if ((the_buffer[the_bufferLen-2] == '-') && (the_buffer[the_bufferLen-1] == '-'))
+  if ((the_bufferLen >= 2) && (the_buffer[the_bufferLen-2] == '-') && (the_buffer[the_bufferLen-1] == '-'))
     the_bufferLen -= 2;
     
+  // Lines of data starting with "--" are rejected by their length, without hashing
+  if (the_bufferLen != the_boundaryLen) return false;
+
   // Compare the crc16 of the candidate line with the given boundary's crc
   return (the_boundaryCRC == crcsum(the_buffer, the_bufferLen, CRC_INIT));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-bool local_skipBeyondBoundary(ClientProxy& the_client, uint16_t the_boundaryCRC, char *the_buffer, uint16_t the_bufferLen)
+bool local_skipBeyondBoundary(ClientProxy& the_client, uint16_t the_boundaryCRC, uint16_t the_boundaryLen, char *the_buffer, uint16_t the_bufferLen)
 {
   // This function consumes all chars up to the boundary delimiter,
   // then consumes the boundary delimiter itself
@@ -77,16 +82,94 @@ bool local_skipBeyondBoundary(ClientProxy& the_client, uint16_t the_boundaryCRC,
   {
     uint16_t uRead = the_client.readToEOL(the_buffer, the_bufferLen);
     if (uRead == 0) return false;
-    if (local_isBoundary(the_buffer, uRead, the_boundaryCRC)) return true;
+    if (local_isBoundary(the_buffer, uRead, the_boundaryCRC, the_boundaryLen)) return true;
   }
   return false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#if HTTPSVR_ETAG
+
+// ETags of files cached in RAM or bundled in flash are the CRC of their content,
+// as 4 hex digits in quotes
+static const uint8_t local_etagLength = 6;
+
+static void local_formatEtag(char * the_dst, uint16_t the_etag)
+{
+  static const char sHex[] = "0123456789abcdef";
+  the_dst[0] = '"';
+  for (uint8_t u = 0; u < 4; ++u)
+    the_dst[1 + u] = sHex[(the_etag >> (12 - 4 * u)) & 0x0F];
+  the_dst[5] = '"';
+}
+
+static int32_t local_parseEtag(const char * the_value)
+{
+  // Returns -1 unless the value is an ETag made by local_formatEtag
+  if (!the_value || (strlen(the_value) != local_etagLength)) return -1;
+  if ((the_value[0] != '"') || (the_value[5] != '"')) return -1;
+  int32_t iEtag = 0;
+  for (uint8_t u = 1; u < 5; ++u)
+  {
+    char ch = the_value[u];
+    if      ((ch >= '0') && (ch <= '9')) iEtag = (iEtag << 4) | (ch - '0');
+    else if ((ch >= 'a') && (ch <= 'f')) iEtag = (iEtag << 4) | (ch - 'a' + 10);
+    else return -1;
+  }
+  return iEtag;
+}
+
+#endif // #if HTTPSVR_ETAG
+
+///////////////////////////////////////////////////////////////////////////////
+
 HttpSvr::HttpSvr()
-: my_sdSvr()
-{ resetAllBindings(); }
+: my_port(0)
+, my_lastRoute(local_noRoute)
+, my_urlBuffer(0)
+, my_urlBufferLen(0)
+#if HTTPSVR_SSE
+, my_eventsDropped(0)
+#endif
+#if HTTPSVR_WEBSOCKET
+, my_wsHandler(0)
+#endif
+#if HTTPSVR_ETAG
+, my_ifNoneMatch(-1)
+#endif
+#if HTTPSVR_BUNDLE
+, my_acceptsGzip(false)
+#endif
+#if HTTPSVR_PUT
+, my_authHandler(0)
+, my_contentLength(-1)
+, my_chunkedBody(false)
+#endif
+{ 
+  resetAllBindings();
+#if HTTPSVR_WEBSOCKET
+  my_wsKey[0] = 0;
+#endif
+#if HTTPSVR_PUT
+  my_authorization[0] = 0;
+#endif
+#if HTTPSVR_METRICS
+  resetMetrics();
+#endif
+#if HTTPSVR_PINIO
+  memset(my_pinIoWritable, 0, sizeof(my_pinIoWritable));
+#endif
+#if HTTPSVR_RESPONSE_CACHE
+  // Each entry starts with its own block, the last one being the spare block
+  for (uint8_t u = 0; u < smy_respEntries; ++u)
+    my_respCache[u].block = u;
+  my_respSpare    = smy_respEntries;
+  my_respUseCount = 0;
+  my_respWanted   = false;
+  my_respMs       = 0;
+#endif
+}
 
 HttpSvr::~HttpSvr()
 { terminate(); }
@@ -96,23 +179,44 @@ HttpSvr::~HttpSvr()
 void HttpSvr::begin_noDHCP(const uint8_t* the_macAddress, const IPAddress& the_ipAddress, uint16_t the_port)
 { 
   // Connect using fixed IP
-  W5100::begin(W5100::mac_address_t(the_macAddress),
-               W5100::ipv4_address_t(the_ipAddress[0],the_ipAddress[1],the_ipAddress[2],the_ipAddress[3]));
+  NetBackend::begin(NetBackend::mac_address_t(the_macAddress),
+                    NetBackend::ipv4_address_t(the_ipAddress[0],the_ipAddress[1],the_ipAddress[2],the_ipAddress[3]));
   
-  for (uint8_t sn = W5100::socket_begin; sn < W5100::socket_end; ++sn)
-    prv_resetSocket(W5100::socket_cast(sn), the_port);
+  my_port = the_port;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+    prv_resetSocket(NetBackend::socket_cast(sn), the_port);
 }
 
 void HttpSvr::begin_noDHCP(int the_sdPinSS, int the_sdPinCS, const uint8_t* the_macAddress, const IPAddress& the_ipAddress, uint16_t the_port)
-{ my_sdSvr.begin(the_sdPinSS, the_sdPinCS); begin_noDHCP(the_macAddress, the_ipAddress, the_port); }
+{ 
+#if HTTPSVR_SD
+  my_sdSvr.begin(the_sdPinSS, the_sdPinCS);
+#else
+  (void)the_sdPinSS;
+  (void)the_sdPinCS;
+#endif
+  begin_noDHCP(the_macAddress, the_ipAddress, the_port);
+}
 
 void HttpSvr::terminate()
 { 
   resetAllBindings();
+#if HTTPSVR_SD
   my_sdSvr.terminate();
-  W5100::terminate();
+#endif
+  NetBackend::terminate();
 }
 
+#if HTTPSVR_BUNDLE
+void HttpSvr::setFlashBundle(const FlashBundle::entry_t * the_entries, uint16_t the_count)
+{ my_bundle.begin(the_entries, the_count); }
+#endif
+
+#if HTTPSVR_SD
+void HttpSvr::flushFileCache()
+{ my_sdSvr.forgetAllResFiles(); }
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool HttpSvr::bindUrl(const char * the_url, url_callback_t the_callback)
@@ -138,6 +242,32 @@ bool HttpSvr::bindUrl(const char * the_url, url_callback_t the_callback)
   return true;
 }
 
+#if HTTPSVR_TEMPLATES
+bool HttpSvr::bindTemplateVar(const char * the_name, var_callback_t the_callback)
+{
+  if (!the_name) return false;
+  if (!the_callback) return false;
+
+  // As for URLs, the CRC16 of the name is stored instead of the name itself
+  uint32_t len = local_boundedStrLen(the_name, local_maxUrlLength);
+  if (len == 0) return false;
+  uint16_t crc = crcsum(the_name, len, CRC_INIT);
+
+  // A name already bound is bound again
+  uint8_t u;
+  for (u = 0; u < smy_templateVars; ++u)
+    if (my_templateVars[u].crc == crc) break;
+  if (u >= smy_templateVars)
+    for (u = 0; u < smy_templateVars; ++u)
+      if (my_templateVars[u].crc == 0) break;
+  if (u >= smy_templateVars) return false;
+
+  my_templateVars[u].crc = crc;
+  my_templateVars[u].fn  = the_callback;
+  return true;
+}
+#endif
+
 bool HttpSvr::isUrlBound(const char * the_url)
 {
   if (!the_url) return false;
@@ -167,6 +297,9 @@ bool HttpSvr::resetUrlBinding(const char * the_url)
   if (u >= smy_resMap_size) return false;
   
   // Reset bind info
+#if HTTPSVR_RESPONSE_CACHE
+  invalidateResponses(the_url);
+#endif
   my_resMap[u] = res_fn_pair();
   return true;
 }
@@ -175,8 +308,100 @@ void HttpSvr::resetAllBindings()
 {
   for (uint8_t u = 0; u < smy_resMap_size; ++u)
     my_resMap[u] = res_fn_pair();
+#if HTTPSVR_RESPONSE_CACHE
+  invalidateAllResponses();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_RESPONSE_CACHE
+
+static const char     local_status200[]   = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP;
+static const uint16_t local_status200_len = sizeof(local_status200) - 1;
+
+void HttpSvr::cacheResponse(uint32_t the_ms)
+{
+  // Only noted here: the response is kept once the provider has returned
+  my_respWanted = true;
+  my_respMs     = the_ms;
+}
+
+void HttpSvr::invalidateResponses(const char * the_url)
+{
+  if (!the_url) return;
+
+  // Responses are dropped for all the queries of the bound URL
+  uint32_t len = local_boundedStrLen(the_url, local_maxUrlLength);
+  if (len == 0) return;
+  uint16_t crc = crcsum(the_url, len, CRC_INIT);
+  for (uint8_t u = 0; u < smy_resMap_size; ++u)
+  {
+    if (my_resMap[u].crc != crc) continue;
+    for (uint8_t v = 0; v < smy_respEntries; ++v)
+      if (my_respCache[v].res == u) my_respCache[v].crc = 0;
+  }
+}
+
+void HttpSvr::invalidateAllResponses()
+{
+  for (uint8_t u = 0; u < smy_respEntries; ++u)
+    my_respCache[u].crc = 0;
+}
+
+bool HttpSvr::prv_callCachedProvider(ClientProxy& the_client, uint8_t the_idx, const char * the_urlBuffer)
+{
+  // The whole URL is looked for, since the response may depend on the query
+  uint16_t crc = crcsum(the_urlBuffer, local_boundedStrLen(the_urlBuffer, local_maxUrlLength), CRC_INIT);
+  for (uint8_t u = 0; u < smy_respEntries; ++u)
+  {
+    cachedResponse_t& aResp = my_respCache[u];
+    if ((aResp.crc != crc) || (aResp.res != the_idx)) continue;
+    if (aResp.ms && (millis() - aResp.stamp >= aResp.ms)) { aResp.crc = 0; break; }
+
+    // Headers and body in a single write
+    aResp.lastUse = ++my_respUseCount;
+    prv_countStatus(http_metrics::st_200);
+    uint8_t * pBlock = my_respPool + aResp.block * smy_respBlockSize;
+    return (the_client.writeBuffer(pBlock, aResp.size) == aResp.size);
+  }
+
+  // The response is captured in the spare block while the provider sends it
+  my_respWanted = false;
+  uint8_t * pSpare = my_respPool + my_respSpare * smy_respBlockSize;
+  the_client.beginCapture(pSpare, smy_respBlockSize);
+  bool bOk = (my_resMap[the_idx].fn)(the_client, http_e::mthd_get, the_urlBuffer);
+  uint16_t uSize = the_client.endCapture();
+
+  // Event streams and WebSocket connections are never kept, nor errors
+  if (!bOk || !my_respWanted || !uSize || the_client.isHeldOpen()) return bOk;
+  if ((uSize < local_status200_len) || memcmp(pSpare, local_status200, local_status200_len)) return bOk;
+
+  // The spare block goes to a free entry, or to the least recently used one,
+  // whose block becomes the spare one: nothing is copied
+  uint8_t uOldest = 0;
+  for (uint8_t u = 0; u < smy_respEntries; ++u)
+  {
+    if (!my_respCache[u].crc) { uOldest = u; break; }
+    if (static_cast<uint16_t>(my_respUseCount - my_respCache[u].lastUse) >
+        static_cast<uint16_t>(my_respUseCount - my_respCache[uOldest].lastUse))
+      uOldest = u;
+  }
+  cachedResponse_t& aResp = my_respCache[uOldest];
+  uint8_t uBlock = aResp.block;
+  aResp.block   = my_respSpare;
+  my_respSpare  = uBlock;
+  aResp.crc     = crc;
+  aResp.res     = the_idx;
+  aResp.size    = uSize;
+  aResp.stamp   = millis();
+  aResp.ms      = my_respMs;
+  aResp.lastUse = ++my_respUseCount;
+  return true;
 }
 
+#endif // #if HTTPSVR_RESPONSE_CACHE
+
 ///////////////////////////////////////////////////////////////////////////////
 
 ClientProxy HttpSvr::pollClient(http_e::poll_type the_pollType) const
@@ -193,12 +418,12 @@ ClientProxy HttpSvr::pollClient_nonBlk() const
 { 
   ClientProxy aClient;
   
-  for (uint8_t sn = W5100::socket_begin; sn < W5100::socket_end; ++sn)
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
   {
-    switch (W5100::checkClientConn(W5100::socket_cast(sn)))
+    switch (NetBackend::checkClientConn(NetBackend::socket_cast(sn)))
     {
-    case W5100::rc_ok:
-      aClient.setConnection(W5100::socket_cast(sn));
+    case NetBackend::rc_ok:
+      aClient.setConnection(NetBackend::socket_cast(sn));
       return aClient;
       
     default:
@@ -228,15 +453,15 @@ ClientProxy HttpSvr::pollClient_blk(unsigned long the_msTimeout) const
 
 void HttpSvr::resetConnection(ClientProxy& the_client) const
 { 
-  W5100::socket_e sn = the_client.socket();
-  uint16_t        port = the_client.localPort();
+  NetBackend::socket_e sn   = the_client.socket();
+  uint16_t             port = the_client.localPort();
   the_client.closeConnection();
   prv_resetSocket(sn, port);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static ClientProxy clients[W5100::socket_end];
+static ClientProxy clients[HttpSvrConfig::sockets];
 
 uint8_t HttpSvr::serveHttpConnections()
 {
@@ -244,22 +469,32 @@ uint8_t HttpSvr::serveHttpConnections()
 
   uint8_t uNewConn = 0;
   
+#ifdef W5100_DBG_PIN1
   digitalWrite(W5100_DBG_PIN1, LOW);
-  for (uint8_t sn = W5100::socket_begin; sn < W5100::socket_end; ++sn)
+#endif
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
   {
     if (!clients[sn].isConnected())
     {
-      if (W5100::isClosed(W5100::socket_cast(sn)))
+      if (clients[sn].socket() != NetBackend::socket_undefined)
       {
-        // If the socket is closed, we must recover it
+        // The client has closed its connection between requests (e.g. a browser
+        // dropping an idle keep-alive connection, or the end of a held-open one):
+        // the socket would stay in CLOSE_WAIT, recover it
         resetConnection(clients[sn]);
       }
+      else if (NetBackend::isClosed(NetBackend::socket_cast(sn)))
+      {
+        // If the socket is closed, we must recover it. The client may no longer
+        // know it (e.g. after a failed read), so reopen it by its number
+        prv_resetSocket(NetBackend::socket_cast(sn), my_port);
+      }
       else
       {
         // If this client is not currently connected, check if there is an incoming connection
-        if (W5100::checkClientConn(W5100::socket_cast(sn)) == W5100::rc_ok)
+        if (NetBackend::checkClientConn(NetBackend::socket_cast(sn)) == NetBackend::rc_ok)
         {
-          clients[sn].setConnection(W5100::socket_cast(sn));
+          clients[sn].setConnection(NetBackend::socket_cast(sn));
           clients[sn].triggerConnTimeout();
           uNewConn++;
         }
@@ -267,28 +502,65 @@ uint8_t HttpSvr::serveHttpConnections()
     }
     else
     {
+#ifdef W5100_DBG_PIN1
       digitalWrite(W5100_DBG_PIN1, HIGH);
+#endif
       
+#if HTTPSVR_SSE
+      // Event streams are held open, with no timeout, and only need some care
+      if (clients[sn].mode() == ClientProxy::mode_eventStream)
+      {
+        prv_serveEventStream(clients[sn]);
+        continue;
+      }
+#endif
+
+#if HTTPSVR_WEBSOCKET
+      // WebSocket connections are held open as well, and carry messages instead of requests
+      if (clients[sn].mode() == ClientProxy::mode_webSocket)
+      {
+        prv_serveWebSocket(clients[sn]);
+        continue;
+      }
+#endif
+
       // If this client is already connected, serve its requests if any
       if (clients[sn].anyDataReceived())
       {
         // Some data are pending from this client: let's refresh its connection timeout
         // and serve its request
 
-        char urlBuffer[local_maxUrlLength];
+        char * urlBuffer    = my_arena.alloc_chars(local_maxUrlLength);
+        uint32_t msStart    = millis();
+        uint32_t uReadStart = clients[sn].totRead();
+        uint32_t uWriteStart= clients[sn].totWrite();
         
         clients[sn].triggerConnTimeout();
-        if (!serveRequest_GETPOST(clients[sn], urlBuffer, sizeof(urlBuffer)))
+        bool bServed = urlBuffer && serveRequest_GETPOST(clients[sn], urlBuffer, local_maxUrlLength);
+        prv_countTraffic(clients[sn].totRead() - uReadStart, clients[sn].totWrite() - uWriteStart);
+        prv_countLatency(my_lastRoute, millis() - msStart);
+        my_arena.reset();
+        if (!bServed)
         {
           // Something went wrong during service: reset this client's connection
+          prv_countReset();
+          HttpTrace_EVENT(ev_reset, sn, 0);
           resetConnection(clients[sn]);
         }
       }
       else
       {
+        // Responses are not waited for: the tail of the last one may still be queued
+        // behind a SEND command in flight, and is passed on once that one completes
+        if (NetBackend::txSizeQueued(NetBackend::socket_cast(sn))) clients[sn].flush_nonBlk();
+
         // No data since last inquiry. Let's check for connection timeout
         if (clients[sn].connTimeoutExpired())
+        {
+          prv_countTimeout();
+          HttpTrace_EVENT(ev_timeout, sn, 0);
           resetConnection(clients[sn]);
+        }
       }
     }
   }
@@ -310,7 +582,10 @@ bool HttpSvr::serveRequest_GET(ClientProxy& the_client, char * the_urlBuffer, ui
   if (!the_bufferLen) return false;
 
   http_e::method aMethod;
+  prv_startRequest(the_urlBuffer, the_bufferLen);
   if (!prv_readRequestLine(the_client, aMethod, the_urlBuffer, the_bufferLen)) return false;
+  prv_countRequest(aMethod);
+  HttpTrace_EVENT(ev_requestLine, the_client.socket(), aMethod);
   if (!dispatchRequest_GET(the_client, aMethod, the_urlBuffer)) return false;
   return true;
 }
@@ -327,7 +602,10 @@ bool HttpSvr::serveRequest_POST(ClientProxy& the_client, char * the_urlBuffer, u
   if (!the_bufferLen) return false;
 
   http_e::method aMethod;
+  prv_startRequest(the_urlBuffer, the_bufferLen);
   if (!prv_readRequestLine(the_client, aMethod, the_urlBuffer, the_bufferLen)) return false;
+  prv_countRequest(aMethod);
+  HttpTrace_EVENT(ev_requestLine, the_client.socket(), aMethod);
   if (!dispatchRequest_POST(the_client, aMethod, the_urlBuffer)) return false;
   return true;
 }
@@ -343,11 +621,45 @@ bool HttpSvr::serveRequest_GETPOST(ClientProxy& the_client, char * the_urlBuffer
   if (!the_bufferLen) return false;
 
   http_e::method aMethod;
+  prv_startRequest(the_urlBuffer, the_bufferLen);
   if (!prv_readRequestLine(the_client, aMethod, the_urlBuffer, the_bufferLen)) return false;
+  prv_countRequest(aMethod);
+  HttpTrace_EVENT(ev_requestLine, the_client.socket(), aMethod);
   if (!dispatchRequest_GETPOST(the_client, aMethod, the_urlBuffer)) return false;
   return true;
 }
 
+void HttpSvr::prv_startRequest(char * the_urlBuffer, uint16_t the_bufferLen)
+{
+  // Forget everything about the previous request
+  my_lastRoute    = local_noRoute;
+  my_urlBuffer    = the_urlBuffer;
+  my_urlBufferLen = the_bufferLen;
+#if HTTPSVR_WEBSOCKET
+  my_wsKey[0]     = 0;
+#endif
+#if HTTPSVR_ETAG
+  my_ifNoneMatch  = -1;
+#endif
+#if HTTPSVR_BUNDLE
+  my_acceptsGzip  = false;
+#endif
+#if HTTPSVR_PUT
+  my_contentLength    = -1;
+  my_chunkedBody      = false;
+  my_authorization[0] = 0;
+#endif
+}
+
+uint8_t HttpSvr::prv_heldOpen() const
+{
+  // Connections held open by event streams and WebSockets
+  uint8_t uHeldOpen = 0;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+    if (clients[sn].isHeldOpen()) ++uHeldOpen;
+  return uHeldOpen;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool HttpSvr::readRequestLine(ClientProxy& the_client, http_e::method& the_method, char * the_urlBuffer, uint16_t the_bufferLen) const
@@ -382,7 +694,12 @@ bool HttpSvr::dispatchRequest_POST(ClientProxy& the_client, http_e::method the_m
   switch (the_method)
   {
   case http_e::mthd_head: sendResponseOk(the_client); return true;
-  case http_e::mthd_post: return prv_dispatchPOST(the_client, the_urlBuffer);
+  case http_e::mthd_post:
+    // With POST disabled, the compiler drops the call and the whole POST handling
+    if (!HttpSvrConfig::post) { sendResponseMethodNotAllowed(the_client); return false; }
+    return prv_dispatchPOST(the_client, the_urlBuffer);
+  case http_e::mthd_put   : return prv_dispatchPUT   (the_client, the_urlBuffer);
+  case http_e::mthd_delete: return prv_dispatchDELETE(the_client, the_urlBuffer);
   default               : sendResponseBadRequest(the_client); return false;
   }
 }
@@ -396,7 +713,11 @@ bool HttpSvr::dispatchRequest_GETPOST(ClientProxy& the_client, http_e::method th
   {
   case http_e::mthd_get : return prv_dispatchGET(the_client, the_urlBuffer);
   case http_e::mthd_head: sendResponseOk(the_client); return true;
-  case http_e::mthd_post: return prv_dispatchPOST(the_client, the_urlBuffer);
+  case http_e::mthd_post:
+    if (!HttpSvrConfig::post) { sendResponseMethodNotAllowed(the_client); return false; }
+    return prv_dispatchPOST(the_client, the_urlBuffer);
+  case http_e::mthd_put   : return prv_dispatchPUT   (the_client, the_urlBuffer);
+  case http_e::mthd_delete: return prv_dispatchDELETE(the_client, the_urlBuffer);
   default               : sendResponseBadRequest(the_client); return false;
   }
 }
@@ -429,34 +750,42 @@ bool HttpSvr::readNextHeader(ClientProxy& the_client,
   while (true)
   {
     if (!the_client.peekByte(ch)) return false;
-    if ((ch != ' ') || (ch != '\t')) break;
+    if ((ch != ' ') && (ch != '\t')) break;
     the_client.skipToNextLine();
     if (!the_client.readCRLF()) return false;
   }
 
-  // Read field name
+  // Read field name (names longer than the buffer are refused)
+  bool bKeepName  = the_fieldName  && the_fieldNameLen;
+  bool bKeepValue = the_fieldValue && the_fieldValueLen;
   uint16_t u = 0;
-  while (u < the_fieldNameLen-1)
+  uint16_t uNameLen = 0;
+  while (true)
   {
     if (!the_client.readByte(ch)) return false;
     if (ch == '\r') { the_client.unreadByte(ch); break; }
     if (ch == ':') break;
-    if (the_fieldName && the_fieldNameLen) the_fieldName[u++] = ch;
+    if (bKeepName)
+    {
+      if (u >= the_fieldNameLen-1) return false;
+      the_fieldName[u++] = ch;
+    }
+    ++uNameLen;
   }
-  if (the_fieldName && the_fieldNameLen) the_fieldName[u] = 0;
-  if ((ch == '\r') && (u != 0)) return false; // \r  is allowed only if the line is empty
-  if ((ch != ':' ) && (u != 0)) return false; // ':' is the only delimiter allowed if the line is not empty
+  if (bKeepName) the_fieldName[u] = 0;
+  if ((ch == '\r') && (uNameLen != 0)) return false; // \r  is allowed only if the line is empty
 
-  // Read field value
+  // Read field value (values longer than the buffer are truncated, the rest of
+  // the line being discarded, so that the next header is read correctly)
   u = 0;
   the_client.skipAllLWS();
-  while (u < the_fieldValueLen-1)
+  while (true)
   {
     if (!the_client.readByte(ch)) return false;
     if (ch == '\r') { the_client.unreadByte(ch); break; }
-    if (the_fieldValue && the_fieldValueLen) the_fieldValue[u++] = ch;
+    if (bKeepValue && (u < the_fieldValueLen-1)) the_fieldValue[u++] = ch;
   }
-  if (the_fieldValue && the_fieldValueLen) the_fieldValue[u] = 0;
+  if (bKeepValue) the_fieldValue[u] = 0;
 
   return true;
 }
@@ -467,8 +796,11 @@ bool HttpSvr::skipHeaders(ClientProxy& the_client) const
   // (empty line or end of message).
   // It returns TRUE if the end of headers is successfully reached,
   // FALSE otherwise.
-  char sFieldName[local_maxFieldNameLength];
-  while (readNextHeader(the_client, sFieldName, sizeof(sFieldName), 0, 0))
+  ext::arena_scope<arena_t> aScope(my_arena);
+  char * sFieldName = my_arena.alloc_chars(local_maxFieldNameLength);
+  if (!sFieldName) return false;
+  
+  while (readNextHeader(the_client, sFieldName, local_maxFieldNameLength, 0, 0))
     if (sFieldName[0] == 0) return true;
   return false;
 }
@@ -478,13 +810,16 @@ uint16_t HttpSvr::skipToBody(ClientProxy& the_client) const
   // This function reads all headers and discards all, and goes to the
   // beginning of body, if any. It returns the value of "Content-Length",
   // if present, so as to allow reading the message body correctly.
-  char sFieldName [local_maxFieldNameLength ];
-  char sFieldValue[local_maxFieldValueLength];
+  // If no scratch memory is available, headers are not consumed and 0 is returned.
+  ext::arena_scope<arena_t> aScope(my_arena);
+  char * sFieldName  = my_arena.alloc_chars(local_maxFieldNameLength );
+  char * sFieldValue = my_arena.alloc_chars(local_maxFieldValueLength);
+  if (!sFieldName || !sFieldValue) return 0;
   uint16_t uBodyLength = 0;
     
   // Consume all headers
   bool bOk;
-  while ((bOk = readNextHeader(the_client, sFieldName, sizeof(sFieldName), sFieldValue, sizeof(sFieldValue))))
+  while ((bOk = readNextHeader(the_client, sFieldName, local_maxFieldNameLength, sFieldValue, local_maxFieldValueLength)))
   {
     if (!sFieldName[0]) break;
     if (!strcasecmp(sFieldName, HttpSvr_content_length))
@@ -492,33 +827,170 @@ uint16_t HttpSvr::skipToBody(ClientProxy& the_client) const
       // A "Content-Length" header has been found, so we must remember its value
       // to skip the message body following headers
       uBodyLength = atoi(sFieldValue);
+#if HTTPSVR_PUT
+      // Kept in full for PUT, whose body may be longer than 64 kB
+      long lLength = atol(sFieldValue);
+      my_contentLength = (lLength >= 0) ? lLength : -1;
+#endif
+    }
+#if HTTPSVR_WEBSOCKET
+    else if (!strcasecmp(sFieldName, HttpSvr_sec_websocket_key) && (strlen(sFieldValue) < sizeof(my_wsKey)))
+    {
+      // Kept for acceptWebSocket, that may be called by the resource provider
+      strcpy(my_wsKey, sFieldValue);
+    }
+#endif
+#if HTTPSVR_ETAG
+    else if (!strcasecmp(sFieldName, HttpSvr_if_none_match))
+    {
+      // Kept for sendResFile, to answer 304 if the file has not changed
+      my_ifNoneMatch = local_parseEtag(sFieldValue);
+    }
+#endif
+#if HTTPSVR_BUNDLE
+    else if (!strcasecmp(sFieldName, HttpSvr_accept_encoding))
+    {
+      // Kept for sendResFile, since bundled files may be gzipped
+      my_acceptsGzip = (strstr(sFieldValue, "gzip") != 0);
+    }
+#endif
+#if HTTPSVR_PUT
+    else if (!strcasecmp(sFieldName, HttpSvr_transfer_encoding))
+    {
+      // Kept for PUT, whose body may come in chunks
+      my_chunkedBody = (strstr(sFieldValue, "chunked") != 0);
+    }
+    else if (!strcasecmp(sFieldName, HttpSvr_authorization) && (strlen(sFieldValue) < sizeof(my_authorization)))
+    {
+      // Kept for the handler set with setAuthHandler
+      strcpy(my_authorization, sFieldValue);
     }
+#endif
   }
   
   // If everything is ok, we must also consume the empty line at the end
   // of headers (headers delimiter).
   if (bOk) the_client.readCRLF();
+  HttpTrace_EVENT(ev_headersDone, the_client.socket(), 0);
   return uBodyLength;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#if HTTPSVR_TEMPLATES
+static bool local_isTemplate(const char * the_url)
+{
+  // The extension is compared without case, as names on the card are uppercase
+  static const char sExt[] = HTTPSVR_TEMPLATE_EXT;
+  const char * pEnd = the_url;
+  while (*pEnd && (*pEnd != '?') && (*pEnd != '#')) ++pEnd;
+  uint16_t uExtLen = sizeof(sExt) - 1;
+  if (pEnd - the_url < uExtLen) return false;
+  return !strncasecmp(pEnd - uExtLen, sExt, uExtLen);
+}
+#endif
+
+#if HTTPSVR_SD
+// Media types of files on SD card by extension, as for the files of a bundle
+// (see extras/tools/mkbundle.py); anything else is application/octet-stream
+static const uint8_t local_maxMimeLength = 22;
+
+struct local_mime_t
+{
+  char ext [5];
+  char type[local_maxMimeLength + 1];
+};
+
+static const local_mime_t local_mimeTypes[] PROGMEM =
+{
+  { "htm",  HttpSvr_mime_html        },
+  { "html", HttpSvr_mime_html        },
+  { "css",  "text/css"               },
+  { "js",   "application/javascript" },
+  { "json", HttpSvr_mime_json        },
+  { "txt",  HttpSvr_mime_text        },
+  { "xml",  "text/xml"               },
+  { "svg",  "image/svg+xml"          },
+  { "png",  "image/png"              },
+  { "gif",  "image/gif"              },
+  { "jpg",  "image/jpeg"             },
+  { "jpeg", "image/jpeg"             },
+  { "ico",  "image/x-icon"           },
+  { "csv",  HttpSvr_mime_csv         }
+};
+
+static const char * local_fileMime(const char * the_url, char * the_mime)
+{
+  // The media type is copied from flash into the_mime, which must hold
+  // local_maxMimeLength chars and the terminating 0. The extension is compared without case,
+  // as names on the card are uppercase.
+  const char * pExt = 0;
+  const char * pEnd = the_url;
+  for (; *pEnd && (*pEnd != '?') && (*pEnd != '#'); ++pEnd)
+  {
+    if (*pEnd == '.') pExt = pEnd + 1;
+    if (*pEnd == '/') pExt = 0;
+  }
+
+  strcpy(the_mime, HttpSvr_mime_octet_stream);
+  if (!pExt) return the_mime;
+  size_t uExtLen = pEnd - pExt;
+  for (uint8_t u = 0; u < sizeof(local_mimeTypes) / sizeof(local_mimeTypes[0]); ++u)
+  {
+    if ((strlen_P(local_mimeTypes[u].ext) == uExtLen) && !strncasecmp_P(pExt, local_mimeTypes[u].ext, uExtLen))
+    {
+      strcpy_P(the_mime, local_mimeTypes[u].type);
+      break;
+    }
+  }
+  return the_mime;
+}
+#endif // #if HTTPSVR_SD
+
 bool HttpSvr::sendResFile(ClientProxy& the_client, const char * the_urlBuffer)
 {
   if (!the_urlBuffer) { sendResponseInternalServerError(the_client); return false; }
   
-  if (my_sdSvr.resFileExists(the_urlBuffer))
+#if HTTPSVR_BUNDLE
+  // Files in flash come first: they need neither an SD card nor a cache
+  if (my_bundle.openResFile(the_urlBuffer))
+    return prv_sendBundleFile(the_client);
+#endif
+
+#if HTTPSVR_SD
+#if HTTPSVR_SD_RAM_CACHE
+  // Small files kept in RAM are sent from there, headers included
+  SdSvr::cachedFile_t aCached;
+  if (my_sdSvr.findCachedResFile(the_urlBuffer, aCached))
+    return prv_sendCachedResFile(the_client, aCached);
+#endif
+
+  // Opening tells whether the file exists, without another directory lookup
+  if (my_sdSvr.openResFile(the_urlBuffer))
   {
-    if (!my_sdSvr.openResFile(the_urlBuffer)) { sendResponseInternalServerError(the_client); return false; }
-
-    // Send a response header with content length
-    sendResponseOkWithContent(the_client, my_sdSvr.resFileSize());
+#if HTTPSVR_TEMPLATES
+    // Templates are rendered on each request
+    if (local_isTemplate(the_urlBuffer))
+      return prv_sendTemplate(the_client);
+#endif
+#if HTTPSVR_SD_RAM_CACHE
+    if (prv_cacheResFile(the_urlBuffer, aCached))
+      return prv_sendCachedResFile(the_client, aCached);
+    if (!my_sdSvr.isResFileOpen() && !my_sdSvr.openResFile(the_urlBuffer))
+    { sendResponseInternalServerError(the_client); return false; }
+#endif
+
+    // Send a response header with content length and media type
+    char sMime[local_maxMimeLength + 1];
+    sendResponseOkWithContent(the_client, my_sdSvr.resFileSize(), local_fileMime(the_urlBuffer, sMime));
     
     // Send resource as message body
-    static const uint16_t uResBufferSize = 256;
-    uint8_t resBuffer[uResBufferSize];
+    static const uint16_t uResBufferSize = HttpSvrConfig::fileBlockSize;
+    ext::arena_scope<arena_t> aScope(my_arena);
+    uint8_t * resBuffer = my_arena.alloc(uResBufferSize);
+    if (!resBuffer) { my_sdSvr.closeCurrentResFile(); return false; }
     uint16_t uRead = 0;
-    while(uRead = my_sdSvr.readResFileBuffer(resBuffer, uResBufferSize))
+    while ((uRead = my_sdSvr.readResFileBuffer(resBuffer, uResBufferSize)) != 0)
     {
       if (the_client.writeBuffer(resBuffer, uRead) != uRead)
       {
@@ -530,11 +1002,575 @@ bool HttpSvr::sendResFile(ClientProxy& the_client, const char * the_urlBuffer)
     return true;
   }    
 
+#if HTTPSVR_AUTOINDEX
+  // Not a file: it may be a directory
+  return prv_sendDirectory(the_client, the_urlBuffer);
+#endif
+#endif // #if HTTPSVR_SD
+
   // If the page does not exist, send a 404 Not Found
   sendResponseNotFound(the_client);
   return false;
 }
 
+#if HTTPSVR_TEMPLATES
+
+static const uint8_t local_templateNameLength = 31;
+
+enum local_templateState
+{
+  tpl_text,       // Copying text
+  tpl_open,       // "{" met
+  tpl_name,       // "{{" met, reading the name
+  tpl_close       // "}" met after the name
+};
+
+static bool local_isNameChar(uint8_t the_ch)
+{ return isalnum(the_ch) || (the_ch == '_') || (the_ch == '.') || (the_ch == '-'); }
+
+static void local_writeHeldBack(ResponseWriter& the_writer, local_templateState the_state, const char * the_name, uint8_t the_len)
+{
+  // Chars read as the start of a placeholder, which finally was not one
+  if (the_state == tpl_text) return;
+  the_writer.writeByte('{');
+  if (the_state == tpl_open) return;
+  the_writer.writeByte('{');
+  the_writer.write(reinterpret_cast<const uint8_t *>(the_name), the_len);
+  if (the_state == tpl_close) the_writer.writeByte('}');
+}
+
+bool HttpSvr::prv_sendTemplate(ClientProxy& the_client)
+{
+  // The current file is copied by blocks, text being written in runs between
+  // placeholders; a placeholder split between two blocks is carried over.
+  static const uint16_t uBlockSize = HttpSvrConfig::fileBlockSize;
+  ext::arena_scope<arena_t> aScope(my_arena);
+  uint8_t * pBlock = my_arena.alloc(uBlockSize);
+  if (!pBlock) { my_sdSvr.closeCurrentResFile(); sendResponseInternalServerError(the_client); return false; }
+
+  ResponseWriter aWriter(&the_client);
+  if (!sendResponseOkChunked(the_client, aWriter, HttpSvr_mime_html)) { my_sdSvr.closeCurrentResFile(); return false; }
+
+  char sName[local_templateNameLength + 1];
+  uint8_t uName = 0;
+  local_templateState eState = tpl_text;
+  uint16_t uRead;
+  while (aWriter.isOk() && (uRead = my_sdSvr.readResFileBuffer(pBlock, uBlockSize)))
+  {
+    const uint8_t * pEnd = pBlock + uRead;
+    const uint8_t * pRun = pBlock;
+    for (const uint8_t * p = pBlock; p < pEnd; ++p)
+    {
+      uint8_t ch = *p;
+      switch (eState)
+      {
+      case tpl_text:
+        if (ch == '{') { aWriter.write(pRun, p - pRun); eState = tpl_open; }
+        continue;
+      case tpl_open:
+        if (ch == '{') { eState = tpl_name; uName = 0; continue; }
+        break;
+      case tpl_name:
+        if (ch == '}') { eState = tpl_close; continue; }
+        if ((uName < local_templateNameLength) && local_isNameChar(ch)) { sName[uName++] = ch; continue; }
+        break;
+      case tpl_close:
+        if (ch == '}')
+        {
+          sName[uName] = 0;
+          prv_writeTemplateVar(aWriter, sName);
+          eState = tpl_text;
+          pRun   = p + 1;
+          continue;
+        }
+        break;
+      }
+
+      // Not a placeholder: what was held back is written as it was, and this
+      // char is read again as text
+      local_writeHeldBack(aWriter, eState, sName, uName);
+      eState = tpl_text;
+      pRun   = p--;
+    }
+    if (eState == tpl_text) aWriter.write(pRun, pEnd - pRun);
+  }
+  local_writeHeldBack(aWriter, eState, sName, uName);
+
+  my_sdSvr.closeCurrentResFile();
+  return aWriter.isOk() && aWriter.finish();
+}
+
+void HttpSvr::prv_writeTemplateVar(ResponseWriter& the_writer, const char * the_name) const
+{
+  uint16_t crc = crcsum(the_name, strlen(the_name), CRC_INIT);
+  for (uint8_t u = 0; u < smy_templateVars; ++u)
+  {
+    if (my_templateVars[u].crc != crc) continue;
+    my_templateVars[u].fn(the_writer, the_name);
+    return;
+  }
+
+  // Names which are not bound are left in the page
+  the_writer.write("{{");
+  the_writer.write(the_name);
+  the_writer.write("}}");
+}
+
+#endif // #if HTTPSVR_TEMPLATES
+
+#if HTTPSVR_AUTOINDEX
+
+static void local_writeHtmlText(ResponseWriter& the_writer, const char * the_text)
+{
+  for (; *the_text; ++the_text)
+  {
+    switch (*the_text)
+    {
+    case '&': the_writer.write(F("&amp;"));  break;
+    case '<': the_writer.write(F("&lt;"));   break;
+    case '>': the_writer.write(F("&gt;"));   break;
+    case '"': the_writer.write(F("&quot;")); break;
+    default:  the_writer.writeByte(*the_text);
+    }
+  }
+}
+
+static void local_writeUrlName(ResponseWriter& the_writer, const char * the_name)
+{
+  // Chars other than unreserved ones are percent-encoded (see RFC 3986 par. 2.3)
+  static const char sHex[] = "0123456789ABCDEF";
+  for (; *the_name; ++the_name)
+  {
+    uint8_t ch = *the_name;
+    if (isalnum(ch) || (ch == '-') || (ch == '.') || (ch == '_') || (ch == '~'))
+      the_writer.writeByte(ch);
+    else
+    {
+      the_writer.writeByte('%');
+      the_writer.writeByte(sHex[ch >> 4]);
+      the_writer.writeByte(sHex[ch & 0x0F]);
+    }
+  }
+}
+
+bool HttpSvr::prv_sendDirectory(ClientProxy& the_client, const char * the_urlBuffer)
+{
+  // The path is taken without query, and without trailing '/' (but for the root),
+  // with room for appending the name of the index page
+  static const char sIndex[] = "/index.htm";
+  ext::arena_scope<arena_t> aScope(my_arena);
+  uint16_t uLen = uriFindEndOfPath(the_urlBuffer) - the_urlBuffer;
+  char * sPath = my_arena.alloc_chars(uLen + sizeof(sIndex));
+  if (!sPath) { sendResponseInternalServerError(the_client); return false; }
+  memcpy(sPath, the_urlBuffer, uLen);
+  bool bSlash = (uLen > 0) && (sPath[uLen - 1] == '/');
+  while ((uLen > 1) && (sPath[uLen - 1] == '/')) --uLen;
+  sPath[uLen] = 0;
+  const char * sBase = (uLen > 1) ? sPath : "";
+
+  if (!my_sdSvr.openDirectory(sPath)) { sendResponseNotFound(the_client); return false; }
+
+  // Only the URL ending with '/' is served, so that relative links in the page
+  // are resolved in the directory: others are redirected to it, query included
+  if (!bSlash)
+  {
+    my_sdSvr.closeDirectory();
+    char * sLocation = my_arena.alloc_chars(strlen(the_urlBuffer) + 2);
+    if (!sLocation) { sendResponseInternalServerError(the_client); return false; }
+    memcpy(sLocation, sPath, uLen);
+    sLocation[uLen] = '/';
+    strcpy(sLocation + uLen + 1, the_urlBuffer + uLen);
+    return sendResponseMovedPermanently(the_client, sLocation);
+  }
+
+  // The index page of the directory is served if there is one
+  strcpy(sPath + uLen, sIndex + ((uLen > 1) ? 0 : 1));
+  bool bIndex = false;
+#if HTTPSVR_BUNDLE
+  bIndex = my_bundle.resFileExists(sPath);
+#endif
+  if (!bIndex && my_sdSvr.openResFile(sPath)) { my_sdSvr.closeCurrentResFile(); bIndex = true; }
+  if (bIndex)
+  {
+    my_sdSvr.closeDirectory();
+    return sendResFile(the_client, sPath);
+  }
+  sPath[uLen] = 0;
+
+  // Otherwise its entries are listed as they are read, in chunked transfer coding
+  HttpParams aParams;
+  bool bJson = queryParams(the_urlBuffer, aParams) && aParams.find("format") && !strcmp(aParams.value(), "json");
+  ResponseWriter aWriter(&the_client);
+  if (!sendResponseOkChunked(the_client, aWriter, bJson ? HttpSvr_mime_json : HttpSvr_mime_html))
+  { my_sdSvr.closeDirectory(); return false; }
+
+  SdSvr::dirEntry_t anEntry;
+  bool bOk;
+  if (bJson)
+  {
+    JsonWriter aJson(aWriter);
+    aJson.beginArray();
+    while (aJson.isOk() && my_sdSvr.readDirectory(anEntry))
+    {
+      aJson.beginObject();
+      aJson.key(F("name")); aJson.string(anEntry.name);
+      aJson.key(F("size")); aJson.number(anEntry.size);
+      aJson.key(F("dir"));  aJson.boolean(anEntry.isDirectory);
+      aJson.endObject();
+    }
+    aJson.endArray();
+    bOk = aJson.isComplete();
+  }
+  else
+  {
+    aWriter.write(F("<html><head><title>Index of "));
+    local_writeHtmlText(aWriter, sPath);
+    aWriter.write(F("</title></head><body><h1>Index of "));
+    local_writeHtmlText(aWriter, sPath);
+    aWriter.write(F("</h1><table>\r\n"));
+    if (uLen > 1)
+    {
+      aWriter.write(F("<tr><td><a href=\""));
+      local_writeHtmlText(aWriter, sBase);
+      aWriter.write(F("/..\">..</a></td><td></td></tr>\r\n"));
+    }
+    while (aWriter.isOk() && my_sdSvr.readDirectory(anEntry))
+    {
+      aWriter.write(F("<tr><td><a href=\""));
+      local_writeHtmlText(aWriter, sBase);
+      aWriter.writeByte('/');
+      local_writeUrlName(aWriter, anEntry.name);
+      if (anEntry.isDirectory) aWriter.writeByte('/');
+      aWriter.write(F("\">"));
+      local_writeHtmlText(aWriter, anEntry.name);
+      if (anEntry.isDirectory) aWriter.writeByte('/');
+      aWriter.write(F("</a></td><td>"));
+      if (!anEntry.isDirectory) aWriter.writeNumber(anEntry.size);
+      aWriter.write(F("</td></tr>\r\n"));
+    }
+    aWriter.write(F("</table></body></html>\r\n"));
+    bOk = aWriter.isOk();
+  }
+  my_sdSvr.closeDirectory();
+  return bOk && aWriter.finish();
+}
+
+#endif // #if HTTPSVR_AUTOINDEX
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_CSVLOG
+
+// Reader of the rows of the current file on SD card, through a block buffer.
+// Rows are returned in place in the buffer, so they must fit in it: longer
+// ones are returned in pieces.
+class local_rowReader
+{
+public:
+  local_rowReader(SdSvr& the_sdSvr, uint8_t * the_buffer, uint16_t the_size)
+  : my_sdSvr(the_sdSvr), my_buffer(the_buffer), my_size(the_size)
+  , my_begin(0), my_end(0), my_pos(0), my_eof(false) {}
+
+  bool seek(uint32_t the_pos)
+  {
+    my_begin = my_end = 0;
+    my_pos   = the_pos;
+    my_eof   = false;
+    return my_sdSvr.seekResFile(the_pos);
+  }
+
+  // Returns the next row, without its end of line, and where it starts in the
+  // file; 0 is returned at the end of the file
+  const char * next(uint16_t& the_len, uint32_t& the_start)
+  {
+    while (true)
+    {
+      uint8_t * pBegin = my_buffer + my_begin;
+      uint8_t * pEol   = static_cast<uint8_t *>(memchr(pBegin, '\n', my_end - my_begin));
+      if (pEol || (my_eof && (my_begin < my_end)) || ((my_begin == 0) && (my_end == my_size)))
+      {
+        uint16_t uLen  = pEol ? (pEol - pBegin) : (my_end - my_begin);
+        uint16_t uNext = pEol ? uLen + 1 : uLen;
+        the_start  = my_pos;
+        my_pos    += uNext;
+        my_begin  += uNext;
+        if (uLen && (pBegin[uLen - 1] == '\r')) --uLen;
+        the_len = uLen;
+        return reinterpret_cast<const char *>(pBegin);
+      }
+      if (my_eof) return 0;
+
+      // The partial row is moved to the front, and the buffer is filled up
+      memmove(my_buffer, pBegin, my_end - my_begin);
+      my_end  -= my_begin;
+      my_begin = 0;
+      uint16_t uRead = my_sdSvr.readResFileBuffer(my_buffer + my_end, my_size - my_end);
+      if (!uRead) my_eof = true;
+      my_end += uRead;
+    }
+  }
+
+private:
+  SdSvr&    my_sdSvr;
+  uint8_t * my_buffer;
+  uint16_t  my_size;
+  uint16_t  my_begin;   // Start of the next row in the buffer
+  uint16_t  my_end;     // End of data in the buffer
+  uint32_t  my_pos;     // Position in the file of the next row
+  bool      my_eof;
+};
+
+static bool local_parseStamp(const char * the_row, uint16_t the_len, uint32_t& the_stamp)
+{
+  // Timestamp in the first column: an unsigned integer, possibly with decimals
+  uint16_t u = 0;
+  the_stamp = 0;
+  for (; (u < the_len) && isdigit(the_row[u]); ++u)
+    the_stamp = the_stamp * 10 + (the_row[u] - '0');
+  if (!u) return false;
+  return (u == the_len) || strchr(",;\t .", the_row[u]);
+}
+
+static bool local_parseUnsigned(const char * the_value, uint32_t& the_result)
+{
+  if (!isdigit(*the_value)) return false;
+  char * pEnd;
+  the_result = strtoul(the_value, &pEnd, 10);
+  return !*pEnd;
+}
+
+bool HttpSvr::serveCsvLog(ClientProxy& the_client, http_e::method the_method, const char * the_url, const char * the_path)
+{
+  if (the_method != http_e::mthd_get) { sendResponseMethodNotAllowed(the_client); return false; }
+
+  // Collect parameters
+  HttpParams aParams;
+  if (!the_path || !queryParams(the_url, aParams)) { sendResponseBadRequest(the_client); return false; }
+  uint32_t uFrom = 0;
+  uint32_t uTo   = 0xFFFFFFFF;
+  uint32_t uSkip = 0;
+  uint32_t uMax  = 0xFFFFFFFF;
+  uint32_t uStep = 1;
+  bool bOk = true;
+  while (bOk && aParams.next())
+  {
+    if      (aParams.is("from")) bOk = local_parseUnsigned(aParams.value(), uFrom);
+    else if (aParams.is("to"  )) bOk = local_parseUnsigned(aParams.value(), uTo  );
+    else if (aParams.is("skip")) bOk = local_parseUnsigned(aParams.value(), uSkip);
+    else if (aParams.is("max" )) bOk = local_parseUnsigned(aParams.value(), uMax );
+    else if (aParams.is("step")) bOk = local_parseUnsigned(aParams.value(), uStep) && uStep;
+  }
+  if (!bOk) { sendResponseBadRequest(the_client); return false; }
+
+  // The log is being appended: it is opened again, to get its current size
+  static const uint16_t uBlockSize = HttpSvrConfig::fileBlockSize;
+  ext::arena_scope<arena_t> aScope(my_arena);
+  uint8_t * pBlock = my_arena.alloc(uBlockSize);
+  if (!pBlock) { sendResponseInternalServerError(the_client); return false; }
+  my_sdSvr.forgetResFile(the_path);
+  if (!my_sdSvr.openResFile(the_path)) { sendResponseNotFound(the_client); return false; }
+  uint32_t uSize = my_sdSvr.resFileSize();
+
+  ResponseWriter aWriter(&the_client);
+  if (!sendResponseOkChunked(the_client, aWriter, HttpSvr_mime_csv)) { my_sdSvr.closeCurrentResFile(); return false; }
+
+  // A first row without timestamp is a header
+  local_rowReader aReader(my_sdSvr, pBlock, uBlockSize);
+  const char * pRow;
+  uint16_t uLen;
+  uint32_t uStart;
+  uint32_t uStamp;
+  uint32_t uData = 0;
+  pRow = aReader.next(uLen, uStart);
+  if (pRow && !local_parseStamp(pRow, uLen, uStamp))
+  {
+    aWriter.write(reinterpret_cast<const uint8_t *>(pRow), uLen);
+    aWriter.write("\r\n");
+    aReader.next(uLen, uData);
+  }
+
+  // Binary search of the window: rows starting before uLo are all before "from",
+  // and the first row starting at or after uHi is not
+  uint32_t uLo = uData;
+  uint32_t uHi = uSize;
+  while (uFrom && (uHi - uLo > uBlockSize))
+  {
+    uint32_t uMid = uLo + (uHi - uLo) / 2;
+    aReader.seek(uMid - 1);
+    aReader.next(uLen, uStart);
+    pRow = aReader.next(uLen, uStart);
+    if (!pRow || (uStart >= uHi) || !local_parseStamp(pRow, uLen, uStamp) || (uStamp >= uFrom))
+      uHi = uMid;
+    else
+      uLo = uStart;
+  }
+
+  // Rows are sent from there, up to the end of the window
+  uint32_t uRows = 0;
+  uint32_t uSent = 0;
+  aReader.seek(uLo);
+  while (aWriter.isOk() && (uSent < uMax) && (pRow = aReader.next(uLen, uStart)))
+  {
+    if (!local_parseStamp(pRow, uLen, uStamp)) continue;
+    if (uStamp < uFrom) continue;
+    if (uStamp > uTo) break;
+    if (uRows++ < uSkip) continue;
+    if ((uRows - 1 - uSkip) % uStep) continue;
+    aWriter.write(reinterpret_cast<const uint8_t *>(pRow), uLen);
+    aWriter.write("\r\n");
+    ++uSent;
+  }
+  my_sdSvr.closeCurrentResFile();
+  return aWriter.isOk() && aWriter.finish();
+}
+
+#endif // #if HTTPSVR_CSVLOG
+
+#if HTTPSVR_SD_RAM_CACHE
+
+bool HttpSvr::prv_cacheResFile(const char * the_urlBuffer, SdSvr::cachedFile_t& the_file)
+{
+  // The current file, if small enough, is read into a RAM block together with its
+  // response headers. The ETag is the CRC of the content, so it is patched into
+  // the headers once the content has been read.
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_content_type;
+  static const char * msg02 = HttpSvr_CRLF HttpSvr_header_content_length;
+  static const char * msg03 = HttpSvr_CRLF HttpSvr_header_etag;
+  static const char * msg04 = HttpSvr_CRLF HttpSvr_CRLF;
+
+  uint32_t uSize = my_sdSvr.resFileSize();
+  if (uSize > HttpSvrConfig::sdRamCacheFile) return false;
+
+  char sMime[local_maxMimeLength + 1];
+  local_fileMime(the_urlBuffer, sMime);
+  char sLength[8];
+  ltoa(uSize, sLength, 10);
+  uint16_t uEtagPos    = strlen(msg01) + strlen(sMime) + strlen(msg02) + strlen(sLength) + strlen(msg03);
+  uint16_t uHeaderSize = uEtagPos + local_etagLength + strlen(msg04);
+  uint8_t * pBlock = my_sdSvr.beginCachedResFile(the_urlBuffer, uHeaderSize + uSize);
+  if (!pBlock) return false;
+
+  char * pHeader = reinterpret_cast<char *>(pBlock);
+  strcpy(pHeader, msg01);
+  strcat(pHeader, sMime);
+  strcat(pHeader, msg02);
+  strcat(pHeader, sLength);
+  strcat(pHeader, msg03);
+  strcat(pHeader, "\"0000\"");
+  strcat(pHeader, msg04);
+
+  // The file is read as a whole, then it is given back
+  uint8_t * pContent = pBlock + uHeaderSize;
+  uint16_t uRead = 0;
+  while (uRead < uSize)
+  {
+    uint16_t u = my_sdSvr.readResFileBuffer(pContent + uRead, uSize - uRead);
+    if (!u) break;
+    uRead += u;
+  }
+  my_sdSvr.closeCurrentResFile();
+
+  uint16_t uEtag = crcsum(reinterpret_cast<const char *>(pContent), uSize, CRC_INIT);
+  local_formatEtag(pHeader + uEtagPos, uEtag);
+  return my_sdSvr.endCachedResFile(uRead == uSize, uEtag, the_file);
+}
+
+bool HttpSvr::prv_sendCachedResFile(ClientProxy& the_client, const SdSvr::cachedFile_t& the_file) const
+{
+  // 304 Not Modified if the client already has this content
+  if (my_ifNoneMatch == the_file.etag) return prv_sendNotModified(the_client, the_file.etag);
+
+  // Headers and content in a single write
+  prv_countStatus(http_metrics::st_200);
+  uint8_t * pBlock = const_cast<uint8_t *>(the_file.block);
+  return (the_client.writeBuffer(pBlock, the_file.size) == the_file.size);
+}
+
+#endif // #if HTTPSVR_SD_RAM_CACHE
+
+#if HTTPSVR_BUNDLE
+
+bool HttpSvr::prv_sendBundleFile(ClientProxy& the_client)
+{
+  // Bundled files are sent as they are, with the media type and ETag of the bundle
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_content_type;
+  static const char * msg02 = HttpSvr_CRLF HttpSvr_header_content_length;
+  static const char * msg03 = HttpSvr_CRLF HttpSvr_header_etag;
+  static const char * msg04 = HttpSvr_CRLF HttpSvr_content_encoding HttpSvr_COLON HttpSvr_SP "gzip";
+  static const char * msg406 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_406 HttpSvr_SP HttpSvr_RP_406 HttpSvr_CRLF
+                               HttpSvr_header_server HttpSvr_CRLF
+                               HttpSvr_CRLF;
+
+  uint16_t uEtag = my_bundle.resFileEtag();
+  if (my_ifNoneMatch == uEtag) { my_bundle.closeCurrentResFile(); return prv_sendNotModified(the_client, uEtag); }
+  if (my_bundle.isResFileGzip() && !my_acceptsGzip)
+  {
+    my_bundle.closeCurrentResFile();
+    prv_countStatus(http_metrics::st_other);
+    prv_sendString(the_client, msg406);
+    return false;
+  }
+
+  char sEtag[local_etagLength + 1];
+  local_formatEtag(sEtag, uEtag);
+  sEtag[local_etagLength] = 0;
+
+  prv_countStatus(http_metrics::st_200);
+  ResponseWriter aWriter(&the_client);
+  aWriter.write(msg01);
+  aWriter.write(my_bundle.resFileMime());
+  aWriter.write(msg02);
+  aWriter.writeNumber(my_bundle.resFileSize());
+  aWriter.write(msg03);
+  aWriter.write(sEtag);
+  if (my_bundle.isResFileGzip()) aWriter.write(msg04);
+  aWriter.write(HttpSvr_CRLF HttpSvr_CRLF);
+  if (!aWriter.flush()) { my_bundle.closeCurrentResFile(); return false; }
+
+  // Content, copied from flash a block at a time
+  static const uint16_t uResBufferSize = HttpSvrConfig::fileBlockSize;
+  ext::arena_scope<arena_t> aScope(my_arena);
+  uint8_t * resBuffer = my_arena.alloc(uResBufferSize);
+  if (!resBuffer) { my_bundle.closeCurrentResFile(); return false; }
+  uint16_t uRead;
+  while ((uRead = my_bundle.readResFileBuffer(resBuffer, uResBufferSize)) > 0)
+  {
+    if (the_client.writeBuffer(resBuffer, uRead) != uRead)
+    {
+      my_bundle.closeCurrentResFile();
+      return false;
+    }
+  }
+  my_bundle.closeCurrentResFile();
+  return true;
+}
+
+#endif // #if HTTPSVR_BUNDLE
+
+#if HTTPSVR_ETAG
+
+bool HttpSvr::prv_sendNotModified(ClientProxy& the_client, uint16_t the_etag) const
+{
+  // 304 Not Modified: the client already has this content
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_304 HttpSvr_SP HttpSvr_RP_304 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_etag;
+  static const char * msg02 = HttpSvr_CRLF HttpSvr_CRLF;
+  char sEtag[local_etagLength + 1];
+  local_formatEtag(sEtag, the_etag);
+  sEtag[local_etagLength] = 0;
+
+  prv_countStatus(http_metrics::st_other);
+  if (!prv_sendString(the_client, msg01)) return false;
+  if (!prv_sendString(the_client, sEtag)) return false;
+  return prv_sendString(the_client, msg02);
+}
+
+#endif // #if HTTPSVR_ETAG
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -580,25 +1616,25 @@ const char * HttpSvr::uriExtractNextQueryNVP(const char * the_URI, char * the_na
   
   uint16_t u;
 
-  // Read name
-  for (u = 0; u < the_nameLen-1; ++u, ++the_URI)
+  // Read name; names and values longer than the buffers are truncated, and
+  // the rest is skipped, so that the next pair is found where it starts
+  for (u = 0; (*the_URI != '=') && (*the_URI != '&'); ++the_URI)
   {
-    if ((*the_URI == 0) || (*the_URI == '?')) { the_name[u] = 0; return static_cast<char *>(0); }
-    if (*the_URI == '=') break;
-    the_name[u] = *the_URI;
+    if ((*the_URI == 0) || (*the_URI == '?') || (*the_URI == '#')) break;
+    if (u < the_nameLen-1) the_name[u++] = *the_URI;
   }
   the_name[u] = 0;
-  if (*the_URI != 0) ++the_URI;
+  if ((u == 0) && (*the_URI != '=') && (*the_URI != '&')) return static_cast<char *>(0);
+  if (*the_URI == '=') ++the_URI;
 
-  // Read value
-  for (u = 0; u < the_valueLen-1; ++u, ++the_URI)
+  // Read value (a name without '=' has an empty value)
+  for (u = 0; *the_URI != '&'; ++the_URI)
   {
-    if ((*the_URI == 0) || (*the_URI == '?')) break;
-    if (*the_URI == '&') break;
-    the_value[u] = *the_URI;
+    if ((*the_URI == 0) || (*the_URI == '?') || (*the_URI == '#')) break;
+    if (u < the_valueLen-1) the_value[u++] = *the_URI;
   }
   the_value[u] = 0;
-  if (*the_URI != 0) ++the_URI;
+  if (*the_URI == '&') ++the_URI;
 
   return the_URI;
 }
@@ -616,47 +1652,130 @@ const char * HttpSvr::uriFindStartOfFragment(const char * the_URI) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
-bool HttpSvr::sendResponse(ClientProxy& the_client, const char * the_str) const
-{ return prv_sendString(the_client, the_str); }
+bool HttpSvr::queryParams(const char * the_url, HttpParams& the_params) const
+{
+  // Decoding takes place in the URL buffer itself, so only the URL of the
+  // current request can be accepted
+  the_params = HttpParams();
+  if (!the_url || !my_urlBuffer) return false;
+  if ((the_url < my_urlBuffer) || (the_url >= my_urlBuffer + my_urlBufferLen)) return false;
+
+  char * pQuery = my_urlBuffer + (the_url - my_urlBuffer);
+  while (*pQuery && (*pQuery != '?')) ++pQuery;
+  if (!*pQuery) return true; // No query: no parameters
+  ++pQuery;
+  
+  // The query ends at the start of fragment, if any
+  char * pEnd = pQuery;
+  while (*pEnd && (*pEnd != '#')) ++pEnd;
+  
+  the_params = HttpParams(pQuery, pEnd - pQuery);
+  return true;
+}
 
-bool HttpSvr::sendResponseOk(ClientProxy& the_client) const
-{ 
-  // 200 OK
+bool HttpSvr::readFormParams(ClientProxy& the_client, HttpParams& the_params) const
+{
+  // The body is read as a whole in the arena, where it stays until the end of
+  // the request, so that names and values can be used by the caller
+  the_params = HttpParams();
+  uint16_t uBodyLength = skipToBody(the_client);
+  if (!uBodyLength) return true;
+
+  char * sBody = (uBodyLength < my_arena.capacity()) ? my_arena.alloc_chars(uBodyLength + 1) : 0;
+  if (!sBody)
+  {
+    uint8_t ch;
+    while (uBodyLength-- > 0)
+      if (!the_client.readByte(ch)) break;
+    return false;
+  }
+  
+  uint16_t uRead = 0;
+  while (uRead < uBodyLength)
+  {
+    uint16_t u = the_client.readBuffer(reinterpret_cast<uint8_t *>(sBody + uRead), uBodyLength - uRead);
+    if (!u) return false;
+    uRead += u;
+  }
+  sBody[uRead] = 0;
+
+  the_params = HttpParams(sBody, uRead);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HttpSvr::sendResponse(ClientProxy& the_client, const char * the_str) const
+{ return prv_sendString(the_client, the_str); }
+
+bool HttpSvr::sendResponseOk(ClientProxy& the_client) const
+{ 
+  // 200 OK
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_200);
   return prv_sendString(the_client, msg); 
 }
 
-bool HttpSvr::sendResponseOkWithContent(ClientProxy& the_client, uint32_t the_size) const
+bool HttpSvr::sendResponseOkWithContent(ClientProxy& the_client, uint32_t the_size, const char * the_mimeType) const
 {
   if (the_size == 0) return sendResponseOk(the_client);
   
-  // 200 OK
-  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF;
-  static const char * msg02 = HttpSvr_header_server HttpSvr_CRLF;
-  static const char * msg03 = HttpSvr_header_content_type_html HttpSvr_CRLF;
-  static const char * msg04 = HttpSvr_header_content_length;
-  static const uint16_t msg04_len = strlen(msg04);
-  
-  // Send start line
+  prv_countStatus(http_metrics::st_200);
+  return prv_sendHeaderOk(the_client, the_size, the_mimeType);
+}
+
+bool HttpSvr::sendResponseOkChunked(ClientProxy& the_client, ResponseWriter& the_writer, const char * the_mimeType) const
+{
+  // 200 OK, with body in chunked transfer coding (see RFC 2616 par. 3.6.1)
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_content_type;
+  static const char * msg02 = HttpSvr_CRLF
+                              HttpSvr_header_chunked HttpSvr_CRLF
+                              HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_200);
+  the_writer.setChunked(true);
   if (!prv_sendString(the_client, msg01)) return false;
-  
-  // Send headers: "Server: xxx"...
-  if (!prv_sendString(the_client, msg02)) return false;
+  if (!prv_sendString(the_client, the_mimeType ? the_mimeType : HttpSvr_mime_html)) return false;
+  return prv_sendString(the_client, msg02);
+}
 
-  // ..."Content-Type: text/html"
-  if (!prv_sendString(the_client, msg03)) return false;
+bool HttpSvr::sendResponseCreated(ClientProxy& the_client) const
+{
+  // 201 Created
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_201 HttpSvr_SP HttpSvr_RP_201 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_header_content_length "0" HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
+  return prv_sendString(the_client, msg); 
+}
 
-  // ..."Content-Length: xxx"
-  char sContentLengthHeader[msg04_len + 16];
-  strncpy(sContentLengthHeader, msg04, msg04_len);
-  ltoa(the_size, &sContentLengthHeader[msg04_len], 10);
-    strcat(sContentLengthHeader, HttpSvr_CRLF);
-  if (!prv_sendString(the_client, sContentLengthHeader)) return false;
-  
-  // ...and an emtpy line (end of headers)
-  return prv_sendString(the_client, HttpSvr_CRLF);
+bool HttpSvr::sendResponseNoContent(ClientProxy& the_client) const
+{
+  // 204 No Content
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_204 HttpSvr_SP HttpSvr_RP_204 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
+  return prv_sendString(the_client, msg); 
+}
+
+bool HttpSvr::sendResponseMovedPermanently(ClientProxy& the_client, const char * the_location) const
+{
+  // 301 Moved Permanently, to the_location
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_301 HttpSvr_SP HttpSvr_RP_301 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_location;
+  static const char * msg02 = HttpSvr_CRLF
+                              HttpSvr_header_content_length "0" HttpSvr_CRLF
+                              HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
+  if (!prv_sendString(the_client, msg01)) return false;
+  if (!prv_sendString(the_client, the_location)) return false;
+  return prv_sendString(the_client, msg02);
 }
 
 bool HttpSvr::sendResponseBadRequest(ClientProxy& the_client) const
@@ -665,6 +1784,17 @@ bool HttpSvr::sendResponseBadRequest(ClientProxy& the_client) const
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_400 HttpSvr_SP HttpSvr_RP_400 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_400);
+  return prv_sendString(the_client, msg); 
+}
+
+bool HttpSvr::sendResponseForbidden(ClientProxy& the_client) const
+{
+  // 403 Forbidden
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_403 HttpSvr_SP HttpSvr_RP_403 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
   return prv_sendString(the_client, msg); 
 }
 
@@ -674,6 +1804,7 @@ bool HttpSvr::sendResponseNotFound(ClientProxy& the_client) const
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_404 HttpSvr_SP HttpSvr_RP_404 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_404);
   return prv_sendString(the_client, msg); 
 }
 
@@ -683,6 +1814,17 @@ bool HttpSvr::sendResponseMethodNotAllowed(ClientProxy& the_client) const
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_405 HttpSvr_SP HttpSvr_RP_405 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_405);
+  return prv_sendString(the_client, msg); 
+}
+
+bool HttpSvr::sendResponseLengthRequired(ClientProxy& the_client) const
+{
+  // 411 Length Required
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_411 HttpSvr_SP HttpSvr_RP_411 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
   return prv_sendString(the_client, msg); 
 }
 
@@ -692,6 +1834,17 @@ bool HttpSvr::sendResponseRequestUriTooLarge(ClientProxy& the_client) const
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_414 HttpSvr_SP HttpSvr_RP_414 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_414);
+  return prv_sendString(the_client, msg); 
+}
+
+bool HttpSvr::sendResponseServiceUnavailable(ClientProxy& the_client) const
+{
+  // 503 Service Unavailable
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_503 HttpSvr_SP HttpSvr_RP_503 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_other);
   return prv_sendString(the_client, msg); 
 }
 
@@ -701,34 +1854,520 @@ bool HttpSvr::sendResponseInternalServerError(ClientProxy& the_client) const
   static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_500 HttpSvr_SP HttpSvr_RP_500 HttpSvr_CRLF
                             HttpSvr_header_server HttpSvr_CRLF
                             HttpSvr_CRLF;
+  prv_countStatus(http_metrics::st_500);
   return prv_sendString(the_client, msg); 
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#if HTTPSVR_METRICS
+
+const http_metrics& HttpSvr::metrics() const
+{
+  my_metrics.uptimeMs        = millis();
+  my_metrics.spiAccesses     = NetBackend::spiAccesses();
+  my_metrics.arenaSize       = my_arena.capacity();
+  my_metrics.arenaPeak       = my_arena.peak();
+  my_metrics.arenaFailures   = my_arena.failures();
+  return my_metrics;
+}
+
+void HttpSvr::resetMetrics()
+{
+  memset(&my_metrics, 0, sizeof(my_metrics));
+  my_metrics.layoutVersion = http_metrics::layout_version;
+  my_metrics.nRoutes       = http_metrics::routes;
+  my_metrics.nBuckets      = http_metrics::buckets;
+}
+
+bool HttpSvr::sendMetrics(ClientProxy& the_client) const
+{
+  // The response is counted in advance, so that the body reports it and its
+  // length does not change between the counting pass and the sending pass
+  prv_countStatus(http_metrics::st_200);
+  metrics();
+
+  ResponseWriter aCounter;
+  prv_writeMetrics(aCounter);
+  if (!prv_sendHeaderOk(the_client, aCounter.count(), HttpSvr_mime_prometheus)) return false;
+
+  ResponseWriter aWriter(&the_client);
+  prv_writeMetrics(aWriter);
+  return aWriter.flush();
+}
+
+bool HttpSvr::sendMetricsBinary(ClientProxy& the_client) const
+{
+  prv_countStatus(http_metrics::st_200);
+  metrics();
+
+  if (!prv_sendHeaderOk(the_client, sizeof(my_metrics), HttpSvr_mime_octet_stream)) return false;
+  uint8_t * pMetrics = static_cast<uint8_t *>(static_cast<void *>(&my_metrics));
+  return (the_client.writeBuffer(pMetrics, sizeof(my_metrics)) == sizeof(my_metrics));
+}
+
+#endif // #if HTTPSVR_METRICS
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_TRACE
+
+bool HttpSvr::sendTrace(ClientProxy& the_client) const
+{
+  // Sending records new events (SEND commands...), which would overwrite the
+  // records being read: recording is suspended until the ring has been sent
+  static const uint8_t uRecordSize = 6;
+  HttpTrace::suspend();
+  uint8_t uRecords = HttpTrace::size();
+
+  prv_countStatus(http_metrics::st_200);
+  bool bOk = prv_sendHeaderOk(the_client, 5 + uRecords * uRecordSize, HttpSvr_mime_octet_stream);
+  if (bOk)
+  {
+    ResponseWriter aWriter(&the_client);
+    aWriter.write("HTR1");
+    aWriter.writeByte(uRecords);
+    for (uint8_t u = 0; u < uRecords; ++u)
+    {
+      HttpTrace::record_t r = HttpTrace::at(u);
+      aWriter.writeByte(r.us       & 0xFF);
+      aWriter.writeByte(r.us >>  8 & 0xFF);
+      aWriter.writeByte(r.us >> 16 & 0xFF);
+      aWriter.writeByte(r.us >> 24 & 0xFF);
+      aWriter.writeByte(r.info);
+      aWriter.writeByte(r.arg);
+    }
+    bOk = aWriter.flush();
+  }
+  HttpTrace::resume();
+  return bOk;
+}
+
+#endif // #if HTTPSVR_TRACE
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_SSE
+
+bool HttpSvr::beginEventStream(ClientProxy& the_client) const
+{
+  // 200 OK, with an event stream as body (see the W3C "Server-Sent Events" recommendation)
+  static const char * msg = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF
+                            HttpSvr_header_server HttpSvr_CRLF
+                            HttpSvr_header_content_type HttpSvr_mime_event_stream HttpSvr_CRLF
+                            HttpSvr_header_no_cache HttpSvr_CRLF
+                            HttpSvr_CRLF;
+  if ((eventStreams() >= HttpSvrConfig::sseMaxStreams) || (prv_heldOpen() >= HttpSvrConfig::sockets - 1))
+  {
+    sendResponseServiceUnavailable(the_client);
+    return false;
+  }
+
+  prv_countStatus(http_metrics::st_200);
+  if (!prv_sendString(the_client, msg)) return false;
+  the_client.setMode(ClientProxy::mode_eventStream);
+  the_client.triggerConnTimeout();
+  return true;
+}
+
+uint8_t HttpSvr::pushEvent(const char * the_event, const char * the_data)
+{
+  // Events are either written as a whole or dropped, so that writing never waits
+  ResponseWriter aCounter;
+  prv_writeEvent(aCounter, the_event, the_data);
+  uint32_t uSize = aCounter.count();
+
+  uint8_t uDelivered = 0;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+  {
+    if ((clients[sn].mode() != ClientProxy::mode_eventStream) || !clients[sn].isConnected()) continue;
+    if (clients[sn].writeAvailable() < uSize) { ++my_eventsDropped; continue; }
+
+    ResponseWriter aWriter(&clients[sn]);
+    prv_writeEvent(aWriter, the_event, the_data);
+    if (!aWriter.flush()) continue;
+    clients[sn].triggerConnTimeout();
+    ++uDelivered;
+  }
+  return uDelivered;
+}
+
+uint8_t HttpSvr::eventStreams() const
+{
+  uint8_t uStreams = 0;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+    if (clients[sn].mode() == ClientProxy::mode_eventStream) ++uStreams;
+  return uStreams;
+}
+
+void HttpSvr::prv_serveEventStream(ClientProxy& the_client)
+{
+  // Clients are not expected to send anything on an event stream: discard it
+  uint8_t sDiscard[16];
+  while (the_client.anyDataReceived())
+    if (!the_client.readBuffer(sDiscard, sizeof(sDiscard))) break;
+
+  // Push out data queued by pushEvent, and keep the stream alive
+  the_client.flush_nonBlk();
+  if (the_client.isConnected() && (the_client.msIdle() >= HttpSvrConfig::sseHeartbeatMs))
+  {
+    static const char sHeartbeat[] = ":\n\n";
+    if (the_client.writeAvailable() >= sizeof(sHeartbeat) - 1)
+      the_client.writeBuffer(reinterpret_cast<uint8_t *>(const_cast<char *>(sHeartbeat)), sizeof(sHeartbeat) - 1);
+    the_client.triggerConnTimeout();
+  }
+}
+
+void HttpSvr::prv_writeEvent(ResponseWriter& the_writer, const char * the_event, const char * the_data)
+{
+  // Each line of data goes in a "data:" field; the event ends with an empty line
+  if (the_event && *the_event)
+  {
+    the_writer.write("event: ");
+    the_writer.write(the_event);
+    the_writer.writeByte('\n');
+  }
+  the_writer.write("data: ");
+  for (const char * p = the_data ? the_data : ""; *p; ++p)
+  {
+    if (*p == '\r') continue;
+    the_writer.writeByte(*p);
+    if (*p == '\n') the_writer.write("data: ");
+  }
+  the_writer.write("\n\n");
+}
+
+#endif // #if HTTPSVR_SSE
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_WEBSOCKET
+
+bool HttpSvr::acceptWebSocket(ClientProxy& the_client) const
+{
+  // 101 Switching Protocols, with the key of the request signed (see RFC 6455 par. 4.2.2)
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_101 HttpSvr_SP HttpSvr_RP_101 HttpSvr_CRLF
+                              HttpSvr_header_server HttpSvr_CRLF
+                              HttpSvr_header_upgrade_websocket HttpSvr_CRLF
+                              HttpSvr_header_connection_upgrade HttpSvr_CRLF
+                              HttpSvr_header_websocket_accept;
+  static const char * msg02 = HttpSvr_CRLF HttpSvr_CRLF;
+
+  if (!my_wsKey[0]) { sendResponseBadRequest(the_client); return false; }
+  if ((webSockets() >= HttpSvrConfig::wsMaxConnections) || (prv_heldOpen() >= HttpSvrConfig::sockets - 1))
+  {
+    sendResponseServiceUnavailable(the_client);
+    return false;
+  }
+
+  char sAccept[WebSocket::acceptKeyLength + 1];
+  WebSocket::acceptKey(my_wsKey, sAccept);
+
+  prv_countStatus(http_metrics::st_other);
+  if (!prv_sendString(the_client, msg01)) return false;
+  if (!prv_sendString(the_client, sAccept)) return false;
+  if (!prv_sendString(the_client, msg02)) return false;
+  the_client.setMode(ClientProxy::mode_webSocket);
+  the_client.triggerConnTimeout();
+  return true;
+}
+
+uint8_t HttpSvr::broadcastWebSocket(WebSocket::opcode_e the_opcode, const uint8_t * the_data, uint16_t the_size)
+{
+  uint8_t uDelivered = 0;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+  {
+    WebSocket aSocket(&clients[sn]);
+    if (aSocket.send(the_opcode, the_data, the_size)) ++uDelivered;
+  }
+  return uDelivered;
+}
+
+uint8_t HttpSvr::webSockets() const
+{
+  uint8_t uSockets = 0;
+  for (uint8_t sn = NetBackend::socket_begin; sn < HttpSvrConfig::sockets; ++sn)
+    if (clients[sn].mode() == ClientProxy::mode_webSocket) ++uSockets;
+  return uSockets;
+}
+
+void HttpSvr::prv_serveWebSocket(ClientProxy& the_client)
+{
+  WebSocket aSocket(&the_client);
+  if (the_client.anyDataReceived())
+  {
+    // The message buffer has room for a terminating null char
+    ext::arena_scope<arena_t> aScope(my_arena);
+    uint8_t * pBuffer = my_arena.alloc(HttpSvrConfig::wsMaxMessage + 1);
+    if (!pBuffer) { aSocket.close(WebSocket::close_tooBig); return; }
+
+    WebSocket::opcode_e aOpcode;
+    uint16_t uLength;
+    if (aSocket.receiveMessage(pBuffer, HttpSvrConfig::wsMaxMessage, aOpcode, uLength))
+    {
+      pBuffer[uLength] = 0;
+      if (my_wsHandler) my_wsHandler(aSocket, aOpcode, pBuffer, uLength);
+    }
+    the_client.triggerConnTimeout();
+  }
+  else if (the_client.msIdle() >= HttpSvrConfig::wsPingMs)
+  {
+    // A ping that is never acknowledged makes the connection time out, and close
+    aSocket.send(WebSocket::op_ping, 0, 0);
+    the_client.triggerConnTimeout();
+  }
+
+  // Push out data queued by sends
+  the_client.flush_nonBlk();
+}
+
+#endif // #if HTTPSVR_WEBSOCKET
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_PINIO
+
+// Iterator over a set of pins, given either as a list of pins and ranges ("2-9,13")
+// or as a hex bitmask ("3ffc", bit n being pin n). Pins are checked against the_pins;
+// a syntax error or a pin out of range stops iteration and makes isOk false.
+class local_pinSet
+{
+public:
+  local_pinSet(const char * the_spec, bool the_isMask, uint8_t the_pins)
+  : my_spec(the_spec ? the_spec : ""), my_len(strlen(my_spec)), my_pins(the_pins)
+  , my_isMask(the_isMask), my_ok(true), my_cur(the_isMask ? 0 : 1), my_last(0) {}
+
+  bool isOk() const { return my_ok; }
+
+  bool next(uint8_t& the_pin)
+  { return my_ok && (my_isMask ? prv_nextBit(the_pin) : prv_nextListed(the_pin)); }
+
+private:
+  bool prv_nextListed(uint8_t& the_pin)
+  {
+    if (my_cur > my_last)
+    {
+      // Current range exhausted: parse the next item of the list
+      if (!*my_spec) return false;
+      uint16_t uFirst, uLast;
+      if (!prv_parseNumber(uFirst)) return (my_ok = false);
+      uLast = uFirst;
+      if ((*my_spec == '-') && (++my_spec, !prv_parseNumber(uLast))) return (my_ok = false);
+      if (*my_spec == ',') ++my_spec;
+      else if (*my_spec) return (my_ok = false);
+      if ((uFirst > uLast) || (uLast >= my_pins)) return (my_ok = false);
+      my_cur  = uFirst;
+      my_last = uLast;
+    }
+    the_pin = static_cast<uint8_t>(my_cur++);
+    return true;
+  }
+
+  bool prv_nextBit(uint8_t& the_pin)
+  {
+    // Hex digits are read from the last one, that holds pins 0 to 3
+    for (; my_cur < 4 * my_len; ++my_cur)
+    {
+      int8_t iDigit = prv_hexDigit(my_spec[my_len - 1 - my_cur / 4]);
+      if (iDigit < 0) return (my_ok = false);
+      if (!(iDigit & (1 << (my_cur % 4)))) continue;
+      if (my_cur >= my_pins) return (my_ok = false);
+      the_pin = static_cast<uint8_t>(my_cur++);
+      return true;
+    }
+    return false;
+  }
+
+  bool prv_parseNumber(uint16_t& the_number)
+  {
+    if ((*my_spec < '0') || (*my_spec > '9')) return false;
+    for (the_number = 0; (*my_spec >= '0') && (*my_spec <= '9'); ++my_spec)
+      if ((the_number = the_number * 10 + (*my_spec - '0')) > 255) return false;
+    return true;
+  }
+
+  static int8_t prv_hexDigit(char the_ch)
+  {
+    if ((the_ch >= '0') && (the_ch <= '9')) return the_ch - '0';
+    if ((the_ch >= 'A') && (the_ch <= 'F')) return the_ch - 'A' + 10;
+    if ((the_ch >= 'a') && (the_ch <= 'f')) return the_ch - 'a' + 10;
+    return -1;
+  }
+
+private:
+  const char * my_spec;
+  uint16_t     my_len;
+  uint8_t      my_pins;
+  bool         my_isMask;
+  bool         my_ok;
+  uint16_t     my_cur;
+  uint16_t     my_last;
+};
+
+static uint8_t local_countPins(const char * the_spec, bool the_isMask, uint8_t the_pins, bool& the_ok)
+{
+  local_pinSet aSet(the_spec, the_isMask, the_pins);
+  uint8_t uCount = 0;
+  uint8_t uPin;
+  while (aSet.next(uPin)) ++uCount;
+  the_ok = the_ok && aSet.isOk();
+  return uCount;
+}
+
+void HttpSvr::setPinIoWritable(uint8_t the_pin, bool the_writable)
+{
+  if (the_pin >= HttpSvrConfig::pinIoDigitalPins) return;
+  if (the_writable) my_pinIoWritable[the_pin / 8] |=  (1 << (the_pin % 8));
+  else              my_pinIoWritable[the_pin / 8] &= ~(1 << (the_pin % 8));
+}
+
+bool HttpSvr::servePinIo(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  // Collect parameters: they stay valid until the end of the request
+  HttpParams aParams;
+  bool bOk = (the_method == http_e::mthd_post) ? readFormParams(the_client, aParams)
+                                               : queryParams(the_url, aParams);
+  if (!bOk) { sendResponseBadRequest(the_client); return false; }
+
+  const char * sDigital = 0;
+  const char * sAnalog  = 0;
+  const char * sWrite   = 0;
+  const char * sPwm     = 0;
+  bool bMask   = false;
+  bool bBinary = false;
+  while (aParams.next())
+  {
+    if      (aParams.is("d"  )) { sDigital = aParams.value(); bMask = false; }
+    else if (aParams.is("dm" )) { sDigital = aParams.value(); bMask = true;  }
+    else if (aParams.is("a"  )) sAnalog = aParams.value();
+    else if (aParams.is("w"  )) sWrite  = aParams.value();
+    else if (aParams.is("pwm")) sPwm    = aParams.value();
+    else if (aParams.is("fmt")) bBinary = (strcmp(aParams.value(), "bin") == 0);
+  }
+
+  // Writes are accepted only with POST, and are applied only if they are all valid
+  if ((sWrite || sPwm) && (the_method != http_e::mthd_post)) { sendResponseBadRequest(the_client); return false; }
+  if (!prv_applyPinWrites(sWrite, false, false) || !prv_applyPinWrites(sPwm, true, false))
+    { sendResponseBadRequest(the_client); return false; }
+
+  // Pin sets are checked before anything is sent, and their size is needed by the binary format
+  uint8_t nDigital = local_countPins(sDigital, bMask, HttpSvrConfig::pinIoDigitalPins, bOk);
+  uint8_t nAnalog  = local_countPins(sAnalog , false, HttpSvrConfig::pinIoAnalogPins , bOk);
+  if (!bOk) { sendResponseBadRequest(the_client); return false; }
+
+  prv_applyPinWrites(sWrite, false, true);
+  prv_applyPinWrites(sPwm  , true , true);
+
+  ResponseWriter aWriter(&the_client);
+  local_pinSet aDigital(sDigital, bMask, HttpSvrConfig::pinIoDigitalPins);
+  local_pinSet aAnalog (sAnalog , false, HttpSvrConfig::pinIoAnalogPins );
+  uint8_t uPin;
+
+  if (bBinary)
+  {
+    prv_countStatus(http_metrics::st_200);
+    if (!prv_sendHeaderOk(the_client, 2 + (nDigital + 7) / 8 + 2 * nAnalog, HttpSvr_mime_octet_stream)) return false;
+    aWriter.writeByte(nDigital);
+    aWriter.writeByte(nAnalog);
+    uint8_t uBits = 0;
+    uint8_t uBit  = 0;
+    while (aDigital.next(uPin))
+    {
+      if (digitalRead(uPin)) uBits |= (1 << uBit);
+      if (++uBit == 8) { aWriter.writeByte(uBits); uBits = 0; uBit = 0; }
+    }
+    if (uBit) aWriter.writeByte(uBits);
+    while (aAnalog.next(uPin))
+    {
+      uint16_t uValue = analogRead(uPin);
+      aWriter.writeByte(uValue & 0xFF);
+      aWriter.writeByte(uValue >> 8);
+    }
+    return aWriter.flush();
+  }
+
+  // Values may change between two passes, so the JSON length cannot be computed in advance
+  if (!sendResponseOkChunked(the_client, aWriter, HttpSvr_mime_json)) return false;
+  JsonWriter aJson(aWriter);
+  aJson.beginObject();
+  if (sDigital)
+  {
+    aJson.key(F("d"));
+    aJson.beginArray();
+    while (aDigital.next(uPin)) aJson.number(static_cast<uint16_t>(digitalRead(uPin) ? 1 : 0));
+    aJson.endArray();
+  }
+  if (sAnalog)
+  {
+    aJson.key(F("a"));
+    aJson.beginArray();
+    while (aAnalog.next(uPin)) aJson.number(static_cast<uint16_t>(analogRead(uPin)));
+    aJson.endArray();
+  }
+  aJson.endObject();
+  return aJson.isComplete() && aWriter.finish();
+}
+
+bool HttpSvr::prv_applyPinWrites(const char * the_spec, bool the_analog, bool the_apply) const
+{
+  // Parses a list like "13:1,12:0", checking pins and values or applying them
+  if (!the_spec) return true;
+  while (*the_spec)
+  {
+    char * pEnd;
+    unsigned long uPin = strtoul(the_spec, &pEnd, 10);
+    if ((pEnd == the_spec) || (*pEnd != ':')) return false;
+    the_spec = pEnd + 1;
+    unsigned long uValue = strtoul(the_spec, &pEnd, 10);
+    if ((pEnd == the_spec) || (*pEnd && (*pEnd != ','))) return false;
+    the_spec = *pEnd ? pEnd + 1 : pEnd;
+
+    if (uPin >= HttpSvrConfig::pinIoDigitalPins) return false;
+    if (!(my_pinIoWritable[uPin / 8] & (1 << (uPin % 8)))) return false;
+    if (uValue > (the_analog ? 255 : 1)) return false;
+
+    if (!the_apply) continue;
+    if (the_analog) analogWrite(uPin, uValue);
+    else            digitalWrite(uPin, uValue ? HIGH : LOW);
+  }
+  return true;
+}
+
+#endif // #if HTTPSVR_PINIO
+
+///////////////////////////////////////////////////////////////////////////////
+
 IPAddress HttpSvr::localIpAddr() const
 {
-  W5100::ipv4_address_t ipAddr;
+  NetBackend::ipv4_address_t ipAddr;
   return IPAddress(ipAddr.ip0(), ipAddr.ip1(), ipAddr.ip2(), ipAddr.ip3());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void HttpSvr::prv_resetSocket(W5100::socket_e the_sn, uint16_t the_port) const
+void HttpSvr::prv_resetSocket(NetBackend::socket_e the_sn, uint16_t the_port) const
 {
-  if (the_sn == W5100::socket_undefined) return;
+  if (the_sn == NetBackend::socket_undefined) return;
   
-  // Modify default initialization of W5100 sockets to prevent buffer overflow
+  // Modify default initialization of sockets to prevent buffer overflow
   // in receive operation.
-  W5100::write_Sn_R8(the_sn, W5100_Sn_MR, W5100::read_Sn_R8(the_sn, W5100_Sn_MR) | W5100_ND);
+  NetBackend::setNoDelayedAck(the_sn);
 
   // Open socket and set it in listen mode
-  W5100::open(the_sn, the_port);
-  W5100::listen(the_sn);
+  NetBackend::open(the_sn, the_port);
+  NetBackend::listen(the_sn);
 }
   
 ///////////////////////////////////////////////////////////////////////////////
 
+static bool local_tokenOverflowed(ClientProxy& the_client)
+{
+  // After readToken, the next char is a delimiter, unless the buffer was too short
+  uint8_t ch;
+  if (!the_client.peekByte(ch)) return false;
+  return (ch != ' ') && (ch != '\r') && (ch != '\n');
+}
+
 static http_e::method local_encodeMethod(const char *the_sMethod)
 {
   // Deduce method by string match
@@ -752,14 +2391,22 @@ bool HttpSvr::prv_readRequestLine(ClientProxy& the_client, http_e::method& the_m
   // Skip empty lines if any (see RFC 2616 par. 4.1)
   if (!the_client.skipAllCRLF()) return false;
   
-  // Read and encode method
+  // Read and encode method; methods longer than the known ones are undefined,
+  // and the rest of their name is discarded
   char sMethod[8];
   if (!the_client.readToken(sMethod, sizeof(sMethod))) return false;
   the_method = local_encodeMethod(sMethod);
+  if (local_tokenOverflowed(the_client))
+  {
+    the_method = http_e::mthd_undefined;
+    uint8_t ch;
+    while (local_tokenOverflowed(the_client)) the_client.readByte(ch);
+  }
 
-  // Read URL
+  // Read URL; URLs longer than the buffer are refused, rather than served truncated
   if (!the_client.skipAllLWS()) return false;
   if (the_client.readToken(the_urlBuffer, the_bufferLen) == 0) return false;
+  if (local_tokenOverflowed(the_client)) { sendResponseRequestUriTooLarge(the_client); return false; }
 
   // Everything seems ok so far. Skip the remaining part of line
   return the_client.skipToNextLine();
@@ -771,12 +2418,16 @@ uint8_t HttpSvr::prv_boundResIdx(ClientProxy& the_client, const char * the_urlBu
 {
   // Isolate the absolute path from entire URI
   // (see RFC 2616 par. 3.2.1 and 5.1.2, and RFC 3986 par. 3)
+  // The CRC is computed while looking for the end of the path
   uint32_t uLen = 0;
+  uint16_t crc  = CRC_INIT;
   for (uLen = 0; true; ++uLen)
+  {
     if ((the_urlBuffer[uLen] == 0) || (the_urlBuffer[uLen] == '?' || (the_urlBuffer[uLen] == '#')))
       break;
+    crc = crcupdate(crc, the_urlBuffer[uLen]);
+  }
   if (uLen == 0) { sendResponseBadRequest(the_client); return static_cast<uint8_t>(-1); }
-  uint16_t crc = crcsum(the_urlBuffer, uLen, CRC_INIT);
   
   // Find stored bind info
   uint8_t u;
@@ -807,10 +2458,27 @@ bool HttpSvr::prv_dispatchGET(ClientProxy& the_client, const char * the_urlBuffe
   // If there is no provider for this resource, try to find the requested
   // resource as a file in SD card
   if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
-    return sendResFile(the_client, the_urlBuffer);
+  {
+    my_lastRoute = http_metrics::route_sd;
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), my_lastRoute);
+    bool bOk = sendResFile(the_client, the_urlBuffer);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), bOk);
+    return bOk;
+  }
   
-  // If a provider has been found, call it
-  if (my_resMap[u].fn) return (my_resMap[u].fn)(the_client, http_e::mthd_get, the_urlBuffer);
+  // If a provider has been found, call it, unless its response has been kept
+  my_lastRoute = u;
+  if (my_resMap[u].fn)
+  {
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), u);
+#if HTTPSVR_RESPONSE_CACHE
+    bool bOk = prv_callCachedProvider(the_client, u, the_urlBuffer);
+#else
+    bool bOk = (my_resMap[u].fn)(the_client, http_e::mthd_get, the_urlBuffer);
+#endif
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), bOk);
+    return bOk;
+  }
   
   sendResponseNotFound(the_client);
   return false;
@@ -823,15 +2491,20 @@ bool HttpSvr::prv_dispatchPOST(ClientProxy& the_client, const char * the_urlBuff
   // Find stored bind info
   uint8_t u = prv_boundResIdx(the_client, the_urlBuffer);
 
+#if HTTPSVR_UPLOAD
   // If there is no provider for this resource, assume that this is a file upload to SD
   if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
   {
-    char sFieldName [local_maxFieldNameLength ];
-    char sFieldValue[local_maxFieldValueLength];
+    my_lastRoute = http_metrics::route_sd;
+
+    ext::arena_scope<arena_t> aScope(my_arena);
+    char * sFieldName  = my_arena.alloc_chars(local_maxFieldNameLength );
+    char * sFieldValue = my_arena.alloc_chars(local_maxFieldValueLength);
+    if (!sFieldName || !sFieldValue) { sendResponseInternalServerError(the_client); return false; }
     
     // Find the "Content-Type" header and check if it is "form/multipart"
     bool bOk;
-    while ((bOk = readNextHeader(the_client, sFieldName, sizeof(sFieldName), sFieldValue, sizeof(sFieldValue))))
+    while ((bOk = readNextHeader(the_client, sFieldName, local_maxFieldNameLength, sFieldValue, local_maxFieldValueLength)))
     {
       if (!sFieldName[0]) break;
       if (!strcasecmp(sFieldName, HttpSvr_content_type)) break;
@@ -848,14 +2521,22 @@ bool HttpSvr::prv_dispatchPOST(ClientProxy& the_client, const char * the_urlBuff
     char * sBoundaryStart = strstr(sFieldValue, sBoundaryName);
     if (!sBoundaryStart) { sendResponseBadRequest(the_client); return false; }
     sBoundaryStart += strlen(sBoundaryName);
+    char cBoundaryDelim = ';';
+    if (*sBoundaryStart == '"') { cBoundaryDelim = '"'; ++sBoundaryStart; }
     char *sBoundaryEnd;
     for (sBoundaryEnd = sBoundaryStart; *sBoundaryEnd; ++sBoundaryEnd)
-      if ((*sBoundaryEnd == ' ') || (*sBoundaryEnd == '\r') || (*sBoundaryEnd == '\n')) break;
-    *sBoundaryEnd = 0;
-    uint16_t crcBoundary = crcsum(sBoundaryStart, sBoundaryEnd - sBoundaryStart, CRC_INIT);
+      if ((*sBoundaryEnd == cBoundaryDelim) || ((cBoundaryDelim == ';') && (*sBoundaryEnd == ' '))) break;
+    uint16_t lenBoundary = sBoundaryEnd - sBoundaryStart;
+
+    // Boundaries are 1 to 70 chars long (see RFC 2046 par. 5.1.1): an empty one
+    // would match any line starting with "--"
+    if ((lenBoundary == 0) || (lenBoundary > 70)) { sendResponseBadRequest(the_client); return false; }
+    uint16_t crcBoundary = crcsum(sBoundaryStart, lenBoundary, CRC_INIT);
     
     // Now skip any other header and goto message body
     if (!skipHeaders(the_client)) { sendResponseBadRequest(the_client); return false; }
+    HttpTrace_EVENT(ev_headersDone, the_client.socket(), 0);
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), my_lastRoute);
 
     // Skip all body sub-parts except the one with header containing the filename
     char * sFilenameStart = 0;
@@ -863,12 +2544,12 @@ bool HttpSvr::prv_dispatchPOST(ClientProxy& the_client, const char * the_urlBuff
     while (true)
     {
       // Start reading body parts
-      if (!local_skipBeyondBoundary(the_client, crcBoundary, sFieldValue, sizeof(sFieldValue)))
+      if (!local_skipBeyondBoundary(the_client, crcBoundary, lenBoundary, sFieldValue, local_maxFieldValueLength))
       { sendResponseBadRequest(the_client); return false; }
 
       // Read subpart headers and look for one like:
       // Content-Disposition: form-data; [...] filename:"originalFileName.ext"; [...] CRLF
-      while ((bOk = readNextHeader(the_client, sFieldName, sizeof(sFieldName), sFieldValue, sizeof(sFieldValue))))
+      while ((bOk = readNextHeader(the_client, sFieldName, local_maxFieldNameLength, sFieldValue, local_maxFieldValueLength)))
       {
         if (!sFieldName[0]) break;
         if (!strcasecmp(sFieldName, "Content-Disposition")) break;
@@ -895,32 +2576,50 @@ bool HttpSvr::prv_dispatchPOST(ClientProxy& the_client, const char * the_urlBuff
     if (!skipHeaders(the_client)) { sendResponseBadRequest(the_client); return false; }
     if (!the_client.readCRLF()) { sendResponseBadRequest(the_client); return false; }
 
-    // Open file for writing on SD card
-    static char * sLocalName = "upload.txt";
-    if (SD.exists(sLocalName)) SD.remove(sLocalName);
-    File aFile = SD.open(sLocalName, FILE_WRITE);
-    if (!aFile) { sendResponseInternalServerError(the_client); return false; }
+    // Open file for writing on SD card, replacing any previous one
+    static const char * sLocalName = "upload.txt";
+    if (!my_sdSvr.openWriteFile(sLocalName, true)) { sendResponseInternalServerError(the_client); return false; }
 
     // Read body until the boundary delimiter or the end delimiter is found
+    // (lines are buffered by SdSvr, and written to the card by whole sectors)
     uint32_t uRead;
     uint32_t uTotRead = 0;
-    while ((uRead = the_client.readToEOL(sFieldValue, sizeof(sFieldValue))) > 0)
+    bool bWritten = true;
+    while ((uRead = the_client.readToEOL(sFieldValue, local_maxFieldValueLength)) > 0)
     {
-      if (local_isBoundary(sFieldValue, uRead, crcBoundary)) break;
-      aFile.write((uint8_t*)(sFieldValue), uRead);
+      if (local_isBoundary(sFieldValue, uRead, crcBoundary, lenBoundary)) break;
+      if (bWritten) bWritten = my_sdSvr.writeFileBuffer(reinterpret_cast<uint8_t *>(sFieldValue), uRead);
       uTotRead += uRead;
     }
-    aFile.close();
+    if (!my_sdSvr.closeWriteFile()) bWritten = false;
+    if (!bWritten) { sendResponseInternalServerError(the_client); return false; }
 
     char sTotRead[16];
     ltoa(uTotRead, sTotRead, 10);
     sendResponseOkWithContent(the_client, strlen(sTotRead));
     sendResponse(the_client, sTotRead);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), 1);
     return true;
   }
+#else
+  // Uploads are disabled: a provider is needed for this resource
+  if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
+  {
+    skipToBody(the_client);
+    sendResponseNotFound(the_client);
+    return false;
+  }
+#endif // #if HTTPSVR_UPLOAD
   
   // If a provider has been found, call it
-  if (my_resMap[u].fn) return (my_resMap[u].fn)(the_client, http_e::mthd_post, the_urlBuffer);
+  my_lastRoute = u;
+  if (my_resMap[u].fn)
+  {
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), u);
+    bool bOk = (my_resMap[u].fn)(the_client, http_e::mthd_post, the_urlBuffer);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), bOk);
+    return bOk;
+  }
   
   sendResponseNotFound(the_client);
   return false;
@@ -928,22 +2627,461 @@ bool HttpSvr::prv_dispatchPOST(ClientProxy& the_client, const char * the_urlBuff
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static const uint8_t msg_size = 32;
+#if HTTPSVR_PUT
 
-bool HttpSvr::prv_sendString(ClientProxy& the_client, const char * the_str) const
+static bool local_isPlainPath(const char * the_path)
 {
-  uint8_t msg[msg_size];
+  // A path from the root, like "/name" or "/dir/name", made of printable chars
+  // other than those with a special meaning (escapes, drives, wildcards...),
+  // where no name is empty or starts with '.' (so there is no "." or "..")
+  if (*the_path != '/') return false;
+  for (const char * p = the_path; *p; ++p)
+  {
+    if (*p == '/')
+    {
+      if ((p[1] == 0) || (p[1] == '/') || (p[1] == '.')) return false;
+      continue;
+    }
+    if ((*p < 0x21) || (*p > 0x7E)) return false;
+    if (strchr("\\:%*?\"<>|", *p)) return false;
+  }
+  return true;
+}
 
-  if (!the_str || !the_str[0]) return false;
+static bool local_readChunkSize(ClientProxy& the_client, uint32_t& the_size)
+{
+  // Size of the next chunk, in hex, followed by extensions (ignored) up to the
+  // end of line (see RFC 2616 par. 3.6.1). As with skipToNextLine, the CRLF
+  // ending the line is left to be consumed.
+  the_size = 0;
+  uint8_t uDigits = 0;
+  uint8_t ch;
+  while (true)
+  {
+    if (!the_client.readByte(ch)) return false;
+    uint8_t uDigit;
+    if      ((ch >= '0') && (ch <= '9')) uDigit = ch - '0';
+    else if ((ch >= 'a') && (ch <= 'f')) uDigit = ch - 'a' + 10;
+    else if ((ch >= 'A') && (ch <= 'F')) uDigit = ch - 'A' + 10;
+    else break;
+    if (++uDigits > 8) return false;
+    the_size = (the_size << 4) | uDigit;
+  }
+  if (!uDigits) return false;
+  the_client.unreadByte(ch);
+  return the_client.skipToNextLine();
+}
+
+static bool local_skipTrailers(ClientProxy& the_client)
+{
+  // Trailers after the last chunk are ignored, up to the empty line, which is
+  // consumed as well. Lines are skipped whole, so that no field buffer is
+  // needed while the block of the body is held.
+  uint8_t ch;
+  while (true)
+  {
+    if (!the_client.readCRLF()) return false;
+    if (!the_client.peekByte(ch)) return false;
+    if (ch == '\r') return the_client.readCRLF();
+    if (!the_client.skipToNextLine()) return false;
+  }
+}
+
+char * HttpSvr::prv_writablePath(ClientProxy& the_client, http_e::method the_method, const char * the_urlBuffer)
+{
+  // The path is copied without query in the arena, which the caller gives back.
+  // If it cannot be written, the response is sent and 0 is returned.
+  uint16_t uLen = uriFindEndOfPath(the_urlBuffer) - the_urlBuffer;
+  char * sPath = my_arena.alloc_chars(uLen + 1);
+  if (!sPath) { sendResponseInternalServerError(the_client); return 0; }
+  memcpy(sPath, the_urlBuffer, uLen);
+  sPath[uLen] = 0;
+
+  if (!local_isPlainPath(sPath)) { sendResponseBadRequest(the_client); return 0; }
+  if (my_authHandler && !my_authHandler(the_client, the_method, sPath, my_authorization))
+  { sendResponseForbidden(the_client); return 0; }
+  return sPath;
+}
+
+bool HttpSvr::prv_readPutBody(ClientProxy& the_client)
+{
+  // The body is written to the current write file block by block, as it is
+  // received. If anything goes wrong, the response is sent and false is returned.
+  static const uint16_t uBlockSize = HttpSvrConfig::fileBlockSize;
+  ext::arena_scope<arena_t> aScope(my_arena);
+  uint8_t * pBlock = my_arena.alloc(uBlockSize);
+  if (!pBlock) { sendResponseInternalServerError(the_client); return false; }
+
+  uint32_t uLeft   = my_chunkedBody ? 0 : my_contentLength;
+  bool     bChunks = false;
+  while (true)
+  {
+    if (!uLeft)
+    {
+      if (!my_chunkedBody) return true;
+
+      // Each chunk is followed by CRLF; the last one is empty, and may be
+      // followed by trailers up to an empty line
+      if (bChunks && !the_client.readCRLF()) { sendResponseBadRequest(the_client); return false; }
+      if (!local_readChunkSize(the_client, uLeft)) { sendResponseBadRequest(the_client); return false; }
+      bChunks = true;
+      if (!uLeft)
+      {
+        if (!local_skipTrailers(the_client)) { sendResponseBadRequest(the_client); return false; }
+        return true;
+      }
+      if (!the_client.readCRLF()) { sendResponseBadRequest(the_client); return false; }
+    }
+
+    uint16_t uSize = (uLeft < uBlockSize) ? uLeft : uBlockSize;
+    uint16_t uRead = the_client.readBuffer(pBlock, uSize);
+    if (!uRead) { sendResponseBadRequest(the_client); return false; }
+    if (!my_sdSvr.writeFileBuffer(pBlock, uRead)) { sendResponseInternalServerError(the_client); return false; }
+    uLeft -= uRead;
+  }
+}
+
+#endif // #if HTTPSVR_PUT
+
+bool HttpSvr::prv_dispatchPUT(ClientProxy& the_client, const char * the_urlBuffer)
+{
+  // Find stored bind info
+  uint8_t u = prv_boundResIdx(the_client, the_urlBuffer);
+
+#if HTTPSVR_PUT
+  // If there is no provider for this resource, the body is written to the file
+  // at this path on SD card
+  if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
+  {
+    my_lastRoute = http_metrics::route_sd;
+    skipToBody(the_client);
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), my_lastRoute);
+    if ((my_contentLength < 0) && !my_chunkedBody) { sendResponseLengthRequired(the_client); return false; }
+
+    ext::arena_scope<arena_t> aScope(my_arena);
+    char * sPath = prv_writablePath(the_client, http_e::mthd_put, the_urlBuffer);
+    if (!sPath) return false;
+
+    // If the file cannot be opened, its directory may be missing
+    bool bExisted = my_sdSvr.resFileExists(sPath);
+    bool bOpen    = my_sdSvr.openWriteFile(sPath, true);
+    char * pSlash = strrchr(sPath, '/');
+    if (!bOpen && !bExisted && (pSlash > sPath))
+    {
+      *pSlash = 0;
+      bool bDir = my_sdSvr.makeDirectory(sPath);
+      *pSlash = '/';
+      bOpen = bDir && my_sdSvr.openWriteFile(sPath, true);
+    }
+    if (!bOpen) { sendResponseInternalServerError(the_client); return false; }
+
+    // A file that has not been written completely is removed
+    bool bRead    = prv_readPutBody(the_client);
+    bool bWritten = my_sdSvr.closeWriteFile() && bRead;
+    if (!bWritten) my_sdSvr.removeFile(sPath);
+    if (!bRead) return false;
+    if (!bWritten) { sendResponseInternalServerError(the_client); return false; }
+
+    if (bExisted) sendResponseNoContent(the_client);
+    else          sendResponseCreated(the_client);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), 1);
+    return true;
+  }
+#else
+  // Files cannot be written: a provider is needed for this resource
+  if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
+  {
+    skipToBody(the_client);
+    sendResponseMethodNotAllowed(the_client);
+    return false;
+  }
+#endif // #if HTTPSVR_PUT
+
+  // If a provider has been found, call it
+  my_lastRoute = u;
+  if (my_resMap[u].fn)
+  {
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), u);
+    bool bOk = (my_resMap[u].fn)(the_client, http_e::mthd_put, the_urlBuffer);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), bOk);
+    return bOk;
+  }
+  
+  sendResponseNotFound(the_client);
+  return false;
+}
+
+bool HttpSvr::prv_dispatchDELETE(ClientProxy& the_client, const char * the_urlBuffer)
+{
+  // Find stored bind info
+  uint8_t u = prv_boundResIdx(the_client, the_urlBuffer);
+
+#if HTTPSVR_PUT
+  // If there is no provider for this resource, the file at this path on SD card
+  // is removed
+  if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
+  {
+    my_lastRoute = http_metrics::route_sd;
+
+    // A body has no meaning here: it is skipped
+    uint16_t uBodyLength = skipToBody(the_client);
+    while (uBodyLength-->0)
+    {
+      uint8_t ch;
+      if (!the_client.readByte(ch))
+      { sendResponseBadRequest(the_client); return false; }
+    }
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), my_lastRoute);
+
+    ext::arena_scope<arena_t> aScope(my_arena);
+    char * sPath = prv_writablePath(the_client, http_e::mthd_delete, the_urlBuffer);
+    if (!sPath) return false;
+
+    // Directories are not removed
+    if (!my_sdSvr.resFileExists(sPath)) { sendResponseNotFound(the_client); return false; }
+    if (!my_sdSvr.removeFile(sPath)) { sendResponseForbidden(the_client); return false; }
+
+    sendResponseNoContent(the_client);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), 1);
+    return true;
+  }
+#else
+  // Files cannot be removed: a provider is needed for this resource
+  if ((u >= smy_resMap_size) || (my_resMap[u].crc == 0))
+  {
+    skipToBody(the_client);
+    sendResponseMethodNotAllowed(the_client);
+    return false;
+  }
+#endif // #if HTTPSVR_PUT
+
+  // If a provider has been found, call it
+  my_lastRoute = u;
+  if (my_resMap[u].fn)
+  {
+    HttpTrace_EVENT(ev_handlerStart, the_client.socket(), u);
+    bool bOk = (my_resMap[u].fn)(the_client, http_e::mthd_delete, the_urlBuffer);
+    HttpTrace_EVENT(ev_handlerEnd, the_client.socket(), bOk);
+    return bOk;
+  }
   
-  uint32_t u = 0;
-  while (*the_str)
+  sendResponseNotFound(the_client);
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void HttpSvr::prv_countRequest(http_e::method the_method)
+{
+#if HTTPSVR_METRICS
+  ++my_metrics.requests[the_method];
+#else
+  (void)the_method;
+#endif
+}
+
+void HttpSvr::prv_countStatus(http_metrics::status the_status) const
+{
+#if HTTPSVR_METRICS
+  ++my_metrics.responses[the_status];
+#else
+  (void)the_status;
+#endif
+}
+
+void HttpSvr::prv_countTraffic(uint32_t the_bytesIn, uint32_t the_bytesOut)
+{
+#if HTTPSVR_METRICS
+  my_metrics.bytesIn  += the_bytesIn;
+  my_metrics.bytesOut += the_bytesOut;
+#else
+  (void)the_bytesIn;
+  (void)the_bytesOut;
+#endif
+}
+
+void HttpSvr::prv_countTimeout()
+{
+#if HTTPSVR_METRICS
+  ++my_metrics.timeouts;
+#endif
+}
+
+void HttpSvr::prv_countReset()
+{
+#if HTTPSVR_METRICS
+  ++my_metrics.resets;
+#endif
+}
+
+void HttpSvr::prv_countLatency(uint8_t the_route, uint32_t the_ms)
+{
+#if HTTPSVR_METRICS
+  if (the_route >= http_metrics::routes) return;
+
+  // Bucket 0 counts requests served in less than 1ms, bucket b counts those
+  // served in [2^(b-1), 2^b) ms, the last bucket counts all the slower ones.
+  // Durations are whole ms, so the upper bound ("le") of bucket b is 2^b - 1
+  uint8_t b = 0;
+  for (uint32_t ms = the_ms; ms && (b < http_metrics::buckets-1); ms >>= 1) ++b;
+
+  uint16_t& counter = my_metrics.latency[the_route][b];
+  if (counter != 0xFFFF) ++counter;
+  my_metrics.latencySumMs[the_route] += the_ms;
+#else
+  (void)the_route;
+  (void)the_ms;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_METRICS
+
+static const char * const local_methodNames[http_metrics::methods] =
+{ "", HttpSvr_OPTIONS, HttpSvr_GET, HttpSvr_HEAD, HttpSvr_POST, HttpSvr_PUT, HttpSvr_DELETE, HttpSvr_TRACE, HttpSvr_CONNECT };
+
+static const char * const local_statusNames[http_metrics::st_end] =
+{ HttpSvr_SC_200, HttpSvr_SC_400, HttpSvr_SC_404, HttpSvr_SC_405, HttpSvr_SC_414, HttpSvr_SC_500, "other" };
+
+static void local_writeCounter(ResponseWriter& the_writer, const char * the_name, uint32_t the_value)
+{
+  the_writer.write("# TYPE httpsvr_");
+  the_writer.write(the_name);
+  the_writer.write(" counter\n" "httpsvr_");
+  the_writer.write(the_name);
+  the_writer.writeByte(' ');
+  the_writer.writeNumber(the_value);
+  the_writer.writeByte('\n');
+}
+
+static void local_writeGauge(ResponseWriter& the_writer, const char * the_name, uint32_t the_value)
+{
+  the_writer.write("# TYPE httpsvr_");
+  the_writer.write(the_name);
+  the_writer.write(" gauge\n" "httpsvr_");
+  the_writer.write(the_name);
+  the_writer.writeByte(' ');
+  the_writer.writeNumber(the_value);
+  the_writer.writeByte('\n');
+}
+
+#endif // #if HTTPSVR_METRICS
+
+void HttpSvr::prv_writeMetrics(ResponseWriter& the_writer) const
+{
+  // Write metrics in Prometheus text exposition format (version 0.0.4)
+#if HTTPSVR_METRICS
+  the_writer.write("# TYPE httpsvr_requests_total counter\n");
+  for (uint8_t m = http_e::mthd_options; m < http_metrics::methods; ++m)
   {
-    msg[u++] = *the_str++;
-    if (u >= msg_size) { the_client.writeBuffer(msg, msg_size); u = 0; }
+    the_writer.write("httpsvr_requests_total{method=\"");
+    the_writer.write(local_methodNames[m]);
+    the_writer.write("\"} ");
+    the_writer.writeNumber(my_metrics.requests[m]);
+    the_writer.writeByte('\n');
   }
-  if (u > 0) the_client.writeBuffer(msg, u);
-  return true;
+
+  the_writer.write("# TYPE httpsvr_responses_total counter\n");
+  for (uint8_t st = 0; st < http_metrics::st_end; ++st)
+  {
+    the_writer.write("httpsvr_responses_total{code=\"");
+    the_writer.write(local_statusNames[st]);
+    the_writer.write("\"} ");
+    the_writer.writeNumber(my_metrics.responses[st]);
+    the_writer.writeByte('\n');
+  }
+
+  local_writeCounter(the_writer, "received_bytes_total"  , my_metrics.bytesIn        );
+  local_writeCounter(the_writer, "sent_bytes_total"      , my_metrics.bytesOut       );
+  local_writeCounter(the_writer, "spi_accesses_total"    , my_metrics.spiAccesses    );
+  local_writeCounter(the_writer, "timeouts_total"        , my_metrics.timeouts       );
+  local_writeCounter(the_writer, "resets_total"          , my_metrics.resets         );
+  local_writeGauge  (the_writer, "arena_bytes"           , my_metrics.arenaSize      );
+  local_writeGauge  (the_writer, "arena_peak_bytes"      , my_metrics.arenaPeak      );
+  local_writeCounter(the_writer, "arena_failures_total"  , my_metrics.arenaFailures  );
+
+  // Latency histograms, one per route. Routes are identified by their binding index,
+  // or by "sd" for files served from SD card. Unused routes are not reported.
+  the_writer.write("# TYPE httpsvr_request_duration_ms histogram\n");
+  for (uint8_t r = 0; r < http_metrics::routes; ++r)
+  {
+    if ((r != http_metrics::route_sd) && (my_resMap[r].crc == 0)) continue;
+
+    char sRoute[4];
+    if (r == http_metrics::route_sd) strcpy(sRoute, "sd");
+    else                            itoa(r, sRoute, 10);
+
+    uint32_t uCumulated = 0;
+    for (uint8_t b = 0; b < http_metrics::buckets; ++b)
+    {
+      uCumulated += my_metrics.latency[r][b];
+      the_writer.write("httpsvr_request_duration_ms_bucket{route=\"");
+      the_writer.write(sRoute);
+      the_writer.write("\",le=\"");
+      if (b < http_metrics::buckets-1) the_writer.writeNumber((static_cast<uint32_t>(1) << b) - 1);
+      else                             the_writer.write("+Inf");
+      the_writer.write("\"} ");
+      the_writer.writeNumber(uCumulated);
+      the_writer.writeByte('\n');
+    }
+    the_writer.write("httpsvr_request_duration_ms_sum{route=\"");
+    the_writer.write(sRoute);
+    the_writer.write("\"} ");
+    the_writer.writeNumber(my_metrics.latencySumMs[r]);
+    the_writer.write("\nhttpsvr_request_duration_ms_count{route=\"");
+    the_writer.write(sRoute);
+    the_writer.write("\"} ");
+    the_writer.writeNumber(uCumulated);
+    the_writer.writeByte('\n');
+  }
+#else
+  (void)the_writer;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool HttpSvr::prv_sendString(ClientProxy& the_client, const char * the_str) const
+{
+  if (!the_str || !the_str[0]) return false;
+  
+  // The string is passed directly to the tx memory of the socket, which does not modify it
+  uint16_t uLen = strlen(the_str);
+  return (the_client.writeBuffer(reinterpret_cast<uint8_t *>(const_cast<char *>(the_str)), uLen) == uLen);
+}
+
+bool HttpSvr::prv_sendHeaderOk(ClientProxy& the_client, uint32_t the_size, const char * the_mimeType) const
+{
+  // 200 OK
+  static const char * msg01 = HttpSvr_HTTP_VERSION HttpSvr_SP HttpSvr_SC_200 HttpSvr_SP HttpSvr_RP_200 HttpSvr_CRLF;
+  static const char * msg02 = HttpSvr_header_server HttpSvr_CRLF;
+  static const char * msg03 = HttpSvr_header_content_type;
+  static const char * msg04 = HttpSvr_header_content_length;
+  static const uint16_t msg04_len = sizeof(HttpSvr_header_content_length) - 1;
+  
+  // Send start line
+  if (!prv_sendString(the_client, msg01)) return false;
+  
+  // Send headers: "Server: xxx"...
+  if (!prv_sendString(the_client, msg02)) return false;
+
+  // ..."Content-Type: text/html" (or the given media type)
+  if (!prv_sendString(the_client, msg03)) return false;
+  if (!prv_sendString(the_client, the_mimeType ? the_mimeType : HttpSvr_mime_html)) return false;
+  if (!prv_sendString(the_client, HttpSvr_CRLF)) return false;
+
+  // ..."Content-Length: xxx"
+  ext::arena_scope<arena_t> aScope(my_arena);
+  char * sContentLengthHeader = my_arena.alloc_chars(msg04_len + 16);
+  if (!sContentLengthHeader) return false;
+  memcpy(sContentLengthHeader, msg04, msg04_len);
+  ltoa(the_size, &sContentLengthHeader[msg04_len], 10);
+    strcat(sContentLengthHeader, HttpSvr_CRLF);
+  if (!prv_sendString(the_client, sContentLengthHeader)) return false;
+  
+  // ...and an emtpy line (end of headers)
+  return prv_sendString(the_client, HttpSvr_CRLF);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
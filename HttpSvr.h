@@ -24,8 +24,20 @@
 #include <Arduino.h>
 #include <IPAddress.h>
 
+#include "HttpSvrConfig.h"
 #include "ClientProxy.h"
-#include "utility/SdSvr.h"
+#include "ResponseWriter.h"
+#include "HttpParams.h"
+#include "JsonWriter.h"
+#include "WebSocket.h"
+#if HTTPSVR_SD
+#  include "utility/SdSvr.h"
+#endif
+#if HTTPSVR_BUNDLE
+#  include "utility/FlashBundle.h"
+#endif
+#include "utility/HttpTrace.h"
+#include "utility/arena.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Some useful definitions of strings
@@ -38,6 +50,9 @@
 #define HttpSvr_COLON        ":"
 #define HttpSvr_SLASH        "/"
 
+// Kept for compatibility: see HTTPSVR_MAX_BOUND_URLS in HttpSvrConfig.h
+#define HttpSvr_MAX_BOUND_URLS HTTPSVR_MAX_BOUND_URLS
+
 ///////////////////////////////////////////////////////////////////////////////
 // Definition of strings used in HTTP protocol
 
@@ -190,12 +205,35 @@
 #define HttpSvr_expires             "Expires"
 #define HttpSvr_last_modified       "Last-Modified"
 
+// WebSocket handshake headers (see RFC 6455 par. 11.3)
+#define HttpSvr_sec_websocket_key    "Sec-WebSocket-Key"
+#define HttpSvr_sec_websocket_accept "Sec-WebSocket-Accept"
+
 ///////////////////////////////////////////////////////////////////////////////
 // Precompiled message headers
 
 #define HttpSvr_header_server              HttpSvr_server HttpSvr_COLON HttpSvr_SP HttpSvr_SERVERNAME HttpSvr_SLASH HttpSvr_VERSION // "Server: HttpSvr/x.y.z"
 #define HttpSvr_header_content_length      HttpSvr_content_length HttpSvr_COLON HttpSvr_SP // "Content-Length: "
+#define HttpSvr_header_content_type        HttpSvr_content_type HttpSvr_COLON HttpSvr_SP // "Content-Type: "
 #define HttpSvr_header_content_type_html   HttpSvr_content_type HttpSvr_COLON HttpSvr_SP "text/html"// "Content-Type: text/html"
+#define HttpSvr_header_chunked             HttpSvr_transfer_encoding HttpSvr_COLON HttpSvr_SP "chunked" // "Transfer-Encoding: chunked"
+#define HttpSvr_header_no_cache            HttpSvr_cache_control HttpSvr_COLON HttpSvr_SP "no-cache" // "Cache-Control: no-cache"
+#define HttpSvr_header_etag                HttpSvr_etag HttpSvr_COLON HttpSvr_SP // "ETag: "
+#define HttpSvr_header_location            HttpSvr_location HttpSvr_COLON HttpSvr_SP // "Location: "
+#define HttpSvr_header_upgrade_websocket   HttpSvr_upgrade HttpSvr_COLON HttpSvr_SP "websocket" // "Upgrade: websocket"
+#define HttpSvr_header_connection_upgrade  HttpSvr_connection HttpSvr_COLON HttpSvr_SP HttpSvr_upgrade // "Connection: Upgrade"
+#define HttpSvr_header_websocket_accept    HttpSvr_sec_websocket_accept HttpSvr_COLON HttpSvr_SP // "Sec-WebSocket-Accept: "
+
+///////////////////////////////////////////////////////////////////////////////
+// Media types (see RFC 2616 par. 3.7)
+
+#define HttpSvr_mime_html           "text/html"
+#define HttpSvr_mime_text           "text/plain"
+#define HttpSvr_mime_prometheus     "text/plain; version=0.0.4"
+#define HttpSvr_mime_octet_stream   "application/octet-stream"
+#define HttpSvr_mime_json           "application/json"
+#define HttpSvr_mime_csv            "text/csv"
+#define HttpSvr_mime_event_stream   "text/event-stream"
 
 ///////////////////////////////////////////////////////////////////////////////
 // The following struct contains all the enums used in the library.
@@ -316,6 +354,55 @@ struct http_e
   };
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// The following struct contains the counters kept by HttpSvr about the requests
+// it serves. It is sent as is by HttpSvr::sendMetricsBinary, so its layout must
+// not change without increasing "layout_version". Multi-byte values are sent in
+// the byte order of the board (little endian on AVR).
+
+struct http_metrics
+{
+  // Response status codes counted one by one. All the others are counted as "other".
+  enum status
+  {
+    st_200,
+    st_400,
+    st_404,
+    st_405,
+    st_414,
+    st_500,
+    st_other,
+    st_end
+  };
+
+  enum
+  {
+    layout_version = 2,
+    methods        = http_e::mthd_connect + 1,
+    routes         = HttpSvr_MAX_BOUND_URLS + 1,  // One per bound URL (in binding order), plus one for SD files
+    route_sd       = HttpSvr_MAX_BOUND_URLS,
+    buckets        = 12                           // <1ms, <2ms, <4ms, ... <1024ms, >=1024ms
+  };
+
+  uint8_t  layoutVersion;
+  uint8_t  nRoutes;
+  uint8_t  nBuckets;
+  uint8_t  reserved;
+  uint32_t uptimeMs;
+  uint32_t requests [methods];                    // Indexed by http_e::method
+  uint32_t responses[st_end];
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+  uint32_t spiAccesses;                           // Register or buffer accesses, i.e. SPI frames
+  uint32_t timeouts;
+  uint32_t resets;
+  uint16_t arenaSize;
+  uint16_t arenaPeak;                             // High-water mark of per-request scratch memory
+  uint32_t arenaFailures;                         // Allocations refused because the arena was full
+  uint32_t latencySumMs[routes];
+  uint16_t latency     [routes][buckets];         // Log2 histogram of request service time
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // The class implementing the HTTP server
 
@@ -351,6 +438,41 @@ public:
   // The function to be called on exit.                   
   void terminate();
 
+#if HTTPSVR_BUNDLE
+  // Files can be served from a bundle in flash memory, generated by extras/tools/mkbundle.py,
+  // either in place of an SD card or along with it (files in the bundle are found first):
+  //   #include "bundle.h"
+  //   server.setFlashBundle(bundle_entries, bundle_count);
+  // Gzipped files are refused with 406 to clients not accepting gzip.
+  void setFlashBundle(const FlashBundle::entry_t * the_entries, uint16_t the_count);
+#endif
+
+#if HTTPSVR_SD
+  // Files served from SD card are kept open, and small ones in RAM (see SdSvr).
+  // This function must be called after files have been changed on the card by
+  // the application, so that they are read again.
+  void flushFileCache();
+
+  // Files can be written on SD card by the application too (e.g. logs), with the
+  // buffered write functions of SdSvr (openWriteFile...). Only one file at a time
+  // can be written, and uploads close the file written by the application.
+  SdSvr& sdSvr() { return my_sdSvr; }
+#endif
+
+#if HTTPSVR_TEMPLATES
+  // Pages on SD card whose name ends with HTTPSVR_TEMPLATE_EXT (".stm") are templates: each
+  // placeholder like {{name}} is replaced, while the page is being sent, by what the function
+  // bound to the name writes, e.g.:
+  //   void tvUptime(ResponseWriter& the_writer, const char * the_name)
+  //   { the_writer.writeNumber(millis() / 1000); }
+  //   server.bindTemplateVar("uptime", &tvUptime);
+  // Names are made of letters, digits, '_', '.' and '-', at most 31 chars; placeholders with
+  // names which are not bound are sent as they are. Pages are sent in chunked transfer
+  // coding, and never cached in RAM.
+  typedef void (*var_callback_t)(ResponseWriter&, const char *);
+  bool            bindTemplateVar       (const char * the_name, var_callback_t the_callback);
+#endif
+
 public:
   // Resource Binding
   // Resources are the basic object of a HTTP request: any HTTP request message is basically
@@ -370,6 +492,25 @@ public:
   bool            isUrlBound            (const char * the_url);
   bool            resetUrlBinding       (const char * the_url);
   void            resetAllBindings      ();
+
+#if HTTPSVR_RESPONSE_CACHE
+  // Responses which seldom change (settings, version...) can be kept in RAM, headers
+  // included, and sent again as they are to the following GET requests for the same URL
+  // (query included), without calling the provider. The provider opts in by calling
+  // cacheResponse while serving a GET, e.g.:
+  //   bool rpVersion(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+  //   {
+  //     server.cacheResponse(60000);
+  //     ...
+  //   }
+  // The response is kept for the_ms milliseconds, or until invalidateResponses is called
+  // for its URL if the_ms is 0. Only complete "200 OK" responses are kept, and only if
+  // they fit in HTTPSVR_RESPONSE_CACHE bytes; the least recently used one is dropped to
+  // make room for a new one.
+  void            cacheResponse         (uint32_t the_ms = 0);
+  void            invalidateResponses   (const char * the_url);
+  void            invalidateAllResponses();
+#endif
   
 public:
   // Client connection management
@@ -435,31 +576,246 @@ public:
   // Response generation utilities
   // These functions may be used as shortcuts for response generation, either for
   // errors or for success. Other fuctions can be added for generating other kinds of responses
+  // When the length of a body is not known in advance (e.g. a long JSON document written with
+  // JsonWriter), sendResponseOkChunked sends headers for chunked transfer coding and sets the
+  // given ResponseWriter accordingly; the body must then be terminated by its "finish":
+  //   ResponseWriter aWriter(&the_client);
+  //   server.sendResponseOkChunked(the_client, aWriter, HttpSvr_mime_json);
+  //   JsonWriter aJson(aWriter);
+  //   ...
+  //   return aWriter.finish();
   bool            sendResponse                    (ClientProxy&, const char *) const;
   bool            sendResponseOk                  (ClientProxy&) const;
-  bool            sendResponseOkWithContent       (ClientProxy&, uint32_t) const;
+  bool            sendResponseOkWithContent       (ClientProxy&, uint32_t, const char * the_mimeType = 0) const;
+  bool            sendResponseOkChunked           (ClientProxy&, ResponseWriter&, const char * the_mimeType = 0) const;
+  bool            sendResponseCreated             (ClientProxy&) const;
+  bool            sendResponseNoContent           (ClientProxy&) const;
+  bool            sendResponseMovedPermanently    (ClientProxy&, const char * the_location) const;
   bool            sendResponseBadRequest          (ClientProxy&) const;
+  bool            sendResponseForbidden           (ClientProxy&) const;
   bool            sendResponseNotFound            (ClientProxy&) const;
   bool            sendResponseMethodNotAllowed    (ClientProxy&) const;
+  bool            sendResponseLengthRequired      (ClientProxy&) const;
   bool            sendResponseInternalServerError (ClientProxy&) const;
   bool            sendResponseRequestUriTooLarge  (ClientProxy&) const;
+  bool            sendResponseServiceUnavailable  (ClientProxy&) const;
   
 public:
-  // Message analysis
+  // Per-request scratch memory
+  // Buffers needed while serving a request (URL, header fields, file blocks, headers being built...)
+  // are taken from a fixed-size arena instead of the stack, so that stack use stays small and
+  // predictable. The arena is emptied at the end of each request served by serveHttpConnections.
+  // Resource providers can take their own buffers from it as well, e.g.:
+  //   ext::arena_scope<HttpSvr::arena_t> aScope(server.arena());
+  //   char * sBuffer = server.arena().alloc_chars(64);
+  //   if (!sBuffer) return server.sendResponseInternalServerError(the_client);
+  // arena().peak() reports the highest amount of memory ever used, to tune HTTPSVR_ARENA_SIZE.
+  typedef ext::arena<HttpSvrConfig::arenaSize> arena_t;
+  arena_t&        arena                 () const { return my_arena; }
+  
+public:
+  // Metrics
+  // When HTTPSVR_METRICS is non-zero, HttpSvr counts requests by method, responses by status code,
+  // bytes received and sent, SPI accesses, timeouts and resets, and keeps a latency histogram
+  // for each bound URL and for files served from SD card (see struct http_metrics).
+  // Counters can be sent to a client either as text, in the Prometheus exposition format, or as
+  // the raw http_metrics struct. These functions are meant to be called by a resource provider
+  // bound to a URL such as "/metrics".
+#if HTTPSVR_METRICS
+  const http_metrics& metrics           () const;
+  void            resetMetrics          ();
+  bool            sendMetrics           (ClientProxy&) const;
+  bool            sendMetricsBinary     (ClientProxy&) const;
+#endif
+
+  // Request lifecycle trace
+  // When HTTPSVR_TRACE is non-zero, the events recorded by HttpTrace can be sent to a client
+  // as binary: the 4 chars "HTR1", the number of records (1 byte), then each record as
+  // 4 bytes of timestamp in microseconds (little endian), 1 byte of socket/event and 1 byte of
+  // argument. extras/tools/httptrace.py decodes this format into per-request timelines.
+#if HTTPSVR_TRACE
+  bool            sendTrace             (ClientProxy&) const;
+#endif
+
+public:
+  // Server-Sent Events
+  // When HTTPSVR_SSE is non-zero, a resource provider can turn its connection into an event
+  // stream (content type "text/event-stream") by calling beginEventStream and returning its
+  // result. The connection is then held open, with no timeout, until the client closes it,
+  // and the application pushes events to all open streams from "loop" with pushEvent, e.g.:
+  //   server.pushEvent("pin", "{\"13\":1}");
+  // Events are written only if they fit in the tx memory of the socket, so pushEvent never
+  // waits: events that do not fit are dropped for that stream and counted in eventsDropped.
+  // Events should then carry states rather than changes, so that a dropped event is made up
+  // for by the next one. Idle streams are sent a comment every HTTPSVR_SSE_HEARTBEAT_MS.
+  // At most HTTPSVR_SSE_MAX_STREAMS streams can be open: further ones are refused with 503.
+#if HTTPSVR_SSE
+  bool            beginEventStream      (ClientProxy&) const;
+  uint8_t         pushEvent             (const char * the_event, const char * the_data);
+  uint8_t         eventStreams          () const;
+  uint32_t        eventsDropped         () const { return my_eventsDropped; }
+#endif
+
+public:
+  // WebSocket
+  // When HTTPSVR_WEBSOCKET is non-zero, a resource provider can upgrade its connection to a
+  // WebSocket (RFC 6455) by calling acceptWebSocket and returning its result; requests without
+  // "Sec-WebSocket-Key" are refused with 400, and those exceeding HTTPSVR_WS_MAX_CONNECTIONS
+  // with 503. The connection is then held open until either side closes it.
+  // Messages are received by serveHttpConnections, as they arrive, and passed to the handler
+  // set with setWebSocketHandler, together with a WebSocket to reply on, e.g.:
+  //   void onMessage(WebSocket& the_ws, WebSocket::opcode_e the_op, uint8_t * the_data, uint16_t the_len)
+  //   { the_ws.sendBinary(the_data, the_len); }
+  // The message is in the arena, unmasked and with a terminating null char, so text can be
+  // used as a string; messages longer than HTTPSVR_WS_MAX_MESSAGE close the connection.
+  // The application sends messages to all connections from "loop" with broadcastWebSocket:
+  // like pushEvent, it never waits, and skips connections whose tx memory is full.
+  // Idle connections are sent a ping every HTTPSVR_WS_PING_MS.
+#if HTTPSVR_WEBSOCKET
+  typedef void (*ws_callback_t)(WebSocket&, WebSocket::opcode_e, uint8_t *, uint16_t);
+  bool            acceptWebSocket       (ClientProxy&) const;
+  void            setWebSocketHandler   (ws_callback_t the_callback) { my_wsHandler = the_callback; }
+  uint8_t         broadcastWebSocket    (WebSocket::opcode_e the_opcode, const uint8_t * the_data, uint16_t the_size);
+  uint8_t         webSockets            () const;
+#endif
+
+public:
+  // File management
+  // When HTTPSVR_PUT is non-zero, PUT and DELETE requests to URLs which are not bound write
+  // and remove files on SD card, e.g. for tools that copy web pages to the device:
+  //   curl -T style.css http://device/css/style.css
+  //   curl -X DELETE http://device/css/old.css
+  // The body of a PUT, sized by "Content-Length" or in chunked transfer coding, is written to
+  // the file as it is received (see SdSvr::openWriteFile), and missing directories are created;
+  // the response is 201 for a new file, 204 for a replaced one. Paths must be plain: segments
+  // starting with '.', '%' escapes, backslashes and the like are refused with 400.
+  // The handler set with setAuthHandler, if any, is called before anything is changed, with
+  // the method, the path and the "Authorization" header of the request (empty if missing);
+  // requests for which it returns false are refused with 403, e.g.:
+  //   bool onAuth(ClientProxy&, http_e::method, const char * the_path, const char * the_auth)
+  //   { return !strcmp(the_auth, "Basic YWRtaW46c2VjcmV0"); }
+#if HTTPSVR_PUT
+  typedef bool (*auth_callback_t)(ClientProxy&, http_e::method, const char *, const char *);
+  void            setAuthHandler        (auth_callback_t the_callback) { my_authHandler = the_callback; }
+#endif
+
+public:
+  // Bulk pin I/O
+  // When HTTPSVR_PINIO is non-zero, servePinIo reads and writes many pins in a single request.
+  // It is meant to be called by a resource provider bound to a URL such as "/pins", passing
+  // the same parameters. Request parameters are taken from the query (GET) or from an
+  // application/x-www-form-urlencoded body (POST):
+  //   d=2-9,13      digital pins to read, as a list of pins and ranges
+  //   dm=3ffc       digital pins to read, as a hex bitmask (bit n is pin n), in place of "d"
+  //   a=0-5         analog inputs to read
+  //   w=13:1,12:0   digital pins to write (POST only)
+  //   pwm=3:128     PWM outputs to write with analogWrite (POST only)
+  //   fmt=bin       binary response instead of JSON
+  // Writes are applied before reads, and only if all of them are valid. Only the pins enabled
+  // by setPinIoWritable can be written; the application is in charge of their pinMode.
+  // The JSON response is like {"d":[1,0,...],"a":[512,...]}, values being in the requested order.
+  // The binary response is made of: number of digital values (1 byte), number of analog values
+  // (1 byte), digital values as bits (the first one in bit 0 of the first byte), analog values
+  // as 16-bit little endian integers.
+#if HTTPSVR_PINIO
+  bool            servePinIo            (ClientProxy&, http_e::method, const char *);
+  void            setPinIoWritable      (uint8_t the_pin, bool the_writable);
+#endif
+
+public:
+  // CSV logs
+  // When HTTPSVR_CSVLOG is non-zero, serveCsvLog sends part of a log file on SD card, so that
+  // a client plotting the last hour does not have to download the whole log. It is meant to
+  // be called by a resource provider bound to a URL such as "/log", passing the same parameters
+  // and the path of the file, e.g.:
+  //   bool rpLog(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+  //   { return server.serveCsvLog(the_client, the_method, the_url, "/data/log.csv"); }
+  // Rows must start with a timestamp, as an unsigned integer (e.g. seconds since 1970), and be
+  // sorted by it, as they are when appended by a logger; a first row without timestamp is
+  // taken as a header, and always sent. Request parameters are taken from the query:
+  //   from=1700000000  first timestamp sent
+  //   to=1700003600    last timestamp sent
+  //   skip=10          number of rows skipped, from the first one in the window
+  //   max=500          maximum number of rows sent
+  //   step=6           one row sent every "step" rows (decimation)
+  // The first row of the window is found by binary search on the file, so that only a few
+  // blocks are read before rows are sent, in chunked transfer coding. Rows must be shorter
+  // than HTTPSVR_FILE_BLOCK_SIZE; longer ones are sent in pieces, as separate rows.
+#if HTTPSVR_CSVLOG
+  bool            serveCsvLog           (ClientProxy&, http_e::method, const char * the_url, const char * the_path);
+#endif
 
-  // TODO : Provide some utility for analyzing/serving AJAX requests
+public:
+  // Message analysis
+  // Parameters of AJAX requests and HTML forms come either in the query of the request-URI
+  // or in an application/x-www-form-urlencoded body. These functions prepare an HttpParams
+  // iterator over them, that decodes names and values in place, without copying them.
+  // - queryParams accepts only the URL of the request being served, as passed to resource
+  //   providers, since it lies in a writable buffer owned by HttpSvr.
+  // - readFormParams consumes headers and body, so a provider calling it must not read
+  //   them before. The body is kept in the arena until the end of the request; if it does
+  //   not fit there, it is discarded and false is returned.
+  bool            queryParams           (const char * the_url, HttpParams& the_params) const;
+  bool            readFormParams        (ClientProxy& the_client, HttpParams& the_params) const;
     
 public:
   // Connection and status information
   IPAddress       localIpAddr           () const;
 
 private:
-  void            prv_resetSocket       (W5100::socket_e the_sn, uint16_t the_port) const;
+  void            prv_resetSocket       (NetBackend::socket_e the_sn, uint16_t the_port) const;
+  void            prv_startRequest      (char * the_urlBuffer, uint16_t the_bufferLen);
+  uint8_t         prv_heldOpen          () const;
   bool            prv_readRequestLine   (ClientProxy& the_client, http_e::method& the_method, char * the_urlBuffer, uint16_t the_bufferLen) const;
   uint8_t         prv_boundResIdx       (ClientProxy&, const char *);
   bool            prv_dispatchGET       (ClientProxy&, const char *);
   bool            prv_dispatchPOST      (ClientProxy&, const char *);
+  bool            prv_dispatchPUT       (ClientProxy&, const char *);
+  bool            prv_dispatchDELETE    (ClientProxy&, const char *);
+#if HTTPSVR_PUT
+  char *          prv_writablePath      (ClientProxy& the_client, http_e::method the_method, const char * the_urlBuffer);
+  bool            prv_readPutBody       (ClientProxy& the_client);
+#endif
   bool            prv_sendString        (ClientProxy& the_client, const char * the_str) const;
+  bool            prv_sendHeaderOk      (ClientProxy& the_client, uint32_t the_size, const char * the_mimeType) const;
+#if HTTPSVR_ETAG
+  bool            prv_sendNotModified   (ClientProxy& the_client, uint16_t the_etag) const;
+#endif
+#if HTTPSVR_SD_RAM_CACHE
+  bool            prv_cacheResFile      (const char * the_urlBuffer, SdSvr::cachedFile_t& the_file);
+  bool            prv_sendCachedResFile (ClientProxy& the_client, const SdSvr::cachedFile_t& the_file) const;
+#endif
+#if HTTPSVR_BUNDLE
+  bool            prv_sendBundleFile    (ClientProxy& the_client);
+#endif
+#if HTTPSVR_AUTOINDEX
+  bool            prv_sendDirectory     (ClientProxy& the_client, const char * the_urlBuffer);
+#endif
+#if HTTPSVR_RESPONSE_CACHE
+  bool            prv_callCachedProvider(ClientProxy& the_client, uint8_t the_idx, const char * the_urlBuffer);
+#endif
+#if HTTPSVR_TEMPLATES
+  bool            prv_sendTemplate      (ClientProxy& the_client);
+  void            prv_writeTemplateVar  (ResponseWriter& the_writer, const char * the_name) const;
+#endif
+
+  void            prv_countRequest      (http_e::method the_method);
+  void            prv_countStatus       (http_metrics::status the_status) const;
+  void            prv_countTraffic      (uint32_t the_bytesIn, uint32_t the_bytesOut);
+  void            prv_countTimeout      ();
+  void            prv_countReset        ();
+  void            prv_countLatency      (uint8_t the_route, uint32_t the_ms);
+  void            prv_writeMetrics      (ResponseWriter& the_writer) const;
+#if HTTPSVR_SSE
+  void            prv_serveEventStream  (ClientProxy& the_client);
+  static void     prv_writeEvent        (ResponseWriter& the_writer, const char * the_event, const char * the_data);
+#endif
+#if HTTPSVR_WEBSOCKET
+  void            prv_serveWebSocket    (ClientProxy& the_client);
+#endif
+#if HTTPSVR_PINIO
+  bool            prv_applyPinWrites    (const char * the_spec, bool the_analog, bool the_apply) const;
+#endif
 
 private:
   struct res_fn_pair
@@ -472,9 +828,79 @@ private:
     url_callback_t fn;
   };  
   
-  static const uint8_t smy_resMap_size = 16;
+  static const uint8_t smy_resMap_size = HttpSvrConfig::maxBoundUrls;
   res_fn_pair          my_resMap[smy_resMap_size];
+#if HTTPSVR_TEMPLATES
+  struct var_fn_pair
+  { 
+    var_fn_pair() : crc(0), fn(0) {}
+    
+    uint16_t       crc;
+    var_callback_t fn;
+  };  
+
+  static const uint8_t smy_templateVars = HttpSvrConfig::templateVars;
+  var_fn_pair          my_templateVars[smy_templateVars];
+#endif
+#if HTTPSVR_RESPONSE_CACHE
+  struct cachedResponse_t
+  {
+    cachedResponse_t() : crc(0), res(0), block(0), size(0), stamp(0), ms(0), lastUse(0) {}
+    
+    uint16_t       crc;      // CRC of the URL, query included; 0 if the entry is free
+    uint8_t        res;      // Index of the bound URL
+    uint8_t        block;    // Index of the block in the pool
+    uint16_t       size;
+    uint32_t       stamp;    // Time when the response was kept
+    uint32_t       ms;       // Time it is kept for; 0 for ever
+    uint16_t       lastUse;
+  };
+
+  static const uint8_t  smy_respEntries   = HttpSvrConfig::responseCacheEntries;
+  static const uint16_t smy_respBlockSize = HttpSvrConfig::responseCache;
+  cachedResponse_t     my_respCache[smy_respEntries];
+  uint8_t              my_respPool[(smy_respEntries + 1) * smy_respBlockSize];
+  uint8_t              my_respSpare;    // Block where responses are captured
+  uint16_t             my_respUseCount;
+  bool                 my_respWanted;   // cacheResponse called by the provider
+  uint32_t             my_respMs;
+#endif
+#if HTTPSVR_SD
   SdSvr                my_sdSvr;
+#endif
+#if HTTPSVR_BUNDLE
+  FlashBundle          my_bundle;
+#endif
+  uint16_t             my_port;
+  uint8_t              my_lastRoute;
+  char *               my_urlBuffer;
+  uint16_t             my_urlBufferLen;
+  mutable arena_t      my_arena;
+#if HTTPSVR_SSE
+  uint32_t             my_eventsDropped;
+#endif
+#if HTTPSVR_WEBSOCKET
+  ws_callback_t        my_wsHandler;
+  mutable char         my_wsKey[25];    // "Sec-WebSocket-Key" of the request being served
+#endif
+#if HTTPSVR_ETAG
+  mutable int32_t      my_ifNoneMatch;  // ETag in "If-None-Match", or -1
+#endif
+#if HTTPSVR_BUNDLE
+  mutable bool         my_acceptsGzip;  // "gzip" in "Accept-Encoding"
+#endif
+#if HTTPSVR_PUT
+  auth_callback_t      my_authHandler;
+  mutable int32_t      my_contentLength;// "Content-Length", or -1
+  mutable bool         my_chunkedBody;  // "chunked" in "Transfer-Encoding"
+  mutable char         my_authorization[HttpSvrConfig::maxAuthLength];
+#endif
+#if HTTPSVR_PINIO
+  uint8_t              my_pinIoWritable[(HttpSvrConfig::pinIoDigitalPins + 7) / 8];
+#endif
+#if HTTPSVR_METRICS
+  mutable http_metrics my_metrics;
+#endif
 };
 
 ///////////////////////////////////////////////////////////////////////////////
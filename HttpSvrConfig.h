@@ -0,0 +1,480 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  HttpSvrConfig.h - Compile-time configuration of HttpSvr
+//
+//  ----------------------
+//
+//  All limits, buffer sizes and optional features of HttpSvr are gathered
+//  here. Each of them can be changed without editing the library sources by
+//  defining the corresponding macro before this file is included (e.g. in the
+//  build flags, -DHTTPSVR_SOCKETS=2), so that each build can trade RAM for
+//  throughput or features.
+//
+//  The library code reads the values through the HttpSvrConfig traits struct:
+//  being compile-time constants, they size tables and buffers and let the
+//  compiler fold loops and drop the code of disabled features.
+//
+//  ----------------------
+//
+//  This file is free software; you can redistribute it and/or modify
+//  it under the terms of either the GNU General Public License version 2
+//  or the GNU Lesser General Public License version 2.1, both as
+//  published by the Free Software Foundation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef HTTPSVRCONFIG_H
+#define HTTPSVRCONFIG_H
+
+#include <Arduino.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Network backend
+
+// Driver of the network interface (see utility/NetBackend.h): the WIZnet W5100
+// of the Ethernet shield, the WIZnet W5500 of the Ethernet shield 2, or the
+// sockets of a POSIX system, so that the server can be run and profiled on a
+// Linux host. The latter is the default when not building for an Arduino board.
+#define HTTPSVR_BACKEND_W5100 0
+#define HTTPSVR_BACKEND_W5500 1
+#define HTTPSVR_BACKEND_POSIX 2
+
+#ifndef HTTPSVR_BACKEND
+#  if defined(__linux__) && !defined(ARDUINO)
+#    define HTTPSVR_BACKEND HTTPSVR_BACKEND_POSIX
+#  else
+#    define HTTPSVR_BACKEND HTTPSVR_BACKEND_W5100
+#  endif
+#endif
+
+// Number of connections the POSIX backend can hold at once
+#ifndef HTTPSVR_POSIX_SOCKETS
+#  define HTTPSVR_POSIX_SOCKETS 16
+#endif
+
+// Number of sockets of the backend
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
+#  define HTTPSVR_BACKEND_SOCKETS 8
+#elif HTTPSVR_BACKEND == HTTPSVR_BACKEND_POSIX
+#  define HTTPSVR_BACKEND_SOCKETS HTTPSVR_POSIX_SOCKETS
+#else
+#  define HTTPSVR_BACKEND_SOCKETS 4
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Limits and buffer sizes
+
+// Number of sockets used for serving clients (1 to the number of sockets of the
+// backend, i.e. 4 on the W5100 and 8 on the W5500). The other ones are left free
+// for the application.
+#ifndef HTTPSVR_SOCKETS
+#  define HTTPSVR_SOCKETS 4
+#endif
+
+// Number of URLs which can be bound to a resource provider
+#ifndef HTTPSVR_MAX_BOUND_URLS
+#  define HTTPSVR_MAX_BOUND_URLS 16
+#endif
+
+// Maximum length of Request-URI, header field names and header field values,
+// including the terminating null char
+#ifndef HTTPSVR_MAX_URL_LENGTH
+#  define HTTPSVR_MAX_URL_LENGTH 128
+#endif
+
+#ifndef HTTPSVR_MAX_FIELD_NAME_LENGTH
+#  define HTTPSVR_MAX_FIELD_NAME_LENGTH 64
+#endif
+
+#ifndef HTTPSVR_MAX_FIELD_VALUE_LENGTH
+#  define HTTPSVR_MAX_FIELD_VALUE_LENGTH 256
+#endif
+
+// Size of the blocks in which files are read from SD card and sent
+#ifndef HTTPSVR_FILE_BLOCK_SIZE
+#  define HTTPSVR_FILE_BLOCK_SIZE 256
+#endif
+
+// Number of files kept open on SD card, so that the most requested ones (e.g.
+// "/index.htm") are served without walking directories again (see SdSvr)
+#ifndef HTTPSVR_SD_OPEN_FILES
+#  define HTTPSVR_SD_OPEN_FILES 2
+#endif
+
+// Size of the buffer of ResponseWriter (1 to 255)
+#ifndef HTTPSVR_WRITER_BUFFER_SIZE
+#  define HTTPSVR_WRITER_BUFFER_SIZE 32
+#endif
+
+// Implementation of CRC16, used to hash URLs and names (see utility/crc16.h):
+// 0 = table in RAM (512 bytes), 1 = table in flash, 2 = nibble table in flash
+// (32 bytes, slower), 3 = slicing by 4 (2 KB of RAM, not on AVR). The table in
+// flash costs about one cycle more per byte than the one in RAM on AVR.
+#ifndef HTTPSVR_CRC16
+#  if defined(__AVR__)
+#    define HTTPSVR_CRC16 1
+#  else
+#    define HTTPSVR_CRC16 3
+#  endif
+#endif
+
+// Size of the arena holding per-request scratch memory (see HttpSvr::arena).
+// It must hold at least the URL, a header field name and value, and a few bytes
+// for building response headers.
+#ifndef HTTPSVR_ARENA_SIZE
+#  define HTTPSVR_ARENA_SIZE 512
+#endif
+
+// Cache of responses of resource providers (see HttpSvr::cacheResponse): largest
+// response kept, headers included, and number of responses. Each one takes a
+// block of HTTPSVR_RESPONSE_CACHE bytes, plus one block where responses are
+// captured. Enabled by default only on boards with enough RAM.
+#ifndef HTTPSVR_RESPONSE_CACHE
+#  if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#    define HTTPSVR_RESPONSE_CACHE 256
+#  else
+#    define HTTPSVR_RESPONSE_CACHE 0
+#  endif
+#endif
+
+#ifndef HTTPSVR_RESPONSE_CACHE_ENTRIES
+#  define HTTPSVR_RESPONSE_CACHE_ENTRIES 2
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Optional features
+
+// Serving of POST requests
+#ifndef HTTPSVR_POST
+#  define HTTPSVR_POST 1
+#endif
+
+// Serving of files from SD card
+#ifndef HTTPSVR_SD
+#  define HTTPSVR_SD 1
+#endif
+
+// Cache in RAM of small files from SD card (favicon, CSS...), kept together with
+// their response headers and ETag (see SdSvr): bytes of RAM used, largest file
+// cached and number of files. Enabled by default only on boards with enough RAM.
+#ifndef HTTPSVR_SD_RAM_CACHE
+#  if HTTPSVR_SD && (defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__))
+#    define HTTPSVR_SD_RAM_CACHE 1024
+#  else
+#    define HTTPSVR_SD_RAM_CACHE 0
+#  endif
+#endif
+
+#ifndef HTTPSVR_SD_RAM_CACHE_FILE
+#  define HTTPSVR_SD_RAM_CACHE_FILE 256
+#endif
+
+#ifndef HTTPSVR_SD_RAM_CACHE_ENTRIES
+#  define HTTPSVR_SD_RAM_CACHE_ENTRIES 8
+#endif
+
+// Buffer of files written to SD card (uploads, logs...), so that the card is
+// written whole sectors at a time (see SdSvr::openWriteFile): 0 or a multiple
+// of 512 bytes. Enabled by default only on boards with enough RAM; without it,
+// data is handed to the SD library as it comes.
+#ifndef HTTPSVR_SD_WRITE_BUFFER
+#  if HTTPSVR_SD && (defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__))
+#    define HTTPSVR_SD_WRITE_BUFFER 512
+#  else
+#    define HTTPSVR_SD_WRITE_BUFFER 0
+#  endif
+#endif
+
+// Number of bytes written to a file on SD card after which it is synced (its
+// directory entry and allocation table updated); 0 syncs only when it is closed
+#ifndef HTTPSVR_SD_SYNC_BYTES
+#  define HTTPSVR_SD_SYNC_BYTES 8192
+#endif
+
+// Serving of files from a bundle in flash memory (see FlashBundle), looked up
+// before the SD card
+#ifndef HTTPSVR_BUNDLE
+#  define HTTPSVR_BUNDLE 1
+#endif
+
+// Upload of files to SD card with POST requests to URLs which are not bound
+#ifndef HTTPSVR_UPLOAD
+#  define HTTPSVR_UPLOAD (HTTPSVR_POST && HTTPSVR_SD)
+#endif
+
+// Management of files on SD card with PUT requests (the body is written to the
+// file at the URL path) and DELETE requests, to URLs which are not bound.
+// Since any client can then change the card, this is disabled by default; an
+// application enabling it will usually check requests with HttpSvr::setAuthHandler.
+#ifndef HTTPSVR_PUT
+#  define HTTPSVR_PUT 0
+#endif
+
+// Maximum length of the "Authorization" header given to the handler set with
+// HttpSvr::setAuthHandler, including the terminating null char
+#ifndef HTTPSVR_MAX_AUTH_LENGTH
+#  define HTTPSVR_MAX_AUTH_LENGTH 64
+#endif
+
+// Built-in resource provider for time windows of CSV logs on SD card (HttpSvr::serveCsvLog)
+#ifndef HTTPSVR_CSVLOG
+#  define HTTPSVR_CSVLOG HTTPSVR_SD
+#endif
+
+// Pages on SD card with placeholders like {{name}}, replaced while the page is sent by
+// what the function bound to each name writes (see HttpSvr::bindTemplateVar): file
+// extension of such pages, and number of names which can be bound
+#ifndef HTTPSVR_TEMPLATES
+#  define HTTPSVR_TEMPLATES HTTPSVR_SD
+#endif
+
+#ifndef HTTPSVR_TEMPLATE_EXT
+#  define HTTPSVR_TEMPLATE_EXT ".stm"
+#endif
+
+#ifndef HTTPSVR_TEMPLATE_VARS
+#  define HTTPSVR_TEMPLATE_VARS 8
+#endif
+
+// Serving of directories on SD card: by their "index.htm" if any, or else by a
+// listing of their files, in HTML or in JSON (with "?format=json"). The URL of
+// a directory ends with '/': without it, the client is redirected (301).
+#ifndef HTTPSVR_AUTOINDEX
+#  define HTTPSVR_AUTOINDEX HTTPSVR_SD
+#endif
+
+// Built-in resource provider for bulk reading/writing of pins (HttpSvr::servePinIo),
+// and number of digital and analog pins it can access
+#ifndef HTTPSVR_PINIO
+#  define HTTPSVR_PINIO 1
+#endif
+
+#ifndef HTTPSVR_PINIO_DIGITAL_PINS
+#  ifdef NUM_DIGITAL_PINS
+#    define HTTPSVR_PINIO_DIGITAL_PINS NUM_DIGITAL_PINS
+#  else
+#    define HTTPSVR_PINIO_DIGITAL_PINS 20
+#  endif
+#endif
+
+#ifndef HTTPSVR_PINIO_ANALOG_PINS
+#  ifdef NUM_ANALOG_INPUTS
+#    define HTTPSVR_PINIO_ANALOG_PINS NUM_ANALOG_INPUTS
+#  else
+#    define HTTPSVR_PINIO_ANALOG_PINS 6
+#  endif
+#endif
+
+// Server-Sent Events (see HttpSvr::beginEventStream): maximum number of event streams
+// held open at the same time (each one takes a socket), and interval after which an
+// idle stream is sent a heartbeat comment, to keep proxies and clients from closing it
+#ifndef HTTPSVR_SSE
+#  define HTTPSVR_SSE 1
+#endif
+
+#ifndef HTTPSVR_SSE_MAX_STREAMS
+#  define HTTPSVR_SSE_MAX_STREAMS (HTTPSVR_SOCKETS > 2 ? 2 : HTTPSVR_SOCKETS - 1)
+#endif
+
+#ifndef HTTPSVR_SSE_HEARTBEAT_MS
+#  define HTTPSVR_SSE_HEARTBEAT_MS 15000
+#endif
+
+// WebSocket (see HttpSvr::acceptWebSocket): maximum number of WebSocket connections held
+// open at the same time, longest message received (its buffer is taken from the arena),
+// and interval after which an idle connection is sent a ping
+#ifndef HTTPSVR_WEBSOCKET
+#  define HTTPSVR_WEBSOCKET 1
+#endif
+
+#ifndef HTTPSVR_WS_MAX_CONNECTIONS
+#  define HTTPSVR_WS_MAX_CONNECTIONS (HTTPSVR_SOCKETS > 2 ? 2 : HTTPSVR_SOCKETS - 1)
+#endif
+
+#ifndef HTTPSVR_WS_MAX_MESSAGE
+#  define HTTPSVR_WS_MAX_MESSAGE 128
+#endif
+
+#ifndef HTTPSVR_WS_PING_MS
+#  define HTTPSVR_WS_PING_MS 30000
+#endif
+
+// Metrics are collected by default only on boards with enough RAM to hold them
+#ifndef HTTPSVR_METRICS
+#  if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#    define HTTPSVR_METRICS 1
+#  else
+#    define HTTPSVR_METRICS 0
+#  endif
+#endif
+
+// Request lifecycle trace (see utility/HttpTrace.h), and number of events kept
+// in its ring buffer, 6 bytes each
+#ifndef HTTPSVR_TRACE
+#  define HTTPSVR_TRACE 0
+#endif
+
+#ifndef HTTPSVR_TRACE_EVENTS
+#  define HTTPSVR_TRACE_EVENTS 64
+#endif
+
+// ETags are handled whenever files are served with one
+#define HTTPSVR_ETAG (HTTPSVR_SD_RAM_CACHE || HTTPSVR_BUNDLE)
+
+///////////////////////////////////////////////////////////////////////////////
+// Consistency checks
+
+#if (HTTPSVR_BACKEND < HTTPSVR_BACKEND_W5100) || (HTTPSVR_BACKEND > HTTPSVR_BACKEND_POSIX)
+#  error "HTTPSVR_BACKEND must be HTTPSVR_BACKEND_W5100, HTTPSVR_BACKEND_W5500 or HTTPSVR_BACKEND_POSIX"
+#endif
+
+#if (HTTPSVR_BACKEND == HTTPSVR_BACKEND_POSIX) && defined(__AVR__)
+#  error "HTTPSVR_BACKEND_POSIX is not available on AVR"
+#endif
+
+#if (HTTPSVR_POSIX_SOCKETS < 1) || (HTTPSVR_POSIX_SOCKETS > 64)
+#  error "HTTPSVR_POSIX_SOCKETS must be between 1 and 64"
+#endif
+
+#if (HTTPSVR_SOCKETS < 1) || (HTTPSVR_SOCKETS > HTTPSVR_BACKEND_SOCKETS)
+#  error "HTTPSVR_SOCKETS must be between 1 and the number of sockets of the backend"
+#endif
+
+#if HTTPSVR_UPLOAD && !(HTTPSVR_POST && HTTPSVR_SD)
+#  error "HTTPSVR_UPLOAD requires HTTPSVR_POST and HTTPSVR_SD"
+#endif
+
+#if HTTPSVR_PUT && !HTTPSVR_SD
+#  error "HTTPSVR_PUT requires HTTPSVR_SD"
+#endif
+
+#if HTTPSVR_CSVLOG && !HTTPSVR_SD
+#  error "HTTPSVR_CSVLOG requires HTTPSVR_SD"
+#endif
+
+#if (HTTPSVR_WRITER_BUFFER_SIZE < 1) || (HTTPSVR_WRITER_BUFFER_SIZE > 255)
+#  error "HTTPSVR_WRITER_BUFFER_SIZE must be between 1 and 255"
+#endif
+
+#if (HTTPSVR_CRC16 < 0) || (HTTPSVR_CRC16 > 3)
+#  error "HTTPSVR_CRC16 must be between 0 and 3"
+#endif
+
+#if (HTTPSVR_CRC16 == 3) && defined(__AVR__)
+#  error "HTTPSVR_CRC16 3 (slicing by 4) is not available on AVR"
+#endif
+
+#if HTTPSVR_RESPONSE_CACHE && ((HTTPSVR_RESPONSE_CACHE_ENTRIES < 1) || (HTTPSVR_RESPONSE_CACHE_ENTRIES > 16))
+#  error "HTTPSVR_RESPONSE_CACHE_ENTRIES must be between 1 and 16"
+#endif
+
+#if HTTPSVR_TEMPLATES && !HTTPSVR_SD
+#  error "HTTPSVR_TEMPLATES requires HTTPSVR_SD"
+#endif
+
+#if HTTPSVR_AUTOINDEX && !HTTPSVR_SD
+#  error "HTTPSVR_AUTOINDEX requires HTTPSVR_SD"
+#endif
+
+#if (HTTPSVR_PINIO_DIGITAL_PINS > 255) || (HTTPSVR_PINIO_ANALOG_PINS > 255)
+#  error "HTTPSVR_PINIO_DIGITAL_PINS and HTTPSVR_PINIO_ANALOG_PINS must not exceed 255"
+#endif
+
+#if HTTPSVR_SSE && (HTTPSVR_SSE_MAX_STREAMS >= HTTPSVR_SOCKETS)
+#  error "HTTPSVR_SSE_MAX_STREAMS must leave at least one socket for serving requests"
+#endif
+
+#if HTTPSVR_WEBSOCKET && (HTTPSVR_WS_MAX_CONNECTIONS >= HTTPSVR_SOCKETS)
+#  error "HTTPSVR_WS_MAX_CONNECTIONS must leave at least one socket for serving requests"
+#endif
+
+#if HTTPSVR_WEBSOCKET && (HTTPSVR_ARENA_SIZE < HTTPSVR_WS_MAX_MESSAGE)
+#  error "HTTPSVR_ARENA_SIZE is too small for the configured WebSocket message length"
+#endif
+
+#if HTTPSVR_ARENA_SIZE < (HTTPSVR_MAX_URL_LENGTH + HTTPSVR_MAX_FIELD_NAME_LENGTH + HTTPSVR_MAX_FIELD_VALUE_LENGTH + 32)
+#  error "HTTPSVR_ARENA_SIZE is too small for the configured URL and header field lengths"
+#endif
+
+#if HTTPSVR_SD_RAM_CACHE && !HTTPSVR_SD
+#  error "HTTPSVR_SD_RAM_CACHE requires HTTPSVR_SD"
+#endif
+
+#if HTTPSVR_SD_RAM_CACHE && ((HTTPSVR_SD_RAM_CACHE_ENTRIES < 1) || (HTTPSVR_SD_RAM_CACHE_ENTRIES > 32))
+#  error "HTTPSVR_SD_RAM_CACHE_ENTRIES must be between 1 and 32"
+#endif
+
+#if HTTPSVR_SD && ((HTTPSVR_SD_OPEN_FILES < 1) || (HTTPSVR_SD_OPEN_FILES > 8))
+#  error "HTTPSVR_SD_OPEN_FILES must be between 1 and 8"
+#endif
+
+#if HTTPSVR_SD_WRITE_BUFFER && !HTTPSVR_SD
+#  error "HTTPSVR_SD_WRITE_BUFFER requires HTTPSVR_SD"
+#endif
+
+#if (HTTPSVR_SD_WRITE_BUFFER % 512) || (HTTPSVR_SD_WRITE_BUFFER > 4096)
+#  error "HTTPSVR_SD_WRITE_BUFFER must be a multiple of 512, up to 4096"
+#endif
+
+#if HTTPSVR_SD && (HTTPSVR_ARENA_SIZE < (HTTPSVR_MAX_URL_LENGTH + HTTPSVR_FILE_BLOCK_SIZE + 32))
+#  error "HTTPSVR_ARENA_SIZE is too small for the configured URL length and file block size"
+#endif
+
+#if HTTPSVR_TRACE && ((HTTPSVR_TRACE_EVENTS < 1) || (HTTPSVR_TRACE_EVENTS > 255))
+#  error "HTTPSVR_TRACE_EVENTS must be between 1 and 255"
+#endif
+
+// Trace records hold the socket number in a nibble
+#if HTTPSVR_TRACE && (HTTPSVR_SOCKETS > 16)
+#  error "HTTPSVR_TRACE supports at most 16 sockets (HTTPSVR_SOCKETS)"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Traits struct
+
+struct HttpSvrConfig
+{
+  static const uint8_t  backend             = HTTPSVR_BACKEND;
+  static const uint8_t  sockets             = HTTPSVR_SOCKETS;
+  static const uint8_t  maxBoundUrls        = HTTPSVR_MAX_BOUND_URLS;
+  static const uint16_t maxUrlLength        = HTTPSVR_MAX_URL_LENGTH;
+  static const uint16_t maxFieldNameLength  = HTTPSVR_MAX_FIELD_NAME_LENGTH;
+  static const uint16_t maxFieldValueLength = HTTPSVR_MAX_FIELD_VALUE_LENGTH;
+  static const uint16_t maxAuthLength       = HTTPSVR_MAX_AUTH_LENGTH;
+  static const uint16_t fileBlockSize       = HTTPSVR_FILE_BLOCK_SIZE;
+  static const uint8_t  sdOpenFiles         = HTTPSVR_SD_OPEN_FILES;
+  static const uint16_t sdRamCache          = HTTPSVR_SD_RAM_CACHE;
+  static const uint16_t sdRamCacheFile      = HTTPSVR_SD_RAM_CACHE_FILE;
+  static const uint8_t  sdRamCacheEntries   = HTTPSVR_SD_RAM_CACHE_ENTRIES;
+  static const uint16_t sdWriteBuffer       = HTTPSVR_SD_WRITE_BUFFER;
+  static const uint32_t sdSyncBytes         = HTTPSVR_SD_SYNC_BYTES;
+  static const uint8_t  writerBufferSize    = HTTPSVR_WRITER_BUFFER_SIZE;
+  static const uint16_t arenaSize           = HTTPSVR_ARENA_SIZE;
+  static const uint8_t  pinIoDigitalPins    = HTTPSVR_PINIO_DIGITAL_PINS;
+  static const uint8_t  pinIoAnalogPins     = HTTPSVR_PINIO_ANALOG_PINS;
+  static const uint8_t  sseMaxStreams       = HTTPSVR_SSE_MAX_STREAMS;
+  static const uint32_t sseHeartbeatMs      = HTTPSVR_SSE_HEARTBEAT_MS;
+  static const uint8_t  wsMaxConnections    = HTTPSVR_WS_MAX_CONNECTIONS;
+  static const uint16_t wsMaxMessage        = HTTPSVR_WS_MAX_MESSAGE;
+  static const uint32_t wsPingMs            = HTTPSVR_WS_PING_MS;
+  static const uint8_t  templateVars        = HTTPSVR_TEMPLATE_VARS;
+  static const uint16_t responseCache       = HTTPSVR_RESPONSE_CACHE;
+  static const uint8_t  responseCacheEntries= HTTPSVR_RESPONSE_CACHE_ENTRIES;
+
+  static const bool     post                = (HTTPSVR_POST    != 0);
+  static const bool     sd                  = (HTTPSVR_SD      != 0);
+  static const bool     bundle              = (HTTPSVR_BUNDLE  != 0);
+  static const bool     upload              = (HTTPSVR_UPLOAD  != 0);
+  static const bool     put                 = (HTTPSVR_PUT     != 0);
+  static const bool     autoIndex           = (HTTPSVR_AUTOINDEX != 0);
+  static const bool     csvLog              = (HTTPSVR_CSVLOG  != 0);
+  static const bool     templates           = (HTTPSVR_TEMPLATES != 0);
+  static const bool     pinIo               = (HTTPSVR_PINIO   != 0);
+  static const bool     sse                 = (HTTPSVR_SSE     != 0);
+  static const bool     webSocket           = (HTTPSVR_WEBSOCKET != 0);
+  static const bool     metrics             = (HTTPSVR_METRICS != 0);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef HTTPSVRCONFIG_H
@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  JsonWriter.cpp - Definition of a streaming writer of JSON documents
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "JsonWriter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+JsonWriter::JsonWriter(ResponseWriter& the_writer)
+: my_writer(the_writer)
+, my_arrays(0)
+, my_nonEmpty(0)
+, my_depth(0)
+, my_afterKey(false)
+, my_started(false)
+, my_ok(true)
+{}
+
+JsonWriter::~JsonWriter()
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool JsonWriter::beginObject()
+{ return prv_begin(false); }
+
+bool JsonWriter::endObject()
+{ return prv_end(false); }
+
+bool JsonWriter::beginArray()
+{ return prv_begin(true); }
+
+bool JsonWriter::endArray()
+{ return prv_end(true); }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool JsonWriter::key(const char * the_key)
+{
+  if (!the_key) return (my_ok = false);
+  if (!prv_beginKey()) return false;
+
+  my_writer.writeByte('"');
+  while (*the_key) prv_writeEscaped(*the_key++);
+  my_writer.write("\":");
+  my_afterKey = true;
+  return isOk();
+}
+
+bool JsonWriter::key(const __FlashStringHelper * the_key)
+{
+  if (!the_key) return (my_ok = false);
+  if (!prv_beginKey()) return false;
+
+  // Keys in flash are written as they are: they are expected not to need escaping
+  my_writer.writeByte('"');
+  my_writer.write(the_key);
+  my_writer.write("\":");
+  my_afterKey = true;
+  return isOk();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool JsonWriter::string(const char * the_value)
+{
+  if (!the_value) return null();
+  if (!prv_beginValue()) return false;
+  my_writer.writeByte('"');
+  while (*the_value) prv_writeEscaped(*the_value++);
+  my_writer.writeByte('"');
+  return isOk();
+}
+
+bool JsonWriter::string(const __FlashStringHelper * the_value)
+{
+  if (!the_value) return null();
+  if (!prv_beginValue()) return false;
+  my_writer.writeByte('"');
+  const char * p = reinterpret_cast<const char *>(the_value);
+  for (uint8_t ch = pgm_read_byte(p); ch; ch = pgm_read_byte(++p))
+    prv_writeEscaped(ch);
+  my_writer.writeByte('"');
+  return isOk();
+}
+
+bool JsonWriter::number(int32_t the_value)
+{
+  if (!prv_beginValue()) return false;
+  if (the_value < 0)
+  {
+    my_writer.writeByte('-');
+    my_writer.writeNumber(static_cast<uint32_t>(0) - static_cast<uint32_t>(the_value));
+  }
+  else
+    my_writer.writeNumber(static_cast<uint32_t>(the_value));
+  return isOk();
+}
+
+bool JsonWriter::number(uint32_t the_value)
+{
+  if (!prv_beginValue()) return false;
+  my_writer.writeNumber(the_value);
+  return isOk();
+}
+
+bool JsonWriter::boolean(bool the_value)
+{
+  if (!prv_beginValue()) return false;
+  my_writer.write(the_value ? "true" : "false");
+  return isOk();
+}
+
+bool JsonWriter::null()
+{
+  if (!prv_beginValue()) return false;
+  my_writer.write("null");
+  return isOk();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool JsonWriter::prv_beginKey()
+{
+  // A key is allowed only in an object, where it follows the previous member
+  if (!my_ok) return false;
+  if (!prv_inObject() || my_afterKey) return (my_ok = false);
+
+  uint16_t uBit = static_cast<uint16_t>(1) << (my_depth - 1);
+  if (my_nonEmpty & uBit) my_writer.writeByte(',');
+  my_nonEmpty |= uBit;
+  return true;
+}
+
+bool JsonWriter::prv_beginValue()
+{
+  // A value is allowed as the whole document, after a key in an object,
+  // or as an element of an array (preceded by a comma if not the first one)
+  if (!my_ok) return false;
+  if (my_depth == 0)
+  {
+    if (my_started) return (my_ok = false);
+    my_started = true;
+    return true;
+  }
+  if (prv_inObject())
+  {
+    if (!my_afterKey) return (my_ok = false);
+    my_afterKey = false;
+    return true;
+  }
+
+  uint16_t uBit = static_cast<uint16_t>(1) << (my_depth - 1);
+  if (my_nonEmpty & uBit) my_writer.writeByte(',');
+  my_nonEmpty |= uBit;
+  return true;
+}
+
+bool JsonWriter::prv_begin(bool the_isArray)
+{
+  if (my_depth >= smy_maxDepth) return (my_ok = false);
+  if (!prv_beginValue()) return false;
+
+  uint16_t uBit = static_cast<uint16_t>(1) << my_depth;
+  if (the_isArray) my_arrays |= uBit;
+  else             my_arrays &= ~uBit;
+  my_nonEmpty &= ~uBit;
+  ++my_depth;
+
+  my_writer.writeByte(the_isArray ? '[' : '{');
+  return isOk();
+}
+
+bool JsonWriter::prv_end(bool the_isArray)
+{
+  if (!my_ok) return false;
+  if (the_isArray ? !prv_inArray() : !prv_inObject()) return (my_ok = false);
+  if (my_afterKey) return (my_ok = false);
+
+  --my_depth;
+  my_writer.writeByte(the_isArray ? ']' : '}');
+  return isOk();
+}
+
+bool JsonWriter::prv_writeEscaped(uint8_t the_ch)
+{
+  // Quote, backslash and control chars must be escaped (RFC 7159 par. 7);
+  // any other char, including UTF-8 sequences, is written as it is
+  if ((the_ch == '"') || (the_ch == '\\'))
+  {
+    my_writer.writeByte('\\');
+    return my_writer.writeByte(the_ch);
+  }
+  if (the_ch >= 0x20) return my_writer.writeByte(the_ch);
+
+  my_writer.writeByte('\\');
+  switch (the_ch)
+  {
+  case '\n': return my_writer.writeByte('n');
+  case '\r': return my_writer.writeByte('r');
+  case '\t': return my_writer.writeByte('t');
+  case '\b': return my_writer.writeByte('b');
+  case '\f': return my_writer.writeByte('f');
+  default  : break;
+  }
+  static const char sHex[] = "0123456789abcdef";
+  my_writer.write("u00");
+  my_writer.writeByte(sHex[the_ch >> 4]);
+  return my_writer.writeByte(sHex[the_ch & 0x0F]);
+}
+
+bool JsonWriter::prv_inArray() const
+{ return my_depth && (my_arrays & (static_cast<uint16_t>(1) << (my_depth - 1))); }
+
+bool JsonWriter::prv_inObject() const
+{ return my_depth && !(my_arrays & (static_cast<uint16_t>(1) << (my_depth - 1))); }
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  JsonWriter.h - Definition of a streaming writer of JSON documents
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <Arduino.h>
+
+#include "ResponseWriter.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// JsonWriter writes a JSON document to a ResponseWriter as it is being built:
+// no document is kept in memory, only the nesting of objects and arrays, so
+// documents of any length can be sent. Commas and quotes are added as needed,
+// and strings are escaped. Keys are best given as flash strings, e.g.:
+//    JsonWriter aJson(aWriter);
+//    aJson.beginObject();
+//    aJson.key(F("pin"));   aJson.number(13);
+//    aJson.key(F("value")); aJson.boolean(true);
+//    aJson.endObject();
+// Any misuse (a value without key inside an object, unbalanced ends, nesting
+// deeper than smy_maxDepth) makes the writer fail, and isOk() return false.
+// Since the document is only written, the same code can be run on a counting
+// ResponseWriter first, to obtain the Content-Length.
+
+class JsonWriter
+{
+public:
+  explicit JsonWriter(ResponseWriter& the_writer);
+  virtual ~JsonWriter();
+
+public:
+  bool                  beginObject ();
+  bool                  endObject   ();
+  bool                  beginArray  ();
+  bool                  endArray    ();
+
+  bool                  key         (const char * the_key);
+  bool                  key         (const __FlashStringHelper * the_key);
+
+  bool                  string      (const char * the_value);
+  bool                  string      (const __FlashStringHelper * the_value);
+  bool                  number      (int32_t the_value);
+  bool                  number      (uint32_t the_value);
+  bool                  number      (int16_t the_value)  { return number(static_cast<int32_t>(the_value)); }
+  bool                  number      (uint16_t the_value) { return number(static_cast<uint32_t>(the_value)); }
+  bool                  boolean     (bool the_value);
+  bool                  null        ();
+
+  bool                  isOk        () const { return my_ok && my_writer.isOk(); }
+  bool                  isComplete  () const { return isOk() && (my_depth == 0) && my_started; }
+
+private:
+  static const uint8_t  smy_maxDepth = 16;
+
+  bool                  prv_beginKey    ();
+  bool                  prv_beginValue  ();
+  bool                  prv_begin       (bool the_isArray);
+  bool                  prv_end         (bool the_isArray);
+  bool                  prv_writeEscaped(uint8_t the_ch);
+  bool                  prv_inArray     () const;
+  bool                  prv_inObject    () const;
+
+private:
+  ResponseWriter&       my_writer;
+  uint16_t              my_arrays;      // Bit n set: level n is an array
+  uint16_t              my_nonEmpty;    // Bit n set: level n already has a member
+  uint8_t               my_depth;
+  bool                  my_afterKey;
+  bool                  my_started;
+  bool                  my_ok;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef JSONWRITER_H
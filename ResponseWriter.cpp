@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  ResponseWriter.cpp - Definition of a buffered writer for response bodies
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "ResponseWriter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+ResponseWriter::ResponseWriter(ClientProxy * the_client)
+: my_client(the_client)
+, my_count(0)
+, my_used(0)
+, my_chunked(false)
+, my_ok(true)
+{}
+
+ResponseWriter::~ResponseWriter()
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool ResponseWriter::write(const char * the_str)
+{
+  if (!the_str) return my_ok;
+  while (*the_str)
+    if (!writeByte(static_cast<uint8_t>(*the_str++))) return false;
+  return my_ok;
+}
+
+bool ResponseWriter::write(const __FlashStringHelper * the_str)
+{
+  if (!the_str) return my_ok;
+  const char * p = reinterpret_cast<const char *>(the_str);
+  for (uint8_t ch = pgm_read_byte(p); ch; ch = pgm_read_byte(++p))
+    if (!writeByte(ch)) return false;
+  return my_ok;
+}
+
+bool ResponseWriter::write(const uint8_t * the_buffer, uint16_t the_size)
+{
+  if (!the_buffer) return my_ok;
+  while (the_size--)
+    if (!writeByte(*the_buffer++)) return false;
+  return my_ok;
+}
+
+bool ResponseWriter::writeByte(uint8_t the_byte)
+{
+  if (!my_ok) return false;
+
+  ++my_count;
+  if (isCounting()) return true;
+
+  my_buffer[smy_chunkHead + my_used++] = the_byte;
+  if (my_used >= smy_bufferSize) return flush();
+  return true;
+}
+
+bool ResponseWriter::writeNumber(uint32_t the_value, uint8_t the_base)
+{
+  char sNumber[12];
+  ultoa(the_value, sNumber, the_base);
+  return write(sNumber);
+}
+
+bool ResponseWriter::flush()
+{
+  if (!my_ok) return false;
+  if (isCounting() || !my_used) return true;
+
+  uint8_t * pData = my_buffer + smy_chunkHead;
+  uint16_t  uSize = my_used;
+  if (my_chunked)
+  {
+    // Frame data as a chunk in place, so that it is sent with a single write
+    static const char sHex[] = "0123456789abcdef";
+    pData -= smy_chunkHead;
+    pData[0] = sHex[my_used >> 4];
+    pData[1] = sHex[my_used & 0x0F];
+    pData[2] = '\r';
+    pData[3] = '\n';
+    pData[smy_chunkHead + my_used    ] = '\r';
+    pData[smy_chunkHead + my_used + 1] = '\n';
+    uSize += smy_chunkHead + smy_chunkTail;
+  }
+
+  uint16_t uWritten = my_client->writeBuffer(pData, uSize);
+  my_ok = (uWritten == uSize);
+  my_used = 0;
+  return my_ok;
+}
+
+bool ResponseWriter::finish()
+{
+  // Sends what is left and, in chunked transfer coding, the last chunk
+  // (with no trailer) that marks the end of the body
+  if (!flush()) return false;
+  if (isCounting() || !my_chunked) return true;
+
+  static const char sLastChunk[] = "0\r\n\r\n";
+  uint16_t uSize = sizeof(sLastChunk) - 1;
+  my_ok = (my_client->writeBuffer(reinterpret_cast<uint8_t *>(const_cast<char *>(sLastChunk)), uSize) == uSize);
+  return my_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
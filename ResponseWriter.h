@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  ResponseWriter.h - Definition of a buffered writer for response bodies
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESPONSEWRITER_H
+#define RESPONSEWRITER_H
+
+#include <Arduino.h>
+
+#include "HttpSvrConfig.h"
+#include "ClientProxy.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// ResponseWriter collects small pieces of a response body (strings, numbers)
+// in a short buffer and sends them to the client in blocks, instead of issuing
+// a socket write for each piece.
+// A writer built without a client does not send anything and only counts the
+// bytes it is given. This allows generating a body twice: a first time to
+// compute its Content-Length, and a second time to actually send it.
+// Alternatively, a body whose length is not known in advance can be sent in
+// chunked transfer coding (see HttpSvr::sendResponseOkChunked): each block is
+// then sent as a chunk, and finish() sends the last, empty, chunk.
+// Strings can also be taken from flash memory, e.g. write(F("text")).
+
+class ResponseWriter
+{
+public:
+  explicit ResponseWriter(ClientProxy * the_client = 0);
+  virtual ~ResponseWriter();
+
+public:
+  bool                  write             (const char * the_str);
+  bool                  write             (const __FlashStringHelper * the_str);
+  bool                  write             (const uint8_t * the_buffer, uint16_t the_size);
+  bool                  writeByte         (uint8_t the_byte);
+  bool                  writeNumber       (uint32_t the_value, uint8_t the_base = 10);
+  bool                  flush             ();
+  bool                  finish            ();
+
+  void                  setChunked        (bool the_chunked) { my_chunked = the_chunked; }
+  bool                  isChunked         () const { return my_chunked; }
+
+  uint32_t              count             () const { return my_count; }
+  bool                  isCounting        () const { return my_client == 0; }
+  bool                  isOk              () const { return my_ok; }
+
+private:
+  static const uint8_t  smy_bufferSize = HttpSvrConfig::writerBufferSize;
+
+  // Room around data for the chunk framing: size (2 hex digits, as the buffer
+  // is never longer than 255 bytes) and CRLF before, CRLF after
+  static const uint8_t  smy_chunkHead  = 4;
+  static const uint8_t  smy_chunkTail  = 2;
+
+  ClientProxy *         my_client;
+  uint32_t              my_count;
+  uint8_t               my_buffer[smy_chunkHead + smy_bufferSize + smy_chunkTail];
+  uint8_t               my_used;
+  bool                  my_chunked;
+  bool                  my_ok;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef RESPONSEWRITER_H
@@ -0,0 +1,222 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  WebSocket.cpp - Definition of WebSocket framing over a client connection
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "WebSocket.h"
+#include "utility/sha1.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char local_guid[] PROGMEM = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static const uint8_t local_fin  = 0x80;
+static const uint8_t local_mask = 0x80;
+
+///////////////////////////////////////////////////////////////////////////////
+
+WebSocket::WebSocket(ClientProxy * the_client)
+: my_client(the_client)
+{}
+
+WebSocket::~WebSocket()
+{}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool WebSocket::isOpen() const
+{ return my_client && (my_client->mode() == ClientProxy::mode_webSocket) && my_client->isConnected(); }
+
+NetBackend::socket_e WebSocket::socket() const
+{ return my_client ? my_client->socket() : NetBackend::socket_undefined; }
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool WebSocket::sendText(const char * the_text)
+{ return send(op_text, reinterpret_cast<const uint8_t *>(the_text), the_text ? strlen(the_text) : 0); }
+
+bool WebSocket::sendBinary(const uint8_t * the_data, uint16_t the_size)
+{ return send(op_binary, the_data, the_size); }
+
+bool WebSocket::send(opcode_e the_opcode, const uint8_t * the_data, uint16_t the_size)
+{
+  // Frames sent by a server are not masked (see RFC 6455 par. 5.1)
+  if (!isOpen()) return false;
+  if (!the_data) the_size = 0;
+
+  uint8_t  sHeader[4];
+  uint8_t  uHeaderSize = 2;
+  sHeader[0] = local_fin | the_opcode;
+  if (the_size < 126)
+    sHeader[1] = static_cast<uint8_t>(the_size);
+  else
+  {
+    sHeader[1] = 126;
+    sHeader[2] = static_cast<uint8_t>(the_size >> 8);
+    sHeader[3] = static_cast<uint8_t>(the_size);
+    uHeaderSize = 4;
+  }
+
+  if (my_client->writeAvailable() < uHeaderSize + the_size) return false;
+  if (my_client->writeBuffer(sHeader, uHeaderSize) != uHeaderSize) return false;
+  if (!the_size) return true;
+  return (my_client->writeBuffer(const_cast<uint8_t *>(the_data), the_size) == the_size);
+}
+
+bool WebSocket::close(uint16_t the_code)
+{
+  if (!isOpen()) return false;
+  uint8_t sCode[2] = { static_cast<uint8_t>(the_code >> 8), static_cast<uint8_t>(the_code) };
+  send(op_close, sCode, sizeof(sCode));
+  my_client->flush();
+  return my_client->closeConnection();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool WebSocket::receiveMessage(uint8_t * the_buffer, uint16_t the_size, opcode_e& the_opcode, uint16_t& the_length)
+{
+  if (!isOpen() || !the_buffer) return false;
+  if (!my_client->anyDataReceived()) return false;
+
+  // Frames are read until the last fragment of a data message. Once the first
+  // frame has arrived, the following ones are waited for.
+  the_length = 0;
+  bool bInMessage = false;
+  while (true)
+  {
+    uint8_t sHeader[2];
+    if (!prv_readFully(sHeader, sizeof(sHeader))) return false;
+
+    bool     bFin    = (sHeader[0] & local_fin) != 0;
+    uint8_t  uOpcode = sHeader[0] & 0x0F;
+    bool     bMasked = (sHeader[1] & local_mask) != 0;
+    uint32_t uSize   = sHeader[1] & 0x7F;
+
+    // Client frames must be masked, and no extension is negotiated
+    if (!bMasked || (sHeader[0] & 0x70)) return prv_fail(close_protocolError);
+
+    // Opcodes 0x3-0x7 and 0xB-0xF are reserved (see RFC 6455 par. 5.2)
+    if ((uOpcode > op_binary) && (uOpcode != op_close) && (uOpcode != op_ping) && (uOpcode != op_pong))
+      return prv_fail(close_protocolError);
+
+    if (uSize == 126)
+    {
+      uint8_t sSize[2];
+      if (!prv_readFully(sSize, sizeof(sSize))) return false;
+      uSize = (static_cast<uint16_t>(sSize[0]) << 8) | sSize[1];
+    }
+    else if (uSize == 127)
+    {
+      // Such long frames cannot be handled here anyway
+      return prv_fail(close_tooBig);
+    }
+
+    uint8_t sMask[4];
+    if (!prv_readFully(sMask, sizeof(sMask))) return false;
+
+    if (uOpcode & 0x08)
+    {
+      // Control frame: short, never fragmented, possibly between fragments
+      uint8_t sPayload[125];
+      if (!bFin || (uSize > sizeof(sPayload))) return prv_fail(close_protocolError);
+      if (!prv_readFully(sPayload, uSize)) return false;
+      for (uint8_t u = 0; u < uSize; ++u) sPayload[u] ^= sMask[u & 3];
+
+      switch (uOpcode)
+      {
+      case op_ping:
+        send(op_pong, sPayload, uSize);
+        break;
+      case op_close:
+        send(op_close, sPayload, (uSize >= 2) ? 2 : 0);
+        my_client->flush();
+        my_client->closeConnection();
+        return false;
+      default:
+        // Pong: nothing to do
+        break;
+      }
+      if (!bInMessage) return false;
+      continue;
+    }
+
+    // Data frame: the first one has an opcode, the following ones are continuations
+    if (bInMessage != (uOpcode == op_continuation)) return prv_fail(close_protocolError);
+    if (!bInMessage) the_opcode = static_cast<opcode_e>(uOpcode);
+    bInMessage = true;
+
+    if (uSize > static_cast<uint32_t>(the_size - the_length)) return prv_fail(close_tooBig);
+    uint8_t * pPayload = the_buffer + the_length;
+    if (!prv_readFully(pPayload, uSize)) return false;
+    for (uint16_t u = 0; u < uSize; ++u) pPayload[u] ^= sMask[u & 3];
+    the_length += uSize;
+
+    if (bFin) return true;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void WebSocket::acceptKey(const char * the_key, char * the_accept)
+{
+  // Base64 of the SHA-1 of the key followed by the GUID (see RFC 6455 par. 4.2.2)
+  static const char sBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  sha1_ctx aCtx;
+  sha1_init(&aCtx);
+  sha1_update(&aCtx, reinterpret_cast<const uint8_t *>(the_key), strlen(the_key));
+  for (const char * p = local_guid; pgm_read_byte(p); ++p)
+  {
+    uint8_t ch = pgm_read_byte(p);
+    sha1_update(&aCtx, &ch, 1);
+  }
+  uint8_t sDigest[SHA1_DIGEST_SIZE + 1];
+  sha1_final(&aCtx, sDigest);
+  sDigest[SHA1_DIGEST_SIZE] = 0;
+
+  // 20 bytes: 6 groups of 3 bytes, then 2 bytes and one '=' of padding
+  char * pOut = the_accept;
+  for (uint8_t u = 0; u < SHA1_DIGEST_SIZE; u += 3)
+  {
+    uint32_t uGroup = (static_cast<uint32_t>(sDigest[u]) << 16) | (static_cast<uint32_t>(sDigest[u+1]) << 8);
+    if (u + 2 < SHA1_DIGEST_SIZE) uGroup |= sDigest[u+2];
+    *pOut++ = sBase64[(uGroup >> 18) & 0x3F];
+    *pOut++ = sBase64[(uGroup >> 12) & 0x3F];
+    *pOut++ = sBase64[(uGroup >>  6) & 0x3F];
+    *pOut++ = (u + 2 < SHA1_DIGEST_SIZE) ? sBase64[uGroup & 0x3F] : '=';
+  }
+  *pOut = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool WebSocket::prv_readFully(uint8_t * the_buffer, uint16_t the_size)
+{
+  while (the_size)
+  {
+    uint16_t uRead = my_client->readBuffer(the_buffer, the_size);
+    if (!uRead) return false;
+    the_buffer += uRead;
+    the_size   -= uRead;
+  }
+  return true;
+}
+
+bool WebSocket::prv_fail(uint16_t the_code)
+{
+  close(the_code);
+  return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
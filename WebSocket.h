@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  WebSocket.h - Definition of WebSocket framing over a client connection
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef WEBSOCKET_H
+#define WEBSOCKET_H
+
+#include <Arduino.h>
+
+#include "ClientProxy.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// WebSocket reads and writes RFC 6455 frames on a connection that has been
+// upgraded by HttpSvr::acceptWebSocket. It holds no state besides the client,
+// so it can be created whenever needed (see HttpSvr::webSocket).
+// - Sending never waits: a frame is written only if it fits as a whole in the
+//   tx memory of the socket, otherwise false is returned and nothing is sent.
+// - receiveMessage reads frames until a whole message has been received,
+//   unmasking payloads in place in the given buffer and joining fragments.
+//   Control frames met on the way are handled: pings are answered with pongs,
+//   and a close frame is echoed before closing the connection.
+
+class WebSocket
+{
+public:
+  enum opcode_e
+  {
+    op_continuation = 0x0,
+    op_text         = 0x1,
+    op_binary       = 0x2,
+    op_close        = 0x8,
+    op_ping         = 0x9,
+    op_pong         = 0xA
+  };
+
+  // Status codes sent in close frames (see RFC 6455 par. 7.4.1)
+  enum close_e
+  {
+    close_normal          = 1000,
+    close_goingAway       = 1001,
+    close_protocolError   = 1002,
+    close_tooBig          = 1009
+  };
+
+public:
+  explicit WebSocket(ClientProxy * the_client = 0);
+  virtual ~WebSocket();
+
+public:
+  bool                  isOpen          () const;
+  NetBackend::socket_e  socket          () const;
+
+  bool                  sendText        (const char * the_text);
+  bool                  sendBinary      (const uint8_t * the_data, uint16_t the_size);
+  bool                  send            (opcode_e the_opcode, const uint8_t * the_data, uint16_t the_size);
+  bool                  close           (uint16_t the_code = close_normal);
+
+  // Returns true when a text or binary message has been received: its opcode and
+  // length are returned, and the message is in the_buffer. Returns false when no
+  // message is available, or if only control frames have been received, or on
+  // errors (in that case, the connection is closed).
+  bool                  receiveMessage  (uint8_t * the_buffer, uint16_t the_size, opcode_e& the_opcode, uint16_t& the_length);
+
+  // Handshake: computes the value of "Sec-WebSocket-Accept" for a "Sec-WebSocket-Key"
+  // (28 chars, plus the terminating null char)
+  static const uint8_t  acceptKeyLength = 28;
+  static void           acceptKey       (const char * the_key, char * the_accept);
+
+private:
+  bool                  prv_readFully   (uint8_t * the_buffer, uint16_t the_size);
+  bool                  prv_fail        (uint16_t the_code);
+
+private:
+  ClientProxy *         my_client;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef WEBSOCKET_H
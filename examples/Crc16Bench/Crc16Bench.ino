@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Crc16Bench - Compares the speed of the CRC16 variants of the HttpSvr library
+//
+//  ----------------------
+//
+// Each variant (see utility/crc16.h) hashes the same buffer a number of times;
+// the time taken is printed on the serial port in cycles per byte, along with
+// the CRC. The buffer is a typical URL, so that the figures match the hashing
+// done by the server on each request.
+// Each variant is also checked against crcsum_ram, on every length and start
+// offset of the buffer (so that the tail and alignment cases of slice4 are
+// covered): "ok" or "MISMATCH" is printed after its figures.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+
+// The following #includes should not be due. However, they must be added here
+#include <SD.h>
+#include <SPI.h>
+#include <HttpSvr.h>
+#include <utility/crc16.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+typedef uint16_t (*crc_function_t)(const char *, uint32_t, uint16_t);
+
+static const char     CRC16BENCH_URL[] = "/www/css/style.css?version=20131207";
+static const uint16_t CRC16BENCH_LOOPS = 1000;
+
+// Whether the_function gives the same CRC as crcsum_ram on every part of the URL
+static bool checkCrc(crc_function_t the_function)
+{
+  const uint32_t uSize = sizeof(CRC16BENCH_URL) - 1;
+
+  for (uint32_t uStart = 0; uStart < 4; ++uStart)
+    for (uint32_t uLen = 0; uStart + uLen <= uSize; ++uLen)
+      if (the_function(CRC16BENCH_URL + uStart, uLen, CRC_INIT) != crcsum_ram(CRC16BENCH_URL + uStart, uLen, CRC_INIT))
+        return false;
+  return true;
+}
+
+static bool benchCrc(const char * the_name, crc_function_t the_function)
+{
+  const uint32_t uLen = sizeof(CRC16BENCH_URL) - 1;
+  uint16_t crc = 0;
+
+  uint32_t uStart = micros();
+  for (uint16_t u = 0; u < CRC16BENCH_LOOPS; ++u)
+    crc = the_function(CRC16BENCH_URL, uLen, CRC_INIT);
+  uint32_t uElapsed = micros() - uStart;
+
+  // Cycles per byte, with one decimal
+  uint32_t uCycles = uElapsed * (F_CPU / 100000L) / (uLen * CRC16BENCH_LOOPS);
+  Serial.print(the_name);
+  Serial.print(": ");
+  Serial.print(uCycles / 10);
+  Serial.print('.');
+  Serial.print(uCycles % 10);
+  Serial.print(" cycles/byte, crc 0x");
+  Serial.print(crc, HEX);
+
+  bool bOk = checkCrc(the_function);
+  Serial.println(bOk ? " ok" : " MISMATCH");
+  return bOk;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("CRC16 variants");
+
+  bool bOk = true;
+  bOk &= benchCrc("ram   ", &crcsum_ram   );
+  bOk &= benchCrc("flash ", &crcsum_flash );
+  bOk &= benchCrc("nibble", &crcsum_nibble);
+#ifndef __AVR__
+  bOk &= benchCrc("slice4", &crcsum_slice4);
+#endif
+  bOk &= benchCrc("crcsum", &crcsum       );
+
+  Serial.println(bOk ? "All variants match" : "MISMATCH: some variants differ from crcsum_ram");
+}
+
+void loop()
+{}
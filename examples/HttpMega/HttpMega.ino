@@ -79,6 +79,9 @@ static const int       HTTPMEGA_TCP_PORT = 80;
 static const int       HTTPMEGA_CS_PIN = 4;  // On the Ethernet Shield, CS is pin 4.
 static const int       HTTPMEGA_SS_PIN = 53; // SS pin is 10 on most Arduino boards, 53 on the Mega
 
+static const uint8_t   HTTPMEGA_DIGITAL_PINS = 54;
+static const uint8_t   HTTPMEGA_ANALOG_PINS  = 16;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Definition of the HTTP Server Object
 HttpSvr HTTPMEGA_httpSvr;
@@ -91,29 +94,32 @@ bool rpRoot(ClientProxy& the_client, http_e::method the_method, const char * the
   return HTTPMEGA_httpSvr.sendResFile(the_client, "/www/index.htm");
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/version"
+// This response never changes: it is kept in RAM after the first request, and
+// sent again from there
+bool rpVersion(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+#if HTTPSVR_RESPONSE_CACHE
+  HTTPMEGA_httpSvr.cacheResponse();
+#endif
+  static const char sVersion[] = "HttpMega " __DATE__ " " __TIME__;
+  HTTPMEGA_httpSvr.sendResponseOkWithContent(the_client, sizeof(sVersion) - 1, HttpSvr_mime_text);
+  return HTTPMEGA_httpSvr.sendResponse(the_client, sVersion);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Resource Provider for "/digitalRead"
 bool rpDigitalRead(ClientProxy& the_client, http_e::method the_method, const char * the_url)
 {
-  static const uint16_t uBufferLen = 32;
-  uint8_t sBuffer[uBufferLen];
-
-  // Skip all headers and goto message body
-  uint16_t uBodyLen = HTTPMEGA_httpSvr.skipToBody(the_client);
-  if (uBodyLen < 5) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-  if (uBodyLen >= uBufferLen) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-
   // Read message body. We expect a string like 'name=XX' where XX
-  // is the pin number.
-  // Remember that, while reading the body, we MUST ALWAYS read EXACTLY
-  // the number of bytes returned by skipToBody.
-  uint16_t uRead = the_client.readBuffer(sBuffer, uBodyLen);
-  if (uRead != uBodyLen) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-  sBuffer[uBodyLen] = 0;
+  // is the pin number. readFormParams consumes headers and body.
+  HttpParams aParams;
+  if (!HTTPMEGA_httpSvr.readFormParams(the_client, aParams)) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
 
-  // Read pin number
-  void *pv = sBuffer + 5;
-  uint8_t pinId = atoi(static_cast<char *>(pv));
+  long pinId = -1;
+  if (aParams.find("name")) pinId = aParams.toInt(-1);
+  if (pinId < 0) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
 
   // Compose the response string
   bool bValue = digitalRead(pinId);
@@ -125,48 +131,215 @@ bool rpDigitalRead(ClientProxy& the_client, http_e::method the_method, const cha
 // Resource Provider for "/digitalWrite"
 bool rpDigitalWrite(ClientProxy& the_client, http_e::method the_method, const char * the_url)
 {
-  static const uint16_t uBufferLen = 32;
-  uint8_t sBuffer[uBufferLen];
-
-  // Skip all headers and goto message body
-  // Skip all headers and goto message body
-  uint16_t uBodyLen = HTTPMEGA_httpSvr.skipToBody(the_client);
-  if (uBodyLen < 5) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-  if (uBodyLen >= uBufferLen) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-
   // Read message body. We expect a string like 'name=XX&value=Y' where XX
   // is the pin number and Y is "true" or "false".
-  // Remember that, while reading the body, we MUST ALWAYS read EXACTLY
-  // the number of bytes returned by skipToBody.
-  uint16_t uRead = the_client.readBuffer(sBuffer, uBodyLen);
-  if (uRead != uBodyLen) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-  sBuffer[uBodyLen] = 0;
+  HttpParams aParams;
+  if (!HTTPMEGA_httpSvr.readFormParams(the_client, aParams)) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
 
-  // Read pin number and value
-  char *ss= static_cast<char *>(static_cast<void *>(sBuffer+5));
-  uint8_t pinId = atoi(ss);
-
-  while ((*ss) && (*ss != '=')) ss++;
-  if (!*ss) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
-  bool bValue = (*(++ss) == 't');
+  long pinId  = -1;
+  int8_t iValue = -1;
+  while (aParams.next())
+  {
+    if      (aParams.is("name" )) pinId  = aParams.toInt(-1);
+    else if (aParams.is("value")) iValue = aParams.toBool(false);
+  }
+  if ((pinId < 0) || (iValue < 0)) { HTTPMEGA_httpSvr.sendResponseBadRequest(the_client); return false; }
 
   // Set digital pin value
-  digitalWrite(pinId, bValue);
+  digitalWrite(pinId, iValue);
   
   // Compose the response string
-  bValue = digitalRead(pinId);
+  bool bValue = digitalRead(pinId);
   HTTPMEGA_httpSvr.sendResponseOkWithContent(the_client, 1);
   return HTTPMEGA_httpSvr.sendResponse(the_client, (bValue ? "1" : "0"));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/pins"
+bool rpPins(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  // All pins at once, as a JSON document like:
+  // {"digital":[0,1,...],"analog":[512,...]}
+  // The length is not computed in advance: the body is sent in chunks.
+  ResponseWriter aWriter(&the_client);
+  if (!HTTPMEGA_httpSvr.sendResponseOkChunked(the_client, aWriter, HttpSvr_mime_json)) return false;
+
+  JsonWriter aJson(aWriter);
+  aJson.beginObject();
+  aJson.key(F("digital"));
+  aJson.beginArray();
+  for (uint8_t pin = 0; pin < HTTPMEGA_DIGITAL_PINS; ++pin)
+    aJson.number(static_cast<uint16_t>(digitalRead(pin)));
+  aJson.endArray();
+  aJson.key(F("analog"));
+  aJson.beginArray();
+  for (uint8_t pin = 0; pin < HTTPMEGA_ANALOG_PINS; ++pin)
+    aJson.number(static_cast<uint16_t>(analogRead(A0 + pin)));
+  aJson.endArray();
+  aJson.endObject();
+
+  return aJson.isComplete() && aWriter.finish();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/io"
+// Many pins in one request, e.g. "GET /io?d=22-29&a=0-3" or "POST /io" with body
+// "w=22:1,23:0&d=22-29" (see HttpSvr::servePinIo for all parameters)
+#if HTTPSVR_PINIO
+bool rpPinIo(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{ return HTTPMEGA_httpSvr.servePinIo(the_client, the_method, the_url); }
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/log"
+// Part of a log on SD card, e.g. "GET /log?from=1700000000&step=6" for one row in six
+// from that time on (see HttpSvr::serveCsvLog for all parameters)
+#if HTTPSVR_CSVLOG
+bool rpLog(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{ return HTTPMEGA_httpSvr.serveCsvLog(the_client, the_method, the_url, "/log.csv"); }
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Template variables
+// In pages on SD card named "*.stm", "{{uptime}}" is replaced with the seconds
+// since reset, and "{{a0}}" with the value read on analog pin 0
+#if HTTPSVR_TEMPLATES
+void tvUptime(ResponseWriter& the_writer, const char * the_name)
+{ the_writer.writeNumber(millis() / 1000); }
+
+void tvAnalog0(ResponseWriter& the_writer, const char * the_name)
+{ the_writer.writeNumber(analogRead(0)); }
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/events"
+// Instead of polling, a page can receive pin changes as Server-Sent Events:
+//   new EventSource("/events").addEventListener("pins", ...)
+#if HTTPSVR_SSE
+bool rpEvents(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{ return HTTPMEGA_httpSvr.beginEventStream(the_client); }
+
+// Pushes the state of pins 22 to 29 when it changes, as a bitmask (bit 0 is pin 22)
+void pushPinChanges()
+{
+  static int16_t iLastState = -1;
+  if (!HTTPMEGA_httpSvr.eventStreams()) { iLastState = -1; return; }
+
+  int16_t iState = 0;
+  for (uint8_t pin = 22; pin < 30; ++pin)
+    if (digitalRead(pin)) iState |= (1 << (pin - 22));
+  if (iState == iLastState) return;
+
+  // A full state is pushed, so that nothing is lost if an event is dropped
+  char sData[16];
+  strcpy(sData, "{\"d22\":");
+  itoa(iState, sData + strlen(sData), 10);
+  strcat(sData, "}");
+  if (HTTPMEGA_httpSvr.pushEvent("pins", sData)) iLastState = iState;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/ws"
+// Pins 22 to 49 can be driven over a WebSocket, with text messages like "22=1&23=0":
+//   var ws = new WebSocket("ws://" + location.host + "/ws"); ws.send("22=1");
+// Each pin written is replied with its new state; other messages are echoed.
+#if HTTPSVR_WEBSOCKET
+bool rpWebSocket(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{ return HTTPMEGA_httpSvr.acceptWebSocket(the_client); }
+
+void onWebSocketMessage(WebSocket& the_ws, WebSocket::opcode_e the_opcode, uint8_t * the_data, uint16_t the_length)
+{
+  if (the_opcode != WebSocket::op_text) { the_ws.sendBinary(the_data, the_length); return; }
+
+  // The message is null terminated, so it can be parsed in place
+  bool bAnyPin = false;
+  HttpParams aParams(reinterpret_cast<char *>(the_data), the_length);
+  while (aParams.next())
+  {
+    int pin = atoi(aParams.name());
+    if ((pin < 22) || (pin > 49)) continue;
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, aParams.toBool(false) ? HIGH : LOW);
+
+    char sReply[8];
+    itoa(pin, sReply, 10);
+    strcat(sReply, digitalRead(pin) ? "=1" : "=0");
+    the_ws.sendText(sReply);
+    bAnyPin = true;
+  }
+  if (!bAnyPin) the_ws.sendBinary(the_data, the_length);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Providers for "/metrics" and "/metrics.bin"
+#if HTTPSVR_METRICS
+bool rpMetrics(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  // Prometheus text format: can be scraped directly by a Prometheus server
+  return HTTPMEGA_httpSvr.sendMetrics(the_client);
+}
+
+bool rpMetricsBinary(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  // Raw http_metrics struct, for compact polling by custom tools
+  return HTTPMEGA_httpSvr.sendMetricsBinary(the_client);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Resource Provider for "/trace"
+#if HTTPSVR_TRACE
+bool rpTrace(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  // Binary dump of the trace buffer: decode it with extras/tools/httptrace.py
+  return HTTPMEGA_httpSvr.sendTrace(the_client);
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 // Configuration of HTTP server object
 void configHttpServer()
 {
   // Bind resource providers
   HTTPMEGA_httpSvr.bindUrl("/"            , &rpRoot        );
+  HTTPMEGA_httpSvr.bindUrl("/version"     , &rpVersion     );
   HTTPMEGA_httpSvr.bindUrl("/digitalRead" , &rpDigitalRead );
   HTTPMEGA_httpSvr.bindUrl("/digitalWrite", &rpDigitalWrite);
+  HTTPMEGA_httpSvr.bindUrl("/pins"        , &rpPins        );
+#if HTTPSVR_SSE
+  HTTPMEGA_httpSvr.bindUrl("/events"      , &rpEvents      );
+#endif
+#if HTTPSVR_WEBSOCKET
+  HTTPMEGA_httpSvr.bindUrl("/ws"          , &rpWebSocket   );
+  HTTPMEGA_httpSvr.setWebSocketHandler(&onWebSocketMessage);
+#endif
+#if HTTPSVR_PINIO
+  HTTPMEGA_httpSvr.bindUrl("/io"          , &rpPinIo       );
+
+  // Only pins 22 to 49 can be written: the others are used by shields or serial ports
+  for (uint8_t pin = 22; pin < 50; ++pin)
+    HTTPMEGA_httpSvr.setPinIoWritable(pin, true);
+#endif
+#if HTTPSVR_CSVLOG
+  HTTPMEGA_httpSvr.bindUrl("/log"         , &rpLog         );
+#endif
+#if HTTPSVR_TEMPLATES
+  HTTPMEGA_httpSvr.bindTemplateVar("uptime" , &tvUptime      );
+  HTTPMEGA_httpSvr.bindTemplateVar("a0"     , &tvAnalog0     );
+#endif
+#if HTTPSVR_METRICS
+  HTTPMEGA_httpSvr.bindUrl("/metrics"     , &rpMetrics      );
+  HTTPMEGA_httpSvr.bindUrl("/metrics.bin" , &rpMetricsBinary);
+#endif
+#if HTTPSVR_TRACE
+  HTTPMEGA_httpSvr.bindUrl("/trace"       , &rpTrace        );
+#endif
+
+  // Pages can also be served from flash, without SD card: generate a bundle from
+  // a directory of pages with extras/tools/mkbundle.py, then pass it to the server
+  //   HTTPMEGA_httpSvr.setFlashBundle(bundle_entries, bundle_count);
 
   // Start the server, specifying the SS and CS pins for SD card
   HTTPMEGA_httpSvr.begin_noDHCP(HTTPMEGA_SS_PIN,
@@ -185,11 +358,13 @@ static const uint8_t DBG_PIN = 9;
 void setup()
 {
   pinMode(DBG_PIN, OUTPUT);
+  digitalWrite(DBG_PIN, HIGH);
+#ifdef W5100_DBG_PIN0
   pinMode(W5100_DBG_PIN0, OUTPUT);
   pinMode(W5100_DBG_PIN1, OUTPUT);
-  digitalWrite(DBG_PIN, HIGH);
   digitalWrite(W5100_DBG_PIN0, HIGH);
   digitalWrite(W5100_DBG_PIN1, HIGH);
+#endif
   
   // Initialize LCD
   configDisplay();
@@ -197,8 +372,10 @@ void setup()
   delay(2000);
   
   // Initialize HttpSvr
+#ifdef W5100_DBG_PIN0
   digitalWrite(W5100_DBG_PIN0, LOW);
   digitalWrite(W5100_DBG_PIN1, LOW);
+#endif
   writeLine1("Connecting...");
   configHttpServer();
   writeIP(HTTPMEGA_httpSvr.localIpAddr());
@@ -220,6 +397,9 @@ void loop()
 
   // Check if there is an incoming client request
   uTotConn += HTTPMEGA_httpSvr.serveHttpConnections();
+#if HTTPSVR_SSE
+  pushPinChanges();
+#endif
   
   // Print some diagnostics
   writeFreeMem();  
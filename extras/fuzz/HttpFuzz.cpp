@@ -0,0 +1,514 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpFuzz.cpp - Fuzzing and differential testing of HttpSvr request parsing
+//
+//  ----------------------
+//
+//  Each input is sent by a client on one connection to an HttpSvr running on
+//  the emulated W5100 (see extras/host/W5100Emu.h), i.e. through ClientProxy
+//  and the W5100 driver as on the board. The client closes the connection once
+//  the server has read everything and has been quiet for a while. Then:
+//    * the responses must be well formed (status line, headers, body of the
+//      announced length or in chunks)
+//    * they must be the ones predicted by the reference model (see HttpRef.h),
+//      as well as the files written by uploads and PUT
+//    * the server must have closed the connection and be listening again on
+//      all its sockets, within 30 s of virtual time
+//  Any other failure (buffer overflow, undefined behavior...) is reported by
+//  the sanitizers the harness is built with (see build.sh).
+//
+//  Built with -fsanitize=fuzzer, this file is a libFuzzer target. Otherwise
+//  it has its own main:
+//    httpfuzz [-runs=N] [-seed=N] [-max_len=N] [-verbose=1] FILE|DIR|-...
+//  runs each input given ("-" for standard input, as afl-fuzz gives it), then
+//  N inputs made by mutating them at random. An input that fails is written
+//  to "crash-N" in the current directory; with -verbose=1, the number of
+//  responses of each input is printed.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <SD.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "HttpSvr.h"
+#include "W5100Emu.h"
+#include "W5100Defs.h"
+#include "HttpRef.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint16_t local_port        = 80;
+static const uint8_t  local_sockets     = 4;
+static const uint64_t local_quietUs     = 50000;      // The client closes after 50 ms of silence
+static const uint64_t local_timeLimitUs = 30000000;
+static size_t         local_maxInput    = 8192;
+static bool           local_verbose     = false;
+
+static const char * const local_methodNames[] =
+{ "?", "OPTIONS", "GET", "HEAD", "POST", "PUT", "DELETE", "TRACE", "CONNECT" };
+
+static HttpSvr      local_server;
+static std::string  local_input;      // Input being run, for reports
+
+////////////////////////////////////////////////////////////////////////////////
+// Reports
+
+static std::string local_escape(const std::string& the_s, size_t the_max = 2048)
+{
+  std::string sOut;
+  for (size_t u = 0; (u < the_s.size()) && (u < the_max); ++u)
+  {
+    unsigned char ch = the_s[u];
+    if      (ch == '\r') sOut += "\\r";
+    else if (ch == '\n') sOut += "\\n\n    ";
+    else if (ch == '\\') sOut += "\\\\";
+    else if ((ch < 0x20) || (ch >= 0x7F))
+    {
+      char sHex[8];
+      snprintf(sHex, sizeof(sHex), "\\x%02X", ch);
+      sOut += sHex;
+    }
+    else sOut += static_cast<char>(ch);
+  }
+  if (the_s.size() > the_max) sOut += "...";
+  return sOut;
+}
+
+static void local_fail(const std::string& the_what, const std::string& the_details = std::string())
+{
+  fprintf(stderr, "httpfuzz: %s\n", the_what.c_str());
+  if (!the_details.empty()) fprintf(stderr, "%s\n", the_details.c_str());
+  fprintf(stderr, "input (%u bytes):\n    %s\n", static_cast<unsigned>(local_input.size()), local_escape(local_input).c_str());
+#ifndef HTTPFUZZ_LIBFUZZER
+  // libFuzzer saves the input by itself
+  char sName[32];
+  snprintf(sName, sizeof(sName), "crash-%d", static_cast<int>(getpid()));
+  FILE * pFile = fopen(sName, "wb");
+  if (pFile)
+  {
+    fwrite(local_input.data(), 1, local_input.size(), pFile);
+    fclose(pFile);
+    fprintf(stderr, "input written to %s\n", sName);
+  }
+#endif
+  abort();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// "/echo" provider: writes back the method, the URL, the query pairs and, for
+// methods other than GET, the headers and the body (see HttpRef)
+
+static bool local_rpEcho(ClientProxy& the_client, http_e::method the_method, const char * the_url)
+{
+  std::string sEcho = std::string(local_methodNames[the_method]) + " " + the_url + "\n";
+
+  char sQueryName [HttpRef::echoQueryNameLength];
+  char sQueryValue[HttpRef::echoQueryValueLength];
+  const char * pNext = local_server.uriExtractFirstQueryNVP(the_url, sQueryName, sizeof(sQueryName), sQueryValue, sizeof(sQueryValue));
+  for (uint16_t u = 0; pNext; ++u)
+  {
+    if (u == HttpRef::echoMaxPairs) { sEcho += "Q ...\n"; break; }
+    sEcho += std::string("Q ") + sQueryName + "=" + sQueryValue + "\n";
+    pNext = local_server.uriExtractNextQueryNVP(pNext, sQueryName, sizeof(sQueryName), sQueryValue, sizeof(sQueryValue));
+  }
+
+  if (the_method != http_e::mthd_get)
+  {
+    // Headers and body are still to be read
+    char sName [HttpRef::echoNameLength];
+    char sValue[HttpRef::echoValueLength];
+    uint16_t uBodyLength = 0;
+    while (true)
+    {
+      if (!local_server.readNextHeader(the_client, sName, sizeof(sName), sValue, sizeof(sValue))) return false;
+      if (!sName[0]) break;
+      sEcho += std::string("H ") + sName + ": " + sValue + "\n";
+      if (!strcasecmp(sName, "Content-Length")) uBodyLength = atoi(sValue);
+    }
+    if (!the_client.readCRLF()) return false;
+
+    std::string sBody;
+    for (uint16_t u = 0; u < uBodyLength; ++u)
+    {
+      uint8_t ch;
+      if (!the_client.readByte(ch)) return false;
+      sBody += static_cast<char>(ch);
+    }
+    char sLength[8];
+    snprintf(sLength, sizeof(sLength), "%u", uBodyLength);
+    sEcho += std::string("B ") + sLength + "\n" + sBody;
+  }
+
+  local_server.sendResponseOkWithContent(the_client, sEcho.size(), "text/plain");
+  the_client.writeBuffer(reinterpret_cast<uint8_t *>(&sEcho[0]), sEcho.size());
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Client
+
+class local_client : public W5100Emu::peer_t
+{
+public:
+  explicit local_client(const std::string& the_request)
+  : my_request(the_request), my_conn(0), my_lastActivity(0), my_closing(false), my_closed(false)
+  {}
+
+  void start()
+  {
+    W5100Emu::link_t aLink;
+    aLink.rttUs = 1000;
+    my_conn = W5100Emu::connect(this, local_port, aLink);
+  }
+
+  bool               closed  () const { return my_closed;   }
+  const std::string& received() const { return my_received; }
+
+  virtual void onConnected(W5100Emu::conn_t)
+  {
+    if (!my_request.empty()) W5100Emu::send(my_conn, my_request.data(), my_request.size());
+    my_lastActivity = W5100Emu::now();
+    W5100Emu::schedule(this, my_lastActivity + local_quietUs, 0);
+  }
+
+  virtual void onRefused(W5100Emu::conn_t)
+  { my_closed = true; }
+
+  virtual void onData(W5100Emu::conn_t, const uint8_t * the_data, uint16_t the_size)
+  {
+    my_received.append(reinterpret_cast<const char *>(the_data), the_size);
+    my_lastActivity = W5100Emu::now();
+  }
+
+  virtual void onClosed(W5100Emu::conn_t)
+  { my_closed = true; }
+
+  virtual void onTimer(uint32_t)
+  {
+    // Closing before the server has read everything would make it fail on
+    // data it never saw
+    if (my_closed || my_closing) return;
+    if ((W5100Emu::unread(my_conn) == 0) && (W5100Emu::now() - my_lastActivity >= local_quietUs))
+    {
+      my_closing = true;
+      W5100Emu::close(my_conn);
+      return;
+    }
+    W5100Emu::schedule(this, W5100Emu::now() + local_quietUs / 5, 0);
+  }
+
+private:
+  std::string       my_request;
+  std::string       my_received;
+  W5100Emu::conn_t  my_conn;
+  uint64_t          my_lastActivity;
+  bool              my_closing;
+  bool              my_closed;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Responses
+
+struct local_response
+{
+  int          status;
+  std::string  body;
+};
+
+static bool local_parseResponses(const std::string& the_data, std::vector<local_response>& the_responses, std::string& the_error)
+{
+  size_t pos = 0;
+  while (pos < the_data.size())
+  {
+    std::string::size_type eoh = the_data.find("\r\n\r\n", pos);
+    if (eoh == std::string::npos) { the_error = "response headers not terminated"; return false; }
+    std::string sHead = the_data.substr(pos, eoh + 2 - pos);
+    pos = eoh + 4;
+
+    // Status line
+    local_response aResponse;
+    if ((sHead.compare(0, 9, "HTTP/1.1 ") != 0) || !isdigit(sHead[9]) || !isdigit(sHead[10]) || !isdigit(sHead[11]) || (sHead[12] != ' '))
+    { the_error = "bad status line"; return false; }
+    aResponse.status = atoi(sHead.substr(9, 3).c_str());
+
+    // Headers
+    long lLength  = -1;
+    bool bChunked = false;
+    for (size_t start = sHead.find("\r\n") + 2; start < sHead.size(); )
+    {
+      size_t end = sHead.find("\r\n", start);
+      std::string sLine = sHead.substr(start, end - start);
+      start = end + 2;
+      std::string::size_type colon = sLine.find(':');
+      if ((colon == std::string::npos) || (colon == 0)) { the_error = "bad response header"; return false; }
+      std::string sName  = sLine.substr(0, colon);
+      std::string sValue = sLine.substr(sLine.find_first_not_of(' ', colon + 1) == std::string::npos ? sLine.size() : sLine.find_first_not_of(' ', colon + 1));
+      if (!strcasecmp(sName.c_str(), "Content-Length"))
+      {
+        if (sValue.empty() || (sValue.find_first_not_of("0123456789") != std::string::npos)) { the_error = "bad Content-Length"; return false; }
+        lLength = atol(sValue.c_str());
+      }
+      if (!strcasecmp(sName.c_str(), "Transfer-Encoding") && (sValue == "chunked")) bChunked = true;
+    }
+
+    // Body
+    if (bChunked)
+    {
+      while (true)
+      {
+        std::string::size_type eol = the_data.find("\r\n", pos);
+        if (eol == std::string::npos) { the_error = "chunk size not terminated"; return false; }
+        std::string sSize = the_data.substr(pos, eol - pos);
+        if (sSize.empty() || (sSize.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)) { the_error = "bad chunk size"; return false; }
+        size_t uSize = strtoul(sSize.c_str(), 0, 16);
+        pos = eol + 2;
+        if (the_data.size() - pos < uSize + 2) { the_error = "truncated chunk"; return false; }
+        if (the_data.compare(pos + uSize, 2, "\r\n") != 0) { the_error = "chunk not terminated"; return false; }
+        aResponse.body.append(the_data, pos, uSize);
+        pos += uSize + 2;
+        if (!uSize) break;
+      }
+    }
+    else if (lLength > 0)
+    {
+      if (the_data.size() - pos < static_cast<size_t>(lLength)) { the_error = "truncated body"; return false; }
+      aResponse.body.assign(the_data, pos, lLength);
+      pos += lLength;
+    }
+    the_responses.push_back(aResponse);
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run
+
+static bool local_allListening()
+{
+  for (uint8_t sn = 0; sn < local_sockets; ++sn)
+    if (W5100Emu::status(sn) != W5100_SOCK_LISTEN) return false;
+  return true;
+}
+
+static void local_run(const uint8_t * the_data, size_t the_size)
+{
+  if (the_size > local_maxInput) the_size = local_maxInput;
+  local_input.assign(reinterpret_cast<const char *>(the_data), the_size);
+
+  // Everything starts afresh: chip, card, clock
+  static const uint8_t macAddress[] = { 0x90, 0xA2, 0xDA, 0x00, 0x00, 0x01 };
+  W5100Emu::begin();
+  SD.clear();
+  local_server.begin_noDHCP(10, 4, macAddress, IPAddress(192, 168, 0, 27), local_port);
+  local_server.flushFileCache();
+  if (!local_server.isUrlBound("/echo")) local_server.bindUrl("/echo", &local_rpEcho);
+
+  local_client aClient(local_input);
+  aClient.start();
+  while (!aClient.closed() && (W5100Emu::now() < local_timeLimitUs))
+    local_server.serveHttpConnections();
+  while (!local_allListening() && (W5100Emu::now() < local_timeLimitUs))
+    local_server.serveHttpConnections();
+  if (W5100Emu::now() >= local_timeLimitUs)
+    local_fail("the connection is still open after 30 s", "received:\n    " + local_escape(aClient.received()));
+
+  // Responses must be well formed...
+  std::vector<local_response> responses;
+  std::string sError;
+  if (!local_parseResponses(aClient.received(), responses, sError))
+    local_fail(sError, "received:\n    " + local_escape(aClient.received()));
+
+  // ...and as predicted
+  HttpRef aRef(local_input);
+  const std::vector<HttpRef::response_t>& expected = aRef.responses();
+  char sCounts[96];
+  snprintf(sCounts, sizeof(sCounts), "%u responses, %u expected%s",
+           static_cast<unsigned>(responses.size()), static_cast<unsigned>(expected.size()), aRef.complete() ? "" : " (at least)");
+  if ((responses.size() < expected.size()) || (aRef.complete() && (responses.size() != expected.size())))
+    local_fail(sCounts, "received:\n    " + local_escape(aClient.received()));
+
+  for (size_t u = 0; u < expected.size(); ++u)
+  {
+    char sWhich[64];
+    snprintf(sWhich, sizeof(sWhich), "response %u: ", static_cast<unsigned>(u + 1));
+    if (responses[u].status != expected[u].status)
+    {
+      snprintf(sWhich, sizeof(sWhich), "response %u: status %d, expected %d", static_cast<unsigned>(u + 1), responses[u].status, expected[u].status);
+      local_fail(sWhich, "received:\n    " + local_escape(aClient.received()));
+    }
+    if (expected[u].checkBody && (responses[u].body != expected[u].body))
+      local_fail(std::string(sWhich) + "unexpected body",
+                 "body:\n    " + local_escape(responses[u].body) + "\nexpected:\n    " + local_escape(expected[u].body));
+  }
+
+  // Uploads and PUT end in files on the card
+  if (aRef.complete())
+  {
+    const HttpRef::files_t& files = aRef.files();
+    for (HttpRef::files_t::const_iterator it = files.begin(); it != files.end(); ++it)
+    {
+      const std::vector<uint8_t> * pFile = SD.fileData(it->first.c_str());
+      if (!pFile) local_fail(it->first + " not written");
+      if (std::string(pFile->begin(), pFile->end()) != it->second)
+        local_fail(it->first + " differs",
+                   "content:\n    " + local_escape(std::string(pFile->begin(), pFile->end())) + "\nexpected:\n    " + local_escape(it->second));
+    }
+    if (SD.fileCount() != files.size()) local_fail("files written unexpectedly");
+  }
+  if (local_verbose) fprintf(stderr, "httpfuzz: %s, %u files\n", sCounts, static_cast<unsigned>(aRef.files().size()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// libFuzzer entry point
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * the_data, size_t the_size)
+{
+  local_run(the_data, the_size);
+  return 0;
+}
+
+#ifndef HTTPFUZZ_LIBFUZZER
+
+////////////////////////////////////////////////////////////////////////////////
+// Standalone runner, for compilers without libFuzzer
+
+static uint32_t local_random = 1;
+
+static uint32_t local_rand(uint32_t the_range)
+{
+  local_random ^= local_random << 13;
+  local_random ^= local_random >> 17;
+  local_random ^= local_random << 5;
+  return the_range ? local_random % the_range : 0;
+}
+
+static const char * const local_tokens[] =
+{
+  "\r\n", "\r", "\n", " ", "\t", ":", "=", "&", "?", "#", "--", "\"", ";", "\r\n\r\n",
+  "GET ", "POST ", "HEAD ", "PUT ", "DELETE ", " HTTP/1.1", "/echo", "/upload",
+  "Content-Length: ", "Content-Type: multipart/form-data; boundary=", "boundary=",
+  "Content-Disposition: form-data; name=\"file\"; filename=\"", "filename=\"",
+  "\r\n\r\n--", "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+};
+
+static std::string local_mutate(const std::vector<std::string>& the_corpus)
+{
+  std::string sData = the_corpus[local_rand(the_corpus.size())];
+  for (uint32_t uMutations = 1 + local_rand(4); uMutations; --uMutations)
+  {
+    size_t pos = local_rand(sData.size() + 1);
+    switch (local_rand(7))
+    {
+    case 0: if (pos < sData.size()) sData[pos] ^= static_cast<char>(1 << local_rand(8)); break;
+    case 1: sData.insert(pos, 1, static_cast<char>(local_rand(256))); break;
+    case 2: sData.erase(pos, 1 + local_rand(16)); break;
+    case 3: sData.insert(pos, local_tokens[local_rand(sizeof(local_tokens) / sizeof(local_tokens[0]))]); break;
+    case 4: sData.insert(pos, sData.substr(local_rand(sData.size() + 1), local_rand(300))); break;
+    case 5: { const std::string& sOther = the_corpus[local_rand(the_corpus.size())];
+              sData = sData.substr(0, pos) + sOther.substr(local_rand(sOther.size() + 1)); } break;
+    case 6: if (pos < sData.size()) sData[pos] = "\r\n :=&?#-\"\0"[local_rand(11)]; break;
+    }
+  }
+  if (sData.size() > local_maxInput) sData.resize(local_maxInput);
+  return sData;
+}
+
+static bool local_readFile(const std::string& the_path, std::string& the_data)
+{
+  FILE * pFile = fopen(the_path.c_str(), "rb");
+  if (!pFile) return false;
+  char sBuffer[4096];
+  size_t uRead;
+  the_data.clear();
+  while ((uRead = fread(sBuffer, 1, sizeof(sBuffer), pFile)) > 0) the_data.append(sBuffer, uRead);
+  fclose(pFile);
+  return true;
+}
+
+static void local_load(const std::string& the_path, std::vector<std::string>& the_corpus)
+{
+  struct stat aStat;
+  if (stat(the_path.c_str(), &aStat) != 0) { fprintf(stderr, "httpfuzz: cannot read %s\n", the_path.c_str()); exit(2); }
+  if (S_ISDIR(aStat.st_mode))
+  {
+    DIR * pDir = opendir(the_path.c_str());
+    std::vector<std::string> names;
+    for (dirent * pEntry; pDir && (pEntry = readdir(pDir)) != 0; )
+      if (pEntry->d_name[0] != '.') names.push_back(the_path + "/" + pEntry->d_name);
+    if (pDir) closedir(pDir);
+    std::sort(names.begin(), names.end());
+    for (size_t u = 0; u < names.size(); ++u) local_load(names[u], the_corpus);
+    return;
+  }
+  std::string sData;
+  if (!local_readFile(the_path, sData)) { fprintf(stderr, "httpfuzz: cannot read %s\n", the_path.c_str()); exit(2); }
+  the_corpus.push_back(sData);
+}
+
+static void local_loadStdin(std::vector<std::string>& the_corpus)
+{
+  // One input, as given by afl-fuzz
+  std::string sData;
+  char sBuffer[4096];
+  size_t uRead;
+  while ((uRead = fread(sBuffer, 1, sizeof(sBuffer), stdin)) > 0) sData.append(sBuffer, uRead);
+  the_corpus.push_back(sData);
+}
+
+static void local_onAlarm(int)
+{ local_fail("no progress for 10 s"); }
+
+int main(int argc, char ** argv)
+{
+  unsigned long ulRuns = 0;
+  std::vector<std::string> corpus;
+  for (int i = 1; i < argc; ++i)
+  {
+    if      (!strncmp(argv[i], "-runs=",    6)) ulRuns       = strtoul(argv[i] + 6, 0, 10);
+    else if (!strncmp(argv[i], "-seed=",    6)) local_random = strtoul(argv[i] + 6, 0, 10) | 1;
+    else if (!strncmp(argv[i], "-max_len=", 9)) local_maxInput = strtoul(argv[i] + 9, 0, 10);
+    else if (!strcmp (argv[i], "-verbose=1"))   local_verbose  = true;
+    else if (!strcmp (argv[i], "-"))            local_loadStdin(corpus);
+    else if (argv[i][0] == '-') { fprintf(stderr, "usage: %s [-runs=N] [-seed=N] [-max_len=N] [-verbose=1] FILE|DIR|-...\n", argv[0]); return 2; }
+    else local_load(argv[i], corpus);
+  }
+  if (corpus.empty()) corpus.push_back(std::string());
+  signal(SIGALRM, &local_onAlarm);
+
+  for (size_t u = 0; u < corpus.size(); ++u)
+  {
+    alarm(10);
+    local_run(reinterpret_cast<const uint8_t *>(corpus[u].data()), corpus[u].size());
+  }
+  for (unsigned long ul = 0; ul < ulRuns; ++ul)
+  {
+    std::string sData = local_mutate(corpus);
+    alarm(10);
+    local_run(reinterpret_cast<const uint8_t *>(sData.data()), sData.size());
+    if (((ul + 1) % 1000) == 0) fprintf(stderr, "httpfuzz: %lu runs\n", ul + 1);
+  }
+  alarm(0);
+
+  fprintf(stderr, "httpfuzz: %u inputs, %lu mutations: ok\n", static_cast<unsigned>(corpus.size()), ulRuns);
+  return 0;
+}
+
+#endif // #ifndef HTTPFUZZ_LIBFUZZER
@@ -0,0 +1,495 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpRef.cpp - Reference model of HttpSvr request parsing
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "HttpSvrConfig.h"
+#include "utility/crc16.h"
+#include "HttpRef.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Limits of the server
+
+static const size_t local_maxUrl        = HTTPSVR_MAX_URL_LENGTH - 1;
+static const size_t local_maxFieldName  = HTTPSVR_MAX_FIELD_NAME_LENGTH;
+static const size_t local_maxFieldValue = HTTPSVR_MAX_FIELD_VALUE_LENGTH;
+static const size_t local_maxLine       = HTTPSVR_MAX_FIELD_VALUE_LENGTH - 1;
+static const size_t local_maxMethod     = 7;
+static const size_t local_maxBoundary   = 70;
+static const char   local_echoPath[]    = "/echo";
+
+////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+static std::string local_cstr(const std::string& the_s)
+{
+  // What the server sees of a buffer through C string functions
+  return the_s.substr(0, the_s.find('\0'));
+}
+
+static std::string local_number(unsigned long the_value)
+{
+  char sBuffer[16];
+  snprintf(sBuffer, sizeof(sBuffer), "%lu", the_value);
+  return sBuffer;
+}
+
+static bool local_isEcho(const std::string& the_path)
+{
+  // Bound URLs are recognized by the CRC of their path (see HttpSvr::bindUrl)
+  return crcsum(the_path.data(), the_path.size(), CRC_INIT) == crcsum(local_echoPath, sizeof(local_echoPath) - 1, CRC_INIT);
+}
+
+static std::string local_queryPairs(const std::string& the_url)
+{
+  // Pairs are taken after the first '?', up to the next '?' or '#'
+  std::string sPairs;
+  std::string::size_type q = the_url.find('?');
+  if (q == std::string::npos) return sPairs;
+  std::string sQuery = the_url.substr(q + 1);
+  sQuery = sQuery.substr(0, sQuery.find_first_of("?#"));
+
+  std::string::size_type pos = 0;
+  for (uint16_t u = 0; true; ++u)
+  {
+    std::string::size_type amp = sQuery.find('&', pos);
+    std::string sItem = sQuery.substr(pos, (amp == std::string::npos) ? std::string::npos : amp - pos);
+    if (sItem.empty() && (amp == std::string::npos)) break;
+    if (u == HttpRef::echoMaxPairs) { sPairs += "Q ...\n"; break; }
+
+    std::string::size_type eq = sItem.find('=');
+    std::string sName  = sItem.substr(0, eq);
+    std::string sValue = (eq == std::string::npos) ? std::string() : sItem.substr(eq + 1);
+    sPairs += "Q " + sName.substr(0, HttpRef::echoQueryNameLength - 1) + "=" + sValue.substr(0, HttpRef::echoQueryValueLength - 1) + "\n";
+
+    if (amp == std::string::npos) break;
+    pos = amp + 1;
+  }
+  return sPairs;
+}
+
+static bool local_isPlainPath(const std::string& the_path)
+{
+  // Names from the root, neither empty nor starting with '.', of printable
+  // chars other than those special to a card or to a shell
+  if (the_path.empty() || (the_path[0] != '/')) return false;
+  for (size_t u = 0; u < the_path.size(); ++u)
+  {
+    char ch = the_path[u];
+    if (ch == '/')
+    {
+      if ((u + 1 == the_path.size()) || (the_path[u + 1] == '/') || (the_path[u + 1] == '.')) return false;
+    }
+    else if ((ch < 0x21) || (ch > 0x7E) || (std::string("\\:%*?\"<>|").find(ch) != std::string::npos))
+      return false;
+  }
+  return true;
+}
+
+static std::string local_parent(const std::string& the_name)
+{
+  std::string::size_type slash = the_name.rfind('/');
+  return (slash == std::string::npos) ? std::string() : the_name.substr(0, slash);
+}
+
+static bool local_isBoundary(const std::string& the_line, const std::string& the_boundary)
+{
+  // "\r\n--boundary" or "\r\n--boundary--", as a whole line
+  if ((the_line.size() < 4) || (the_line.compare(0, 4, "\r\n--") != 0)) return false;
+  std::string sRest = the_line.substr(4);
+  if ((sRest.size() >= 2) && (sRest.compare(sRest.size() - 2, 2, "--") == 0)) sRest.resize(sRest.size() - 2);
+  return sRest == the_boundary;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+HttpRef::HttpRef(const std::string& the_input)
+: my_in(the_input), my_pos(0), my_eod(false), my_complete(true), my_contentLength(-1), my_chunked(false)
+{
+  // The card is empty
+  my_dirs.insert(std::string());
+
+  // Requests are served one after the other, until one makes the server
+  // reset the connection
+  while (!my_eod && (prv_request() == res_ok));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading
+
+bool HttpRef::prv_atEnd()
+{
+  if (my_pos < my_in.size()) return false;
+  my_eod = true;
+  return true;
+}
+
+bool HttpRef::prv_readCRLF()
+{
+  // A lone CR is consumed anyway
+  if (prv_atEnd() || (my_in[my_pos] != '\r')) return false;
+  ++my_pos;
+  if (prv_atEnd() || (my_in[my_pos] != '\n')) return false;
+  ++my_pos;
+  return true;
+}
+
+bool HttpRef::prv_readHeader(std::string& the_name, std::string& the_value, uint16_t the_nameLen, uint16_t the_valueLen)
+{
+  // Starts at the CRLF ending the previous line
+  the_name.clear();
+  the_value.clear();
+  if (!prv_readCRLF()) return false;
+
+  // Continuation lines are skipped
+  while (true)
+  {
+    if (prv_atEnd()) return false;
+    if ((my_in[my_pos] != ' ') && (my_in[my_pos] != '\t')) break;
+    std::string::size_type eol = my_in.find_first_of("\r\n", my_pos);
+    if (eol == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+    my_pos = eol;
+    if (!prv_readCRLF()) return false;
+  }
+
+  // Name, up to ':' (or CR for the empty line ending headers)
+  std::string::size_type end = my_in.find_first_of(":\r", my_pos);
+  size_t uLen = ((end == std::string::npos) ? my_in.size() : end) - my_pos;
+  if (uLen >= the_nameLen) { my_pos += the_nameLen; return false; }
+  if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+  the_name = my_in.substr(my_pos, uLen);
+  my_pos = end;
+  if (my_in[end] == '\r')
+  {
+    if (uLen) return false;
+  }
+  else
+    ++my_pos;
+
+  // Value, after spaces, up to CR
+  std::string::size_type start = my_in.find_first_not_of(" \t", my_pos);
+  if (start == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+  end = my_in.find('\r', start);
+  if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+  if (the_valueLen) the_value = my_in.substr(start, std::min<size_t>(end - start, the_valueLen - 1));
+  my_pos = end;
+  return true;
+}
+
+bool HttpRef::prv_skipHeaders()
+{
+  std::string sName, sValue;
+  while (prv_readHeader(sName, sValue, local_maxFieldName, 0))
+    if (local_cstr(sName).empty()) return true;
+  return false;
+}
+
+bool HttpRef::prv_skipToBody(uint16_t& the_bodyLength)
+{
+  // Content-Length is also kept in full (or -1), along with chunks, for PUT
+  std::string sName, sValue;
+  bool bOk;
+  the_bodyLength   = 0;
+  my_contentLength = -1;
+  my_chunked       = false;
+  while ((bOk = prv_readHeader(sName, sValue, local_maxFieldName, local_maxFieldValue)))
+  {
+    sName  = local_cstr(sName);
+    sValue = local_cstr(sValue);
+    if (sName.empty()) break;
+    if (!strcasecmp(sName.c_str(), "Content-Length"))
+    {
+      the_bodyLength = static_cast<uint16_t>(atoi(sValue.c_str()));
+      long lLength = atol(sValue.c_str());
+      my_contentLength = (lLength >= 0) ? static_cast<int32_t>(lLength) : -1;
+    }
+    else if (!strcasecmp(sName.c_str(), "Transfer-Encoding"))
+      my_chunked = (sValue.find("chunked") != std::string::npos);
+  }
+  if (bOk) prv_readCRLF();
+  return bOk;
+}
+
+bool HttpRef::prv_skipBytes(uint32_t the_count, std::string * the_bytes)
+{
+  if (my_in.size() - my_pos < the_count)
+  {
+    my_pos = my_in.size();
+    my_eod = true;
+    return false;
+  }
+  if (the_bytes) the_bytes->assign(my_in, my_pos, the_count);
+  my_pos += the_count;
+  return true;
+}
+
+std::string HttpRef::prv_readToEOL()
+{
+  // A line of multipart data starts with the CRLF ending the previous one;
+  // long lines come in pieces
+  std::string sLine;
+  while (sLine.size() < local_maxLine)
+  {
+    if (prv_atEnd()) break;
+    if ((my_in[my_pos] == '\r') && !sLine.empty()) break;
+    sLine += my_in[my_pos++];
+  }
+  return sLine;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Requests
+
+void HttpRef::prv_respond(int the_status, bool the_checkBody, const std::string& the_body)
+{
+  // After the server has waited for more data, the connection is gone
+  if (my_eod) return;
+  response_t aResponse;
+  aResponse.status    = the_status;
+  aResponse.checkBody = the_checkBody;
+  aResponse.body      = the_body;
+  my_responses.push_back(aResponse);
+}
+
+HttpRef::result_e HttpRef::prv_request()
+{
+  // Empty lines before the request line are skipped
+  std::string::size_type start = my_in.find_first_not_of("\r\n", my_pos);
+  if (start == std::string::npos) { my_pos = my_in.size(); my_eod = true; return res_fail; }
+  my_pos = start;
+
+  // Method
+  std::string::size_type end = my_in.find_first_of(" \r\n", my_pos);
+  if (end == my_pos) return res_fail;
+  if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return res_fail; }
+  std::string sMethod = (end - my_pos > local_maxMethod) ? std::string() : local_cstr(my_in.substr(my_pos, end - my_pos));
+  my_pos = end;
+
+  // URL
+  start = my_in.find_first_not_of(" \t", my_pos);
+  if (start == std::string::npos) { my_pos = my_in.size(); my_eod = true; return res_fail; }
+  my_pos = start;
+  end = my_in.find_first_of(" \r\n", my_pos);
+  size_t uLen = ((end == std::string::npos) ? my_in.size() : end) - my_pos;
+  if (uLen == 0) return res_fail;
+  if (uLen > local_maxUrl) { my_pos += local_maxUrl; prv_respond(414); return res_fail; }
+  if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return res_fail; }
+  std::string sUrl = local_cstr(my_in.substr(my_pos, uLen));
+
+  // Rest of the request line
+  end = my_in.find_first_of("\r\n", end);
+  if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return res_fail; }
+  my_pos = end;
+
+  // Dispatch
+  std::string sPath = sUrl.substr(0, sUrl.find_first_of("?#"));
+  if (sMethod == "HEAD") { prv_respond(200); return res_ok; }
+  if (sMethod == "GET")
+  {
+    uint16_t uBodyLength;
+    prv_skipToBody(uBodyLength);
+    if (!prv_skipBytes(uBodyLength, 0)) { prv_respond(400); return res_fail; }
+    if (sPath.empty() || !local_isEcho(sPath)) { my_complete = false; return res_stop; }
+    prv_respond(200, true, sMethod + " " + sUrl + "\n" + local_queryPairs(sUrl));
+    return res_ok;
+  }
+  if ((sMethod == "POST") || (sMethod == "PUT") || (sMethod == "DELETE"))
+  {
+    if (sPath.empty()) { my_complete = false; return res_stop; }
+    if (local_isEcho(sPath)) return prv_echo(sMethod, sUrl);
+    if (sMethod == "POST") return prv_upload();
+    if (sMethod == "PUT")  return prv_put(sPath);
+    return prv_delete(sPath);
+  }
+
+  prv_respond(400);
+  return res_fail;
+}
+
+HttpRef::result_e HttpRef::prv_echo(const std::string& the_method, const std::string& the_url)
+{
+  // The provider reads the headers and the body itself
+  std::string sEcho = the_method + " " + the_url + "\n" + local_queryPairs(the_url);
+  std::string sName, sValue;
+  uint16_t uBodyLength = 0;
+  while (true)
+  {
+    if (!prv_readHeader(sName, sValue, echoNameLength, echoValueLength)) return res_fail;
+    sName  = local_cstr(sName);
+    sValue = local_cstr(sValue);
+    if (sName.empty()) break;
+    sEcho += "H " + sName + ": " + sValue + "\n";
+    if (!strcasecmp(sName.c_str(), "Content-Length"))
+      uBodyLength = static_cast<uint16_t>(atoi(sValue.c_str()));
+  }
+  if (!prv_readCRLF()) return res_fail;
+
+  std::string sBody;
+  if (!prv_skipBytes(uBodyLength, &sBody)) return res_fail;
+  sEcho += "B " + local_number(uBodyLength) + "\n" + sBody;
+  prv_respond(200, true, sEcho);
+  return res_ok;
+}
+
+HttpRef::result_e HttpRef::prv_upload()
+{
+  // Multipart/form-data: the content of the first part with a file name is
+  // written to "upload.txt"
+  std::string sName, sValue;
+  while (true)
+  {
+    if (!prv_readHeader(sName, sValue, local_maxFieldName, local_maxFieldValue)) { prv_respond(400); return res_fail; }
+    sName = local_cstr(sName);
+    if (sName.empty()) { prv_respond(400); return res_fail; }
+    if (!strcasecmp(sName.c_str(), "Content-Type")) break;
+  }
+  sValue = local_cstr(sValue);
+  if (sValue.find("multipart/form-data") == std::string::npos) { prv_respond(400); return res_fail; }
+
+  std::string::size_type start = sValue.find("boundary=");
+  if (start == std::string::npos) { prv_respond(400); return res_fail; }
+  start += 9;
+  std::string sDelimiters = "; ";
+  if ((start < sValue.size()) && (sValue[start] == '"')) { sDelimiters = "\""; ++start; }
+  std::string sBoundary = sValue.substr(start, sValue.find_first_of(sDelimiters, start) - start);
+  if (sBoundary.empty() || (sBoundary.size() > local_maxBoundary)) { prv_respond(400); return res_fail; }
+
+  if (!prv_skipHeaders()) { prv_respond(400); return res_fail; }
+
+  // Parts up to the one with a file name
+  while (true)
+  {
+    while (true)
+    {
+      std::string sLine = prv_readToEOL();
+      if (sLine.empty()) { prv_respond(400); return res_fail; }
+      if (local_isBoundary(sLine, sBoundary)) break;
+    }
+
+    bool bOk;
+    while ((bOk = prv_readHeader(sName, sValue, local_maxFieldName, local_maxFieldValue)))
+    {
+      sName = local_cstr(sName);
+      if (sName.empty()) break;
+      if (!strcasecmp(sName.c_str(), "Content-Disposition")) break;
+    }
+    if (!bOk) { prv_respond(400); return res_fail; }
+    if (sName.empty()) continue;
+
+    sValue = local_cstr(sValue);
+    start = sValue.find("filename=");
+    if (start != std::string::npos) break;
+  }
+  if (sValue.find('"', start) == std::string::npos) { prv_respond(400); return res_fail; }
+  if (!prv_skipHeaders() || !prv_readCRLF()) { prv_respond(400); return res_fail; }
+
+  // Data, up to the next boundary, replacing the previous file (if the name
+  // is not that of a directory)
+  static const char sUpload[] = "upload.txt";
+  if (my_dirs.count(sUpload)) { prv_respond(500); return res_fail; }
+  std::string& sData = my_files[sUpload];
+  sData.clear();
+  while (true)
+  {
+    std::string sLine = prv_readToEOL();
+    if (sLine.empty() || local_isBoundary(sLine, sBoundary)) break;
+    sData += sLine;
+  }
+  prv_respond(200, true, local_number(sData.size()));
+  return res_ok;
+}
+
+HttpRef::result_e HttpRef::prv_put(const std::string& the_path)
+{
+  // The body is written to the file at this path: 201 if it is new, 204 if
+  // it has been replaced
+  uint16_t uBodyLength;
+  prv_skipToBody(uBodyLength);
+  if ((my_contentLength < 0) && !my_chunked) { prv_respond(411); return res_fail; }
+  if (!local_isPlainPath(the_path)) { prv_respond(400); return res_fail; }
+
+  // The card holds files in existing directories only; the one of the file
+  // is created if nothing has this name (nor that of the file)
+  std::string sName   = the_path.substr(1);
+  std::string sParent = local_parent(sName);
+  bool bExisted = my_files.count(sName) || my_dirs.count(sName);
+  my_files.erase(sName);
+  bool bOpen = !my_dirs.count(sName) && my_dirs.count(sParent);
+  if (!bOpen && !bExisted && !sParent.empty() && !my_files.count(sParent))
+  {
+    for (std::string sDir = sParent; !sDir.empty(); sDir = local_parent(sDir))
+      my_dirs.insert(sDir);
+    bOpen = true;
+  }
+  if (!bOpen) { prv_respond(500); return res_fail; }
+
+  std::string sBody;
+  if (!prv_putBody(sBody)) { prv_respond(400); return res_fail; }
+  my_files[sName] = sBody;
+  prv_respond(bExisted ? 204 : 201);
+  return res_ok;
+}
+
+bool HttpRef::prv_putBody(std::string& the_body)
+{
+  if (!my_chunked) return prv_skipBytes(static_cast<uint32_t>(my_contentLength), &the_body);
+
+  // Chunks: size in hex and extensions up to CRLF, data, CRLF; the last one
+  // is empty, followed by trailers up to an empty line
+  static const char sHex[] = "0123456789abcdefABCDEF";
+  for (bool bFirst = true; true; bFirst = false)
+  {
+    if (!bFirst && !prv_readCRLF()) return false;
+    std::string::size_type end = my_in.find_first_not_of(sHex, my_pos);
+    size_t uDigits = ((end == std::string::npos) ? my_in.size() : end) - my_pos;
+    if (uDigits > 8) return false;
+    if (end == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+    if (!uDigits) return false;
+    uint32_t uSize = static_cast<uint32_t>(strtoul(my_in.substr(my_pos, uDigits).c_str(), 0, 16));
+
+    std::string::size_type eol = my_in.find_first_of("\r\n", end);
+    if (eol == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+    my_pos = eol;
+    if (!uSize) break;
+
+    std::string sChunk;
+    if (!prv_readCRLF() || !prv_skipBytes(uSize, &sChunk)) return false;
+    the_body += sChunk;
+  }
+
+  // Trailers, whole lines of any length
+  while (true)
+  {
+    if (!prv_readCRLF() || prv_atEnd()) return false;
+    if (my_in[my_pos] == '\r') return prv_readCRLF();
+    std::string::size_type eol = my_in.find_first_of("\r\n", my_pos);
+    if (eol == std::string::npos) { my_pos = my_in.size(); my_eod = true; return false; }
+    my_pos = eol;
+  }
+}
+
+HttpRef::result_e HttpRef::prv_delete(const std::string& the_path)
+{
+  // The file at this path is removed (204); directories are not (403)
+  uint16_t uBodyLength;
+  prv_skipToBody(uBodyLength);
+  if (!prv_skipBytes(uBodyLength, 0)) { prv_respond(400); return res_fail; }
+  if (!local_isPlainPath(the_path)) { prv_respond(400); return res_fail; }
+
+  std::string sName = the_path.substr(1);
+  if (!my_files.count(sName) && !my_dirs.count(sName)) { prv_respond(404); return res_fail; }
+  if (!my_files.erase(sName)) { prv_respond(403); return res_fail; }
+  prv_respond(204);
+  return res_ok;
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpRef.h - Reference model of HttpSvr request parsing, for differential
+//              testing
+//
+//  ----------------------
+//
+//  HttpRef predicts, from the bytes sent by a client on one connection, the
+//  responses HttpSvr sends back, as HttpFuzz.cpp sets it up: "/echo" bound to
+//  a provider that writes back what it was given, uploads and PUT written to
+//  the SD card, DELETE removing from it, nothing else. It is written from the documented behavior of HttpSvr
+//  (comments of HttpSvr.h and HttpSvr.cpp, RFC 2616 where they refer to it),
+//  on whole strings rather than on a byte stream, so that it does not share
+//  the mistakes of the code it checks.
+//
+//  The rules it follows, beyond plain HTTP/1.1:
+//    * request line: method and URL end at SP, CR or LF; methods longer than
+//      7 chars are unknown (400); URLs longer than the URL buffer get 414
+//    * headers: lines starting with SP or HT are skipped; names longer than
+//      the buffer make the request fail, values are truncated; only CRLF ends
+//      a line
+//    * query: name=value pairs after the first '?', up to the next '?' or '#',
+//      each truncated to its buffer; '&' alone gives an empty pair
+//    * multipart: the boundary comes from the Content-Type header (1 to 70
+//      chars, may be quoted), data are read in lines of at most 255 chars
+//    * PUT: the body is sized by Content-Length or in chunks (at most 8 hex
+//      digits, trailer lines skipped whole); a file not written completely
+//      is removed, and a missing directory is created
+//  Once the server has tried to read past the end of the data (i.e. it waits
+//  for more, until the client closes), nothing else can be sent back. Where
+//  the server goes where this model does not follow (files on the SD card),
+//  the prediction stops: responses up to there must match, the following ones
+//  must only be well formed.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HTTPREF_H
+#define HTTPREF_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class HttpRef
+{
+public:
+  // Buffers of the "/echo" provider, smaller than those of the server so
+  // that truncation is exercised
+  static const uint16_t echoNameLength      = 32;
+  static const uint16_t echoValueLength     = 24;
+  static const uint16_t echoQueryNameLength = 8;
+  static const uint16_t echoQueryValueLength= 12;
+  static const uint8_t  echoMaxPairs        = 64;
+
+  struct response_t
+  {
+    int          status;
+    bool         checkBody;   // Otherwise, the body is not predicted
+    std::string  body;
+  };
+
+public:
+  explicit HttpRef(const std::string& the_input);
+
+  typedef std::map<std::string, std::string> files_t;  // Paths without the leading '/'
+
+  const std::vector<response_t>& responses() const { return my_responses; }
+  bool                complete            () const { return my_complete; }
+  const files_t&      files               () const { return my_files;    }
+
+private:
+  enum result_e { res_ok, res_fail, res_stop };
+
+  bool                prv_atEnd           ();
+  bool                prv_readCRLF        ();
+  bool                prv_readHeader      (std::string& the_name, std::string& the_value, uint16_t the_nameLen, uint16_t the_valueLen);
+  bool                prv_skipHeaders     ();
+  bool                prv_skipToBody      (uint16_t& the_bodyLength);
+  bool                prv_skipBytes       (uint32_t the_count, std::string * the_bytes);
+  std::string         prv_readToEOL       ();
+
+  result_e            prv_request         ();
+  result_e            prv_echo            (const std::string& the_method, const std::string& the_url);
+  result_e            prv_upload          ();
+  result_e            prv_put             (const std::string& the_path);
+  bool                prv_putBody         (std::string& the_body);
+  result_e            prv_delete          (const std::string& the_path);
+  void                prv_respond         (int the_status, bool the_checkBody = false, const std::string& the_body = std::string());
+
+private:
+  std::string              my_in;
+  size_t                   my_pos;
+  bool                     my_eod;        // The server has read past the end of the data
+  std::vector<response_t>  my_responses;
+  bool                     my_complete;
+  int32_t                  my_contentLength;  // As kept by the last prv_skipToBody
+  bool                     my_chunked;
+  files_t                  my_files;      // Content of the SD card
+  std::set<std::string>    my_dirs;       // The root is ""
+};
+
+#endif // #ifndef HTTPREF_H
@@ -0,0 +1,50 @@
+#!/bin/sh
+################################################################################
+#
+#  build.sh - Builds the HttpSvr fuzz harness on a Linux host
+#
+#  ----------------------
+#
+#  Run from anywhere; the binaries are written to the current directory:
+#    httpfuzz       g++ or clang++, ASan + UBSan, standalone runner
+#    httpfuzz-lf    clang++ -fsanitize=fuzzer (if clang++ is found)
+#    httpfuzz-afl   afl-clang-fast++ (if found); run with
+#                   afl-fuzz -i extras/fuzz/corpus -x extras/fuzz/http.dict -o out -- ./httpfuzz-afl -
+#  Then, e.g.:
+#    ./httpfuzz extras/fuzz/corpus -runs=100000
+#    ./httpfuzz-lf -dict=extras/fuzz/http.dict extras/fuzz/corpus
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+
+# The library, less the SPI driver the emulation replaces
+SOURCES=""
+for f in "$ROOT"/*.cpp "$ROOT"/utility/*.cpp "$ROOT"/extras/host/*.cpp "$ROOT"/extras/fuzz/*.cpp; do
+  [ "$(basename "$f")" = "W5100Spi.cpp" ] || SOURCES="$SOURCES $f"
+done
+FLAGS="-std=gnu++98 -g -O1 -fno-omit-frame-pointer -DHTTPSVR_BACKEND=0 -DHTTPSVR_PUT=1 \
+  -I$ROOT/extras/host -I$ROOT -I$ROOT/utility -I$ROOT/extras/fuzz $CXXFLAGS"
+SANITIZERS="-fsanitize=address,undefined -fno-sanitize-recover=undefined"
+
+CXX=${CXX:-g++}
+$CXX $FLAGS $SANITIZERS $SOURCES -o httpfuzz
+echo "built httpfuzz"
+
+if command -v clang++ >/dev/null 2>&1; then
+  clang++ $FLAGS $SANITIZERS,fuzzer -DHTTPFUZZ_LIBFUZZER $SOURCES -o httpfuzz-lf
+  echo "built httpfuzz-lf"
+fi
+
+if command -v afl-clang-fast++ >/dev/null 2>&1; then
+  afl-clang-fast++ $FLAGS $SOURCES -o httpfuzz-afl
+  echo "built httpfuzz-afl"
+fi
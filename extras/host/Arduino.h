@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Arduino.h - Arduino core for host builds of HttpSvr
+//
+//  ----------------------
+//
+//  The part of the Arduino core used by HttpSvr, so that the library can be
+//  built and run on a PC (see extras/fuzz and extras/tools/loadgen). Time is
+//  taken from HostClock (see HostClock.h), pins do nothing, and analog inputs
+//  read 512. Serial writes to stderr.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <avr/pgmspace.h>
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define LSBFIRST      0
+#define MSBFIRST      1
+
+#define NUM_DIGITAL_PINS  20
+#define NUM_ANALOG_INPUTS 6
+#define A0                14
+
+#define _BV(bit) (1 << (bit))
+
+// Port registers written by the chip select code of W5100Spi
+extern volatile uint8_t DDRB, PORTB;
+
+unsigned long millis            ();
+unsigned long micros            ();
+void          delay             (unsigned long the_ms);
+void          delayMicroseconds (unsigned int the_us);
+
+void          pinMode           (uint8_t the_pin, uint8_t the_mode);
+void          digitalWrite      (uint8_t the_pin, uint8_t the_value);
+int           digitalRead       (uint8_t the_pin);
+int           analogRead        (uint8_t the_pin);
+void          analogWrite       (uint8_t the_pin, int the_value);
+
+inline void   interrupts        () {}
+inline void   noInterrupts      () {}
+
+char *        itoa              (int the_value, char * the_buffer, int the_radix);
+char *        ltoa              (long the_value, char * the_buffer, int the_radix);
+char *        ultoa             (unsigned long the_value, char * the_buffer, int the_radix);
+
+////////////////////////////////////////////////////////////////////////////////
+// Strings in flash memory are plain strings on the host
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+
+////////////////////////////////////////////////////////////////////////////////
+
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t the_byte) = 0;
+  virtual size_t write(const uint8_t * the_buffer, size_t the_size);
+
+  size_t         print  (const char * the_s);
+  size_t         print  (const __FlashStringHelper * the_s);
+  size_t         print  (char the_ch);
+  size_t         print  (int the_value, int the_radix = 10);
+  size_t         print  (unsigned int the_value, int the_radix = 10);
+  size_t         print  (long the_value, int the_radix = 10);
+  size_t         print  (unsigned long the_value, int the_radix = 10);
+  size_t         println();
+  size_t         println(const char * the_s);
+  size_t         println(const __FlashStringHelper * the_s);
+  size_t         println(unsigned long the_value, int the_radix = 10);
+};
+
+class Stream : public Print
+{
+public:
+  virtual int  available() = 0;
+  virtual int  read     () = 0;
+  virtual int  peek     () = 0;
+  virtual void flush    () = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+  void   begin    (unsigned long the_baud);
+  size_t write    (uint8_t the_byte);
+  int    available();
+  int    read     ();
+  int    peek     ();
+  void   flush    ();
+
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif // #ifndef ARDUINO_H
@@ -0,0 +1,201 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  Host.cpp - Arduino core and clock for host builds of HttpSvr
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <stdio.h>
+#include <time.h>
+#include "HostClock.h"
+
+volatile uint8_t DDRB  = 0;
+volatile uint8_t PORTB = 0;
+
+HardwareSerial Serial;
+SPIClass       SPI;
+
+////////////////////////////////////////////////////////////////////////////////
+// Clock
+
+bool                  HostClock::smy_virtual  = false;
+uint64_t              HostClock::smy_us       = 0;
+HostClock::listener_t HostClock::smy_listener = 0;
+
+static uint64_t local_realUs()
+{
+  static uint64_t uStart = 0;
+  timespec aTime;
+  clock_gettime(CLOCK_MONOTONIC, &aTime);
+  uint64_t uNow = static_cast<uint64_t>(aTime.tv_sec) * 1000000 + aTime.tv_nsec / 1000;
+  if (!uStart) uStart = uNow;
+  return uNow - uStart;
+}
+
+void HostClock::useVirtualTime(listener_t the_listener)
+{
+  smy_virtual  = true;
+  smy_us       = 0;
+  smy_listener = the_listener;
+}
+
+uint64_t HostClock::now()
+{ return smy_virtual ? smy_us : local_realUs(); }
+
+void HostClock::advance(uint64_t the_us)
+{
+  if (!smy_virtual)
+  {
+    timespec aTime;
+    aTime.tv_sec  = the_us / 1000000;
+    aTime.tv_nsec = (the_us % 1000000) * 1000;
+    nanosleep(&aTime, 0);
+    return;
+  }
+
+  smy_us += the_us;
+  if (smy_listener) smy_listener(smy_us);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Time
+
+unsigned long millis()
+{ return static_cast<unsigned long>(HostClock::now() / 1000); }
+
+unsigned long micros()
+{ return static_cast<unsigned long>(HostClock::now()); }
+
+void delay(unsigned long the_ms)
+{ HostClock::advance(static_cast<uint64_t>(the_ms) * 1000); }
+
+void delayMicroseconds(unsigned int the_us)
+{ HostClock::advance(the_us); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Pins
+
+void pinMode(uint8_t, uint8_t)
+{}
+
+void digitalWrite(uint8_t, uint8_t)
+{}
+
+int digitalRead(uint8_t)
+{ return LOW; }
+
+int analogRead(uint8_t)
+{ return 512; }
+
+void analogWrite(uint8_t, int)
+{}
+
+////////////////////////////////////////////////////////////////////////////////
+// Number conversions of avr-libc
+
+static char * local_toString(unsigned long the_value, bool the_negative, char * the_buffer, int the_radix)
+{
+  if ((the_radix < 2) || (the_radix > 36)) { the_buffer[0] = 0; return the_buffer; }
+
+  char sDigits[33];
+  int  n = 0;
+  do
+  {
+    int iDigit = the_value % the_radix;
+    sDigits[n++] = static_cast<char>(iDigit < 10 ? '0' + iDigit : 'a' + iDigit - 10);
+    the_value /= the_radix;
+  }
+  while (the_value);
+
+  char * p = the_buffer;
+  if (the_negative) *p++ = '-';
+  while (n) *p++ = sDigits[--n];
+  *p = 0;
+  return the_buffer;
+}
+
+char * itoa(int the_value, char * the_buffer, int the_radix)
+{ return ltoa(the_value, the_buffer, the_radix); }
+
+char * ltoa(long the_value, char * the_buffer, int the_radix)
+{
+  // As in avr-libc, only radix 10 has a sign
+  if ((the_radix == 10) && (the_value < 0))
+    return local_toString(0UL - static_cast<unsigned long>(the_value), true, the_buffer, 10);
+  return local_toString(static_cast<unsigned long>(the_value), false, the_buffer, the_radix);
+}
+
+char * ultoa(unsigned long the_value, char * the_buffer, int the_radix)
+{ return local_toString(the_value, false, the_buffer, the_radix); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Print
+
+size_t Print::write(const uint8_t * the_buffer, size_t the_size)
+{
+  size_t n = 0;
+  while (the_size--) n += write(*the_buffer++);
+  return n;
+}
+
+size_t Print::print(const char * the_s)
+{ return write(reinterpret_cast<const uint8_t *>(the_s), strlen(the_s)); }
+
+size_t Print::print(const __FlashStringHelper * the_s)
+{ return print(reinterpret_cast<const char *>(the_s)); }
+
+size_t Print::print(char the_ch)
+{ return write(static_cast<uint8_t>(the_ch)); }
+
+size_t Print::print(int the_value, int the_radix)
+{ return print(static_cast<long>(the_value), the_radix); }
+
+size_t Print::print(unsigned int the_value, int the_radix)
+{ return print(static_cast<unsigned long>(the_value), the_radix); }
+
+size_t Print::print(long the_value, int the_radix)
+{ char sBuffer[34]; return print(ltoa(the_value, sBuffer, the_radix)); }
+
+size_t Print::print(unsigned long the_value, int the_radix)
+{ char sBuffer[34]; return print(ultoa(the_value, sBuffer, the_radix)); }
+
+size_t Print::println()
+{ return print("\r\n"); }
+
+size_t Print::println(const char * the_s)
+{ return print(the_s) + println(); }
+
+size_t Print::println(const __FlashStringHelper * the_s)
+{ return print(the_s) + println(); }
+
+size_t Print::println(unsigned long the_value, int the_radix)
+{ return print(the_value, the_radix) + println(); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Serial
+
+void HardwareSerial::begin(unsigned long)
+{}
+
+size_t HardwareSerial::write(uint8_t the_byte)
+{ return (fputc(the_byte, stderr) != EOF) ? 1 : 0; }
+
+int HardwareSerial::available()
+{ return 0; }
+
+int HardwareSerial::read()
+{ return -1; }
+
+int HardwareSerial::peek()
+{ return -1; }
+
+void HardwareSerial::flush()
+{ fflush(stderr); }
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HostClock.h - Time source of host builds of HttpSvr
+//
+//  ----------------------
+//
+//  millis, micros and delay of host builds read this clock. It runs in real
+//  time until "useVirtualTime" is called; virtual time then only moves when
+//  it is advanced, either explicitly or by the simulated hardware (each
+//  access to the emulated W5100 costs the time of an SPI frame), so that a
+//  run depends only on its inputs and not on the speed of the host.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOSTCLOCK_H
+#define HOSTCLOCK_H
+
+#include <stdint.h>
+
+class HostClock
+{
+public:
+  // Called each time virtual time has been advanced, e.g. to run the events
+  // of a simulation that are due
+  typedef void (*listener_t)(uint64_t the_us);
+
+  static void         useVirtualTime      (listener_t the_listener = 0);
+  static bool         isVirtual           () { return smy_virtual; }
+
+  // Microseconds since startup (real time) or since useVirtualTime
+  static uint64_t     now                 ();
+
+  // Moves virtual time forward; in real time, sleeps
+  static void         advance             (uint64_t the_us);
+
+private:
+  static bool         smy_virtual;
+  static uint64_t     smy_us;
+  static listener_t   smy_listener;
+
+private:
+  HostClock(); // An object of this class cannot be instantiated
+};
+
+#endif // #ifndef HOSTCLOCK_H
@@ -0,0 +1,36 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  IPAddress.h - IPv4 address for host builds of HttpSvr
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef IPADDRESS_H
+#define IPADDRESS_H
+
+#include <stdint.h>
+
+class IPAddress
+{
+public:
+  IPAddress()
+  { my_addr[0] = my_addr[1] = my_addr[2] = my_addr[3] = 0; }
+
+  IPAddress(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3)
+  { my_addr[0] = ip0; my_addr[1] = ip1; my_addr[2] = ip2; my_addr[3] = ip3; }
+
+  uint8_t operator[](int the_idx) const { return my_addr[the_idx]; }
+
+  const uint8_t * raw_address() const { return my_addr; }
+
+private:
+  uint8_t my_addr[4];
+};
+
+#endif // #ifndef IPADDRESS_H
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  SD.cpp - SD card library for host builds of HttpSvr
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "SD.h"
+
+SDClass SD;
+
+////////////////////////////////////////////////////////////////////////////////
+// Files
+//
+// A File only holds the path of what it refers to: data are looked up on each
+// access, so that a file removed while open just reads as empty.
+
+File::File()
+: my_dir(false), my_writable(false), my_pos(0)
+{ my_name[0] = 0; }
+
+File::operator bool() const
+{ return !my_path.empty() || my_dir; }
+
+size_t File::write(uint8_t the_byte)
+{ return write(&the_byte, 1); }
+
+size_t File::write(const uint8_t * the_buffer, size_t the_size)
+{
+  if (!my_writable) return 0;
+  SDClass::files_t::iterator it = SD.my_files.find(my_path);
+  if (it == SD.my_files.end()) return 0;
+
+  std::vector<uint8_t>& data = it->second;
+  if (data.size() < my_pos + the_size) data.resize(my_pos + the_size);
+  memcpy(&data[my_pos], the_buffer, the_size);
+  my_pos += the_size;
+  return the_size;
+}
+
+int File::read()
+{
+  uint8_t ch;
+  return (read(&ch, 1) == 1) ? ch : -1;
+}
+
+int File::read(void * the_buffer, uint16_t the_size)
+{
+  if (my_dir) return -1;
+  SDClass::files_t::const_iterator it = SD.my_files.find(my_path);
+  if (it == SD.my_files.end()) return -1;
+
+  const std::vector<uint8_t>& data = it->second;
+  uint32_t uLeft = (my_pos < data.size()) ? data.size() - my_pos : 0;
+  uint16_t uRead = (uLeft < the_size) ? uLeft : the_size;
+  if (uRead) memcpy(the_buffer, &data[my_pos], uRead);
+  my_pos += uRead;
+  return uRead;
+}
+
+int File::peek()
+{
+  int ch = read();
+  if (ch >= 0) --my_pos;
+  return ch;
+}
+
+int File::available()
+{
+  uint32_t uSize = size();
+  return (my_pos < uSize) ? uSize - my_pos : 0;
+}
+
+void File::flush()
+{}
+
+bool File::seek(uint32_t the_pos)
+{
+  if (my_dir || (the_pos > size())) return false;
+  my_pos = the_pos;
+  return true;
+}
+
+uint32_t File::position()
+{ return my_pos; }
+
+uint32_t File::size()
+{
+  if (my_dir) return 0;
+  SDClass::files_t::const_iterator it = SD.my_files.find(my_path);
+  return (it == SD.my_files.end()) ? 0 : it->second.size();
+}
+
+void File::close()
+{
+  my_path.clear();
+  my_name[0]  = 0;
+  my_dir      = false;
+  my_writable = false;
+  my_pos      = 0;
+}
+
+char * File::name()
+{ return my_name; }
+
+bool File::isDirectory()
+{ return my_dir; }
+
+File File::openNextFile(uint8_t the_mode)
+{
+  // Entries are reported in alphabetical order, directories first
+  File aFile;
+  if (!my_dir) return aFile;
+
+  std::vector<std::string> entries;
+  for (std::set<std::string>::const_iterator it = SD.my_dirs.begin(); it != SD.my_dirs.end(); ++it)
+    if (!it->empty() && (SDClass::prv_parent(*it) == my_path)) entries.push_back(*it);
+  for (SDClass::files_t::const_iterator it = SD.my_files.begin(); it != SD.my_files.end(); ++it)
+    if (SDClass::prv_parent(it->first) == my_path) entries.push_back(it->first);
+
+  if (my_pos >= entries.size()) return aFile;
+  return SD.open(entries[my_pos++].c_str(), the_mode);
+}
+
+void File::rewindDirectory()
+{ my_pos = 0; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Card
+
+bool SDClass::begin(uint8_t /*the_csPin*/)
+{
+  my_dirs.insert("");
+  return true;
+}
+
+File SDClass::open(const char * the_path, uint8_t the_mode)
+{
+  File aFile;
+  std::string sPath = prv_normalize(the_path);
+
+  if (my_dirs.count(sPath))
+  {
+    if (the_mode != FILE_READ) return aFile;
+    aFile.my_dir = true;
+  }
+  else if (!my_files.count(sPath))
+  {
+    // Files are created in existing directories only, as on a FAT card
+    if ((the_mode == FILE_READ) || !my_dirs.count(prv_parent(sPath))) return aFile;
+    my_files[sPath];
+  }
+
+  aFile.my_path     = sPath;
+  aFile.my_writable = (the_mode != FILE_READ) && !aFile.my_dir;
+  aFile.my_pos      = aFile.my_writable ? my_files[sPath].size() : 0;
+
+  std::string sName = sPath.substr(sPath.rfind('/') + 1);
+  strncpy(aFile.my_name, sName.c_str(), sizeof(aFile.my_name) - 1);
+  aFile.my_name[sizeof(aFile.my_name) - 1] = 0;
+  return aFile;
+}
+
+bool SDClass::exists(const char * the_path)
+{
+  std::string sPath = prv_normalize(the_path);
+  return my_files.count(sPath) || my_dirs.count(sPath);
+}
+
+bool SDClass::remove(const char * the_path)
+{ return my_files.erase(prv_normalize(the_path)) != 0; }
+
+bool SDClass::mkdir(const char * the_path)
+{
+  std::string sPath = prv_normalize(the_path);
+  if (sPath.empty() || my_files.count(sPath)) return false;
+  prv_mkdirs(sPath);
+  return true;
+}
+
+bool SDClass::rmdir(const char * the_path)
+{
+  std::string sPath = prv_normalize(the_path);
+  if (sPath.empty()) return false;
+  for (files_t::const_iterator it = my_files.begin(); it != my_files.end(); ++it)
+    if (prv_parent(it->first) == sPath) return false;
+  for (std::set<std::string>::const_iterator it = my_dirs.begin(); it != my_dirs.end(); ++it)
+    if (!it->empty() && (prv_parent(*it) == sPath)) return false;
+  return my_dirs.erase(sPath) != 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Host side
+
+void SDClass::putFile(const char * the_path, const void * the_data, size_t the_size)
+{
+  std::string sPath = prv_normalize(the_path);
+  prv_mkdirs(prv_parent(sPath));
+  const uint8_t * pData = static_cast<const uint8_t *>(the_data);
+  my_files[sPath].assign(pData, pData + the_size);
+}
+
+const std::vector<uint8_t> * SDClass::fileData(const char * the_path) const
+{
+  files_t::const_iterator it = my_files.find(prv_normalize(the_path));
+  return (it == my_files.end()) ? 0 : &it->second;
+}
+
+size_t SDClass::fileCount() const
+{ return my_files.size(); }
+
+void SDClass::clear()
+{
+  my_files.clear();
+  my_dirs.clear();
+  my_dirs.insert("");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+std::string SDClass::prv_normalize(const char * the_path)
+{
+  // "/dir/name/" and "dir/name" are both "dir/name"
+  std::string sPath(the_path ? the_path : "");
+  while (!sPath.empty() && (sPath[0] == '/')) sPath.erase(0, 1);
+  while (!sPath.empty() && (sPath[sPath.size() - 1] == '/')) sPath.erase(sPath.size() - 1);
+  return sPath;
+}
+
+std::string SDClass::prv_parent(const std::string& the_path)
+{
+  std::string::size_type pos = the_path.rfind('/');
+  return (pos == std::string::npos) ? std::string() : the_path.substr(0, pos);
+}
+
+void SDClass::prv_mkdirs(const std::string& the_path)
+{
+  for (std::string sDir = the_path; !sDir.empty(); sDir = prv_parent(sDir))
+    my_dirs.insert(sDir);
+  my_dirs.insert("");
+}
@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  SD.h - SD card library for host builds of HttpSvr
+//
+//  ----------------------
+//
+//  The card is a set of files and directories in memory, with the interface
+//  of the Arduino SD library used by HttpSvr. Host programs fill it before
+//  starting the server, and read back what the server has written:
+//      SD.putFile("/index.htm", sPage, strlen(sPage));
+//      ...
+//      const std::vector<uint8_t> * pData = SD.fileData("/upload.txt");
+//  Paths are case sensitive and always taken from the root; a leading '/'
+//  is optional.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SD_H
+#define SD_H
+
+#include <Arduino.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#define FILE_READ  0x01
+#define FILE_WRITE 0x13
+
+////////////////////////////////////////////////////////////////////////////////
+
+class File : public Stream
+{
+public:
+  File();
+
+  operator bool () const;
+
+  size_t   write          (uint8_t the_byte);
+  size_t   write          (const uint8_t * the_buffer, size_t the_size);
+  int      read           ();
+  int      read           (void * the_buffer, uint16_t the_size);
+  int      peek           ();
+  int      available      ();
+  void     flush          ();
+  bool     seek           (uint32_t the_pos);
+  uint32_t position       ();
+  uint32_t size           ();
+  void     close          ();
+  char *   name           ();
+  bool     isDirectory    ();
+  File     openNextFile   (uint8_t the_mode = FILE_READ);
+  void     rewindDirectory();
+
+  using Print::write;
+
+private:
+  friend class SDClass;
+
+  std::string my_path;      // Empty if the file is not open
+  char        my_name[13];  // Last component of the path, as reported by "name"
+  bool        my_dir;
+  bool        my_writable;
+  uint32_t    my_pos;       // Position in a file, or index of the next entry of a directory
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+class SDClass
+{
+public:
+  bool     begin          (uint8_t the_csPin);
+  File     open           (const char * the_path, uint8_t the_mode = FILE_READ);
+  bool     exists         (const char * the_path);
+  bool     remove         (const char * the_path);
+  bool     mkdir          (const char * the_path);
+  bool     rmdir          (const char * the_path);
+
+public:
+  // Host side: content of the card
+  void     putFile        (const char * the_path, const void * the_data, size_t the_size);
+  const std::vector<uint8_t> * fileData(const char * the_path) const;
+  size_t   fileCount      () const;
+  void     clear          ();
+
+private:
+  friend class File;
+  typedef std::map<std::string, std::vector<uint8_t> > files_t;
+
+  static std::string prv_normalize(const char * the_path);
+  static std::string prv_parent   (const std::string& the_path);
+  void               prv_mkdirs   (const std::string& the_path);
+
+  files_t               my_files;
+  std::set<std::string> my_dirs;     // The root is ""
+};
+
+extern SDClass SD;
+
+#endif // #ifndef SD_H
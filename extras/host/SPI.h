@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  SPI.h - SPI library for host builds of HttpSvr
+//
+//  ----------------------
+//
+//  Only declared: host builds replace the SPI transport of the W5100 driver
+//  with W5100Emu, and use an SD card in memory (see SD.h), so nothing is ever
+//  sent on this bus.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+#define SPI_HAS_TRANSACTION 1
+
+#define SPI_MODE0       0x00
+#define SPI_MODE1       0x04
+#define SPI_MODE2       0x08
+#define SPI_MODE3       0x0C
+#define SPI_CLOCK_DIV2  0x04
+
+class SPISettings
+{
+public:
+  SPISettings() {}
+  SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+class SPIClass
+{
+public:
+  static void    begin           () {}
+  static void    end             () {}
+  static void    beginTransaction(SPISettings) {}
+  static void    endTransaction  () {}
+  static uint8_t transfer        (uint8_t) { return 0; }
+  static void    setBitOrder     (uint8_t) {}
+  static void    setDataMode     (uint8_t) {}
+  static void    setClockDivider (uint8_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif // #ifndef SPI_H
@@ -0,0 +1,769 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5100Emu.cpp - Emulation of the W5100 and of the network behind it
+//
+//  ----------------------
+//
+//  Definition of W5100Spi (see utility/W5100Spi.h) on emulated registers and
+//  memory, and of the emulation itself (see W5100Emu.h).
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+#include "W5100Emu.h"
+#include "HostClock.h"
+#include "utility/W5100Spi.h"
+#include "utility/W5100Defs.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Parameters of the emulated TCP
+
+static const uint8_t  local_sockets     = 4;
+static const uint16_t local_mss         = 1460;       // Segment size on Ethernet
+static const uint32_t local_rtoUs       = 200000;     // Initial retransmission time, both sides
+static const uint8_t  local_maxRetries  = 8;          // RCR of the W5100 after reset
+static const uint8_t  local_synRetries  = 5;          // SYNs sent again by a peer without answer
+static const uint64_t local_never       = ~static_cast<uint64_t>(0);
+
+////////////////////////////////////////////////////////////////////////////////
+// State of the emulation
+
+namespace
+{
+  // A connection, from the SYN of its peer until both sides are done with it
+  struct conn_s
+  {
+    W5100Emu::peer_t *   peer;
+    W5100Emu::link_t     link;
+    uint16_t             port;
+    uint16_t             peerPort;
+    uint8_t              peerIp[4];
+    int8_t               sn;            // Socket holding the connection; -1 if none
+    uint32_t             gen;           // Generation of the socket when it took the connection
+    uint8_t              synTries;
+    bool                 established;
+    bool                 vanished;
+    bool                 finAtChip;     // The FIN of the peer has reached the W5100
+    bool                 closedToPeer;  // The peer has been told the connection is over
+    uint64_t             closedAt;      // When the W5100 closed the socket
+    uint64_t             linkFree;      // End of the last transmission towards the peer
+    uint64_t             lastToChip;    // Arrival of the last segment sent by the peer
+    uint32_t             peerSent;      // Bytes sent by the peer
+    std::deque<uint8_t>  heldBack;      // Received, waiting for room in rx memory
+    uint32_t             peerSeq;       // Next byte expected by the peer
+    std::map<uint32_t, std::vector<uint8_t> > outOfOrder;
+  };
+
+  // A socket of the W5100, beyond its plain registers
+  struct socket_s
+  {
+    uint8_t              sr;
+    uint8_t              ir;
+    W5100Emu::conn_t     conn;
+    uint32_t             gen;           // Incremented when the socket leaves a connection
+    uint32_t             sendSeq;       // End of data passed to SEND
+    uint32_t             ackSeq;        // End of data acknowledged by the peer
+    uint32_t             sendEnd;       // End of the SEND in flight
+    bool                 sendBusy;
+    uint32_t             rxWr;          // End of data written to rx memory
+    uint32_t             rxRd;          // Sn_RX_RD at the last RECV
+  };
+
+  enum event_e
+  {
+    ev_timer,
+    ev_synToChip,
+    ev_synAckToPeer,
+    ev_rstToPeer,
+    ev_synRetry,
+    ev_dataToChip,
+    ev_finToChip,
+    ev_dataToPeer,
+    ev_ackToChip,
+    ev_resend,
+    ev_closedToPeer,
+    ev_finWaitDone
+  };
+
+  struct event_s
+  {
+    event_e              type;
+    W5100Emu::conn_t     conn;
+    uint32_t             gen;
+    uint32_t             seq;
+    uint8_t              tries;
+    uint64_t             txStart;
+    std::vector<uint8_t> data;
+    W5100Emu::peer_t *   peer;
+    uint32_t             cookie;
+  };
+
+  typedef std::pair<uint64_t, uint64_t>   eventKey_t;   // Time, then order of scheduling
+  typedef std::map<eventKey_t, event_s>   events_t;
+  typedef std::map<W5100Emu::conn_t, conn_s> conns_t;
+}
+
+static uint8_t          local_mem[0x8000];
+static socket_s         local_sockets_[local_sockets];
+static conns_t          local_conns;
+static events_t         local_events;
+static uint64_t         local_eventOrder   = 0;
+static W5100Emu::conn_t local_nextConn     = 1;
+static uint16_t         local_nextPeerPort = 49152;
+static uint32_t         local_random       = 1;
+static uint32_t         local_frameNs      = 5000;
+static uint32_t         local_pendingNs    = 0;
+static bool             local_refuseSyn    = true;
+static bool             local_running      = false;
+
+////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+static uint32_t local_rand()
+{
+  // xorshift32: the same sequence on every host
+  local_random ^= local_random << 13;
+  local_random ^= local_random >> 17;
+  local_random ^= local_random << 5;
+  return local_random;
+}
+
+static bool local_lost(const conn_s& the_conn)
+{
+  if (the_conn.vanished) return true;
+  return the_conn.link.lossPerMillion && ((local_rand() % 1000000) < the_conn.link.lossPerMillion);
+}
+
+static uint64_t local_halfRtt(const conn_s& the_conn)
+{ return the_conn.link.rttUs / 2; }
+
+static uint64_t local_rto(uint8_t the_tries)
+{ return static_cast<uint64_t>(local_rtoUs) << (the_tries > 6 ? 6 : the_tries); }
+
+static event_s& local_schedule(uint64_t the_atUs, event_e the_type, W5100Emu::conn_t the_conn)
+{
+  event_s& ev = local_events[eventKey_t(the_atUs, local_eventOrder++)];
+  ev.type    = the_type;
+  ev.conn    = the_conn;
+  ev.gen     = 0;
+  ev.seq     = 0;
+  ev.tries   = 0;
+  ev.txStart = 0;
+  ev.peer    = 0;
+  ev.cookie  = 0;
+  return ev;
+}
+
+static uint16_t local_memSize(uint16_t the_msr, uint8_t the_sn)
+{ return 0x0400 << ((local_mem[the_msr] >> (2 * the_sn)) & 0x03); }
+
+static uint16_t local_memBase(uint16_t the_base, uint16_t the_msr, uint8_t the_sn)
+{
+  uint16_t uBase = the_base;
+  for (uint8_t sn = 0; sn < the_sn; ++sn) uBase += local_memSize(the_msr, sn);
+  return uBase;
+}
+
+static uint16_t local_snReg16(uint8_t the_sn, uint8_t the_off)
+{
+  uint16_t uAddr = W5100_S0_MASK + (the_sn << 8) + the_off;
+  return (local_mem[uAddr] << 8) | local_mem[uAddr + 1];
+}
+
+static void local_setSnReg16(uint8_t the_sn, uint8_t the_off, uint16_t the_value)
+{
+  uint16_t uAddr = W5100_S0_MASK + (the_sn << 8) + the_off;
+  local_mem[uAddr]     = the_value >> 8;
+  local_mem[uAddr + 1] = the_value & 0xFF;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Connections
+
+static void local_notifyClosed(conn_s& the_conn, W5100Emu::conn_t the_id, uint64_t the_atUs)
+{
+  if (the_conn.vanished || the_conn.closedToPeer) return;
+  the_conn.closedToPeer = true;
+  local_schedule(the_atUs, ev_closedToPeer, the_id);
+}
+
+static void local_detach(uint8_t the_sn, uint8_t the_status)
+{
+  // The socket leaves its connection: whatever is still in flight for it is dropped
+  socket_s& sock = local_sockets_[the_sn];
+  if (sock.conn)
+  {
+    conn_s& conn = local_conns[sock.conn];
+    conn.closedAt = W5100Emu::now();
+    conn.sn       = -1;
+    local_notifyClosed(conn, sock.conn, W5100Emu::now() + local_halfRtt(conn));
+  }
+  sock.conn     = 0;
+  sock.sr       = the_status;
+  sock.sendBusy = false;
+  ++sock.gen;
+}
+
+static void local_fillRx(uint8_t the_sn)
+{
+  // Moves data held back into rx memory, as far as there is room
+  socket_s& sock = local_sockets_[the_sn];
+  if (!sock.conn) return;
+  conn_s& conn = local_conns[sock.conn];
+
+  uint16_t uSize  = local_memSize(W5100_RMSR, the_sn);
+  uint16_t uBase  = local_memBase(W5100_MEM_RX_BASE, W5100_RMSR, the_sn);
+  uint32_t uRoom  = uSize - (sock.rxWr - sock.rxRd);
+  uint32_t uMoved = 0;
+  while (uRoom && !conn.heldBack.empty())
+  {
+    local_mem[uBase + (sock.rxWr & (uSize - 1))] = conn.heldBack.front();
+    conn.heldBack.pop_front();
+    ++sock.rxWr;
+    --uRoom;
+    ++uMoved;
+  }
+  if (uMoved) sock.ir |= W5100_IR_RECV;
+
+  // The FIN of the peer comes after its data
+  if (conn.finAtChip && conn.heldBack.empty() && (sock.sr == W5100_SOCK_ESTABLISHED))
+  {
+    sock.sr  = W5100_SOCK_CLOSE_WAIT;
+    sock.ir |= W5100_IR_DISCON;
+  }
+}
+
+static void local_transmit(W5100Emu::conn_t the_id, uint32_t the_seq, const std::vector<uint8_t>& the_data, uint8_t the_tries)
+{
+  // A segment towards the peer, at the pace of the link
+  conn_s& conn = local_conns[the_id];
+  uint64_t uStart = W5100Emu::now() > conn.linkFree ? W5100Emu::now() : conn.linkFree;
+  uint64_t uEnd   = uStart;
+  if (conn.link.bytesPerSec)
+    uEnd += static_cast<uint64_t>(the_data.size()) * 1000000 / conn.link.bytesPerSec;
+  conn.linkFree = uEnd;
+
+  event_s& ev = local_schedule(local_lost(conn) ? uEnd + local_rto(the_tries) : uEnd + local_halfRtt(conn),
+                               local_lost(conn) ? ev_resend : ev_dataToPeer, the_id);
+  ev.gen     = conn.gen;
+  ev.seq     = the_seq;
+  ev.tries   = the_tries;
+  ev.txStart = uStart;
+  ev.data    = the_data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Commands
+
+static void local_command(uint8_t the_sn, uint8_t the_command)
+{
+  socket_s& sock = local_sockets_[the_sn];
+  uint16_t  uTxSize = local_memSize(W5100_TMSR, the_sn);
+  uint16_t  uTxBase = local_memBase(W5100_MEM_TX_BASE, W5100_TMSR, the_sn);
+
+  switch (the_command)
+  {
+  case W5100_COMMAND_OPEN:
+    local_detach(the_sn, W5100_SOCK_CLOSED);
+    if ((local_mem[W5100_S0_MASK + (the_sn << 8) + W5100_Sn_MR] & 0x0F) != W5100_PROTOCOL_TCP) break;
+    sock.sr      = W5100_SOCK_INIT;
+    sock.ir      = 0;
+    sock.sendSeq = sock.ackSeq = sock.sendEnd = 0;
+    sock.rxWr    = sock.rxRd = 0;
+    local_setSnReg16(the_sn, W5100_Sn_TX_WR, 0);
+    local_setSnReg16(the_sn, W5100_Sn_RX_RD, 0);
+    break;
+
+  case W5100_COMMAND_LISTEN:
+    if (sock.sr == W5100_SOCK_INIT) sock.sr = W5100_SOCK_LISTEN;
+    break;
+
+  case W5100_COMMAND_CLOSE:
+    local_detach(the_sn, W5100_SOCK_CLOSED);
+    break;
+
+  case W5100_COMMAND_DISCON:
+    if ((sock.sr == W5100_SOCK_ESTABLISHED) || (sock.sr == W5100_SOCK_CLOSE_WAIT))
+    {
+      // FIN after the data already sent; the peer answers with its own
+      conn_s& conn = local_conns[sock.conn];
+      uint64_t uFinAt = (conn.linkFree > W5100Emu::now() ? conn.linkFree : W5100Emu::now()) + local_halfRtt(conn);
+      local_notifyClosed(conn, sock.conn, uFinAt);
+      event_s& ev = local_schedule(uFinAt + local_halfRtt(conn), ev_finWaitDone, sock.conn);
+      ev.gen  = sock.gen;
+      sock.sr = W5100_SOCK_FIN_WAIT;
+    }
+    break;
+
+  case W5100_COMMAND_SEND:
+    if ((sock.sr == W5100_SOCK_ESTABLISHED) || (sock.sr == W5100_SOCK_CLOSE_WAIT))
+    {
+      uint16_t uSize = (local_snReg16(the_sn, W5100_Sn_TX_WR) - sock.sendSeq) & 0xFFFF;
+      if (uSize > uTxSize - (sock.sendSeq - sock.ackSeq)) uSize = uTxSize - (sock.sendSeq - sock.ackSeq);
+      for (uint16_t uDone = 0; uDone < uSize; )
+      {
+        uint16_t uSeg = (uSize - uDone > local_mss) ? local_mss : uSize - uDone;
+        std::vector<uint8_t> data(uSeg);
+        for (uint16_t u = 0; u < uSeg; ++u)
+          data[u] = local_mem[uTxBase + ((sock.sendSeq + uDone + u) & (uTxSize - 1))];
+        local_transmit(sock.conn, sock.sendSeq + uDone, data, 0);
+        uDone += uSeg;
+      }
+      sock.sendSeq += uSize;
+      sock.sendEnd  = sock.sendSeq;
+      sock.sendBusy = (uSize != 0);
+      if (!uSize) sock.ir |= W5100_IR_SEND_OK;
+    }
+    break;
+
+  case W5100_COMMAND_RECV:
+    sock.rxRd = sock.rxWr - ((sock.rxWr - local_snReg16(the_sn, W5100_Sn_RX_RD)) & 0xFFFF);
+    local_fillRx(the_sn);
+    if (sock.rxWr != sock.rxRd) sock.ir |= W5100_IR_RECV;
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void local_reset()
+{
+  for (uint8_t sn = 0; sn < local_sockets; ++sn)
+    local_detach(sn, W5100_SOCK_CLOSED);
+  memset(local_mem, 0, sizeof(local_mem));
+  local_mem[W5100_RMSR] = 0x55;
+  local_mem[W5100_TMSR] = 0x55;
+  for (uint8_t sn = 0; sn < local_sockets; ++sn)
+  {
+    socket_s& sock = local_sockets_[sn];
+    sock.ir = 0;
+    sock.sendSeq = sock.ackSeq = sock.sendEnd = 0;
+    sock.rxWr = sock.rxRd = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Events
+
+static void local_runEvent(event_s& the_ev)
+{
+  conns_t::iterator it = local_conns.find(the_ev.conn);
+  if ((the_ev.type == ev_timer) || (it == local_conns.end()))
+  {
+    if (the_ev.peer) the_ev.peer->onTimer(the_ev.cookie);
+    return;
+  }
+  conn_s& conn = it->second;
+  socket_s * pSock = (conn.sn >= 0) && (conn.gen == the_ev.gen) ? &local_sockets_[conn.sn] : 0;
+
+  switch (the_ev.type)
+  {
+  case ev_synToChip:
+  {
+    for (uint8_t sn = 0; sn < local_sockets; ++sn)
+    {
+      socket_s& sock = local_sockets_[sn];
+      if ((sock.sr != W5100_SOCK_LISTEN) || (local_snReg16(sn, W5100_Sn_PORT) != conn.port)) continue;
+
+      sock.sr   = W5100_SOCK_ESTABLISHED;
+      sock.ir  |= W5100_IR_CON;
+      sock.conn = the_ev.conn;
+      conn.sn   = sn;
+      conn.gen  = sock.gen;
+      conn.established = true;
+      memcpy(&local_mem[W5100_S0_MASK + (sn << 8) + W5100_Sn_DIPR], conn.peerIp, 4);
+      local_setSnReg16(sn, W5100_Sn_DPORT, conn.peerPort);
+      local_schedule(W5100Emu::now() + local_halfRtt(conn), ev_synAckToPeer, the_ev.conn);
+      return;
+    }
+    if (local_refuseSyn)
+      local_schedule(W5100Emu::now() + local_halfRtt(conn), ev_rstToPeer, the_ev.conn);
+    else
+      local_schedule(W5100Emu::now() + (1000000ULL << conn.synTries) - local_halfRtt(conn), ev_synRetry, the_ev.conn);
+    break;
+  }
+
+  case ev_synRetry:
+    if (++conn.synTries > local_synRetries) { conn.closedToPeer = true; conn.peer->onRefused(the_ev.conn); break; }
+    if (local_lost(conn))
+      local_schedule(W5100Emu::now() + (1000000ULL << conn.synTries), ev_synRetry, the_ev.conn);
+    else
+      local_schedule(W5100Emu::now() + local_halfRtt(conn), ev_synToChip, the_ev.conn);
+    break;
+
+  case ev_synAckToPeer:
+    if (conn.sn >= 0) conn.peer->onConnected(the_ev.conn);
+    break;
+
+  case ev_rstToPeer:
+    conn.closedToPeer = true;
+    conn.peer->onRefused(the_ev.conn);
+    break;
+
+  case ev_dataToChip:
+    if (!pSock) break;
+    conn.heldBack.insert(conn.heldBack.end(), the_ev.data.begin(), the_ev.data.end());
+    local_fillRx(conn.sn);
+    break;
+
+  case ev_finToChip:
+    if (!pSock) break;
+    conn.finAtChip = true;
+    local_fillRx(conn.sn);
+    break;
+
+  case ev_dataToPeer:
+  {
+    // Segments sent after the socket was closed never left the W5100
+    if (the_ev.txStart >= conn.closedAt) break;
+    if (the_ev.seq >= conn.peerSeq) conn.outOfOrder[the_ev.seq].swap(the_ev.data);
+    while (!conn.outOfOrder.empty() && (conn.outOfOrder.begin()->first == conn.peerSeq))
+    {
+      std::vector<uint8_t> data;
+      data.swap(conn.outOfOrder.begin()->second);
+      conn.outOfOrder.erase(conn.outOfOrder.begin());
+      conn.peerSeq += data.size();
+      if (!conn.closedToPeer && !data.empty()) conn.peer->onData(the_ev.conn, &data[0], data.size());
+    }
+    event_s& ev = local_schedule(W5100Emu::now() + local_halfRtt(conn), ev_ackToChip, the_ev.conn);
+    ev.gen = the_ev.gen;
+    ev.seq = conn.peerSeq;
+    break;
+  }
+
+  case ev_ackToChip:
+    if (!pSock) break;
+    if (the_ev.seq > pSock->ackSeq) pSock->ackSeq = the_ev.seq;
+    if (pSock->sendBusy && (pSock->ackSeq >= pSock->sendEnd))
+    {
+      pSock->sendBusy = false;
+      pSock->ir |= W5100_IR_SEND_OK;
+    }
+    break;
+
+  case ev_resend:
+    if (!pSock) break;
+    if (the_ev.tries >= local_maxRetries)
+    {
+      // The W5100 gives up: the socket is closed, with a TIMEOUT
+      uint8_t sn = conn.sn;
+      local_detach(sn, W5100_SOCK_CLOSED);
+      local_sockets_[sn].ir |= W5100_IR_TIMEOUT;
+      break;
+    }
+    local_transmit(the_ev.conn, the_ev.seq, the_ev.data, the_ev.tries + 1);
+    break;
+
+  case ev_closedToPeer:
+    if (!conn.vanished) conn.peer->onClosed(the_ev.conn);
+    break;
+
+  case ev_finWaitDone:
+    if (pSock && (pSock->sr == W5100_SOCK_FIN_WAIT)) local_detach(conn.sn, W5100_SOCK_CLOSED);
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void local_runDue(uint64_t the_us)
+{
+  while (!local_events.empty() && (local_events.begin()->first.first <= the_us))
+  {
+    event_s ev = event_s();
+    std::swap(ev, local_events.begin()->second);
+    local_events.erase(local_events.begin());
+    local_runEvent(ev);
+  }
+}
+
+static void local_frame()
+{
+  // Each SPI frame takes time, during which the network goes on
+  local_pendingNs += local_frameNs;
+  if (local_pendingNs >= 1000)
+  {
+    uint32_t uUs = local_pendingNs / 1000;
+    local_pendingNs -= uUs * 1000;
+    HostClock::advance(uUs);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Registers
+
+static uint8_t local_read(uint16_t the_addr)
+{
+  if ((the_addr >= W5100_S0_MASK) && (the_addr < W5100_S0_MASK + (local_sockets << 8)))
+  {
+    uint8_t   sn   = (the_addr - W5100_S0_MASK) >> 8;
+    uint8_t   off  = the_addr & 0xFF;
+    socket_s& sock = local_sockets_[sn];
+    uint16_t  uValue;
+    if (off == W5100_Sn_CR) return 0;     // Commands complete at once
+    if (off == W5100_Sn_IR) return sock.ir;
+    if (off == W5100_Sn_SR) return sock.sr;
+    switch (off & 0xFE)
+    {
+    case W5100_Sn_TX_FSR:  uValue = local_memSize(W5100_TMSR, sn) - (sock.sendSeq - sock.ackSeq); break;
+    case W5100_Sn_TX_RD:   uValue = sock.ackSeq & 0xFFFF; break;
+    case W5100_Sn_RX_RSR:  uValue = (sock.rxWr - sock.rxRd) & 0xFFFF; break;
+    default:               return local_mem[the_addr];
+    }
+    return (off & 1) ? (uValue & 0xFF) : (uValue >> 8);
+  }
+
+  return (the_addr < sizeof(local_mem)) ? local_mem[the_addr] : 0;
+}
+
+static void local_write(uint16_t the_addr, uint8_t the_data)
+{
+  if (the_addr == W5100_MR)
+  {
+    if (the_data & W5100_RST) { local_reset(); return; }
+    local_mem[W5100_MR] = the_data;
+    return;
+  }
+
+  if ((the_addr >= W5100_S0_MASK) && (the_addr < W5100_S0_MASK + (local_sockets << 8)))
+  {
+    uint8_t sn  = (the_addr - W5100_S0_MASK) >> 8;
+    uint8_t off = the_addr & 0xFF;
+    if (off == W5100_Sn_CR) { local_command(sn, the_data); return; }
+    if (off == W5100_Sn_IR) { local_sockets_[sn].ir &= ~the_data; return; }
+    if ((off == W5100_Sn_SR) || ((off & 0xFE) == W5100_Sn_TX_FSR) || ((off & 0xFE) == W5100_Sn_RX_RSR)) return;
+  }
+
+  if (the_addr < sizeof(local_mem)) local_mem[the_addr] = the_data;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// W5100Spi on the emulated chip
+
+uint32_t W5100Spi::smy_accesses = 0;
+uint8_t  W5100Spi::smy_depth    = 0;
+
+void W5100Spi::begin()
+{ if (!local_running) W5100Emu::begin(); }
+
+void W5100Spi::beginTransaction()
+{ ++smy_depth; }
+
+void W5100Spi::endTransaction()
+{ if (smy_depth) --smy_depth; }
+
+void W5100Spi::suspend()
+{}
+
+void W5100Spi::resume()
+{}
+
+bool W5100Spi::inTransaction()
+{ return smy_depth != 0; }
+
+void W5100Spi::prv_acquireBus()
+{}
+
+void W5100Spi::prv_releaseBus()
+{}
+
+void W5100Spi::write(uint16_t the_addr, uint8_t the_data)
+{
+  ++smy_accesses;
+  local_frame();
+  local_write(the_addr, the_data);
+}
+
+void W5100Spi::write(uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size)
+{
+  for (uint16_t u = 0; u < the_size; ++u)
+    write(the_addr + u, the_buffer[u]);
+}
+
+void W5100Spi::write16(uint16_t the_addr, uint16_t the_data)
+{
+  write(the_addr,     the_data >> 8);
+  write(the_addr + 1, the_data & 0xFF);
+}
+
+uint8_t W5100Spi::read(uint16_t the_addr)
+{
+  ++smy_accesses;
+  local_frame();
+  return local_read(the_addr);
+}
+
+void W5100Spi::read(uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size)
+{
+  for (uint16_t u = 0; u < the_size; ++u)
+    the_buffer[u] = read(the_addr + u);
+}
+
+uint16_t W5100Spi::read16(uint16_t the_addr)
+{
+  // Both bytes are taken at once: what happens on the network during the
+  // second frame shows in the next read
+  uint16_t uValue = (local_read(the_addr) << 8) | local_read(the_addr + 1);
+  smy_accesses += 2;
+  local_frame();
+  local_frame();
+  return uValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// W5100Emu
+
+void W5100Emu::begin(uint32_t the_seed)
+{
+  local_events.clear();
+  local_conns.clear();
+  memset(local_sockets_, 0, sizeof(local_sockets_));
+  local_eventOrder   = 0;
+  local_nextConn     = 1;
+  local_nextPeerPort = 49152;
+  local_random       = the_seed ? the_seed : 1;
+  local_pendingNs    = 0;
+  local_running      = true;
+  HostClock::useVirtualTime(&local_runDue);
+  local_reset();
+}
+
+void W5100Emu::end()
+{
+  local_events.clear();
+  local_conns.clear();
+  for (uint8_t sn = 0; sn < local_sockets; ++sn) local_sockets_[sn].conn = 0;
+}
+
+void W5100Emu::setSpiFrameTime(uint32_t the_ns)
+{ local_frameNs = the_ns; }
+
+void W5100Emu::setRefuseSyn(bool the_refuse)
+{ local_refuseSyn = the_refuse; }
+
+W5100Emu::conn_t W5100Emu::connect(peer_t * the_peer, uint16_t the_port, const link_t& the_link)
+{
+  conn_t id = local_nextConn++;
+  conn_s& conn = local_conns[id];
+  conn.peer         = the_peer;
+  conn.link         = the_link;
+  conn.port         = the_port;
+  conn.peerPort     = local_nextPeerPort++;
+  conn.peerIp[0]    = 10;
+  conn.peerIp[1]    = 0;
+  conn.peerIp[2]    = (id >> 8) & 0xFF;
+  conn.peerIp[3]    = id & 0xFF;
+  conn.sn           = -1;
+  conn.gen          = 0;
+  conn.synTries     = 0;
+  conn.established  = false;
+  conn.vanished     = false;
+  conn.finAtChip    = false;
+  conn.closedToPeer = false;
+  conn.closedAt     = local_never;
+  conn.linkFree     = 0;
+  conn.lastToChip   = 0;
+  conn.peerSeq      = 0;
+  conn.peerSent     = 0;
+  if (local_nextPeerPort == 0) local_nextPeerPort = 49152;
+
+  if (local_lost(conn))
+    local_schedule(now() + 1000000, ev_synRetry, id);
+  else
+    local_schedule(now() + local_halfRtt(conn), ev_synToChip, id);
+  return id;
+}
+
+void W5100Emu::send(conn_t the_conn, const void * the_data, size_t the_size)
+{
+  conns_t::iterator it = local_conns.find(the_conn);
+  if ((it == local_conns.end()) || !it->second.established) return;
+  conn_s& conn = it->second;
+  conn.peerSent += the_size;
+
+  // Segments reach the W5100 in order: a lost one holds back those behind it
+  const uint8_t * pData = static_cast<const uint8_t *>(the_data);
+  for (size_t uDone = 0; uDone < the_size; )
+  {
+    size_t uSeg = (the_size - uDone > local_mss) ? local_mss : the_size - uDone;
+    uint64_t uAt = now() + local_halfRtt(conn);
+    for (uint8_t uTry = 0; local_lost(conn) && (uTry < local_maxRetries); ++uTry)
+      uAt += local_rto(uTry);
+    if (uAt < conn.lastToChip) uAt = conn.lastToChip;
+    conn.lastToChip = uAt;
+
+    event_s& ev = local_schedule(uAt, ev_dataToChip, the_conn);
+    ev.gen = conn.gen;
+    ev.data.assign(pData + uDone, pData + uDone + uSeg);
+    uDone += uSeg;
+  }
+}
+
+void W5100Emu::close(conn_t the_conn)
+{
+  conns_t::iterator it = local_conns.find(the_conn);
+  if ((it == local_conns.end()) || !it->second.established) return;
+  conn_s& conn = it->second;
+
+  uint64_t uAt = now() + local_halfRtt(conn);
+  if (uAt < conn.lastToChip) uAt = conn.lastToChip;
+  conn.lastToChip = uAt;
+  event_s& ev = local_schedule(uAt, ev_finToChip, the_conn);
+  ev.gen = conn.gen;
+}
+
+void W5100Emu::vanish(conn_t the_conn)
+{
+  conns_t::iterator it = local_conns.find(the_conn);
+  if (it != local_conns.end()) it->second.vanished = true;
+}
+
+void W5100Emu::schedule(peer_t * the_peer, uint64_t the_atUs, uint32_t the_cookie)
+{
+  event_s& ev = local_schedule(the_atUs < now() ? now() : the_atUs, ev_timer, 0);
+  ev.peer   = the_peer;
+  ev.cookie = the_cookie;
+}
+
+uint64_t W5100Emu::now()
+{ return HostClock::now(); }
+
+uint8_t W5100Emu::status(uint8_t the_sn)
+{ return (the_sn < local_sockets) ? local_sockets_[the_sn].sr : W5100_SOCK_UNDEFINED; }
+
+W5100Emu::conn_t W5100Emu::connection(uint8_t the_sn)
+{ return (the_sn < local_sockets) ? local_sockets_[the_sn].conn : 0; }
+
+uint32_t W5100Emu::unread(conn_t the_conn)
+{
+  // Data are read when the RECV command moves Sn_RX_RD past them
+  conns_t::const_iterator it = local_conns.find(the_conn);
+  if ((it == local_conns.end()) || (it->second.sn < 0)) return 0;
+  return it->second.peerSent - local_sockets_[it->second.sn].rxRd;
+}
+
+uint64_t W5100Emu::delivered(conn_t the_conn)
+{
+  // Losses are drawn when data are sent, so their arrival is known from then on
+  conns_t::const_iterator it = local_conns.find(the_conn);
+  return (it == local_conns.end()) ? 0 : it->second.lastToChip;
+}
+
+uint32_t W5100Emu::spiFrames()
+{ return W5100Spi::accesses(); }
+
+bool W5100Emu::idle()
+{ return local_events.empty(); }
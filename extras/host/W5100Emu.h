@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5100Emu.h - Emulation of the W5100 and of the network behind it
+//
+//  ----------------------
+//
+//  W5100Emu.cpp replaces utility/W5100Spi.cpp in host builds: the W5100 driver
+//  and everything above it (ClientProxy, HttpSvr) run unchanged, on registers
+//  and buffer memory emulated as described in the W5100 datasheet. Only TCP
+//  is emulated, which is all HttpSvr uses.
+//
+//  Time is virtual (see HostClock): each SPI frame costs the time it takes on
+//  an AVR (setSpiFrameTime), and everything else happens at the time it is
+//  scheduled. Connections come from peers, i.e. objects of the host program
+//  acting as clients, each over a link with its own round trip time, loss
+//  rate and bandwidth:
+//    * a SYN is accepted by the first socket listening on its port; if there
+//      is none, the W5100 answers with a RST (or, with setRefuseSyn(false),
+//      the SYN is lost and sent again after 1 s, 2 s, 4 s...)
+//    * data are cut in segments of 1460 bytes; a lost segment is sent again
+//      after the retransmission time of its side (200 ms, doubled at each
+//      retry), and after 8 retries the W5100 gives up with a TIMEOUT
+//    * SEND_OK is raised when the last segment of a SEND is acknowledged, and
+//      Sn_TX_FSR grows as segments are acknowledged
+//    * data from a peer are held back while the rx memory of the socket is
+//      full, as the receive window would do
+//    * a CLOSE command resets the connection: data not yet acknowledged are
+//      lost, and the peer is told after half a round trip
+//  All random draws (losses) come from a generator seeded with "begin", so a
+//  run only depends on the seed and on what peers do.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef W5100EMU_H
+#define W5100EMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class W5100Emu
+{
+public:
+  /////////////////////////////////////////////////////////
+  // Network link between the W5100 and a peer
+  struct link_t
+  {
+    uint32_t rttUs;             // Round trip time
+    uint32_t bytesPerSec;       // Bandwidth towards the peer; 0: unlimited
+    uint16_t lossPerMillion;    // Probability of losing a segment, either way
+
+    link_t() : rttUs(0), bytesPerSec(0), lossPerMillion(0) {}
+  };
+
+  /////////////////////////////////////////////////////////
+  // A client, implemented by the host program. Callbacks are made while
+  // virtual time advances, i.e. from inside the SPI accesses of the server:
+  // they may call connect, send, close and schedule, but nothing of HttpSvr.
+  typedef uint32_t conn_t;      // Connection, as known by its peer (0: none)
+
+  class peer_t
+  {
+  public:
+    virtual ~peer_t() {}
+    virtual void onConnected (conn_t /*the_conn*/) {}
+    virtual void onRefused   (conn_t /*the_conn*/) {}  // RST, or no answer to any SYN
+    virtual void onData      (conn_t /*the_conn*/, const uint8_t * /*the_data*/, uint16_t /*the_size*/) {}
+    virtual void onClosed    (conn_t /*the_conn*/) {}  // Reset or closed by the W5100
+    virtual void onTimer     (uint32_t /*the_cookie*/) {}
+  };
+
+public:
+  // Starts the emulation, with virtual time at 0
+  static void         begin               (uint32_t the_seed = 1);
+  // Ends a run: what is still scheduled is dropped and peers are no longer
+  // called, so that they can be destroyed before the server
+  static void         end                 ();
+
+  // Time of an SPI frame, i.e. of a byte of register or buffer memory
+  // (5 us by default: 4 bytes at 8 MHz, plus chip select, on a 16 MHz AVR)
+  static void         setSpiFrameTime     (uint32_t the_ns);
+  static void         setRefuseSyn        (bool the_refuse);
+
+  // Peer side of connections
+  static conn_t       connect             (peer_t * the_peer, uint16_t the_port, const link_t& the_link);
+  static void         send                (conn_t the_conn, const void * the_data, size_t the_size);
+  static void         close               (conn_t the_conn);   // FIN, after the data sent so far
+  static void         vanish              (conn_t the_conn);   // The peer stops answering
+  static void         schedule            (peer_t * the_peer, uint64_t the_atUs, uint32_t the_cookie);
+
+  // Inspection
+  static uint64_t     now                 ();
+  static uint8_t      status              (uint8_t the_sn);    // Sn_SR
+  static conn_t       connection          (uint8_t the_sn);    // 0 if none
+  static uint32_t     unread              (conn_t the_conn);   // Sent by the peer, not read yet by the server
+  static uint64_t     delivered           (conn_t the_conn);   // When the data sent so far by the peer reach the W5100
+  static uint32_t     spiFrames           ();
+  static bool         idle                ();                  // Nothing scheduled
+
+private:
+  W5100Emu(); // An object of this class cannot be instantiated
+};
+
+#endif // #ifndef W5100EMU_H
@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  avr/pgmspace.h - Program memory access for host builds of HttpSvr
+//
+//  ----------------------
+//
+//  There is a single address space on the host: data "in flash" are plain
+//  constants, and the _P functions are the standard ones.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PGMSPACE_H
+#define PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#define PROGMEM
+#define PGM_P                 const char *
+#define PSTR(s)               (s)
+
+#define pgm_read_byte(p)      (*reinterpret_cast<const uint8_t  *>(p))
+#define pgm_read_word(p)      (*reinterpret_cast<const uint16_t *>(p))
+#define pgm_read_dword(p)     (*reinterpret_cast<const uint32_t *>(p))
+#define pgm_read_ptr(p)       (*reinterpret_cast<void * const   *>(p))
+
+#define memcpy_P              memcpy
+#define memcmp_P              memcmp
+#define strlen_P              strlen
+#define strcmp_P              strcmp
+#define strncmp_P             strncmp
+#define strcasecmp_P          strcasecmp
+#define strncasecmp_P         strncasecmp
+#define strcpy_P              strcpy
+#define strstr_P              strstr
+
+#endif // #ifndef PGMSPACE_H
@@ -0,0 +1,624 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpLoad.cpp - Browsers loading pages from HttpSvr on the emulated W5100
+//
+//  ----------------------
+//
+//  The server is HttpSvr itself, through ClientProxy and the W5100 driver, on
+//  the emulated W5100 of extras/host (see W5100Emu.h): sockets, tx and rx
+//  memory, SPI time, and the network behind the chip with its round trip
+//  time, losses and bandwidth. Each browser is a peer of the emulation and
+//  loads a page the way real browsers do: the HTML first, then its assets in
+//  parallel on up to -connections connections (more than the sockets of the
+//  W5100), then periodic AJAX polls on the connections kept alive.
+//
+//  The page and assets are files of the emulated SD card, the polled URL is
+//  bound to a provider; each response has a body of -size bytes (1000 by
+//  default). Time is virtual and losses come from a generator seeded with
+//  -seed, so a run only depends on its options and on the code of the server:
+//  two builds can be compared under the same load.
+//
+//    httpload [-browsers=N] [-connections=N] [-stagger-ms=MS] [-page=URL]
+//             [-asset=URL...] [-poll=URL] [-poll-ms=MS] [-duration-ms=MS]
+//             [-think-ms=MS] [-rtt-ms=MS] [-loss=P] [-client-kbps=KBPS]
+//             [-full=rst|drop] [-rst-retry-ms=MS] [-spi-ns=NS] [-seed=N]
+//             [-size=URL=BYTES...]
+//
+//  The output is meant for extras/tools/loadgen.py, which prints the report.
+//  Times are in ms from the start, '-' if the event did not happen:
+//    req BROWSER KIND URL new|keep RETRIES OK WANTED SENT ARRIVED STARTED DONE
+//      ARRIVED is when the request reached the W5100, STARTED when the server
+//      began to read it, DONE when the browser had the whole response
+//    sock SN TIME STATE      '.' free, '-' connected and idle, '#' serving
+//    refused COUNT           connection attempts refused by the W5100
+//    end TIME
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include "HttpSvr.h"
+#include "W5100Emu.h"
+#include "W5100Defs.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint16_t local_port         = 80;
+static const uint64_t local_sampleUs     = 100;        // Period of the sampling of sockets
+static const uint64_t local_graceUs      = 60000000;   // Run after the end of polling, at most
+static const uint64_t local_none         = ~static_cast<uint64_t>(0);
+static const uint8_t  local_maxAttempts  = 3;          // Connection attempts refused before giving up (rst)
+static const uint8_t  local_maxResends   = 1;          // Requests sent again after the server closed
+
+// Options
+static uint16_t                 local_browsers    = 2;
+static uint16_t                 local_connections = 6;
+static double                   local_staggerMs   = 0;
+static std::string              local_page        = "/";
+static std::vector<std::string> local_assets;
+static std::string              local_poll;
+static double                   local_pollMs      = 1000;
+static double                   local_durationMs  = 10000;
+static double                   local_thinkMs     = 10;
+static double                   local_rttMs       = 2;
+static double                   local_loss        = 0;
+static double                   local_clientKbps  = 0;
+static bool                     local_refuse      = true;
+static double                   local_rstRetryMs  = 250;
+static uint32_t                 local_spiNs       = 5000;
+static uint32_t                 local_seed        = 1;
+static std::map<std::string, uint32_t> local_sizes;
+
+static HttpSvr  local_server;
+static uint32_t local_refused = 0;
+
+static uint64_t local_us(double the_ms)
+{ return static_cast<uint64_t>(the_ms * 1000.0 + 0.5); }
+
+static uint32_t local_sizeOf(const std::string& the_url)
+{
+  std::map<std::string, uint32_t>::const_iterator it = local_sizes.find(the_url);
+  return (it == local_sizes.end()) ? 1000 : it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Requests
+
+struct local_request
+{
+  uint16_t          browser;
+  const char *      kind;
+  std::string       url;
+  bool              newConn;
+  uint8_t           retries;
+  bool              ok;
+  W5100Emu::conn_t  conn;         // Connection it was sent on (0: none yet)
+  uint32_t          size;         // Bytes of the request
+  uint64_t          wanted;
+  uint64_t          sent;
+  uint64_t          arrived;
+  uint64_t          started;
+  uint64_t          done;
+};
+
+static std::vector<local_request>          local_requests;
+static std::map<W5100Emu::conn_t, size_t>  local_inFlight;    // Request in progress on each connection
+
+static void local_finish(size_t the_req, bool the_ok)
+{
+  local_request& req = local_requests[the_req];
+  req.ok   = the_ok;
+  req.done = W5100Emu::now();
+  if (req.conn) local_inFlight.erase(req.conn);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Responses, as they come: true once the first one in the_data is complete,
+// with its length in the_size; the_close is set if the server closes the
+// connection after it (a body with no length ends with the connection)
+
+static bool local_responseComplete(const std::string& the_data, size_t& the_size, bool& the_close)
+{
+  std::string::size_type eoh = the_data.find("\r\n\r\n");
+  if (eoh == std::string::npos) return false;
+  std::string sHead = the_data.substr(0, eoh + 2);
+  for (std::string::size_type u = 0; u < sHead.size(); ++u) sHead[u] = tolower(sHead[u]);
+
+  the_close = (sHead.find("\r\nconnection: close\r\n") != std::string::npos);
+  size_t uBody = eoh + 4;
+  std::string::size_type len = sHead.find("\r\ncontent-length:");
+  if (len != std::string::npos)
+  {
+    size_t uLength = strtoul(sHead.c_str() + len + 17, 0, 10);
+    if (the_data.size() < uBody + uLength) return false;
+    the_size = uBody + uLength;
+    return true;
+  }
+  if (sHead.find("\r\ntransfer-encoding: chunked\r\n") != std::string::npos)
+  {
+    for (size_t pos = uBody; ; )
+    {
+      std::string::size_type eol = the_data.find("\r\n", pos);
+      if (eol == std::string::npos) return false;
+      size_t uChunk = strtoul(the_data.c_str() + pos, 0, 16);
+      if (the_data.size() < eol + 2 + uChunk + 2) return false;
+      pos = eol + 2 + uChunk + 2;
+      if (!uChunk) { the_size = pos; return true; }
+    }
+  }
+  // No length: the body ends with the connection
+  the_close = true;
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Browsers
+
+class local_browser : public W5100Emu::peer_t
+{
+public:
+  explicit local_browser(uint16_t the_idx)
+  : my_idx(the_idx), my_assetsLeft(0), my_polling(false), my_closed(false)
+  { W5100Emu::schedule(this, local_us(the_idx * local_staggerMs), cookie_begin); }
+
+  bool done() const { return my_closed; }
+
+  virtual void onConnected(W5100Emu::conn_t the_conn)
+  {
+    connection_s * pConn = prv_find(the_conn);
+    if (!pConn) return;
+    pConn->opening = false;
+    pConn->open    = true;
+    pConn->fresh   = true;
+    prv_dispatch();
+  }
+
+  virtual void onRefused(W5100Emu::conn_t the_conn)
+  {
+    connection_s * pConn = prv_find(the_conn);
+    if (!pConn) return;
+    ++local_refused;
+    ++pConn->attempts;
+    if (local_refuse && (pConn->attempts < local_maxAttempts))
+    {
+      // The RST has come back: the browser tries again a little later. Without
+      // answer, the SYNs have been sent again already by the TCP of the client
+      W5100Emu::schedule(this, W5100Emu::now() + local_us(local_rstRetryMs), cookie_reconnect + (pConn - &my_conns[0]));
+      return;
+    }
+
+    // With no other connection to wait for, the browser gives up the first request
+    pConn->opening = false;
+    if (!prv_active() && !my_queue.empty())
+    {
+      size_t req = my_queue.front();
+      my_queue.pop_front();
+      local_requests[req].retries += pConn->attempts;
+      local_finish(req, false);
+      prv_completed(req);
+    }
+    prv_dispatch();
+  }
+
+  virtual void onData(W5100Emu::conn_t the_conn, const uint8_t * the_data, uint16_t the_size)
+  {
+    connection_s * pConn = prv_find(the_conn);
+    if (!pConn || (pConn->request == no_request)) return;
+    pConn->received.append(reinterpret_cast<const char *>(the_data), the_size);
+
+    // Some response came: the server has read the request
+    local_request& req = local_requests[pConn->request];
+    if (req.started == local_none) req.started = W5100Emu::now();
+
+    size_t uSize;
+    bool   bClose = false;
+    if (!local_responseComplete(pConn->received, uSize, bClose)) return;
+    pConn->received.erase(0, uSize);
+    pConn->closing = pConn->closing || bClose;
+    size_t uReq = pConn->request;
+    pConn->request = no_request;
+    local_finish(uReq, true);
+    prv_completed(uReq);
+    prv_dispatch();
+  }
+
+  virtual void onClosed(W5100Emu::conn_t the_conn)
+  {
+    connection_s * pConn = prv_find(the_conn);
+    if (!pConn) return;
+    pConn->open    = false;
+    pConn->opening = false;
+    if (pConn->request != no_request)
+    {
+      size_t uReq = pConn->request;
+      local_request& req = local_requests[uReq];
+      size_t uSize;
+      bool   bClose;
+      pConn->request = no_request;
+      if (!pConn->received.empty() && !local_responseComplete(pConn->received, uSize, bClose) && bClose)
+      {
+        // The body ended with the connection
+        local_finish(uReq, true);
+        prv_completed(uReq);
+      }
+      else if (pConn->received.empty() && (req.retries < local_maxResends + pConn->attempts))
+      {
+        // Closed as the request was sent (e.g. an idle timeout): it is sent again
+        local_inFlight.erase(req.conn);
+        ++req.retries;
+        req.conn    = 0;
+        req.sent    = local_none;
+        req.arrived = local_none;
+        req.started = local_none;
+        my_queue.push_front(uReq);
+      }
+      else
+      {
+        local_finish(uReq, false);
+        prv_completed(uReq);
+      }
+    }
+    prv_dispatch();
+  }
+
+  virtual void onTimer(uint32_t the_cookie)
+  {
+    if (the_cookie == cookie_begin)
+      prv_want(local_page, "page");
+    else if (the_cookie == cookie_assets)
+    {
+      my_assetsLeft = local_assets.size();
+      for (size_t u = 0; u < local_assets.size(); ++u) prv_want(local_assets[u], "asset");
+      if (local_assets.empty()) prv_startPolling();
+    }
+    else if (the_cookie == cookie_poll)
+    {
+      if (W5100Emu::now() >= local_us(local_durationMs)) { my_polling = false; prv_checkDone(); return; }
+      prv_want(local_poll, "poll");
+      W5100Emu::schedule(this, W5100Emu::now() + local_us(local_pollMs), cookie_poll);
+    }
+    else if (the_cookie >= cookie_reconnect)
+    {
+      connection_s& conn = my_conns[the_cookie - cookie_reconnect];
+      W5100Emu::link_t aLink = prv_link();
+      conn.id = W5100Emu::connect(this, local_port, aLink);
+    }
+  }
+
+private:
+  static const size_t   no_request       = static_cast<size_t>(-1);
+  static const uint32_t cookie_begin     = 0;
+  static const uint32_t cookie_assets    = 1;
+  static const uint32_t cookie_poll      = 2;
+  static const uint32_t cookie_reconnect = 16;   // + index of the connection
+
+  struct connection_s
+  {
+    W5100Emu::conn_t id;
+    bool             opening;
+    bool             open;
+    bool             fresh;      // Opened, and no request sent yet
+    bool             closing;    // The server closes it after the response
+    uint8_t          attempts;   // Connection attempts refused
+    size_t           request;
+    std::string      received;
+  };
+
+  W5100Emu::link_t prv_link() const
+  {
+    W5100Emu::link_t aLink;
+    aLink.rttUs          = local_us(local_rttMs);
+    aLink.bytesPerSec    = static_cast<uint32_t>(local_clientKbps * 1000.0);
+    aLink.lossPerMillion = static_cast<uint16_t>(local_loss * 1000000.0 + 0.5);
+    return aLink;
+  }
+
+  connection_s * prv_find(W5100Emu::conn_t the_conn)
+  {
+    for (size_t u = 0; u < my_conns.size(); ++u)
+      if (my_conns[u].id == the_conn) return &my_conns[u];
+    return 0;
+  }
+
+  size_t prv_active() const
+  {
+    size_t uCount = 0;
+    for (size_t u = 0; u < my_conns.size(); ++u)
+      if (my_conns[u].opening || my_conns[u].open) ++uCount;
+    return uCount;
+  }
+
+  void prv_want(const std::string& the_url, const char * the_kind)
+  {
+    local_request req;
+    req.browser    = my_idx;
+    req.kind       = the_kind;
+    req.url        = the_url;
+    req.newConn    = false;
+    req.retries    = 0;
+    req.ok         = false;
+    req.conn       = 0;
+    req.size       = 0;
+    req.wanted     = W5100Emu::now();
+    req.sent = req.arrived = req.started = req.done = local_none;
+    local_requests.push_back(req);
+    my_queue.push_back(local_requests.size() - 1);
+    prv_dispatch();
+  }
+
+  void prv_dispatch()
+  {
+    // Requests go to the first connection available, whether it has just been
+    // opened or has been kept alive; connections are opened while requests wait
+    while (!my_queue.empty())
+    {
+      connection_s * pIdle = 0;
+      size_t uOpening = 0;
+      for (size_t u = 0; u < my_conns.size(); ++u)
+      {
+        connection_s& conn = my_conns[u];
+        if (conn.opening) ++uOpening;
+        if (!pIdle && conn.open && !conn.closing && (conn.request == no_request)) pIdle = &conn;
+      }
+      if (pIdle)
+      {
+        size_t uReq = my_queue.front();
+        my_queue.pop_front();
+        prv_send(*pIdle, uReq);
+        continue;
+      }
+      if ((prv_active() < local_connections) && (uOpening < my_queue.size()))
+      {
+        connection_s conn;
+        conn.opening  = true;
+        conn.open     = false;
+        conn.fresh    = false;
+        conn.closing  = false;
+        conn.attempts = 0;
+        conn.request  = no_request;
+        W5100Emu::link_t aLink = prv_link();
+        conn.id = W5100Emu::connect(this, local_port, aLink);
+        my_conns.push_back(conn);
+        continue;
+      }
+      return;
+    }
+  }
+
+  void prv_send(connection_s& the_conn, size_t the_req)
+  {
+    local_request& req = local_requests[the_req];
+    if (the_conn.fresh)
+    {
+      req.newConn     = true;
+      req.retries    += the_conn.attempts;
+      the_conn.fresh  = false;
+    }
+    std::string sRequest = "GET " + req.url + " HTTP/1.1\r\nHost: 192.168.0.27\r\nConnection: keep-alive\r\n\r\n";
+    req.conn       = the_conn.id;
+    req.size       = sRequest.size();
+    req.sent       = W5100Emu::now();
+    the_conn.request = the_req;
+    W5100Emu::send(the_conn.id, sRequest.data(), sRequest.size());
+    req.arrived = W5100Emu::delivered(the_conn.id);
+    local_inFlight[the_conn.id] = the_req;
+  }
+
+  void prv_completed(size_t the_req)
+  {
+    const local_request& req = local_requests[the_req];
+    if (!strcmp(req.kind, "page"))
+    {
+      // The HTML is parsed, then all assets are asked for at once
+      W5100Emu::schedule(this, W5100Emu::now() + local_us(local_thinkMs), cookie_assets);
+    }
+    else if (!strcmp(req.kind, "asset"))
+    {
+      if (--my_assetsLeft == 0) prv_startPolling();
+    }
+    prv_checkDone();
+  }
+
+  void prv_startPolling()
+  {
+    my_polling = !local_poll.empty();
+    if (my_polling) W5100Emu::schedule(this, W5100Emu::now(), cookie_poll);
+    prv_checkDone();
+  }
+
+  void prv_checkDone()
+  {
+    // Once the page and its assets are loaded and polling is over, the browser
+    // closes its connections
+    if (my_closed || my_polling || !my_queue.empty()) return;
+    size_t uWanted = 0;
+    for (size_t u = 0; u < local_requests.size(); ++u)
+      if (local_requests[u].browser == my_idx)
+      {
+        ++uWanted;
+        if (local_requests[u].done == local_none) return;
+      }
+    if (uWanted < 1 + local_assets.size()) return;
+    my_closed = true;
+    for (size_t u = 0; u < my_conns.size(); ++u)
+      if (my_conns[u].open) W5100Emu::close(my_conns[u].id);
+  }
+
+private:
+  uint16_t                  my_idx;
+  size_t                    my_assetsLeft;
+  bool                      my_polling;
+  bool                      my_closed;
+  std::deque<size_t>        my_queue;
+  std::vector<connection_s> my_conns;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Sockets of the server, sampled as time goes
+
+class local_monitor : public W5100Emu::peer_t
+{
+public:
+  local_monitor() : my_states(HttpSvrConfig::sockets, '.')
+  { W5100Emu::schedule(this, 0, 0); }
+
+  virtual void onTimer(uint32_t)
+  {
+    for (uint8_t sn = 0; sn < HttpSvrConfig::sockets; ++sn)
+    {
+      W5100Emu::conn_t conn = W5100Emu::connection(sn);
+      char state = conn ? '-' : '.';
+      std::map<W5100Emu::conn_t, size_t>::const_iterator it = conn ? local_inFlight.find(conn) : local_inFlight.end();
+      if (it != local_inFlight.end())
+      {
+        // The server has begun to read the request once it is no longer all unread
+        local_request& req = local_requests[it->second];
+        if ((req.started == local_none) && (W5100Emu::unread(conn) < req.size)) req.started = W5100Emu::now();
+        if (req.started != local_none) state = '#';
+      }
+      if (state != my_states[sn])
+      {
+        my_states[sn] = state;
+        printf("sock %u %.3f %c\n", sn, W5100Emu::now() / 1000.0, state);
+      }
+    }
+    W5100Emu::schedule(this, W5100Emu::now() + local_sampleUs, 0);
+  }
+
+private:
+  std::vector<char> my_states;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Server
+
+static bool local_rpPoll(ClientProxy& the_client, http_e::method, const char * the_url)
+{
+  std::string sBody(local_sizeOf(the_url), ' ');
+  local_server.sendResponseOkWithContent(the_client, sBody.size(), "application/json");
+  the_client.writeBuffer(reinterpret_cast<uint8_t *>(&sBody[0]), sBody.size());
+  return true;
+}
+
+static void local_putFile(const std::string& the_url)
+{
+  // A directory is served by its index page
+  std::string sPath = the_url.substr(0, the_url.find('?'));
+  if (sPath.empty() || (sPath[sPath.size() - 1] == '/')) sPath += "index.htm";
+  std::vector<uint8_t> data(local_sizeOf(the_url), 'x');
+  SD.putFile(sPath.c_str(), data.empty() ? 0 : &data[0], data.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static std::string local_time(uint64_t the_us)
+{
+  if (the_us == local_none) return "-";
+  char sTime[24];
+  snprintf(sTime, sizeof(sTime), "%.3f", the_us / 1000.0);
+  return sTime;
+}
+
+static bool local_option(const char * the_arg, const char * the_name, const char *& the_value)
+{
+  size_t uLen = strlen(the_name);
+  if (strncmp(the_arg, the_name, uLen) || (the_arg[uLen] != '=')) return false;
+  the_value = the_arg + uLen + 1;
+  return true;
+}
+
+int main(int argc, char ** argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char * v;
+    if      (local_option(argv[i], "-browsers",     v)) local_browsers    = atoi(v);
+    else if (local_option(argv[i], "-connections",  v)) local_connections = atoi(v);
+    else if (local_option(argv[i], "-stagger-ms",   v)) local_staggerMs   = atof(v);
+    else if (local_option(argv[i], "-page",         v)) local_page        = v;
+    else if (local_option(argv[i], "-asset",        v)) local_assets.push_back(v);
+    else if (local_option(argv[i], "-poll",         v)) local_poll        = v;
+    else if (local_option(argv[i], "-poll-ms",      v)) local_pollMs      = atof(v);
+    else if (local_option(argv[i], "-duration-ms",  v)) local_durationMs  = atof(v);
+    else if (local_option(argv[i], "-think-ms",     v)) local_thinkMs     = atof(v);
+    else if (local_option(argv[i], "-rtt-ms",       v)) local_rttMs       = atof(v);
+    else if (local_option(argv[i], "-loss",         v)) local_loss        = atof(v);
+    else if (local_option(argv[i], "-client-kbps",  v)) local_clientKbps  = atof(v);
+    else if (local_option(argv[i], "-full",         v) && (!strcmp(v, "rst") || !strcmp(v, "drop"))) local_refuse = !strcmp(v, "rst");
+    else if (local_option(argv[i], "-rst-retry-ms", v)) local_rstRetryMs  = atof(v);
+    else if (local_option(argv[i], "-spi-ns",       v)) local_spiNs       = strtoul(v, 0, 10);
+    else if (local_option(argv[i], "-seed",         v)) local_seed        = strtoul(v, 0, 10);
+    else if (local_option(argv[i], "-size",         v) && strchr(v + 1, '='))
+      local_sizes[std::string(v, strchr(v + 1, '=') - v)] = strtoul(strchr(v + 1, '=') + 1, 0, 10);
+    else
+    {
+      fprintf(stderr, "usage: %s [-browsers=N] [-connections=N] [-stagger-ms=MS] [-page=URL] [-asset=URL...]\n"
+                      "  [-poll=URL] [-poll-ms=MS] [-duration-ms=MS] [-think-ms=MS] [-rtt-ms=MS] [-loss=P]\n"
+                      "  [-client-kbps=KBPS] [-full=rst|drop] [-rst-retry-ms=MS] [-spi-ns=NS] [-seed=N]\n"
+                      "  [-size=URL=BYTES...]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // The chip, the card and the server
+  static const uint8_t macAddress[] = { 0x90, 0xA2, 0xDA, 0x00, 0x00, 0x01 };
+  W5100Emu::begin(local_seed);
+  W5100Emu::setSpiFrameTime(local_spiNs);
+  W5100Emu::setRefuseSyn(local_refuse);
+  SD.clear();
+  local_putFile(local_page);
+  for (size_t u = 0; u < local_assets.size(); ++u) local_putFile(local_assets[u]);
+  local_server.begin_noDHCP(10, 4, macAddress, IPAddress(192, 168, 0, 27), local_port);
+  if (!local_poll.empty()) local_server.bindUrl(local_poll.c_str(), &local_rpPoll);
+
+  // The load
+  local_monitor aMonitor;
+  std::vector<local_browser *> browsers;
+  for (uint16_t u = 0; u < local_browsers; ++u) browsers.push_back(new local_browser(u));
+
+  uint64_t uLimit = local_us(local_durationMs) + local_graceUs;
+  for (bool bDone = false; !bDone && (W5100Emu::now() < uLimit); )
+  {
+    local_server.serveHttpConnections();
+    bDone = true;
+    for (size_t u = 0; u < browsers.size(); ++u) bDone = bDone && browsers[u]->done();
+  }
+  // The server closes its side of the connections
+  for (bool bListening = false; !bListening && (W5100Emu::now() < uLimit); )
+  {
+    local_server.serveHttpConnections();
+    bListening = true;
+    for (uint8_t sn = 0; sn < HttpSvrConfig::sockets; ++sn)
+      bListening = bListening && (W5100Emu::status(sn) == W5100_SOCK_LISTEN);
+  }
+  aMonitor.onTimer(0);
+
+  for (size_t u = 0; u < local_requests.size(); ++u)
+  {
+    const local_request& req = local_requests[u];
+    printf("req %u %s %s %s %u %u %s %s %s %s %s\n", req.browser, req.kind, req.url.c_str(),
+           req.newConn ? "new" : "keep", req.retries, req.ok ? 1 : 0,
+           local_time(req.wanted).c_str(), local_time(req.sent).c_str(), local_time(req.arrived).c_str(),
+           local_time(req.started).c_str(), local_time(req.done).c_str());
+  }
+  printf("refused %u\n", local_refused);
+  printf("end %.3f\n", W5100Emu::now() / 1000.0);
+
+  W5100Emu::end();
+  for (size_t u = 0; u < browsers.size(); ++u) delete browsers[u];
+  return 0;
+}
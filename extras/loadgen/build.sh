@@ -0,0 +1,35 @@
+#!/bin/sh
+################################################################################
+#
+#  build.sh - Builds the HttpSvr load generator on a Linux host
+#
+#  ----------------------
+#
+#  Run from anywhere; "httpload" is written to the current directory, where
+#  extras/tools/loadgen.py looks for it (see its --sim option), e.g.
+#    extras/loadgen/build.sh && extras/tools/loadgen.py --asset /www/app.js
+#  Options of the server (HTTPSVR_SOCKETS...) can be given in CXXFLAGS.
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+
+# The library, less the SPI driver the emulation replaces
+SOURCES=""
+for f in "$ROOT"/*.cpp "$ROOT"/utility/*.cpp "$ROOT"/extras/host/*.cpp "$ROOT"/extras/loadgen/*.cpp; do
+  [ "$(basename "$f")" = "W5100Spi.cpp" ] || SOURCES="$SOURCES $f"
+done
+FLAGS="-std=gnu++98 -O2 -DHTTPSVR_BACKEND=0 \
+  -I$ROOT/extras/host -I$ROOT -I$ROOT/utility $CXXFLAGS"
+
+CXX=${CXX:-g++}
+$CXX $FLAGS $SOURCES -o httpload
+echo "built httpload"
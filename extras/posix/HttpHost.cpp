@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpHost.cpp - HttpSvr serving a directory on Linux, over POSIX sockets
+//
+//  ----------------------
+//
+//  The library is built with HTTPSVR_BACKEND_POSIX and the Arduino core and
+//  SD library of extras/host (see build.sh): the files of DIR are copied to
+//  the emulated SD card at startup, then served on PORT until the program is
+//  interrupted, e.g.
+//      tar xzf extras/SD-Card.tar.gz && ./httphost -port=8080 SD-Card
+//      curl http://127.0.0.1:8080/www/index.htm
+//  Files written by uploads stay on the emulated card.
+//
+//    httphost [-port=N] [DIR]
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include <SD.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "HttpSvr.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+static HttpSvr local_server;
+
+static unsigned local_load(const std::string& the_dir, const std::string& the_path)
+{
+  // Copies the files under the_dir to the card, at the_path
+  DIR * pDir = opendir(the_dir.c_str());
+  if (!pDir) return 0;
+  unsigned uFiles = 0;
+  for (dirent * pEntry; (pEntry = readdir(pDir)) != 0; )
+  {
+    if (pEntry->d_name[0] == '.') continue;
+    std::string sFrom = the_dir  + "/" + pEntry->d_name;
+    std::string sTo   = the_path + "/" + pEntry->d_name;
+    struct stat aStat;
+    if (stat(sFrom.c_str(), &aStat) != 0) continue;
+    if (S_ISDIR(aStat.st_mode))
+    {
+      SD.mkdir(sTo.c_str());
+      uFiles += local_load(sFrom, sTo);
+      continue;
+    }
+
+    FILE * pFile = fopen(sFrom.c_str(), "rb");
+    if (!pFile) continue;
+    std::vector<uint8_t> data;
+    uint8_t aBuffer[4096];
+    size_t uRead;
+    while ((uRead = fread(aBuffer, 1, sizeof(aBuffer), pFile)) > 0) data.insert(data.end(), aBuffer, aBuffer + uRead);
+    fclose(pFile);
+    SD.putFile(sTo.c_str(), data.empty() ? 0 : &data[0], data.size());
+    ++uFiles;
+  }
+  closedir(pDir);
+  return uFiles;
+}
+
+int main(int argc, char ** argv)
+{
+  uint16_t    uPort = 8080;
+  const char * sDir = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    if      (!strncmp(argv[i], "-port=", 6)) uPort = atoi(argv[i] + 6);
+    else if ((argv[i][0] != '-') && !sDir)   sDir  = argv[i];
+    else { fprintf(stderr, "usage: %s [-port=N] [DIR]\n", argv[0]); return 2; }
+  }
+
+  unsigned uFiles = sDir ? local_load(sDir, "") : 0;
+
+  // The MAC and IP addresses are those of the host: they are not used
+  static const uint8_t macAddress[] = { 0x90, 0xA2, 0xDA, 0x00, 0x00, 0x01 };
+  local_server.begin_noDHCP(10, 4, macAddress, IPAddress(127, 0, 0, 1), uPort);
+  fprintf(stderr, "httphost: %u files, listening on port %u\n", uFiles, uPort);
+
+  for (;;)
+  {
+    NetBackend::waitEvents(100);
+    local_server.serveHttpConnections();
+  }
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+################################################################################
+#
+#  build.sh - Builds HttpSvr for Linux, over POSIX sockets
+#
+#  ----------------------
+#
+#  Run from anywhere; "httphost" is written to the current directory (see
+#  HttpHost.cpp). The library is built with HTTPSVR_BACKEND_POSIX, on the
+#  Arduino core and SD library of extras/host; the SPI drivers of the W5100
+#  and W5500, and the W5100 emulation, are left out. Options of the server
+#  can be given in CXXFLAGS, e.g. CXXFLAGS=-DHTTPSVR_POSIX_SOCKETS=8
+#  (CXXFLAGS=-U__linux__ builds the poll variant of waitEvents, instead of
+#  epoll).
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+set -e
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+
+SOURCES=""
+for f in "$ROOT"/*.cpp "$ROOT"/utility/*.cpp "$ROOT"/extras/host/*.cpp "$ROOT"/extras/posix/*.cpp; do
+  case "$(basename "$f")" in
+    W5100Spi.cpp|W5500Spi.cpp|W5100Emu.cpp) ;;
+    *) SOURCES="$SOURCES $f" ;;
+  esac
+done
+FLAGS="-std=gnu++98 -O2 -DHTTPSVR_BACKEND=2 \
+  -I$ROOT/extras/host -I$ROOT -I$ROOT/utility $CXXFLAGS"
+
+CXX=${CXX:-g++}
+$CXX $FLAGS $SOURCES -o httphost
+echo "built httphost"
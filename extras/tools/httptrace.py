@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+################################################################################
+#
+#  httptrace.py - Decoder for HttpSvr request lifecycle traces
+#
+#  ----------------------
+#
+#  Reads a trace dumped by HttpTrace, either:
+#  * as binary, as sent by HttpSvr::sendTrace ("HTR1" header), e.g.
+#      curl -s http://192.168.0.27/trace -o trace.bin && httptrace.py trace.bin
+#  * as text, as printed by HttpTrace::dump on Serial (one event per line:
+#    "<us> <socket> <event> <arg>"), e.g. copied from the Serial monitor.
+#
+#  and prints one timeline per request, with the duration of each phase:
+#    parse   : from connection (or previous request) to request line parsed
+#    headers : from request line to end of headers
+#    handler : from handler start to handler end
+#    tail    : from handler end to close (or next request)
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+import struct
+import sys
+
+# Must match HttpTrace::event_e
+EVENTS = ["none", "connect", "requestLine", "headersDone", "handlerStart",
+          "handlerEnd", "send", "close", "timeout", "reset"]
+
+# Must match http_e::method
+METHODS = ["?", "OPTIONS", "GET", "HEAD", "POST", "PUT", "DELETE", "TRACE", "CONNECT"]
+
+
+def parse_binary(data):
+    if data[:4] != b"HTR1":
+        raise ValueError("not a HttpSvr binary trace")
+    count = data[4]
+    records = []
+    for i in range(count):
+        us, info, arg = struct.unpack_from("<IBB", data, 5 + 6 * i)
+        records.append((us, info >> 4, info & 0x0F, arg))
+    return records
+
+
+def parse_text(text):
+    records = []
+    for line in text.splitlines():
+        fields = line.split()
+        if len(fields) != 4 or not all(f.isdigit() for f in fields):
+            continue
+        records.append(tuple(int(f) for f in fields))
+    return records
+
+
+def unwrap(records):
+    # micros() wraps around every ~71 minutes: make timestamps monotonic
+    result, offset, last = [], 0, None
+    for us, sn, ev, arg in records:
+        if last is not None and us < last:
+            offset += 1 << 32
+        last = us
+        result.append((us + offset, sn, ev, arg))
+    return result
+
+
+class Request:
+    def __init__(self, sn, start):
+        self.sn = sn
+        self.start = start
+        self.marks = {}
+        self.method = "?"
+        self.route = None
+        self.ok = None
+        self.sends = 0
+        self.sendUnits = 0
+        self.end = None
+
+    def phase(self, a, b):
+        if a in self.marks and b in self.marks:
+            return "%8.2f" % ((self.marks[b] - self.marks[a]) / 1000.0)
+        return "%8s" % "-"
+
+
+def timelines(records):
+    open_req = {}
+    done = []
+
+    def finish(sn, us):
+        req = open_req.pop(sn, None)
+        if req is not None:
+            req.marks["end"] = us
+            done.append(req)
+
+    for us, sn, ev, arg in records:
+        name = EVENTS[ev] if ev < len(EVENTS) else "ev%d" % ev
+        if name == "connect":
+            finish(sn, us)
+            open_req[sn] = Request(sn, us)
+            open_req[sn].marks["begin"] = us
+        elif name == "requestLine":
+            req = open_req.get(sn)
+            if req is None or "requestLine" in req.marks:
+                # Keep-alive: a new request on the same connection
+                finish(sn, us)
+                req = open_req[sn] = Request(sn, us)
+                req.marks["begin"] = us
+            req.marks["requestLine"] = us
+            req.method = METHODS[arg] if arg < len(METHODS) else "?"
+        elif name in ("headersDone", "handlerStart", "handlerEnd"):
+            req = open_req.get(sn)
+            if req is None:
+                continue
+            req.marks.setdefault(name, us)
+            if name == "handlerStart":
+                req.route = "sd" if arg == 16 else ("-" if arg == 0xFF else str(arg))
+            if name == "handlerEnd":
+                req.ok = bool(arg)
+        elif name == "send":
+            req = open_req.get(sn)
+            if req is not None:
+                req.sends += 1
+                req.sendUnits += arg
+        elif name in ("close", "timeout", "reset"):
+            req = open_req.get(sn)
+            if req is not None and name != "close":
+                req.ok = False
+            finish(sn, us)
+
+    for sn in list(open_req):
+        req = open_req.pop(sn)
+        done.append(req)
+    done.sort(key=lambda r: r.start)
+    return done
+
+
+def main(argv):
+    if len(argv) != 2:
+        sys.stderr.write("usage: %s <trace.bin|trace.txt>\n" % argv[0])
+        return 2
+
+    data = open(argv[1], "rb").read()
+    records = parse_binary(data) if data[:4] == b"HTR1" else parse_text(data.decode("ascii", "replace"))
+    records = unwrap(records)
+    if not records:
+        print("no events")
+        return 1
+
+    t0 = records[0][0]
+    print("%10s %2s %-7s %5s %8s %8s %8s %8s %5s %7s %s" %
+          ("start_ms", "sn", "method", "route", "parse", "headers", "handler", "tail", "sends", "~bytes", "ok"))
+    for r in timelines(records):
+        print("%10.2f %2d %-7s %5s %s %s %s %s %5d %7d %s" %
+              ((r.start - t0) / 1000.0, r.sn, r.method, r.route or "-",
+               r.phase("begin", "requestLine"), r.phase("requestLine", "headersDone"),
+               r.phase("handlerStart", "handlerEnd"), r.phase("handlerEnd", "end"),
+               r.sends, r.sendUnits * 16, "-" if r.ok is None else ("yes" if r.ok else "NO")))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,409 @@
+#!/usr/bin/env python3
+################################################################################
+#
+#  loadgen.py - Load generator simulating browsers loading pages from HttpSvr
+#
+#  ----------------------
+#
+#  Each browser loads a page the way real browsers do: the HTML first, then
+#  its assets in parallel on up to 6 connections (more than the 4 sockets of
+#  the W5100), then periodic AJAX polls on the connections kept alive, e.g.
+#      loadgen.py --browsers 2 --asset /www/style.css --asset /www/app.js \
+#                 --poll /pins --rtt-ms 20 --loss 0.01
+#
+#  By default, the server is HttpSvr itself, run by extras/loadgen/HttpLoad.cpp
+#  on the emulated W5100 of extras/host, in virtual time: build it first with
+#  extras/loadgen/build.sh. Results then only depend on the options, the seed
+#  and the code of the server, so that a change of serveHttpConnections, of
+#  keep-alive or of the number of sockets can be compared under the same load:
+#    * the W5100 accepts a connection only on a free socket; otherwise it
+#      refuses it (--full rst: the browser retries a little later) or does
+#      not answer (--full drop: the SYN is sent again after 1 s, 2 s, 4 s)
+#    * segments are lost with probability --loss, and sent again after the
+#      retransmission time of their side
+#    * the page and assets are files of the SD card, the polled URL is bound
+#      to a provider, each with a body of --size bytes
+#  With --live HOST[:PORT], the same load is sent to a real server instead;
+#  RTT and slowness are then added by the client, and loss is not simulated.
+#
+#  The report gives, for each request, where its time went:
+#    conn  : waiting for a connection (browser limit, refused or lost SYNs)
+#    queue : in the W5100, waiting for the server busy with other sockets
+#            (simulation only)
+#    serve : from the moment the server began to read the request to the
+#            last byte of the response at the browser
+#    total : from the moment the browser wanted the resource to its last byte
+#    rtx   : refused connection attempts, and requests sent again after the
+#            server closed the connection
+#  then a timeline of the sockets of the server (simulation) or of the
+#  connections opened by browsers (live): '.' free, '-' connected and idle,
+#  '#' serving.
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+import argparse
+import os
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+# Segment size of the W5100 (MSS on Ethernet), read at once by live clients
+SEGMENT = 1460
+
+# Times at which a lost SYN is sent again, after the first one
+SYN_RETRIES_MS = [1000, 3000, 7000]
+
+
+class Request:
+    def __init__(self, browser, url, kind, wanted):
+        self.browser = browser
+        self.url = url
+        self.kind = kind          # "page", "asset" or "poll"
+        self.wanted = wanted      # When the browser wanted it
+        self.sent = None          # When it was sent on a connection
+        self.arrived = None       # When it reached the server
+        self.started = None       # When the server started serving it
+        self.done = None          # When the browser had the whole response
+        self.newConn = False
+        self.retries = 0
+        self.ok = True
+
+    def phases(self):
+        conn = self.sent - self.wanted if self.sent is not None else None
+        queue = self.started - self.arrived if None not in (self.started, self.arrived) else None
+        serve = self.done - self.started if None not in (self.done, self.started) else None
+        total = self.done - self.wanted if self.done is not None else None
+        return conn, queue, serve, total
+
+
+class Timeline:
+    # State changes of each socket (or connection), drawn in buckets of time
+    def __init__(self, count):
+        self.changes = [[(0.0, ".")] for _ in range(count)]
+
+    def set(self, idx, t, state):
+        while idx >= len(self.changes):
+            self.changes.append([(0.0, ".")])
+        self.changes[idx].append((t, state))
+
+    def draw(self, end, bucket, label):
+        lines = []
+        buckets = int(end // bucket) + 1
+        for idx, changes in enumerate(self.changes):
+            row = []
+            for b in range(buckets):
+                lo, hi = b * bucket, (b + 1) * bucket
+                # The state at the start of the bucket, and any state met inside;
+                # serving wins over idle, which wins over free
+                states = [s for t, s in changes if lo <= t < hi]
+                before = [s for t, s in changes if t < lo]
+                states.append(before[-1] if before else ".")
+                row.append("#" if "#" in states else ("-" if "-" in states else "."))
+            lines.append("%s%-2d %s" % (label, idx, "".join(row)))
+        return lines
+
+
+################################################################################
+# HttpSvr on the emulated W5100
+
+class SimRun:
+    def __init__(self, args):
+        self.args = args
+        self.timeline = Timeline(0)
+        self.requests = []
+        self.refused = 0
+        self.end = 0.0
+
+    def command(self):
+        a = self.args
+        cmd = [a.sim, "-browsers=%d" % a.browsers, "-connections=%d" % a.connections,
+               "-stagger-ms=%g" % a.stagger_ms, "-page=%s" % a.page,
+               "-poll-ms=%g" % a.poll_ms, "-duration-ms=%g" % a.duration_ms,
+               "-think-ms=%g" % a.think_ms, "-rtt-ms=%g" % a.rtt_ms, "-loss=%g" % a.loss,
+               "-client-kbps=%g" % a.client_kbps, "-full=%s" % a.full,
+               "-rst-retry-ms=%g" % a.rst_retry_ms, "-spi-ns=%d" % a.spi_ns, "-seed=%d" % a.seed]
+        cmd += ["-asset=%s" % url for url in a.asset]
+        cmd += ["-size=%s" % item for item in a.size]
+        if a.poll:
+            cmd.append("-poll=%s" % a.poll)
+        return cmd
+
+    def run(self):
+        if not os.path.exists(self.args.sim):
+            sys.exit("%s not found: build it with extras/loadgen/build.sh, or give --sim" % self.args.sim)
+        out = subprocess.run(self.command(), stdout=subprocess.PIPE, check=True,
+                             universal_newlines=True).stdout
+        time = lambda value: None if value == "-" else float(value)
+        for line in out.splitlines():
+            fields = line.split()
+            if fields[0] == "req":
+                req = Request(int(fields[1]), fields[3], fields[2], float(fields[7]))
+                req.newConn = fields[4] == "new"
+                req.retries = int(fields[5])
+                req.ok = fields[6] == "1"
+                req.sent, req.arrived, req.started, req.done = [time(f) for f in fields[8:12]]
+                self.requests.append(req)
+            elif fields[0] == "sock":
+                self.timeline.set(int(fields[1]), float(fields[2]), fields[3])
+            elif fields[0] == "refused":
+                self.refused = int(fields[1])
+            elif fields[0] == "end":
+                self.end = float(fields[1])
+
+
+################################################################################
+# Real server
+
+class LiveRun:
+    def __init__(self, args):
+        self.args = args
+        host, _, port = args.live.partition(":")
+        self.address = (host, int(port or 80))
+        self.t0 = time.monotonic()
+        self.lock = threading.Lock()
+        self.timeline = Timeline(0)
+        self.slots = 0
+        self.requests = []
+
+    def now(self):
+        return (time.monotonic() - self.t0) * 1000.0
+
+    def sleep(self, ms):
+        if ms > 0:
+            time.sleep(ms / 1000.0)
+
+    def run(self):
+        threads = [threading.Thread(target=self.browser, args=(b,)) for b in range(self.args.browsers)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+    def browser(self, idx):
+        a = self.args
+        self.sleep(idx * a.stagger_ms)
+        pool = []                              # Idle connections: (slot, socket)
+        poolLock = threading.Lock()
+        limit = threading.Semaphore(a.connections)
+
+        def fetch(url, kind):
+            req = Request(idx, url, kind, self.now())
+            with self.lock:
+                self.requests.append(req)
+            limit.acquire()
+            try:
+                with poolLock:
+                    conn = pool.pop() if pool else None
+                if conn is None:
+                    req.newConn = True
+                    conn = self.open(req)
+                if conn is None:
+                    req.ok = False
+                    req.done = self.now()
+                    return
+                if self.exchange(conn, req):
+                    with poolLock:
+                        pool.append(conn)
+                else:
+                    self.closeConn(conn)
+            finally:
+                limit.release()
+
+        fetch(a.page, "page")
+        self.sleep(a.think_ms)
+        workers = [threading.Thread(target=fetch, args=(url, "asset")) for url in a.asset]
+        for w in workers:
+            w.start()
+        for w in workers:
+            w.join()
+        while a.poll and self.now() < a.duration_ms:
+            fetch(a.poll, "poll")
+            self.sleep(a.poll_ms)
+        for conn in pool:
+            self.closeConn(conn)
+
+    def open(self, req):
+        a = self.args
+        for attempt in range(len(SYN_RETRIES_MS) + 1):
+            try:
+                self.sleep(a.rtt_ms / 2.0)
+                s = socket.create_connection(self.address, timeout=10)
+                self.sleep(a.rtt_ms / 2.0)
+                with self.lock:
+                    slot = self.slots
+                    self.slots += 1
+                    self.timeline.set(slot, self.now(), "-")
+                return (slot, s)
+            except OSError:
+                req.retries += 1
+                self.sleep(a.rst_retry_ms)
+        return None
+
+    def closeConn(self, conn):
+        slot, s = conn
+        s.close()
+        with self.lock:
+            self.timeline.set(slot, self.now(), ".")
+
+    def exchange(self, conn, req):
+        a = self.args
+        slot, s = conn
+        req.sent = self.now()
+        with self.lock:
+            self.timeline.set(slot, req.sent, "#")
+        try:
+            self.sleep(a.rtt_ms / 2.0)
+            req.started = self.now()
+            s.sendall(("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n" %
+                       (req.url, self.address[0])).encode("ascii"))
+            keep = self.readResponse(s)
+            self.sleep(a.rtt_ms / 2.0)
+            req.done = self.now()
+        except OSError:
+            req.ok, keep = False, False
+            req.done = self.now()
+        with self.lock:
+            self.timeline.set(slot, self.now(), "-")
+        return keep
+
+    def recv(self, s):
+        # A slow client reads at --client-kbps
+        data = s.recv(SEGMENT)
+        if self.args.client_kbps:
+            self.sleep(len(data) / self.args.client_kbps)
+        return data
+
+    def readResponse(self, s):
+        data = b""
+        while b"\r\n\r\n" not in data:
+            chunk = self.recv(s)
+            if not chunk:
+                raise OSError("connection closed in headers")
+            data += chunk
+        head, _, body = data.partition(b"\r\n\r\n")
+        headers = head.decode("latin-1").lower()
+        if headers.startswith("http/1.0"):
+            keep = "connection: keep-alive" in headers
+        else:
+            keep = "connection: close" not in headers
+        length = None
+        for line in headers.split("\r\n"):
+            if line.startswith("content-length:"):
+                length = int(line.split(":", 1)[1])
+        if "transfer-encoding: chunked" in headers:
+            while not body.endswith(b"0\r\n\r\n"):
+                chunk = self.recv(s)
+                if not chunk:
+                    raise OSError("connection closed in body")
+                body += chunk
+        elif length is not None:
+            while len(body) < length:
+                chunk = self.recv(s)
+                if not chunk:
+                    raise OSError("connection closed in body")
+                body += chunk
+        else:
+            # No length: the body ends when the server closes the connection
+            while self.recv(s):
+                pass
+            keep = False
+        return keep
+
+
+################################################################################
+
+def percentile(values, p):
+    if not values:
+        return None
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p * (len(values) - 1))))]
+
+
+def ms(value):
+    return "%8s" % "-" if value is None else "%8.1f" % value
+
+
+def report(requests, lines, refused, args):
+    print("%9s %2s %-6s %-24s %4s %s %s %s %s %3s %s" %
+          ("start_ms", "br", "kind", "url", "conn", "    conn", "   queue", "   serve", "   total", "rtx", "ok"))
+    for r in sorted(requests, key=lambda r: r.wanted):
+        conn, queue, serve, total = r.phases()
+        print("%9.1f %2d %-6s %-24s %4s %s %s %s %s %3d %s" %
+              (r.wanted, r.browser, r.kind, r.url[:24], "new" if r.newConn else "keep",
+               ms(conn), ms(queue), ms(serve), ms(total), r.retries, "yes" if r.ok else "NO"))
+
+    print("")
+    print("%-6s %5s %8s %8s %8s %8s" % ("kind", "count", "p50", "p90", "max", "conn_max"))
+    for kind in ("page", "asset", "poll"):
+        done = [r for r in requests if r.kind == kind and r.ok and r.done is not None]
+        if not done:
+            continue
+        totals = [r.phases()[3] for r in done]
+        conns = [r.phases()[0] for r in done]
+        print("%-6s %5d %s %s %s %s" % (kind, len(done), ms(percentile(totals, 0.5)),
+                                        ms(percentile(totals, 0.9)), ms(max(totals)), ms(max(conns))))
+    failed = len([r for r in requests if not r.ok])
+    print("failed requests: %d" % failed)
+    if refused is not None:
+        print("refused connections: %d" % refused)
+
+    print("")
+    print("timeline, %d ms per char" % args.bucket_ms)
+    for line in lines:
+        print(line)
+
+
+def parse_args(argv):
+    parser = argparse.ArgumentParser(description="Simulates browsers loading pages from HttpSvr")
+    parser.add_argument("--live", metavar="HOST[:PORT]", help="load a real server instead of the simulation")
+    parser.add_argument("--sim", default="./httpload", help="simulation, built by extras/loadgen/build.sh (default: ./httpload)")
+    parser.add_argument("--browsers", type=int, default=2, help="number of browsers (default: 2)")
+    parser.add_argument("--connections", type=int, default=6, help="connections per browser (default: 6)")
+    parser.add_argument("--stagger-ms", type=float, default=0, help="delay between browsers (default: 0)")
+    parser.add_argument("--page", default="/", help="URL of the page (default: /)")
+    parser.add_argument("--asset", action="append", default=[], help="URL of an asset of the page (repeatable)")
+    parser.add_argument("--poll", help="URL polled once the page is loaded")
+    parser.add_argument("--poll-ms", type=float, default=1000, help="polling period (default: 1000)")
+    parser.add_argument("--duration-ms", type=float, default=10000, help="end of polling (default: 10000)")
+    parser.add_argument("--think-ms", type=float, default=10, help="parsing of the HTML by the browser (default: 10)")
+    parser.add_argument("--rtt-ms", type=float, default=2, help="round trip time (default: 2)")
+    parser.add_argument("--loss", type=float, default=0, help="probability of losing a segment (simulation only)")
+    parser.add_argument("--client-kbps", type=float, default=0, help="reading speed of clients, kB/s (default: unlimited)")
+    parser.add_argument("--full", choices=("rst", "drop"), default="rst",
+                        help="connection attempts with no free socket are refused (rst) or lost (drop)")
+    parser.add_argument("--rst-retry-ms", type=float, default=250, help="delay before trying again after a refusal")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the losses (default: 1)")
+    parser.add_argument("--bucket-ms", type=float, default=100, help="time per char of the timeline (default: 100)")
+    sim = parser.add_argument_group("simulation")
+    sim.add_argument("--spi-ns", type=int, default=5000, help="time of an SPI frame, i.e. a byte of the W5100 (default: 5000)")
+    sim.add_argument("--size", action="append", default=[], metavar="URL=BYTES",
+                     help="size of the body of a response (repeatable; default: 1000)")
+    return parser.parse_args(argv[1:])
+
+
+def main(argv):
+    args = parse_args(argv)
+    if args.live:
+        run = LiveRun(args)
+        run.run()
+        end = run.now()
+        report(run.requests, run.timeline.draw(end, args.bucket_ms, "c"), None, args)
+        return 0
+
+    run = SimRun(args)
+    run.run()
+    report(run.requests, run.timeline.draw(run.end, args.bucket_ms, "s"), run.refused, args)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
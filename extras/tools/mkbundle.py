@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+################################################################################
+#
+#  mkbundle.py - Generator of flash bundles of web pages for HttpSvr
+#
+#  ----------------------
+#
+#  Packs all the files in a directory (the web root) into a C++ header that
+#  places them in program memory, to be served by HttpSvr without SD card
+#  (see FlashBundle), e.g.
+#      mkbundle.py www bundle.h
+#  and then, in the sketch:
+#      #include "bundle.h"
+#      server.setFlashBundle(bundle_entries, bundle_count);
+#
+#  Each file is stored with:
+#    * its path from the web root, as requested (e.g. "/css/style.css")
+#    * its media type, guessed from its extension
+#    * its content, gzipped if that makes it smaller (unless --no-gzip)
+#    * its ETag, the CRC16 of the stored content (same as crcsum in crc16.cpp)
+#  Entries are sorted by path, as HttpSvr looks them up by binary search.
+#
+#  ----------------------
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of either the GNU General Public License version 2
+# or the GNU Lesser General Public License version 2.1, both as
+# published by the Free Software Foundation.
+#
+################################################################################
+
+import argparse
+import gzip
+import os
+import sys
+
+# Media types by extension; anything else is sent as application/octet-stream.
+# Files on SD card get the same ones (see local_mimeTypes in HttpSvr.cpp)
+MIME_TYPES = {
+    ".htm":  "text/html",
+    ".html": "text/html",
+    ".css":  "text/css",
+    ".js":   "application/javascript",
+    ".json": "application/json",
+    ".txt":  "text/plain",
+    ".xml":  "text/xml",
+    ".svg":  "image/svg+xml",
+    ".png":  "image/png",
+    ".gif":  "image/gif",
+    ".jpg":  "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".ico":  "image/x-icon",
+    ".csv":  "text/csv",
+}
+
+# Already compressed formats are never gzipped
+NO_GZIP = {".png", ".gif", ".jpg", ".jpeg"}
+
+# Must match FlashBundle::flags_e
+FLAG_GZIP = 0x01
+
+# Must match FlashBundle::entry_t::size
+MAX_SIZE = 0xFFFF
+
+
+def crc16(data, crc=0xFFFF):
+    # Same as crcsum in utility/crc16.cpp (reflected CCITT polynomial, no final xor)
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def collect(root):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in sorted(filenames):
+            if name.startswith("."):
+                continue
+            full = os.path.join(dirpath, name)
+            path = "/" + os.path.relpath(full, root).replace(os.sep, "/")
+            files.append((path, full))
+    # Sorted as strcmp does, for the binary search in FlashBundle
+    files.sort(key=lambda f: f[0].encode("utf-8"))
+    return files
+
+
+def pack(path, full, use_gzip):
+    data = open(full, "rb").read()
+    ext = os.path.splitext(path)[1].lower()
+    flags = 0
+    if use_gzip and ext not in NO_GZIP:
+        # mtime=0 so that the same content always gives the same bundle and ETag
+        packed = gzip.compress(data, 9, mtime=0)
+        if len(packed) < len(data):
+            data, flags = packed, FLAG_GZIP
+    if len(data) > MAX_SIZE:
+        raise ValueError("%s: %d bytes, more than %d" % (path, len(data), MAX_SIZE))
+    return data, MIME_TYPES.get(ext, "application/octet-stream"), flags
+
+
+def c_string(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def c_bytes(data, indent="  "):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append(indent + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(lines)
+
+
+def generate(root, prefix, use_gzip):
+    files = collect(root)
+    if not files:
+        raise ValueError("%s: no files" % root)
+
+    out = []
+    out.append("// Generated by mkbundle.py from \"%s\" - do not edit" % os.path.basename(os.path.abspath(root)))
+    out.append("#ifndef %s_H" % prefix.upper())
+    out.append("#define %s_H" % prefix.upper())
+    out.append("")
+    out.append("#include <HttpSvr.h>")
+    out.append("")
+
+    mimes = {}
+    entries = []
+    total = 0
+    for i, (path, full) in enumerate(files):
+        data, mime, flags = pack(path, full, use_gzip)
+        if mime not in mimes:
+            mimes[mime] = "%s_m%d" % (prefix, len(mimes))
+            out.append("static const char    %s[] PROGMEM = %s;" % (mimes[mime], c_string(mime)))
+        out.append("static const char    %s_p%d[] PROGMEM = %s;" % (prefix, i, c_string(path)))
+        out.append("static const uint8_t %s_d%d[] PROGMEM = {" % (prefix, i))
+        out.append(c_bytes(data))
+        out.append("};")
+        entries.append("  { %s_p%d, %s, %s_d%d, %d, 0x%04x, %s }, // %s" %
+                       (prefix, i, mimes[mime], prefix, i, len(data), crc16(data),
+                        "FlashBundle::flag_gzip" if flags & FLAG_GZIP else "0", path))
+        total += len(data)
+
+    out.append("")
+    out.append("static const FlashBundle::entry_t %s_entries[] PROGMEM =" % prefix)
+    out.append("{")
+    out.extend(entries)
+    out.append("};")
+    out.append("static const uint16_t %s_count = sizeof(%s_entries) / sizeof(*%s_entries);" % (prefix, prefix, prefix))
+    out.append("")
+    out.append("#endif // #ifndef %s_H" % prefix.upper())
+    out.append("")
+    return "\n".join(out), len(files), total
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Packs a web root into a flash bundle for HttpSvr")
+    parser.add_argument("root", help="directory holding the web pages")
+    parser.add_argument("output", help="header file to generate")
+    parser.add_argument("--prefix", default="bundle", help="prefix of generated names (default: bundle)")
+    parser.add_argument("--no-gzip", action="store_true", help="store all files uncompressed")
+    args = parser.parse_args(argv[1:])
+
+    try:
+        text, count, total = generate(args.root, args.prefix, not args.no_gzip)
+    except (OSError, ValueError) as e:
+        sys.stderr.write("mkbundle: %s\n" % e)
+        return 1
+
+    with open(args.output, "w") as f:
+        f.write(text)
+    print("%s: %d files, %d bytes of data" % (args.output, count, total))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  FlashBundle.cpp - Definition of a read-only file system in flash memory
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "FlashBundle.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+FlashBundle::FlashBundle()
+: my_entries(0)
+, my_count(0)
+, my_open(false)
+, my_pos(0)
+{ memset(&my_current, 0, sizeof(my_current)); }
+
+FlashBundle::~FlashBundle()
+{}
+
+void FlashBundle::begin(const entry_t * the_entries, uint16_t the_count)
+{
+  closeCurrentResFile();
+  my_entries = the_entries;
+  my_count   = the_entries ? the_count : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool FlashBundle::resFileExists(const char * the_url) const
+{ return prv_find(the_url) >= 0; }
+
+uint32_t FlashBundle::resFileSize() const
+{ return my_open ? my_current.size : 0; }
+
+bool FlashBundle::openResFile(const char * the_url)
+{
+  closeCurrentResFile();
+  int16_t iEntry = prv_find(the_url);
+  if (iEntry < 0) return false;
+
+  memcpy_P(&my_current, &my_entries[iEntry], sizeof(my_current));
+  my_pos  = 0;
+  my_open = true;
+  return true;
+}
+
+void FlashBundle::closeCurrentResFile()
+{ my_open = false; }
+
+bool FlashBundle::isResFileOpen() const
+{ return my_open; }
+
+uint16_t FlashBundle::readResFileBuffer(uint8_t * the_buffer, uint16_t the_size)
+{
+  if (!the_buffer || !my_open) return 0;
+  uint16_t uRead = my_current.size - my_pos;
+  if (uRead > the_size) uRead = the_size;
+  memcpy_P(the_buffer, my_current.data + my_pos, uRead);
+  my_pos += uRead;
+  return uRead;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const __FlashStringHelper * FlashBundle::resFileMime() const
+{ return my_open ? reinterpret_cast<const __FlashStringHelper *>(my_current.mime) : 0; }
+
+uint16_t FlashBundle::resFileEtag() const
+{ return my_open ? my_current.etag : 0; }
+
+bool FlashBundle::isResFileGzip() const
+{ return my_open && (my_current.flags & flag_gzip); }
+
+////////////////////////////////////////////////////////////////////////////////
+
+int16_t FlashBundle::prv_find(const char * the_url) const
+{
+  // Binary search on paths, which the generator sorts as strcmp does
+  if (!the_url) return -1;
+  int16_t iLow  = 0;
+  int16_t iHigh = static_cast<int16_t>(my_count) - 1;
+  while (iLow <= iHigh)
+  {
+    int16_t iMid = (iLow + iHigh) / 2;
+    const char * pPath;
+    memcpy_P(&pPath, &my_entries[iMid].path, sizeof(pPath));
+    int iCmp = strcmp_P(the_url, pPath);
+    if (iCmp == 0) return iMid;
+    if (iCmp < 0) iHigh = iMid - 1;
+    else          iLow  = iMid + 1;
+  }
+  return -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  FlashBundle.h - Definition of a read-only file system in flash memory
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FLASHBUNDLE_H
+#define FLASHBUNDLE_H
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// FlashBundle serves files from a table in program memory, generated from a
+// directory of web pages by extras/tools/mkbundle.py. Each file comes with its
+// media type and ETag, and possibly gzipped, so that it is sent as it is.
+// Entries are sorted by path, so that a path is found by binary search.
+// Files are read like those on SD card (see SdSvr), with the same functions.
+// On AVR, tables and data are reached with 16-bit pointers, so the bundle must
+// lie in the lower 64 KB of flash; the linker places PROGMEM data there first.
+
+class FlashBundle
+{
+public:
+  enum flags_e
+  {
+    flag_gzip = 0x01    // Data are gzipped: sent with "Content-Encoding: gzip"
+  };
+  
+  struct entry_t
+  {
+    const char *    path;   // All in program memory
+    const char *    mime;
+    const uint8_t * data;
+    uint16_t        size;
+    uint16_t        etag;   // CRC16 of data
+    uint8_t         flags;
+  };
+
+public:
+  FlashBundle();
+  virtual ~FlashBundle();
+
+  void      begin               (const entry_t * the_entries, uint16_t the_count);
+  uint16_t  count               () const { return my_count; }
+
+public:
+  // Same as SdSvr
+  bool      resFileExists       (const char * the_url) const;
+  uint32_t  resFileSize         () const;
+  bool      openResFile         (const char * the_url);
+  void      closeCurrentResFile ();
+  bool      isResFileOpen       () const;
+  uint16_t  readResFileBuffer   (uint8_t * the_buffer, uint16_t the_size);
+
+  // Properties of the current file
+  const __FlashStringHelper * resFileMime () const;
+  uint16_t  resFileEtag         () const;
+  bool      isResFileGzip       () const;
+
+private:
+  int16_t   prv_find            (const char * the_url) const;
+
+private:
+  const entry_t * my_entries;
+  uint16_t        my_count;
+  entry_t         my_current;   // Copy in RAM of the entry of the current file
+  bool            my_open;
+  uint16_t        my_pos;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef FLASHBUNDLE_H
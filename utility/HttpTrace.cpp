@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpTrace.cpp - Definition of the request lifecycle trace buffer
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "HttpTrace.h"
+
+#if HTTPSVR_TRACE
+
+////////////////////////////////////////////////////////////////////////////////
+
+static HttpTrace::record_t local_ring[HTTPSVR_TRACE_EVENTS];
+static uint8_t             local_next  = 0;   // Where the next record will be written
+static uint8_t             local_count = 0;   // Number of valid records
+static bool                local_suspended = false;
+
+////////////////////////////////////////////////////////////////////////////////
+
+void HttpTrace::record(event_e the_event, uint8_t the_socket, uint8_t the_arg)
+{
+  if (local_suspended) return;
+
+  record_t& r = local_ring[local_next];
+  r.us   = micros();
+  r.info = static_cast<uint8_t>((the_socket << 4) | (the_event & 0x0F));
+  r.arg  = the_arg;
+
+  if (++local_next >= HTTPSVR_TRACE_EVENTS) local_next = 0;
+  if (local_count < HTTPSVR_TRACE_EVENTS) ++local_count;
+}
+
+void HttpTrace::clear()
+{ local_next = local_count = 0; }
+
+void HttpTrace::suspend()
+{ local_suspended = true; }
+
+void HttpTrace::resume()
+{ local_suspended = false; }
+
+uint8_t HttpTrace::size()
+{ return local_count; }
+
+HttpTrace::record_t HttpTrace::at(uint8_t the_index)
+{
+  // Records are indexed from the oldest (0) to the newest (size()-1)
+  record_t r = { 0, 0, 0 };
+  if (the_index >= local_count) return r;
+
+  uint16_t u = local_next + HTTPSVR_TRACE_EVENTS - local_count + the_index;
+  return local_ring[u % HTTPSVR_TRACE_EVENTS];
+}
+
+void HttpTrace::dump(Print& the_out)
+{
+  // One event per line: "<us> <socket> <event> <arg>"
+  for (uint8_t u = 0; u < local_count; ++u)
+  {
+    record_t r = at(u);
+    the_out.print(r.us);
+    the_out.print(' ');
+    the_out.print(static_cast<unsigned int>(r.info >> 4));
+    the_out.print(' ');
+    the_out.print(static_cast<unsigned int>(r.info & 0x0F));
+    the_out.print(' ');
+    the_out.println(static_cast<unsigned long>(r.arg));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #if HTTPSVR_TRACE
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  HttpTrace.h - Definition of the request lifecycle trace buffer
+//
+//  ----------------------
+//
+//  HttpTrace records timestamped events (connection, request line parsed,
+//  headers done, handler start/end, each SEND command, close...) in a small
+//  ring buffer in RAM. The buffer can be dumped as text on any Print object
+//  (e.g. Serial) or as binary over HTTP (see HttpSvr::sendTrace), and decoded
+//  into per-request timelines by extras/tools/httptrace.py.
+//
+//  Tracing is enabled at compile time by defining HTTPSVR_TRACE to 1, and the
+//  ring holds HTTPSVR_TRACE_EVENTS records (see HttpSvrConfig.h). When tracing
+//  is disabled, HttpTrace_EVENT expands to nothing and no RAM is used.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HTTPTRACE_H
+#define HTTPTRACE_H
+
+#include <Arduino.h>
+#include "../HttpSvrConfig.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+class HttpTrace
+{
+public:
+  // Event identifiers. Their values are part of the dump format:
+  // do not reorder, only append.
+  enum event_e
+  {
+    ev_none         = 0,
+    ev_connect      ,   // arg: unused
+    ev_requestLine  ,   // arg: http_e::method
+    ev_headersDone  ,   // arg: unused
+    ev_handlerStart ,   // arg: route index (0xFF: none)
+    ev_handlerEnd   ,   // arg: 1 if successful, 0 otherwise
+    ev_send         ,   // arg: bytes passed to SEND command, in units of 16 bytes (saturated)
+    ev_close        ,   // arg: unused
+    ev_timeout      ,   // arg: unused
+    ev_reset            // arg: unused
+  };
+
+  // A single trace record. "info" holds the socket number in the high nibble
+  // and the event identifier in the low nibble.
+  struct record_t
+  {
+    uint32_t us;
+    uint8_t  info;
+    uint8_t  arg;
+  };
+
+public:
+  static void         record              (event_e the_event, uint8_t the_socket, uint8_t the_arg);
+  static void         clear               ();
+  static uint8_t      size                ();
+  static record_t     at                  (uint8_t the_index);
+  static void         dump                (Print& the_out);
+
+  // While suspended, events are not recorded, so that the records can be read
+  // by code which itself records events (e.g. HttpSvr::sendTrace)
+  static void         suspend             ();
+  static void         resume              ();
+
+  // Argument of ev_send for a given number of bytes
+  static uint8_t      sendArg             (uint16_t the_size) { return (the_size >> 4) > 0xFF ? 0xFF : (the_size >> 4); }
+
+private:
+  HttpTrace(); // An object of this class cannot be instantiated
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_TRACE
+#  define HttpTrace_EVENT(ev, sn, arg) HttpTrace::record(HttpTrace::ev, static_cast<uint8_t>(sn), static_cast<uint8_t>(arg))
+#else
+#  define HttpTrace_EVENT(ev, sn, arg) ((void)0)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef HTTPTRACE_H
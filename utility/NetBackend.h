@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  NetBackend.h - Selection of the network driver used by HttpSvr
+//
+//  ----------------------
+//
+//  HttpSvr and ClientProxy talk to the network through NetBackend, a typedef
+//  of the driver selected by HTTPSVR_BACKEND (see HttpSvrConfig.h):
+//
+//    HTTPSVR_BACKEND_W5100  W5100     4 sockets, 2 KB buffers, one SPI frame per byte
+//    HTTPSVR_BACKEND_W5500  W5500     8 sockets, 2 KB per socket, burst SPI
+//    HTTPSVR_BACKEND_POSIX  PosixNet  HTTPSVR_POSIX_SOCKETS sockets, non-blocking
+//                                     sockets and epoll (Linux)
+//
+//  A driver is a class with static members only, as the server owns the
+//  network interface and there is never more than one of them. It provides:
+//
+//  * socket_e, the socket numbers, from socket_begin to socket_end (excluded),
+//    with socket_undefined for no socket, and socket_cast to convert integers;
+//  * retcode_e, the return codes, with at least the ones of W5100::retcode_e
+//    that the server checks (rc_ok, rc_not_connected, rc_no_data, rc_send_pending);
+//  * mac_address_t and ipv4_address_t, built from bytes, from a socket (address
+//    of the peer) or with no argument (address of the interface), with a0..a5
+//    and ip0..ip3 accessors;
+//  * begin/terminate, open/listen of a socket on a port, checkClientConn to
+//    accept a connection on a listening socket, close, isClosed, isConnected;
+//  * receive, checkReceivePending and waitReceivePending;
+//  * send, which copies data to the tx memory of the socket and returns the
+//    amount copied (0 when it is full); checkSendCompleted and waitSendCompleted,
+//    which push queued data out and tell when they have all been acknowledged;
+//    waitSendSpace, called when send has taken nothing: the W5100 and W5500
+//    push queued data out as checkSendCompleted does, while PosixNet waits
+//    until the system takes more, with a deadline, so that a peer that stops
+//    reading neither spins the host nor holds the server;
+//    txSizeQueued, the data not yet passed to the chip (or system) for sending,
+//    known without any SPI access; canTransmitData, txMemSize and txSizePending,
+//    for the free space;
+//  * localPort, remotePort and setNoDelayedAck;
+//  * waitEvents, which waits until some socket may need service, or the timeout
+//    expires: the W5100 and W5500 are polled and return at once, while PosixNet
+//    sleeps in epoll_wait, so that a host build does not spin;
+//  * suspendBus/resumeBus, which let the SD card use the SPI bus while the
+//    driver is in the middle of a transaction, and spiAccesses.
+//
+//  The driver is chosen at compile time rather than through a template
+//  parameter of HttpSvr and ClientProxy: the library is made of separate
+//  translation units, as the Arduino IDE builds it, and the server code is
+//  compiled once for the driver of the build. Only the selected driver is
+//  compiled in.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NETBACKEND_H
+#define NETBACKEND_H
+
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
+#  include "W5500.h"
+   typedef W5500 NetBackend;
+#elif HTTPSVR_BACKEND == HTTPSVR_BACKEND_POSIX
+#  include "PosixNet.h"
+   typedef PosixNet NetBackend;
+#else
+#  include "W5100.h"
+   typedef W5100 NetBackend;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef NETBACKEND_H
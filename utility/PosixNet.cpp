@@ -0,0 +1,589 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  PosixNet.cpp - Definition of POSIX sockets driver
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_POSIX
+
+#include "PosixNet.h"
+#include "HttpTrace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#if defined(__linux__)
+#  include <sys/epoll.h>
+#  include <linux/sockios.h>
+#endif
+
+PosixNet::slot_t PosixNet::smy_slots[PosixNet::socket_end];
+int      PosixNet::smy_listenFd    = -1;
+uint16_t PosixNet::smy_listenPort  = 0;
+bool     PosixNet::smy_listenReady = false;
+bool     PosixNet::smy_listenArmed = false;
+int      PosixNet::smy_pollFd      = -1;
+bool     PosixNet::smy_polled      = false;
+uint8_t  PosixNet::smy_macAddr[6];
+uint8_t  PosixNet::smy_ipAddr[4];
+
+// Longest wait for the peer to acknowledge data, as the idle timeout of
+// connections (see ClientProxy::connTimeoutExpired)
+static const unsigned long local_msSendTimeout = 5000;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static bool local_wouldBlock()
+{ return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR); }
+
+static bool local_setNonBlocking(int the_fd)
+{
+  int iFlags = fcntl(the_fd, F_GETFL, 0);
+  return (iFlags >= 0) && (fcntl(the_fd, F_SETFL, iFlags | O_NONBLOCK) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Initialization and termination
+
+void PosixNet::begin(const mac_address_t& the_macAddr, const ipv4_address_t& the_ipAddr)
+{
+  terminate();
+
+  // A peer closing its connection must not kill the process when data are sent
+  signal(SIGPIPE, SIG_IGN);
+
+  smy_macAddr[0] = the_macAddr.a0(); smy_macAddr[1] = the_macAddr.a1(); smy_macAddr[2] = the_macAddr.a2();
+  smy_macAddr[3] = the_macAddr.a3(); smy_macAddr[4] = the_macAddr.a4(); smy_macAddr[5] = the_macAddr.a5();
+  smy_ipAddr[0]  = the_ipAddr.ip0(); smy_ipAddr[1]  = the_ipAddr.ip1();
+  smy_ipAddr[2]  = the_ipAddr.ip2(); smy_ipAddr[3]  = the_ipAddr.ip3();
+
+#if defined(__linux__)
+  smy_pollFd = epoll_create(socket_end + 1);
+#endif
+}
+
+void PosixNet::terminate()
+{
+  // Close all connections and the listening socket
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    close(socket_cast(sn));
+
+  if (smy_listenFd >= 0) ::close(smy_listenFd);
+  if (smy_pollFd   >= 0) ::close(smy_pollFd);
+  smy_listenFd    = -1;
+  smy_listenPort  = 0;
+  smy_listenReady = false;
+  smy_listenArmed = false;
+  smy_pollFd      = -1;
+  smy_polled      = false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Socket command functions
+
+PosixNet::retcode_e PosixNet::open(socket_e the_socket, uint16_t the_port)
+{
+  // Check preconditions: slot must be closed or opened
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  slot_t& sl = smy_slots[the_socket];
+  if ((sl.state != st_closed) && (sl.state != st_init))
+    return rc_invalid_status;
+
+  // All slots share the listening socket, hence its port
+  if (smy_listenFd < 0)
+  {
+    if (!prv_openListener(the_port)) return rc_open_failed;
+  }
+  else if (the_port != smy_listenPort)
+    return rc_invalid_port;
+
+  sl.state = st_init;
+  return rc_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::listen(socket_e the_socket)
+{
+  // Check preconditions: slot must be opened
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (smy_slots[the_socket].state != st_init)
+    return rc_invalid_status;
+
+  smy_slots[the_socket].state = st_listen;
+  return rc_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::checkClientConn(socket_e the_socket)
+{
+  // Check for client connection (non blocking)
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+
+  switch (smy_slots[the_socket].state)
+  {
+  case st_listen:
+    return prv_accept(the_socket);
+
+  case st_connected:
+    return rc_ok;
+
+  default:
+    return rc_invalid_status;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::close(socket_e the_socket)
+{
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+
+  // Closing the socket also removes it from the epoll instance
+  slot_t& sl = smy_slots[the_socket];
+  if (sl.state == st_connected) ::close(sl.fd);
+  sl.fd     = -1;
+  sl.state  = st_closed;
+  sl.ready  = false;
+  sl.txSize = 0;
+  return rc_ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t PosixNet::send(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  // This function does not wait: it returns the amount of data taken by the system
+  if (!isConnected(the_socket)) return 0;
+
+  ssize_t iSent = ::send(smy_slots[the_socket].fd, the_buffer, the_size, 0);
+  if (iSent > 0)
+  {
+    HttpTrace_EVENT(ev_send, the_socket, HttpTrace::sendArg(static_cast<uint16_t>(iSent)));
+    return static_cast<uint16_t>(iSent);
+  }
+  if ((iSent < 0) && !local_wouldBlock()) prv_drop(the_socket);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::checkSendCompleted(socket_e the_socket)
+{
+  // Check for acknowledgement of all data sent (non blocking), as the W5100
+  // driver does: the system does not take more than its send buffer anyway
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (!isConnected(the_socket))
+    return rc_invalid_status;
+
+  return (txSizePending(the_socket) == 0 ? rc_ok : rc_send_pending);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::waitSendCompleted(socket_e the_socket)
+{
+  // Wait for completion of data transmission (blocking). The system tells
+  // when there is room in its send buffer, not when data are acknowledged:
+  // the queue is checked every millisecond, sleeping in poll in between
+  // (which returns at once if the connection fails), up to a deadline
+  unsigned long msStart = millis();
+  retcode_e rc;
+  while ((rc = checkSendCompleted(the_socket)) == rc_send_pending)
+  {
+    if (millis() - msStart >= local_msSendTimeout) return rc_send_timeout;
+
+    pollfd aFd;
+    aFd.fd      = smy_slots[the_socket].fd;
+    aFd.events  = 0;
+    aFd.revents = 0;
+    if ((poll(&aFd, 1, 1) > 0) && (aFd.revents & (POLLERR | POLLHUP)))
+    {
+      prv_drop(the_socket);
+      return rc_invalid_status;
+    }
+  }
+  return rc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::waitSendSpace(socket_e the_socket)
+{
+  // Wait until the system takes more data (blocking), sleeping in poll, up
+  // to the deadline of waitSendCompleted: rc_send_timeout if the peer does
+  // not read in the meantime
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (!isConnected(the_socket))
+    return rc_invalid_status;
+
+  unsigned long msStart = millis();
+  while (true)
+  {
+    unsigned long msElapsed = millis() - msStart;
+    if (msElapsed >= local_msSendTimeout) return rc_send_timeout;
+
+    pollfd aFd;
+    aFd.fd      = smy_slots[the_socket].fd;
+    aFd.events  = POLLOUT;
+    aFd.revents = 0;
+    int iReady = poll(&aFd, 1, static_cast<int>(local_msSendTimeout - msElapsed));
+    if ((iReady < 0) && (errno == EINTR)) continue;
+    if ((iReady < 0) || (aFd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+    {
+      prv_drop(the_socket);
+      return rc_invalid_status;
+    }
+    if (aFd.revents & POLLOUT) return rc_ok;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t PosixNet::receive(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  if (!isConnected(the_socket)) return 0;
+
+  ssize_t iRead = ::recv(smy_slots[the_socket].fd, the_buffer, the_size, 0);
+  if (iRead > 0) return static_cast<uint16_t>(iRead);
+
+  // End of stream (the peer has closed the connection) or failure
+  if ((iRead < 0) && local_wouldBlock()) smy_slots[the_socket].ready = false;
+  else                                   prv_drop(the_socket);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::checkReceivePending(socket_e the_socket)
+{
+  // Check for received data (non blocking): when waitEvents is used,
+  // slots it has not marked are known to have no data
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (!isConnected(the_socket))
+    return rc_invalid_status;
+  if (smy_polled && !smy_slots[the_socket].ready)
+    return rc_no_data;
+
+  return prv_peek(the_socket);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::retcode_e PosixNet::waitReceivePending(socket_e the_socket)
+{
+  // Wait for received data (blocking), sleeping until the socket is readable
+  for (;;)
+  {
+    if (!prv_isValidSocket(the_socket))
+      return rc_invalid_socket;
+    if (!isConnected(the_socket))
+      return rc_invalid_status;
+
+    retcode_e rc = prv_peek(the_socket);
+    if (rc != rc_no_data) return rc;
+
+    pollfd aFd;
+    aFd.fd     = smy_slots[the_socket].fd;
+    aFd.events = POLLIN;
+    poll(&aFd, 1, -1);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Socket status inquiry functions
+
+uint16_t PosixNet::txMemSize(socket_e the_socket)
+{ return (isConnected(the_socket) ? smy_slots[the_socket].txSize : 0); }
+
+uint16_t PosixNet::txSizePending(socket_e the_socket)
+{
+  // Data not yet acknowledged by the peer
+  if (!isConnected(the_socket)) return 0;
+#if defined(SIOCOUTQ)
+  int iPending = 0;
+  if (ioctl(smy_slots[the_socket].fd, SIOCOUTQ, &iPending) < 0) return 0;
+  return (iPending > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(iPending));
+#else
+  // Not known: data are considered sent once taken by the system
+  return 0;
+#endif
+}
+
+bool PosixNet::isClosed(socket_e the_socket)
+{ return !prv_isValidSocket(the_socket) || (smy_slots[the_socket].state == st_closed); }
+
+bool PosixNet::isConnected(socket_e the_socket)
+{ return prv_isValidSocket(the_socket) && (smy_slots[the_socket].state == st_connected); }
+
+bool PosixNet::canTransmitData(socket_e the_socket)
+{ return isConnected(the_socket); }
+
+uint16_t PosixNet::localPort(socket_e the_socket)
+{ return (prv_isValidSocket(the_socket) ? smy_listenPort : 0); }
+
+uint16_t PosixNet::remotePort(socket_e the_socket)
+{
+  uint16_t uPort = 0;
+  return (prv_peerAddress(the_socket, 0, &uPort) ? uPort : 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Events
+
+bool PosixNet::waitEvents(uint16_t the_msTimeout)
+{
+  // Marks the slots with pending data, and the listening socket if a
+  // connection is pending. Slots which are not marked are not looked at
+  // by checkReceivePending until the next call.
+#if defined(__linux__)
+  if (smy_pollFd < 0) return true;
+#endif
+  smy_polled = true;
+
+  // Pending connections are only looked at while a slot can take them:
+  // otherwise they would wake this function up at once, again and again
+  bool bListening = false;
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    if (smy_slots[sn].state == st_listen) bListening = true;
+
+#if defined(__linux__)
+  // Sockets are registered in the epoll instance when they are created:
+  // the slot number (socket_end for the listening socket) is the event data
+  if ((smy_listenFd >= 0) && (bListening != smy_listenArmed))
+  {
+    epoll_event anEvent;
+    memset(&anEvent, 0, sizeof(anEvent));
+    anEvent.events   = (bListening ? static_cast<uint32_t>(EPOLLIN) : 0);
+    anEvent.data.u32 = socket_end;
+    epoll_ctl(smy_pollFd, EPOLL_CTL_MOD, smy_listenFd, &anEvent);
+    smy_listenArmed = bListening;
+  }
+
+  epoll_event aEvents[socket_end + 1];
+  int iEvents = epoll_wait(smy_pollFd, aEvents, socket_end + 1, the_msTimeout);
+  for (int i = 0; i < iEvents; ++i)
+  {
+    uint32_t u = aEvents[i].data.u32;
+    if (u == socket_end) smy_listenReady = true;
+    else if (u < socket_end) smy_slots[u].ready = true;
+  }
+#else
+  pollfd  aFds[socket_end + 1];
+  uint8_t aSlots[socket_end + 1];
+  nfds_t  uFds = 0;
+  if ((smy_listenFd >= 0) && bListening)
+  {
+    aFds[uFds].fd = smy_listenFd; aFds[uFds].events = POLLIN; aSlots[uFds++] = socket_end;
+  }
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+  {
+    if (smy_slots[sn].state != st_connected) continue;
+    aFds[uFds].fd = smy_slots[sn].fd; aFds[uFds].events = POLLIN; aSlots[uFds++] = sn;
+  }
+  int iEvents = poll(aFds, uFds, the_msTimeout);
+  for (nfds_t i = 0; (iEvents > 0) && (i < uFds); ++i)
+  {
+    if (!aFds[i].revents) continue;
+    if (aSlots[i] == socket_end) smy_listenReady = true;
+    else smy_slots[aSlots[i]].ready = true;
+  }
+#endif
+
+  return iEvents > 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Private member functions
+
+bool PosixNet::prv_isValidSocket(socket_e the_socket)
+{ return (the_socket >= socket_begin) && (the_socket < socket_end); }
+
+bool PosixNet::prv_openListener(uint16_t the_port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+
+  int iOn = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &iOn, sizeof(iOn));
+
+  sockaddr_in anAddr;
+  memset(&anAddr, 0, sizeof(anAddr));
+  anAddr.sin_family      = AF_INET;
+  anAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+  anAddr.sin_port        = htons(the_port);
+
+  if ((bind(fd, reinterpret_cast<sockaddr *>(&anAddr), sizeof(anAddr)) < 0) ||
+      (::listen(fd, socket_end) < 0) ||
+      !local_setNonBlocking(fd))
+  {
+    ::close(fd);
+    return false;
+  }
+
+#if defined(__linux__)
+  epoll_event anEvent;
+  memset(&anEvent, 0, sizeof(anEvent));
+  anEvent.events   = EPOLLIN;
+  anEvent.data.u32 = socket_end;
+  epoll_ctl(smy_pollFd, EPOLL_CTL_ADD, fd, &anEvent);
+#endif
+
+  smy_listenFd    = fd;
+  smy_listenPort  = the_port;
+  smy_listenReady = true;
+  smy_listenArmed = true;
+  return true;
+}
+
+PosixNet::retcode_e PosixNet::prv_accept(socket_e the_socket)
+{
+  // The first listening slot to look takes the next pending connection
+  if (smy_polled && !smy_listenReady) return rc_not_connected;
+
+  int fd = accept(smy_listenFd, 0, 0);
+  if (fd < 0)
+  {
+    if (local_wouldBlock()) smy_listenReady = false;
+    return rc_not_connected;
+  }
+
+  int iOn = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iOn, sizeof(iOn));
+  if (!local_setNonBlocking(fd)) { ::close(fd); return rc_not_connected; }
+
+  int       iSize = 0;
+  socklen_t uLen  = sizeof(iSize);
+  getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &iSize, &uLen);
+
+#if defined(__linux__)
+  epoll_event anEvent;
+  memset(&anEvent, 0, sizeof(anEvent));
+  anEvent.events   = EPOLLIN | EPOLLRDHUP;
+  anEvent.data.u32 = the_socket;
+  epoll_ctl(smy_pollFd, EPOLL_CTL_ADD, fd, &anEvent);
+#endif
+
+  // The request may have come with the connection
+  slot_t& sl = smy_slots[the_socket];
+  sl.fd     = fd;
+  sl.state  = st_connected;
+  sl.ready  = true;
+  sl.txSize = (iSize > 0xFFFF ? 0xFFFF : (iSize > 0 ? static_cast<uint16_t>(iSize) : 0));
+  return rc_ok;
+}
+
+PosixNet::retcode_e PosixNet::prv_peek(socket_e the_socket)
+{
+  slot_t& sl = smy_slots[the_socket];
+  uint8_t aByte;
+  ssize_t iRead = ::recv(sl.fd, &aByte, 1, MSG_PEEK);
+  if (iRead > 0) return rc_ok;
+
+  if ((iRead < 0) && local_wouldBlock())
+  {
+    sl.ready = false;
+    return rc_no_data;
+  }
+
+  // End of stream (the peer has closed the connection) or failure
+  prv_drop(the_socket);
+  return rc_invalid_status;
+}
+
+void PosixNet::prv_drop(socket_e the_socket)
+{
+  // The connection is lost: the slot is closed, to be reopened by the server
+  close(the_socket);
+}
+
+bool PosixNet::prv_peerAddress(socket_e the_socket, uint8_t * the_ip, uint16_t * the_port)
+{
+  if (!isConnected(the_socket)) return false;
+
+  sockaddr_in anAddr;
+  socklen_t   uLen = sizeof(anAddr);
+  if (getpeername(smy_slots[the_socket].fd, reinterpret_cast<sockaddr *>(&anAddr), &uLen) < 0) return false;
+  if (anAddr.sin_family != AF_INET) return false;
+
+  if (the_ip)   memcpy(the_ip, &anAddr.sin_addr.s_addr, 4);
+  if (the_port) *the_port = ntohs(anAddr.sin_port);
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::mac_address_t::mac_address_t()
+{ memcpy(my_addr, PosixNet::smy_macAddr, sizeof(my_addr)); }
+
+PosixNet::mac_address_t::mac_address_t(socket_e /*the_socket*/)
+{ memset(my_addr, 0, sizeof(my_addr)); }
+
+PosixNet::mac_address_t::mac_address_t(uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4, uint8_t a5)
+{
+  my_addr[0] = a0;
+  my_addr[1] = a1;
+  my_addr[2] = a2;
+  my_addr[3] = a3;
+  my_addr[4] = a4;
+  my_addr[5] = a5;
+}
+
+PosixNet::mac_address_t::mac_address_t(const uint8_t * the_mac)
+{ memcpy(my_addr, the_mac, sizeof(my_addr)); }
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+PosixNet::ipv4_address_t::ipv4_address_t()
+{ memcpy(my_addr, PosixNet::smy_ipAddr, sizeof(my_addr)); }
+
+PosixNet::ipv4_address_t::ipv4_address_t(socket_e the_socket)
+{
+  if (!PosixNet::prv_peerAddress(the_socket, my_addr, 0))
+    memset(my_addr, 0, sizeof(my_addr));
+}
+
+PosixNet::ipv4_address_t::ipv4_address_t(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3)
+{
+  my_addr[0] = ip0;
+  my_addr[1] = ip1;
+  my_addr[2] = ip2;
+  my_addr[3] = ip3;
+}
+
+PosixNet::ipv4_address_t::ipv4_address_t(const uint8_t * the_ip)
+{ memcpy(my_addr, the_ip, sizeof(my_addr)); }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // #if HTTPSVR_BACKEND == HTTPSVR_BACKEND_POSIX
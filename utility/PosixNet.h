@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  PosixNet.h - Definition of POSIX sockets driver
+//
+//  ----------------------
+//
+//  Same interface as the W5100 driver (see W5100.h), on the sockets of a POSIX
+//  system, so that HttpSvr can be run, debugged and profiled on a host at full
+//  speed (with an emulation of the Arduino core for millis, IPAddress, SD...).
+//
+//  Each socket of the driver is a slot holding at most one connection, as a
+//  socket of the W5100 does. All slots share a single listening socket, bound
+//  to any address of the host on the port of the first "open" (the address
+//  given to "begin" is only reported by ipv4_address_t). A listening slot takes
+//  the next pending connection in checkClientConn. All sockets are non-blocking
+//  and Nagle's algorithm is disabled, as the W5100 sends what it is given.
+//
+//  A peer closing its side of the connection closes the slot: unlike a W5100
+//  socket, it does not stay in CLOSE_WAIT, waiting for the server to close it.
+//
+//  waitEvents sleeps in epoll_wait (poll on systems other than Linux) until
+//  a connection or data are pending, or until the timeout expires, and marks
+//  the slots which need service: until the next call, the others are reported
+//  without system calls as having no data. A host program serves connections
+//  with a loop such as
+//      for (;;) { NetBackend::waitEvents(100); server.serveHttpConnections(); }
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef POSIXNET_H
+#define POSIXNET_H
+
+#include <Arduino.h>
+#include "../HttpSvrConfig.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+class PosixNet
+{
+public:
+  /////////////////////////////////////////////////////////
+  // Socket numbers
+  enum socket_e
+  {
+    socket_undefined = -1,
+    socket_begin = 0,
+    socket_end = HTTPSVR_POSIX_SOCKETS
+  };
+
+  template<typename T>
+  static inline socket_e socket_cast(T u)
+  { return static_cast<socket_e>(u); }
+
+  /////////////////////////////////////////////////////////
+  // Return codes
+  enum retcode_e
+  {
+    rc_ok                 = 0,
+    rc_invalid_status     ,
+    rc_invalid_socket     ,
+    rc_invalid_port       ,
+    rc_open_failed        ,
+    rc_listen_failed      ,
+    rc_connect_failed     ,
+    rc_connect_timeout    ,
+    rc_disconnect_failed  ,
+    rc_disconnect_timeout ,
+    rc_not_connected      ,
+    rc_close_failed       ,
+    rc_no_data            ,
+    rc_send_pending       ,
+    rc_send_timeout       ,
+    rc_unknown
+  };
+
+  /////////////////////////////////////////////////////////
+  // Utility class for manipulation of MAC address
+  class mac_address_t
+  {
+  public:
+    // The address given to "begin"; the address of peers is not known
+    // to sockets, so the second form gives 00:00:00:00:00:00
+    mac_address_t();
+    explicit mac_address_t(socket_e the_socket);
+
+    mac_address_t(uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4, uint8_t a5);
+    explicit mac_address_t(const uint8_t * the_mac);
+
+  public:
+    uint8_t           a0 () const { return my_addr[0]; }
+    uint8_t           a1 () const { return my_addr[1]; }
+    uint8_t           a2 () const { return my_addr[2]; }
+    uint8_t           a3 () const { return my_addr[3]; }
+    uint8_t           a4 () const { return my_addr[4]; }
+    uint8_t           a5 () const { return my_addr[5]; }
+
+  private:
+    uint8_t           my_addr[6];
+  };
+
+  /////////////////////////////////////////////////////////
+  // Utility class for manipulation of IP address (IPV4)
+  class ipv4_address_t
+  {
+  public:
+    // The address given to "begin", or the address of the peer of a socket
+    ipv4_address_t();
+    explicit ipv4_address_t(socket_e the_socket);
+
+    ipv4_address_t(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3);
+    explicit ipv4_address_t(const uint8_t * the_ip);
+
+  public:
+    uint8_t           ip0 () const { return my_addr[0]; }
+    uint8_t           ip1 () const { return my_addr[1]; }
+    uint8_t           ip2 () const { return my_addr[2]; }
+    uint8_t           ip3 () const { return my_addr[3]; }
+
+  private:
+    uint8_t           my_addr[4];
+  };
+
+  /////////////////////////////////////////////////////////
+
+public:
+  // Initialization and termination
+  static void         begin               (const mac_address_t& the_macAddr, const ipv4_address_t& the_ipAddr);
+  static void         terminate           ();
+
+public:
+  // Socket command functions
+  static retcode_e    open                (socket_e the_socket, uint16_t the_port);
+  static retcode_e    listen              (socket_e the_socket);
+  static retcode_e    checkClientConn     (socket_e the_socket);
+  static retcode_e    close               (socket_e the_socket);
+  static uint16_t     send                (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+  static retcode_e    checkSendCompleted  (socket_e the_socket);
+  static uint16_t     txSizeQueued        (socket_e) { return 0; }   // send passes data to the system at once
+  static retcode_e    waitSendCompleted   (socket_e the_socket);
+  static retcode_e    waitSendSpace       (socket_e the_socket);
+  static uint16_t     receive             (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+  static retcode_e    checkReceivePending (socket_e the_socket);
+  static retcode_e    waitReceivePending  (socket_e the_socket);
+
+  // Socket status inquiry functions
+  static uint16_t     txMemSize           (socket_e the_socket);
+  static uint16_t     txSizePending       (socket_e the_socket);
+
+  static bool         isClosed            (socket_e the_socket);
+  static bool         isConnected         (socket_e the_socket);
+  static bool         canTransmitData     (socket_e the_socket);
+
+  static uint16_t     localPort           (socket_e the_socket);
+  static uint16_t     remotePort          (socket_e the_socket);
+
+  // Socket options; delayed ACKs are left to the system
+  static void         setNoDelayedAck     (socket_e /*the_socket*/) {}
+
+  // Events: waits for a connection or data, up to the_msTimeout.
+  // Returns false if the timeout has expired with nothing pending.
+  static bool         waitEvents          (uint16_t the_msTimeout);
+
+  // There is no SPI bus
+  static uint32_t     spiAccesses         () { return 0; }
+  static void         suspendBus          () {}
+  static void         resumeBus           () {}
+
+private:
+  /////////////////////////////////////////////////////////
+  // Slots
+  enum state_e
+  {
+    st_closed,
+    st_init,          // Opened, i.e. the listening socket exists
+    st_listen,        // Waiting for a connection
+    st_connected
+  };
+
+  struct slot_t
+  {
+    int      fd;        // Socket of the connection; -1 if none
+    uint8_t  state;
+    bool     ready;     // Data may be pending (see waitEvents)
+    uint16_t txSize;    // Size of the send buffer
+  };
+
+  static slot_t       smy_slots[socket_end];
+  static int          smy_listenFd;
+  static uint16_t     smy_listenPort;
+  static bool         smy_listenReady;
+  static bool         smy_listenArmed;    // The listening socket is watched by epoll
+  static int          smy_pollFd;         // epoll instance
+  static bool         smy_polled;         // waitEvents is in use: ready flags are valid
+  static uint8_t      smy_macAddr[6];
+  static uint8_t      smy_ipAddr[4];
+
+  static bool         prv_isValidSocket   (socket_e the_socket);
+  static bool         prv_openListener    (uint16_t the_port);
+  static retcode_e    prv_accept          (socket_e the_socket);
+  static retcode_e    prv_peek            (socket_e the_socket);
+  static void         prv_drop            (socket_e the_socket);
+  static bool         prv_peerAddress     (socket_e the_socket, uint8_t * the_ip, uint16_t * the_port);
+
+private:
+  PosixNet(); // An object of this class cannot be instantiated
+
+friend class mac_address_t;
+friend class ipv4_address_t;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef POSIXNET_H
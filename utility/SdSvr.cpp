@@ -12,6 +12,8 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "SdSvr.h"
+#include "NetBackend.h"
+#include "crc16.h"
 
 #ifndef LOCAL_MAX_URL_LENGTH
 #  define LOCAL_MAX_URL_LENGTH  128
@@ -27,11 +29,45 @@ static unsigned int local_strlen(const char * s)
   return 0;
 }
 
+// The SD card shares the SPI bus with the network chip: if one of its transactions
+// is open, the bus is released for the duration of the SD access
+class local_busGuard
+{
+public:
+  local_busGuard()  { NetBackend::suspendBus(); }
+  ~local_busGuard() { NetBackend::resumeBus();  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+static uint16_t local_urlCrc(const char * the_url)
+{
+  // 0 marks free cache entries, so it is never used as a CRC
+  uint16_t crc = crcsum(the_url, local_strlen(the_url), CRC_INIT);
+  return crc ? crc : 1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 // Construction without initialization of SD card
 SdSvr::SdSvr()
 : my_sdStatus(sd_notAvailable)
+, my_current(-1)
+, my_useCount(0)
+, my_writeOpen(false)
+, my_writeFailed(false)
+, my_writePos(0)
+, my_unsynced(0)
+#if HTTPSVR_SD_WRITE_BUFFER
+, my_writeUsed(0)
+#endif
+#if HTTPSVR_AUTOINDEX
+, my_dirOpen(false)
+#endif
+#if HTTPSVR_SD_RAM_CACHE
+, my_ramUsed(0)
+, my_ramPending(-1)
+#endif
 {}
 
 SdSvr::~SdSvr()
@@ -47,44 +83,118 @@ void SdSvr::begin(int the_SS, int the_CS)
   // or the SD library functions will not work. 
   pinMode(the_SS, OUTPUT);
    
+  local_busGuard aGuard;
   if (!SD.begin(the_CS)) return;
   my_sdStatus = sd_initialized;
 }
 
 void SdSvr::terminate()
-{ my_sdStatus = sd_notAvailable; }
+{
+  closeWriteFile();
+#if HTTPSVR_AUTOINDEX
+  closeDirectory();
+#endif
+  forgetAllResFiles();
+  my_sdStatus = sd_notAvailable;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
 bool SdSvr::resFileExists(const char * the_url) const
 {
-  if (my_sdStatus != sd_initialized) return false;
+  if ((my_sdStatus != sd_initialized) && (my_sdStatus != sd_resFileOpen)) return false;
+  if (!the_url) return false;
+  if (prv_findOpenFile(local_urlCrc(the_url)) >= 0) return true;
+#if HTTPSVR_SD_RAM_CACHE
+  if (prv_findRamFile(local_urlCrc(the_url)) >= 0) return true;
+#endif
+  local_busGuard aGuard;
   return SD.exists(const_cast<char *>(the_url));
 }
 
 uint32_t SdSvr::resFileSize() const
 {
   if (!isResFileOpen()) return 0;
-  return const_cast<File&>(my_resFile).size(); // size() should be const
+  return const_cast<File&>(my_openFiles[my_current].file).size(); // size() should be const
 }
 
 bool SdSvr::openResFile(const char *the_url)
 {
+  closeCurrentResFile();
   if (my_sdStatus != sd_initialized) return false;
+  if (!the_url) return false;
+  
+  local_busGuard aGuard;
+  uint16_t crc = local_urlCrc(the_url);
+  int8_t iFile = prv_findOpenFile(crc);
+  if (iFile >= 0)
+  {
+    // Cache hit: no directory to walk, just rewind the file
+    if (!my_openFiles[iFile].file.seek(0))
+    {
+      my_openFiles[iFile].file.close();
+      my_openFiles[iFile].crc = 0;
+      iFile = -1;
+    }
+  }
+  if (iFile < 0)
+  {
+    // Cache miss: opening is the existence check as well
+    File aFile = SD.open(const_cast<char *>(the_url), FILE_READ);
+    if (!aFile) return false;
+    if (aFile.isDirectory()) { aFile.close(); return false; }
+    
+    iFile = prv_freeOpenFile();
+    my_openFiles[iFile].crc  = crc;
+    my_openFiles[iFile].file = aFile;
+  }
   
-  if (my_resFile) my_resFile.close();
-  my_resFile = SD.open(const_cast<char *>(the_url), FILE_READ);
+  my_openFiles[iFile].lastUse = ++my_useCount;
+  my_current  = iFile;
   my_sdStatus = sd_resFileOpen;
+  return true;
 }
 
 void SdSvr::closeCurrentResFile()
 {
+  // The file is left open in the cache
   if (my_sdStatus != sd_resFileOpen) return;
   
-  if (my_resFile) my_resFile.close();
+  my_current  = -1;
   my_sdStatus = sd_initialized;
 }
 
+void SdSvr::forgetResFile(const char * the_url)
+{
+  if (!the_url) return;
+#if HTTPSVR_SD_RAM_CACHE
+  int8_t iRamFile = prv_findRamFile(local_urlCrc(the_url));
+  if (iRamFile >= 0) prv_dropRamFile(iRamFile);
+#endif
+  int8_t iFile = prv_findOpenFile(local_urlCrc(the_url));
+  if (iFile < 0) return;
+  
+  if (iFile == my_current) closeCurrentResFile();
+  local_busGuard aGuard;
+  my_openFiles[iFile].file.close();
+  my_openFiles[iFile].crc = 0;
+}
+
+void SdSvr::forgetAllResFiles()
+{
+#if HTTPSVR_SD_RAM_CACHE
+  flushCachedResFiles();
+#endif
+  closeCurrentResFile();
+  local_busGuard aGuard;
+  for (uint8_t u = 0; u < smy_openFiles; ++u)
+  {
+    if (!my_openFiles[u].crc) continue;
+    my_openFiles[u].file.close();
+    my_openFiles[u].crc = 0;
+  }
+}
+
 bool SdSvr::isResFileOpen() const
 { return my_sdStatus == sd_resFileOpen; }
 
@@ -94,10 +204,332 @@ uint16_t SdSvr::readResFileBuffer(uint8_t * the_buffer, uint16_t the_size)
   if (the_size < 1) return 0;
   if (!isResFileOpen()) return 0;
 
-  uint16_t uRead = my_resFile.read(the_buffer, the_size);
-  memset(the_buffer + uRead, the_size - uRead, 0);
+  local_busGuard aGuard;
+  int iRead = my_openFiles[my_current].file.read(the_buffer, the_size);
+  uint16_t uRead = (iRead > 0) ? iRead : 0;
+  memset(the_buffer + uRead, 0, the_size - uRead);
   return uRead;
 }
 
+bool SdSvr::seekResFile(uint32_t the_pos)
+{
+  if (!isResFileOpen()) return false;
+
+  local_busGuard aGuard;
+  return my_openFiles[my_current].file.seek(the_pos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SdSvr::openWriteFile(const char * the_name, bool the_truncate)
+{
+  closeWriteFile();
+  if ((my_sdStatus != sd_initialized) && (my_sdStatus != sd_resFileOpen)) return false;
+  if (!the_name) return false;
+
+  // Files kept open or cached for serving may be stale once one is written
+  forgetAllResFiles();
+
+  local_busGuard aGuard;
+  char * sName = const_cast<char *>(the_name);
+  if (the_truncate && SD.exists(sName)) SD.remove(sName);
+  my_writeFile = SD.open(sName, FILE_WRITE);
+  if (!my_writeFile) return false;
+  if (my_writeFile.isDirectory()) { my_writeFile.close(); return false; }
+
+  // Data is appended: the first sector boundary depends on the current size
+  my_writePos    = my_writeFile.size();
+  my_unsynced    = 0;
+  my_writeFailed = false;
+  my_writeOpen   = true;
+#if HTTPSVR_SD_WRITE_BUFFER
+  my_writeUsed   = 0;
+#endif
+  return true;
+}
+
+bool SdSvr::writeFileBuffer(const uint8_t * the_data, uint16_t the_size)
+{
+  if (!my_writeOpen || my_writeFailed) return false;
+  if (!the_data) return false;
+
+#if HTTPSVR_SD_WRITE_BUFFER
+  while (the_size)
+  {
+    // Data is written from the buffered position up to a sector boundary: only
+    // the first write may be shorter than the buffer, to get to a boundary
+    uint16_t uChunk = smy_writeSize - static_cast<uint16_t>(my_writePos % smy_sectorSize);
+    if (!my_writeUsed && (the_size >= uChunk))
+    {
+      // Nothing buffered: whole sectors are written straight from the data
+      if (!prv_writeThrough(the_data, uChunk)) return false;
+      the_data += uChunk;
+      the_size -= uChunk;
+      continue;
+    }
+
+    uint16_t uCopy = uChunk - my_writeUsed;
+    if (uCopy > the_size) uCopy = the_size;
+    memcpy(my_writeBuffer + my_writeUsed, the_data, uCopy);
+    my_writeUsed += uCopy;
+    the_data     += uCopy;
+    the_size     -= uCopy;
+
+    if (my_writeUsed < uChunk) break;
+    my_writeUsed = 0;
+    if (!prv_writeThrough(my_writeBuffer, uChunk)) return false;
+  }
+  return true;
+#else
+  return prv_writeThrough(the_data, the_size);
+#endif
+}
+
+bool SdSvr::syncWriteFile()
+{
+  if (!my_writeOpen || my_writeFailed) return false;
+
+#if HTTPSVR_SD_WRITE_BUFFER
+  // The partial sector left in the buffer is written as well
+  uint16_t uUsed = my_writeUsed;
+  my_writeUsed = 0;
+  if (!prv_writeThrough(my_writeBuffer, uUsed)) return false;
+#endif
+
+  local_busGuard aGuard;
+  my_writeFile.flush();
+  my_unsynced = 0;
+  return true;
+}
+
+bool SdSvr::closeWriteFile()
+{
+  if (!my_writeOpen) return false;
+  bool bOk = syncWriteFile();
+
+  local_busGuard aGuard;
+  my_writeFile.close();
+  my_writeOpen = false;
+  return bOk;
+}
+
+bool SdSvr::isWriteFileOpen() const
+{ return my_writeOpen; }
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool SdSvr::removeFile(const char * the_name)
+{
+  if ((my_sdStatus != sd_initialized) && (my_sdStatus != sd_resFileOpen)) return false;
+  if (!the_name) return false;
+
+  // The file may be kept open or cached for serving
+  forgetAllResFiles();
+
+  local_busGuard aGuard;
+  return SD.remove(const_cast<char *>(the_name));
+}
+
+bool SdSvr::makeDirectory(const char * the_path)
+{
+  // Missing parent directories are created as well
+  if ((my_sdStatus != sd_initialized) && (my_sdStatus != sd_resFileOpen)) return false;
+  if (!the_path) return false;
+
+  local_busGuard aGuard;
+  return SD.mkdir(const_cast<char *>(the_path));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_AUTOINDEX
+
+bool SdSvr::openDirectory(const char * the_path)
+{
+  closeDirectory();
+  if ((my_sdStatus != sd_initialized) && (my_sdStatus != sd_resFileOpen)) return false;
+  if (!the_path) return false;
+
+  local_busGuard aGuard;
+  my_dir = SD.open(const_cast<char *>(the_path), FILE_READ);
+  if (!my_dir) return false;
+  if (!my_dir.isDirectory()) { my_dir.close(); return false; }
+  my_dir.rewindDirectory();
+  my_dirOpen = true;
+  return true;
+}
+
+bool SdSvr::readDirectory(dirEntry_t& the_entry)
+{
+  if (!my_dirOpen) return false;
+
+  // Each entry is opened to get its attributes, and closed at once
+  local_busGuard aGuard;
+  File aEntry = my_dir.openNextFile();
+  if (!aEntry) return false;
+  strncpy(the_entry.name, aEntry.name(), sizeof(the_entry.name) - 1);
+  the_entry.name[sizeof(the_entry.name) - 1] = 0;
+  the_entry.isDirectory = aEntry.isDirectory();
+  the_entry.size        = the_entry.isDirectory ? 0 : aEntry.size();
+  aEntry.close();
+  return true;
+}
+
+void SdSvr::closeDirectory()
+{
+  if (!my_dirOpen) return;
+  local_busGuard aGuard;
+  my_dir.close();
+  my_dirOpen = false;
+}
+
+#endif // #if HTTPSVR_AUTOINDEX
+
+////////////////////////////////////////////////////////////////////////////////
+
+int8_t SdSvr::prv_findOpenFile(uint16_t the_crc) const
+{
+  for (uint8_t u = 0; u < smy_openFiles; ++u)
+    if (my_openFiles[u].crc == the_crc) return u;
+  return -1;
+}
+
+uint8_t SdSvr::prv_freeOpenFile()
+{
+  // Returns a free entry, closing the least recently used file if none is free
+  // (the current file is never chosen, since it has just been closed)
+  uint8_t uOldest = 0;
+  for (uint8_t u = 0; u < smy_openFiles; ++u)
+  {
+    if (!my_openFiles[u].crc) return u;
+    if (static_cast<uint16_t>(my_useCount - my_openFiles[u].lastUse) >
+        static_cast<uint16_t>(my_useCount - my_openFiles[uOldest].lastUse))
+      uOldest = u;
+  }
+  my_openFiles[uOldest].file.close();
+  my_openFiles[uOldest].crc = 0;
+  return uOldest;
+}
+
+bool SdSvr::prv_writeThrough(const uint8_t * the_data, uint16_t the_size)
+{
+  if (!the_size) return true;
+
+  local_busGuard aGuard;
+  uint16_t uWritten = my_writeFile.write(the_data, the_size);
+  my_writePos += uWritten;
+  my_unsynced += uWritten;
+  if (uWritten != the_size) { my_writeFailed = true; return false; }
+
+  if (smy_syncBytes && (my_unsynced >= smy_syncBytes))
+  {
+    my_writeFile.flush();
+    my_unsynced = 0;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#if HTTPSVR_SD_RAM_CACHE
+
+bool SdSvr::findCachedResFile(const char * the_url, cachedFile_t& the_file)
+{
+  if (!the_url) return false;
+  int8_t iFile = prv_findRamFile(local_urlCrc(the_url));
+  if ((iFile < 0) || (iFile == my_ramPending)) return false;
+
+  ramFile_t& aFile = my_ramFiles[iFile];
+  aFile.lastUse  = ++my_useCount;
+  the_file.block = my_ramPool + aFile.offset;
+  the_file.size  = aFile.size;
+  the_file.etag  = aFile.etag;
+  return true;
+}
+
+uint8_t * SdSvr::beginCachedResFile(const char * the_url, uint16_t the_size)
+{
+  if (!the_url || !the_size || (the_size > smy_ramSize)) return 0;
+  if (my_ramPending >= 0) prv_dropRamFile(my_ramPending);
+  uint16_t crc = local_urlCrc(the_url);
+  int8_t iFile = prv_findRamFile(crc);
+  if (iFile >= 0) prv_dropRamFile(iFile);
+
+  // Make room by dropping the least recently used blocks, and take a free entry
+  while (true)
+  {
+    iFile = -1;
+    int8_t iOldest = -1;
+    for (uint8_t u = 0; u < smy_ramFiles; ++u)
+    {
+      if (!my_ramFiles[u].crc) { if (iFile < 0) iFile = u; continue; }
+      if ((iOldest < 0) ||
+          (static_cast<uint16_t>(my_useCount - my_ramFiles[u].lastUse) >
+           static_cast<uint16_t>(my_useCount - my_ramFiles[iOldest].lastUse)))
+        iOldest = u;
+    }
+    if ((iFile >= 0) && (smy_ramSize - my_ramUsed >= the_size)) break;
+    if (iOldest < 0) return 0;
+    prv_dropRamFile(iOldest);
+  }
+
+  ramFile_t& aFile = my_ramFiles[iFile];
+  aFile.crc     = crc;
+  aFile.offset  = my_ramUsed;
+  aFile.size    = the_size;
+  aFile.etag    = 0;
+  aFile.lastUse = ++my_useCount;
+  my_ramUsed   += the_size;
+  my_ramPending = iFile;
+  return my_ramPool + aFile.offset;
+}
+
+bool SdSvr::endCachedResFile(bool the_keep, uint16_t the_etag, cachedFile_t& the_file)
+{
+  if (my_ramPending < 0) return false;
+  uint8_t uFile = my_ramPending;
+  my_ramPending = -1;
+  if (!the_keep) { prv_dropRamFile(uFile); return false; }
+
+  ramFile_t& aFile = my_ramFiles[uFile];
+  aFile.etag     = the_etag;
+  the_file.block = my_ramPool + aFile.offset;
+  the_file.size  = aFile.size;
+  the_file.etag  = aFile.etag;
+  return true;
+}
+
+void SdSvr::flushCachedResFiles()
+{
+  for (uint8_t u = 0; u < smy_ramFiles; ++u)
+    my_ramFiles[u].crc = 0;
+  my_ramUsed    = 0;
+  my_ramPending = -1;
+}
+
+int8_t SdSvr::prv_findRamFile(uint16_t the_crc) const
+{
+  for (uint8_t u = 0; u < smy_ramFiles; ++u)
+    if (my_ramFiles[u].crc == the_crc) return u;
+  return -1;
+}
+
+void SdSvr::prv_dropRamFile(uint8_t the_idx)
+{
+  // Blocks are kept packed: those following the dropped one are moved down
+  ramFile_t& aFile = my_ramFiles[the_idx];
+  if (!aFile.crc) return;
+  uint16_t uEnd = aFile.offset + aFile.size;
+  memmove(my_ramPool + aFile.offset, my_ramPool + uEnd, my_ramUsed - uEnd);
+  for (uint8_t u = 0; u < smy_ramFiles; ++u)
+    if (my_ramFiles[u].crc && (my_ramFiles[u].offset > aFile.offset))
+      my_ramFiles[u].offset -= aFile.size;
+  my_ramUsed -= aFile.size;
+  aFile.crc = 0;
+  if (my_ramPending == the_idx) my_ramPending = -1;
+}
+
+#endif // #if HTTPSVR_SD_RAM_CACHE
+
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -17,7 +17,28 @@
 #include <Arduino.h>
 #include <SD.h>
 
+#include "../HttpSvrConfig.h"
+
 ////////////////////////////////////////////////////////////////////////////////
+// SdSvr serves files from the SD card. Files are opened once and kept open in
+// a small cache, with the least recently used one closed to make room for a new
+// one, so that requests for the most common files do not walk directories at
+// all: a cached file is just rewound. Opening also tells if a file exists, so
+// a request takes one lookup at most.
+// Files on the card must not be changed or removed while they are cached:
+// forgetResFile closes the cached handle of a file before it is written.
+// When HTTPSVR_SD_RAM_CACHE is non-zero, small files can also be kept in RAM,
+// each one as a single block made of its response headers and its content,
+// so that it can be sent with no SD access at all. Blocks are packed in a
+// pool of HTTPSVR_SD_RAM_CACHE bytes; the least recently used ones are
+// dropped to make room for new ones.
+// One file at a time can be written (uploads, logs...). With a write buffer
+// (HTTPSVR_SD_WRITE_BUFFER), data is kept until a whole number of sectors can
+// be written at once, at sector boundaries of the file, instead of rewriting a
+// partial sector on each write. The file is synced every HTTPSVR_SD_SYNC_BYTES
+// and when it is closed.
+// With HTTPSVR_AUTOINDEX, directories can be listed one entry at a time, so
+// that a listing of any length takes no memory.
 
 class SdSvr
 {
@@ -30,12 +51,63 @@ public:
   
 public:
   // Management of HTML pages
+  // openResFile returns false if the file does not exist (or is a directory),
+  // and leaves it as the current file otherwise; closeCurrentResFile gives it
+  // back to the cache.
   bool      resFileExists       (const char * the_url) const;
   uint32_t  resFileSize         () const;
   bool      openResFile         (const char * the_url);
   void      closeCurrentResFile ();
   bool      isResFileOpen       () const;
   uint16_t  readResFileBuffer   (uint8_t * the_buffer, uint16_t the_size);
+  bool      seekResFile         (uint32_t the_pos);
+  void      forgetResFile       (const char * the_url);
+  void      forgetAllResFiles   ();
+
+  // Writing of files
+  // openWriteFile appends to the file, or replaces it if the_truncate is true.
+  // Once a write has failed, the following ones and closeWriteFile fail too.
+  bool      openWriteFile       (const char * the_name, bool the_truncate);
+  bool      writeFileBuffer     (const uint8_t * the_data, uint16_t the_size);
+  bool      syncWriteFile       ();
+  bool      closeWriteFile      ();
+  bool      isWriteFileOpen     () const;
+
+  // Management of files
+  bool      removeFile          (const char * the_name);
+  bool      makeDirectory       (const char * the_path);
+
+#if HTTPSVR_AUTOINDEX
+  // Listing of directories
+  // openDirectory returns false if the path is not a directory; readDirectory
+  // returns false at the end of the listing. Dates are not available through
+  // the SD library, so they are not listed.
+  struct dirEntry_t
+  {
+    char            name[13];   // 8.3 name and terminating null char
+    uint32_t        size;
+    bool            isDirectory;
+  };
+  bool      openDirectory       (const char * the_path);
+  bool      readDirectory       (dirEntry_t& the_entry);
+  void      closeDirectory      ();
+#endif
+
+#if HTTPSVR_SD_RAM_CACHE
+  // Management of files cached in RAM
+  // A block is added with beginCachedResFile, that returns the memory where headers
+  // and content must be written, and endCachedResFile, that keeps or drops it.
+  struct cachedFile_t
+  {
+    const uint8_t * block;
+    uint16_t        size;       // Headers and content
+    uint16_t        etag;
+  };
+  bool      findCachedResFile   (const char * the_url, cachedFile_t& the_file);
+  uint8_t * beginCachedResFile  (const char * the_url, uint16_t the_size);
+  bool      endCachedResFile    (bool the_keep, uint16_t the_etag, cachedFile_t& the_file);
+  void      flushCachedResFiles ();
+#endif
 
 private:
   enum sdStatus_e
@@ -46,9 +118,70 @@ private:
     sd_resFileOpen
   };
 
+  struct openFile_t
+  {
+    openFile_t() : crc(0), lastUse(0) {}
+    
+    uint16_t crc;      // CRC of the URL; 0 if the entry is free
+    uint16_t lastUse;
+    File     file;
+  };
+
+  static const uint8_t smy_openFiles = HttpSvrConfig::sdOpenFiles;
+
+  static const uint16_t smy_sectorSize = 512;
+  static const uint16_t smy_writeSize  = HttpSvrConfig::sdWriteBuffer;
+  static const uint32_t smy_syncBytes  = HttpSvrConfig::sdSyncBytes;
+
+#if HTTPSVR_SD_RAM_CACHE
+  struct ramFile_t
+  {
+    ramFile_t() : crc(0), offset(0), size(0), etag(0), lastUse(0) {}
+    
+    uint16_t crc;      // CRC of the URL; 0 if the entry is free
+    uint16_t offset;   // Position of the block in the pool
+    uint16_t size;
+    uint16_t etag;
+    uint16_t lastUse;
+  };
+
+  static const uint8_t  smy_ramFiles = HttpSvrConfig::sdRamCacheEntries;
+  static const uint16_t smy_ramSize  = HttpSvrConfig::sdRamCache;
+#endif
+
+private:
+  int8_t     prv_findOpenFile   (uint16_t the_crc) const;
+  uint8_t    prv_freeOpenFile   ();
+  bool       prv_writeThrough   (const uint8_t * the_data, uint16_t the_size);
+#if HTTPSVR_SD_RAM_CACHE
+  int8_t     prv_findRamFile    (uint16_t the_crc) const;
+  void       prv_dropRamFile    (uint8_t the_idx);
+#endif
+  
 private:
   sdStatus_e my_sdStatus;
-  File       my_resFile;
+  openFile_t my_openFiles[smy_openFiles];
+  int8_t     my_current;
+  uint16_t   my_useCount;
+  File       my_writeFile;
+  bool       my_writeOpen;
+  bool       my_writeFailed;
+  uint32_t   my_writePos;      // Position in the file of the buffered data
+  uint32_t   my_unsynced;
+#if HTTPSVR_SD_WRITE_BUFFER
+  uint8_t    my_writeBuffer[smy_writeSize];
+  uint16_t   my_writeUsed;
+#endif
+#if HTTPSVR_AUTOINDEX
+  File       my_dir;
+  bool       my_dirOpen;
+#endif
+#if HTTPSVR_SD_RAM_CACHE
+  ramFile_t  my_ramFiles[smy_ramFiles];
+  uint8_t    my_ramPool[smy_ramSize];
+  uint16_t   my_ramUsed;
+  int8_t     my_ramPending;
+#endif
 };
 
 ////////////////////////////////////////////////////////////////////////////////
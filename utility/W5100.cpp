@@ -32,24 +32,32 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "Arduino.h"
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5100
+
 #include "W5100.h"
-#include "SPI.h"
+#include "W5100Spi.h"
+#include "HttpTrace.h"
 
 static const uint8_t  uMaxTry = 10;
 static const uint16_t oneKB   = 0x0400; // 1024 bytes
 
+W5100::shadow_t W5100::smy_shadow[W5100::socket_end];
+
 ////////////////////////////////////////////////////////////////////////////////
 // Initialization and termination
 
 void W5100::begin(const mac_address_t& the_macAddr, const ipv4_address_t& the_ipAddr)
 {
   // Init SPI for communication
-  SPI.begin();
-  prv_initSS();
+  W5100Spi::begin();
  
   // Reset chip
   write_R8(W5100_MR, W5100_RST);
   while (read_R8(W5100_MR));
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    prv_invalidate(socket_cast(sn));
   
   // Set TX and RX buffer size for each socket
   write_R8(W5100_RMSR, W5100_S0_2K | W5100_S1_2K | W5100_S2_2K | W5100_S3_2K);
@@ -71,6 +79,8 @@ void W5100::terminate()
   // Reset chip
   write_R8(W5100_MR, W5100_RST);
   while (read_R8(W5100_MR));
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    prv_invalidate(socket_cast(sn));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -93,8 +103,8 @@ W5100::retcode_e W5100::open(socket_e the_socket, uint16_t the_port)
   // Issue the OPEN command and wait for completion
   for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
   {
-    write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_OPEN);
-    if (read_Sn_R8(the_socket, W5100_Sn_SR) == W5100_SOCK_INIT) return rc_ok;
+    prv_command(the_socket, W5100_COMMAND_OPEN);
+    if (status(the_socket) == W5100_SOCK_INIT) return rc_ok;
   }
   return rc_open_failed;
 }
@@ -110,8 +120,8 @@ W5100::retcode_e W5100::listen(socket_e the_socket)
   // Issue the LISTEN command and wait for completion
   for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
   {
-    write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_LISTEN);
-    if (read_Sn_R8(the_socket, W5100_Sn_SR) == W5100_SOCK_LISTEN) return rc_ok;
+    prv_command(the_socket, W5100_COMMAND_LISTEN);
+    if (status(the_socket) == W5100_SOCK_LISTEN) return rc_ok;
   }
   return rc_listen_failed;
 }
@@ -140,7 +150,7 @@ W5100::retcode_e W5100::connect(socket_e the_socket, const ipv4_address_t& the_i
   set_flags(the_socket, W5100_IR_SEND_OK | W5100_IR_TIMEOUT);
   
   // Issue the CONNECT command and wait for completion or timeout
-  write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_CONNECT);
+  prv_command(the_socket, W5100_COMMAND_CONNECT);
   for (;;)
   {
     volatile uint8_t snFlags = flags(the_socket);
@@ -171,7 +181,7 @@ W5100::retcode_e W5100::disconnect(socket_e the_socket)
     return rc_ok;
   
   // Issue the DISCONNECT command and wait for completion or timeout
-  write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_DISCON);
+  prv_command(the_socket, W5100_COMMAND_DISCON);
   for (;;)
   {
     volatile uint8_t snFlags = flags(the_socket);
@@ -232,7 +242,7 @@ W5100::retcode_e W5100::close(socket_e the_socket)
   // Issue the CLOSE command and wait for completion
   for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
   {
-    write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_CLOSE);
+    prv_command(the_socket, W5100_COMMAND_CLOSE);
     if (status(the_socket) == W5100_SOCK_CLOSED)
     {
       // Clear any previous event flag
@@ -247,6 +257,10 @@ W5100::retcode_e W5100::close(socket_e the_socket)
 
 uint16_t W5100::send(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
 {
+  // This function does not wait for the data to be sent: they are copied to
+  // tx memory and passed to a SEND command as soon as the previous one has
+  // completed. Use checkSendCompleted/waitSendCompleted to push them out.
+  
   // Check preconditions: socket status must be ESTABLISHED
   if (status(the_socket) != W5100_SOCK_ESTABLISHED)
     return 0;
@@ -258,20 +272,32 @@ uint16_t W5100::send(socket_e the_socket, uint8_t * the_buffer, uint16_t the_siz
 
 W5100::retcode_e W5100::checkSendCompleted(socket_e the_socket)
 {
-  // Check for completion of data transmission (non blocking)
+  // Check for completion of data transmission (non blocking).
+  // Data still queued in tx memory are passed to a new SEND command
+  // as soon as the previous one has completed.
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  shadow_t& sh = smy_shadow[the_socket];
 
-  // Check preconditions: socket status must be ESTABLISHED
-  if (status(the_socket) != W5100_SOCK_ESTABLISHED)
-    return rc_invalid_status;
-
-  // Check status      
+  // Check flags first: the amount of pending data is read only when no SEND
+  // is in flight, and socket status only while the transmission is pending
   uint8_t currFlags = flags(the_socket);
-  if ((currFlags & W5100_IR_SEND_OK) && (txSizePending(the_socket) == 0))
-    return rc_ok;
+  if (currFlags & W5100_IR_SEND_OK) sh.sendBusy = false;
+  if (!sh.sendBusy)
+  {
+    if (prv_commitSend(the_socket)) return rc_send_pending;
+    if (txSizePending(the_socket) == 0) return rc_ok;
+  }
 
   if (currFlags & W5100_IR_TIMEOUT)
     return rc_send_timeout;
   
+  // Check preconditions: socket status must be ESTABLISHED or CLOSE_WAIT
+  // (the peer has closed its side of the connection, but still receives)
+  uint8_t sockStatus = status(the_socket);
+  if ((sockStatus != W5100_SOCK_ESTABLISHED) && (sockStatus != W5100_SOCK_CLOSE_WAIT))
+    return rc_invalid_status;
+
   return rc_send_pending;
 }
 
@@ -290,8 +316,11 @@ W5100::retcode_e W5100::waitSendCompleted(socket_e the_socket)
 
 uint16_t W5100::receive(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
 {
-  // Check preconditions: socket status must be ESTABLISHED
-  if (status(the_socket) != W5100_SOCK_ESTABLISHED)
+  // Check preconditions: socket status must be ESTABLISHED,
+  // unless data are already known to be available
+  if (!prv_isValidSocket(the_socket))
+    return 0;
+  if (!smy_shadow[the_socket].rxAvail && (status(the_socket) != W5100_SOCK_ESTABLISHED))
     return 0;
 
   return prv_rxData(the_socket, the_buffer, the_size);
@@ -303,6 +332,12 @@ W5100::retcode_e W5100::checkReceivePending(socket_e the_socket)
 {
   // Wait for received data (non blocking)
   
+  // Data already known to be available: no need to ask the chip
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (smy_shadow[the_socket].rxAvail)
+    return rc_ok;
+  
   // Check preconditions: socket status must be ESTABLISHED
   if (status(the_socket) != W5100_SOCK_ESTABLISHED)
     return rc_invalid_status;
@@ -330,7 +365,20 @@ W5100::retcode_e W5100::waitReceivePending(socket_e the_socket)
 // Socket status inquiry functions
 
 uint8_t W5100::status(socket_e the_socket)
-{ return read_Sn_R8(the_socket, W5100_Sn_SR); }
+{
+  uint8_t sockStatus = read_Sn_R8(the_socket, W5100_Sn_SR);
+  
+  // Any change of status (e.g. a connection accepted by a listening socket)
+  // makes the shadow registers meaningless, except when the peer half-closes
+  // the connection: data already queued must still be sent
+  if (prv_isValidSocket(the_socket) && (sockStatus != smy_shadow[the_socket].status))
+  {
+    if ((smy_shadow[the_socket].status != W5100_SOCK_ESTABLISHED) || (sockStatus != W5100_SOCK_CLOSE_WAIT))
+      prv_invalidate(the_socket);
+    smy_shadow[the_socket].status = sockStatus;
+  }
+  return sockStatus;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -371,7 +419,22 @@ uint16_t W5100::txMemBase(socket_e the_socket)
 ////////////////////////////////////////////////////////////////////////////////
 
 uint16_t W5100::txSizePending(socket_e the_socket)
-{ return txMemSize(the_socket) - read_Sn_R16(the_socket, W5100_Sn_TX_FSR); }
+{
+  // Data not yet acknowledged by the peer, including those still queued
+  uint16_t txFree   = read_Sn_R16(the_socket, W5100_Sn_TX_FSR);
+  uint16_t txQueued = txSizeQueued(the_socket);
+  if (prv_isValidSocket(the_socket)) 
+    smy_shadow[the_socket].txFree = (txFree > txQueued ? txFree - txQueued : 0);
+  return txMemSize(the_socket) - txFree + txQueued;
+}
+
+uint16_t W5100::txSizeQueued(socket_e the_socket)
+{
+  // Data written to tx memory, but not yet passed to a SEND command
+  if (!prv_isValidSocket(the_socket)) return 0;
+  const shadow_t& sh = smy_shadow[the_socket];
+  return (sh.ptrValid ? sh.txWr - sh.txSent : 0);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -404,7 +467,11 @@ uint16_t W5100::rxMemBase(socket_e the_socket)
 ////////////////////////////////////////////////////////////////////////////////
 
 uint16_t W5100::rxSizePending(socket_e the_socket)
-{ return read_Sn_R16(the_socket, W5100_Sn_RX_RSR); }
+{
+  uint16_t rxAvail = read_Sn_R16(the_socket, W5100_Sn_RX_RSR);
+  if (prv_isValidSocket(the_socket)) smy_shadow[the_socket].rxAvail = rxAvail;
+  return rxAvail;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -448,24 +515,27 @@ bool W5100::canTransmitData(socket_e the_socket)
   return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5100::localPort(socket_e the_socket)
+{ return read_Sn_R16(the_socket, W5100_Sn_PORT); }
+
+uint16_t W5100::remotePort(socket_e the_socket)
+{ return read_Sn_R16(the_socket, W5100_Sn_DPORT); }
+
+////////////////////////////////////////////////////////////////////////////////
+
+void W5100::setNoDelayedAck(socket_e the_socket)
+{ write_Sn_R8(the_socket, W5100_Sn_MR, read_Sn_R8(the_socket, W5100_Sn_MR) | W5100_ND); }
+
 ////////////////////////////////////////////////////////////////////////////////
 // Utility functions for reading/writing registers
 
 void W5100::write_R8(uint16_t the_addr, uint8_t the_data)
-{
-  prv_setSS();  
-  SPI.transfer(0xF0);
-  SPI.transfer(the_addr >> 8);
-  SPI.transfer(the_addr & 0xFF);
-  SPI.transfer(the_data);
-  prv_resetSS();
-}
+{ W5100Spi::write(the_addr, the_data); }
 
 void W5100::write_R16(uint16_t the_addr, uint16_t the_data)
-{
-  write_R8(the_addr, the_data >> 8);
-  write_R8(++the_addr, the_data & 0xFF);
-}
+{ W5100Spi::write16(the_addr, the_data); }
 
 void W5100::write_Sn_R8(socket_e the_socket, uint16_t the_addr, uint8_t the_data)
 {
@@ -498,22 +568,10 @@ void W5100::write_Sn_R16(socket_e the_socket, uint16_t the_addr, uint16_t the_da
 ///////////////////////////////////////////////////////////////////////////////
 
 uint8_t W5100::read_R8(uint16_t the_addr)
-{
-  prv_setSS();  
-  SPI.transfer(0x0F);
-  SPI.transfer(the_addr >> 8);
-  SPI.transfer(the_addr & 0xFF);
-  uint8_t d8 = SPI.transfer(0);
-  prv_resetSS();
-  return d8;
-}
+{ return W5100Spi::read(the_addr); }
 
 uint16_t W5100::read_R16(uint16_t the_addr)
-{
-  uint16_t d16 = read_R8(the_addr);
-  d16 = ((d16 << 8) & 0xFF00) + read_R8(++the_addr);
-  return d16;
-}
+{ return W5100Spi::read16(the_addr); }
 
 uint8_t W5100::read_Sn_R8(socket_e the_socket, uint16_t the_addr)
 {
@@ -546,47 +604,117 @@ uint16_t W5100::read_Sn_R16(socket_e the_socket, uint16_t the_addr)
 ///////////////////////////////////////////////////////////////////////////////
 // Private member functions
 
+bool W5100::prv_isValidSocket(socket_e the_socket)
+{ return (the_socket >= socket_begin) && (the_socket < socket_end); }
+
+void W5100::prv_invalidate(socket_e the_socket)
+{
+  if (!prv_isValidSocket(the_socket)) return;
+  
+  shadow_t& sh = smy_shadow[the_socket];
+  sh.status   = W5100_SOCK_CLOSED;
+  sh.ptrValid = false;
+  sh.sendBusy = false;
+  sh.txFree   = 0;
+  sh.rxAvail  = 0;
+}
+
+void W5100::prv_command(socket_e the_socket, uint8_t the_command)
+{
+  write_Sn_R8(the_socket, W5100_Sn_CR, the_command);
+  
+  // SEND and RECV only move the pointers, which are tracked by the caller
+  if ((the_command != W5100_COMMAND_SEND) && (the_command != W5100_COMMAND_RECV))
+    prv_invalidate(the_socket);
+}
+
+void W5100::prv_loadPointers(socket_e the_socket)
+{
+  shadow_t& sh = smy_shadow[the_socket];
+  if (sh.ptrValid) return;
+  
+  sh.txWr     = read_Sn_R16(the_socket, W5100_Sn_TX_WR);
+  sh.txSent   = sh.txWr;
+  sh.rxRd     = read_Sn_R16(the_socket, W5100_Sn_RX_RD);
+  sh.ptrValid = true;
+}
+
+bool W5100::prv_commitSend(socket_e the_socket)
+{
+  // Pass queued data to a SEND command, unless the previous one is still in flight.
+  // Returns true if a SEND command has been issued.
+  shadow_t& sh = smy_shadow[the_socket];
+  if (!sh.ptrValid) return false;
+  if (sh.txWr == sh.txSent) return false;
+  
+  // Only one SEND command can be in progress at any time
+  if (sh.sendBusy)
+  {
+    if (!(flags(the_socket) & W5100_IR_SEND_OK)) return false;
+    sh.sendBusy = false;
+  }
+  
+  set_flags(the_socket, W5100_IR_SEND_OK);
+  write_Sn_R16(the_socket, W5100_Sn_TX_WR, sh.txWr);
+  prv_command(the_socket, W5100_COMMAND_SEND);
+  HttpTrace_EVENT(ev_send, the_socket, HttpTrace::sendArg(sh.txWr - sh.txSent));
+  sh.txSent   = sh.txWr;
+  sh.sendBusy = true;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 uint16_t W5100::prv_txData(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
 {
   // This function writes data to tx memory and returns the amount of data acutally written
+  // The whole operation is performed in a single SPI transaction
+  W5100Spi::scope_t aScope;
+  
+  // Socket status has already been checked by the caller; the write pointer
+  // and the free size are taken from the shadow registers when known
+  if (!prv_isValidSocket(the_socket)) return 0;
+  shadow_t& sh = smy_shadow[the_socket];
+  prv_loadPointers(the_socket);
   
   // Compute write address limits
+  uint16_t memSize         = txMemSize(the_socket);
   uint16_t memBegin        = txMemBase(the_socket);
-  uint16_t memEnd          = memBegin + txMemSize(the_socket);
+  uint16_t memEnd          = memBegin + memSize;
   uint16_t writtenActually = 0;
     
   while (the_size)
   {
-    // Check preconditions: data must be available and socket must be in correct state
-    if (!canTransmitData(the_socket))
-      return writtenActually;
-
-    // Compute howmany bytes can be written
-    uint16_t available = read_Sn_R16(the_socket, W5100_Sn_TX_FSR);
-    if (available == 0) return writtenActually;
+    // Compute howmany bytes can be written: Sn_TX_FSR is read only when
+    // the space known to be free has been used up. Sn_TX_FSR does not
+    // account for queued data, which have not been passed to SEND yet.
+    if (sh.txFree == 0)
+    {
+      uint16_t txFree   = read_Sn_R16(the_socket, W5100_Sn_TX_FSR);
+      uint16_t txQueued = sh.txWr - sh.txSent;
+      sh.txFree = (txFree > txQueued ? txFree - txQueued : 0);
+      if (sh.txFree == 0) break;
+    }
     
-    uint16_t writeOfs   = read_Sn_R16(the_socket, W5100_Sn_TX_WR);
-    uint16_t writeStart = memBegin + (writeOfs & (txMemSize(the_socket) - 1));
+    uint16_t writeStart = memBegin + (sh.txWr & (memSize - 1));
     uint16_t sizeToTop  = memEnd - writeStart;
-    uint16_t canWrite   = (available > the_size ? the_size : available);
+    uint16_t canWrite   = (sh.txFree > the_size ? the_size : sh.txFree);
     canWrite = (sizeToTop > canWrite ? canWrite : sizeToTop);
     
     // Copy this portion of bytes from buffer to tx memory
-    for (uint16_t u = 0; u < canWrite; ++u, ++the_buffer, ++writeStart)
-      write_R8(writeStart, *the_buffer);
+    W5100Spi::write(writeStart, the_buffer, canWrite);
+    the_buffer += canWrite;
     
     // Update counters and pointers
     the_size        -= canWrite;
     writtenActually += canWrite;
-    if (writeStart >= memEnd) writeStart = memBegin;
-    
-    // Signal completion of this portion of reading
-    set_flags(the_socket, W5100_IR_SEND_OK);
-    set_flags(the_socket, W5100_IR_TIMEOUT);
-    write_Sn_R16(the_socket, W5100_Sn_TX_WR, writeOfs + canWrite);
-    write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_SEND);
+    sh.txWr         += canWrite;
+    sh.txFree       -= canWrite;
   }
   
+  // Send what has been written, unless a SEND is already in flight:
+  // in that case data stay queued until its completion
+  prv_commitSend(the_socket);
   return writtenActually;
 }
 
@@ -595,40 +723,50 @@ uint16_t W5100::prv_txData(socket_e the_socket, uint8_t * the_buffer, uint16_t t
 uint16_t W5100::prv_rxData(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
 {
   // This function reads data from rx memory and returns the amount of data acutally read
+  // The whole operation is performed in a single SPI transaction
+  W5100Spi::scope_t aScope;
+  
+  // Socket status has already been checked by the caller; the read pointer
+  // and the received size are taken from the shadow registers when known
+  if (!prv_isValidSocket(the_socket)) return 0;
+  shadow_t& sh = smy_shadow[the_socket];
+  prv_loadPointers(the_socket);
   
   // Compute read address limits
+  uint16_t memSize      = rxMemSize(the_socket);
   uint16_t memBegin     = rxMemBase(the_socket);
-  uint16_t memEnd       = memBegin + rxMemSize(the_socket);
+  uint16_t memEnd       = memBegin + memSize;
   uint16_t readActually = 0;
     
   while (the_size)
   {
-    // Check preconditions: data must be available and socket must be in correct state
-    if (!canReceiveData(the_socket))
-      return readActually;
-
-    // Compute howmany bytes can be read
-    uint16_t available = read_Sn_R16(the_socket, W5100_Sn_RX_RSR);
-    uint16_t readOfs   = read_Sn_R16(the_socket, W5100_Sn_RX_RD);
-    uint16_t readStart = memBegin + (readOfs & (rxMemSize(the_socket) - 1));
+    // Compute howmany bytes can be read: Sn_RX_RSR is read only when
+    // the data known to be available have been used up
+    if (sh.rxAvail == 0)
+    {
+      sh.rxAvail = read_Sn_R16(the_socket, W5100_Sn_RX_RSR);
+      if (sh.rxAvail == 0) return readActually;
+    }
+    
+    uint16_t readStart = memBegin + (sh.rxRd & (memSize - 1));
     uint16_t sizeToTop = memEnd - readStart;
-    uint16_t canRead   = (available > the_size ? the_size : available);
+    uint16_t canRead   = (sh.rxAvail > the_size ? the_size : sh.rxAvail);
     canRead = (sizeToTop > canRead ? canRead : sizeToTop);
     
     // Copy this portion of bytes from rx memory to buffer
-    for (uint16_t u = 0; u < canRead; ++u, ++the_buffer, ++readStart)
-      *the_buffer = read_R8(readStart);
+    W5100Spi::read(readStart, the_buffer, canRead);
+    the_buffer += canRead;
     
     // Update counters and pointers
     the_size     -= canRead;
     readActually += canRead;
-    if (readStart >= memEnd) readStart = memBegin;
+    sh.rxRd      += canRead;
+    sh.rxAvail   -= canRead;
     
     // Signal completion of this portion of reading
-    set_flags(the_socket, W5100_IR_RECV);
-    set_flags(the_socket, W5100_IR_TIMEOUT);
-    write_Sn_R16(the_socket, W5100_Sn_RX_RD, readOfs + canRead);
-    write_Sn_R8(the_socket, W5100_Sn_CR, W5100_COMMAND_RECV);
+    set_flags(the_socket, W5100_IR_RECV | W5100_IR_TIMEOUT);
+    write_Sn_R16(the_socket, W5100_Sn_RX_RD, sh.rxRd);
+    prv_command(the_socket, W5100_COMMAND_RECV);
   }
   
   return readActually;
@@ -852,3 +990,5 @@ void W5100::ipv4_address_t::set(uint16_t the_regAddr) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
+
+#endif // #if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5100
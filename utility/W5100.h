@@ -16,8 +16,8 @@
 #define W5100_H
 
 #include <Arduino.h>
-#include <SPI.h>
 #include "W5100Defs.h"
+#include "W5100Spi.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -153,7 +153,9 @@ public:
   static retcode_e    close               (socket_e the_socket);
   static uint16_t     send                (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
   static retcode_e    checkSendCompleted  (socket_e the_socket);
+  static uint16_t     txSizeQueued        (socket_e the_socket);
   static retcode_e    waitSendCompleted   (socket_e the_socket);
+  static retcode_e    waitSendSpace       (socket_e the_socket) { return checkSendCompleted(the_socket); } // The chip is polled
   static uint16_t     receive             (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
   static retcode_e    checkReceivePending (socket_e the_socket);
   static retcode_e    waitReceivePending  (socket_e the_socket);
@@ -177,6 +179,15 @@ public:
   static bool         canReceiveData      (socket_e the_socket);
   static bool         canTransmitData     (socket_e the_socket);
 
+  static uint16_t     localPort           (socket_e the_socket);
+  static uint16_t     remotePort          (socket_e the_socket);
+
+  // Socket options; to be set before "open"
+  static void         setNoDelayedAck     (socket_e the_socket);
+
+  // Events: the chip is polled, so some socket may always need service
+  static bool         waitEvents          (uint16_t /*the_msTimeout*/) { return true; }
+
 public:  
   // Utility functions for reading/writing registers
   static void         write_R8            (uint16_t the_addr, uint8_t the_data );
@@ -189,6 +200,46 @@ public:
   static uint8_t      read_Sn_R8          (socket_e the_socket, uint16_t the_addr);
   static uint16_t     read_Sn_R16         (socket_e the_socket, uint16_t the_addr);
 
+  // Number of register or buffer accesses (i.e. SPI frames) since startup
+  static uint32_t     spiAccesses         () { return W5100Spi::accesses(); }
+
+  // Release of the SPI bus to another device in the middle of a transaction
+  static void         suspendBus          () { W5100Spi::suspend(); }
+  static void         resumeBus           () { W5100Spi::resume();  }
+
+private:
+  /////////////////////////////////////////////////////////
+  // Shadow of socket registers, used to avoid reading back from the chip
+  // what the driver already knows:
+  // - Sn_TX_WR and Sn_RX_RD are only written by the driver, so they are
+  //   tracked locally once read;
+  // - Sn_TX_FSR and Sn_RX_RSR can only grow between two SEND/RECV commands,
+  //   so the last value read, minus what has been used since, is a safe
+  //   lower bound of the actual value.
+  // Data written to tx memory are queued (txSent..txWr) while a SEND is in
+  // flight, and sent with the next SEND once SEND_OK has been signalled.
+  // The shadow is invalidated by any command other than SEND/RECV and
+  // whenever a change of Sn_SR is detected.
+  struct shadow_t
+  {
+    uint8_t  status;      // Last Sn_SR read
+    bool     ptrValid;    // txWr and rxRd are valid
+    bool     sendBusy;    // A SEND has been issued and its SEND_OK not yet seen
+    uint16_t txWr;        // End of data written to tx memory
+    uint16_t txSent;      // Sn_TX_WR, i.e. end of data passed to SEND
+    uint16_t rxRd;        // Sn_RX_RD
+    uint16_t txFree;      // Lower bound of Sn_TX_FSR
+    uint16_t rxAvail;     // Lower bound of Sn_RX_RSR
+  };
+  
+  static shadow_t     smy_shadow[socket_end];
+
+  static bool         prv_isValidSocket   (socket_e the_socket);
+  static void         prv_invalidate      (socket_e the_socket);
+  static void         prv_command         (socket_e the_socket, uint8_t the_command);
+  static void         prv_loadPointers    (socket_e the_socket);
+  static bool         prv_commitSend      (socket_e the_socket);
+
 private:  
   static uint16_t     prv_txData      (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
   static uint16_t     prv_rxData      (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
@@ -218,25 +269,6 @@ private:
 private:
   W5100(); // An object of this class cannot be instantiated
 
-  // Initialization and utility functions for SPI  
-#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-  inline static void  prv_initSS    ()      { DDRB  |=  _BV(4); };
-  inline static void  prv_setSS     ()      { PORTB &= ~_BV(4); };
-  inline static void  prv_resetSS   ()      { PORTB |=  _BV(4); };
-#elif defined(__AVR_ATmega32U4__)
-  inline static void  prv_initSS    ()      { DDRB  |=  _BV(6); };
-  inline static void  prv_setSS     ()      { PORTB &= ~_BV(6); };
-  inline static void  prv_resetSS   ()      { PORTB |=  _BV(6); }; 
-#elif defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB646__) || defined(__AVR_AT90USB162__)
-  inline static void  prv_initSS    ()      { DDRB  |=  _BV(0); };
-  inline static void  prv_setSS     ()      { PORTB &= ~_BV(0); };
-  inline static void  prv_resetSS   ()      { PORTB |=  _BV(0); }; 
-#else
-  inline static void  prv_initSS    ()      { DDRB  |=  _BV(2); };
-  inline static void  prv_setSS     ()      { PORTB &= ~_BV(2); };
-  inline static void  prv_resetSS   ()      { PORTB |=  _BV(2); };
-#endif
-
 friend class mac_address_t;
 friend class ip_address_t;
 };
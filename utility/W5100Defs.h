@@ -125,7 +125,7 @@
 
 #define W5100_CONFLICT              0x80    // IP Conflict (set to 1 when triggered; write 1 to clear)
 #define W5100_UNREACH               0x40    // Destination unreachable (set to 1 when triggered; write 1 to clear)
-#define W5100_PPPoE                 0x20    // PPPoE Connection Close (set to 1 when triggered; write 1 to clear)
+#define W5100_PPPoE_CLOSE           0x20    // PPPoE Connection Close (set to 1 when triggered; write 1 to clear)
 #define W5100_S3_INT                0x08    // Occurrence of Socket 3 Socket Interrupt (set to 1 when triggered; write 1 to clear)
 #define W5100_S2_INT                0x04    // Occurrence of Socket 2 Socket Interrupt (set to 1 when triggered; write 1 to clear)
 #define W5100_S1_INT                0x02    // Occurrence of Socket 1 Socket Interrupt (set to 1 when triggered; write 1 to clear)
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5100Spi.cpp - Definition of SPI transport for W5100 driver
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5100
+
+#include "W5100Spi.h"
+#include "SPI.h"
+
+// W5100 SPI opcodes
+static const uint8_t local_opWrite = 0xF0;
+static const uint8_t local_opRead  = 0x0F;
+
+uint32_t W5100Spi::smy_accesses = 0;
+uint8_t  W5100Spi::smy_depth    = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+// Initialization
+
+void W5100Spi::begin()
+{
+  SPI.begin();
+  prv_initSS();
+  prv_resetSS();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Bus ownership
+
+void W5100Spi::beginTransaction()
+{ if (smy_depth++ == 0) prv_acquireBus(); }
+
+void W5100Spi::endTransaction()
+{
+  if (!smy_depth) return;
+  if (--smy_depth == 0) prv_releaseBus();
+}
+
+void W5100Spi::suspend()
+{
+  // Let another device use the bus while a transaction is open:
+  // the transaction is resumed by "resume"
+  if (smy_depth) prv_releaseBus();
+}
+
+void W5100Spi::resume()
+{ if (smy_depth) prv_acquireBus(); }
+
+bool W5100Spi::inTransaction()
+{ return smy_depth != 0; }
+
+void W5100Spi::prv_acquireBus()
+{
+#ifdef SPI_HAS_TRANSACTION
+  SPI.beginTransaction(SPISettings(W5100_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+#else
+  // Older SPI libraries have no transactions: settings are shared with the SD library,
+  // so they are restored every time the W5100 takes the bus.
+  SPI.setBitOrder(MSBFIRST);
+  SPI.setDataMode(SPI_MODE0);
+  SPI.setClockDivider(SPI_CLOCK_DIV2);
+#endif
+}
+
+void W5100Spi::prv_releaseBus()
+{
+#ifdef SPI_HAS_TRANSACTION
+  SPI.endTransaction();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Register access
+
+void W5100Spi::write(uint16_t the_addr, uint8_t the_data)
+{
+  scope_t aScope;
+  ++smy_accesses;
+  prv_setSS();
+  SPI.transfer(local_opWrite);
+  SPI.transfer(the_addr >> 8);
+  SPI.transfer(the_addr & 0xFF);
+  SPI.transfer(the_data);
+  prv_resetSS();
+}
+
+void W5100Spi::write(uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size)
+{
+  scope_t aScope;
+  for (; the_size; --the_size, ++the_addr, ++the_buffer)
+    write(the_addr, *the_buffer);
+}
+
+void W5100Spi::write16(uint16_t the_addr, uint16_t the_data)
+{
+  // 16 bit registers are written MSB first
+  scope_t aScope;
+  write(the_addr, the_data >> 8);
+  write(++the_addr, the_data & 0xFF);
+}
+
+uint8_t W5100Spi::read(uint16_t the_addr)
+{
+  scope_t aScope;
+  ++smy_accesses;
+  prv_setSS();
+  SPI.transfer(local_opRead);
+  SPI.transfer(the_addr >> 8);
+  SPI.transfer(the_addr & 0xFF);
+  uint8_t d8 = SPI.transfer(0);
+  prv_resetSS();
+  return d8;
+}
+
+void W5100Spi::read(uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size)
+{
+  scope_t aScope;
+  for (; the_size; --the_size, ++the_addr, ++the_buffer)
+    *the_buffer = read(the_addr);
+}
+
+uint16_t W5100Spi::read16(uint16_t the_addr)
+{
+  // 16 bit registers are read MSB first
+  scope_t aScope;
+  uint16_t d16 = read(the_addr);
+  d16 = ((d16 << 8) & 0xFF00) + read(++the_addr);
+  return d16;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5100
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5100Spi.h - Definition of SPI transport for W5100 driver
+//
+//  ----------------------
+//
+//  All SPI traffic to the W5100 goes through this class. It selects the chip,
+//  applies the W5100 SPI settings (mode 0, MSB first, at the fastest clock the
+//  chip allows) and frames each register access as required by the W5100 SPI
+//  protocol: opcode, address high byte, address low byte, data byte.
+//
+//  The W5100 does not support burst accesses on SPI: each byte requires its own
+//  4-byte frame with the chip select toggled in between. Multi-byte accesses are
+//  nevertheless performed inside a single SPI transaction, so that the bus
+//  settings are applied once per block and not once per byte.
+//
+//  Transactions can be nested: only the outermost beginTransaction/endTransaction
+//  pair actually acquires and releases the bus. Other devices on the same bus
+//  (i.e. the SD card) can temporarily take the bus with suspend/resume.
+//
+//  Since this is the only place where the W5100 is accessed, a host-side
+//  emulator of the chip can be plugged in by replacing W5100Spi.cpp.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef W5100SPI_H
+#define W5100SPI_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#ifndef W5100_SPI_CLOCK
+#  define W5100_SPI_CLOCK 14000000  // Maximum SPI clock of W5100 (the board may use a lower one)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+class W5100Spi
+{
+public:
+  // Initialization of SPI bus and chip select pin
+  static void         begin               ();
+
+  // Bus ownership
+  static void         beginTransaction    ();
+  static void         endTransaction      ();
+  static void         suspend             ();
+  static void         resume              ();
+  static bool         inTransaction       ();
+
+  // Register access
+  static void         write               (uint16_t the_addr, uint8_t the_data);
+  static void         write               (uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size);
+  static void         write16             (uint16_t the_addr, uint16_t the_data);
+  static uint8_t      read                (uint16_t the_addr);
+  static void         read                (uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size);
+  static uint16_t     read16              (uint16_t the_addr);
+
+  // Number of register accesses (i.e. SPI frames) since startup
+  static uint32_t     accesses            () { return smy_accesses; }
+
+  // Utility class: the bus is owned by the W5100 for the lifetime of the object
+  class scope_t
+  {
+  public:
+    scope_t()  { beginTransaction(); }
+    ~scope_t() { endTransaction();   }
+  };
+
+private:
+  static void         prv_acquireBus      ();
+  static void         prv_releaseBus      ();
+
+  static uint32_t     smy_accesses;
+  static uint8_t      smy_depth;
+
+private:
+  W5100Spi(); // An object of this class cannot be instantiated
+
+  // Chip select of W5100
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(4); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(4); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(4); };
+#elif defined(__AVR_ATmega32U4__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(6); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(6); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(6); };
+#elif defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB646__) || defined(__AVR_AT90USB162__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(0); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(0); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(0); };
+#else
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(2); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(2); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(2); };
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef W5100SPI_H
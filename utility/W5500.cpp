@@ -0,0 +1,696 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5500.cpp - Definition of W5500 driver
+//
+//  ----------------------
+//
+//  IMPORTANT: Refer to WIZnet W5500 datasheet for a complete description
+//  of the chip and its operation.
+//
+//  The socket state machine is the one of the W5100, and so is the driver
+//  (see W5100.cpp). Differences are in the access to the chip: registers and
+//  buffers are addressed by block (see W5500Defs.h), and tx/rx pointers are
+//  used as they are in the buffer block of the socket, the chip wrapping them
+//  around at the end of the buffer. Thus data are always copied with a single
+//  burst frame, with no need to split them at the end of the buffer.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
+
+#include "W5500.h"
+#include "W5500Spi.h"
+#include "HttpTrace.h"
+
+static const uint8_t  uMaxTry = 10;
+
+W5500::shadow_t W5500::smy_shadow[W5500::socket_end];
+
+////////////////////////////////////////////////////////////////////////////////
+// Initialization and termination
+
+void W5500::begin(const mac_address_t& the_macAddr, const ipv4_address_t& the_ipAddr)
+{
+  // Init SPI for communication
+  W5500Spi::begin();
+
+  // Reset chip
+  prv_reset();
+
+  // Set TX and RX buffer size for each socket: the 16KB of each are split evenly
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+  {
+    write_Sn_R8(socket_cast(sn), W5500_Sn_RXBUF_SIZE, smy_bufSize >> 10);
+    write_Sn_R8(socket_cast(sn), W5500_Sn_TXBUF_SIZE, smy_bufSize >> 10);
+  }
+
+  // Set MAC and IP address to SHAR and SIPR respectively
+  the_macAddr.set();
+  the_ipAddr.set();
+}
+
+void W5500::terminate()
+{
+  // Close all connections
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    close(socket_cast(sn));
+
+  // Reset chip
+  prv_reset();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Socket command functions
+
+W5500::retcode_e W5500::open(socket_e the_socket, uint16_t the_port)
+{
+  // Check preconditions: socket status must be CLOSED or INIT
+  uint8_t sockStatus = status(the_socket);
+  if ((sockStatus != W5500_SOCK_INIT) && (sockStatus != W5500_SOCK_CLOSED))
+    return rc_invalid_status;
+
+  // Clear any previous event flag
+  write_Sn_R8(the_socket, W5500_Sn_IR, 0xFF);
+
+  // Set socket mode (TCP) and port
+  write_Sn_R8 (the_socket, W5500_Sn_MR, W5500_PROTOCOL_TCP);
+  write_Sn_R16(the_socket, W5500_Sn_PORT, the_port);
+
+  // Issue the OPEN command and wait for completion
+  for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+  {
+    prv_command(the_socket, W5500_COMMAND_OPEN);
+    if (status(the_socket) == W5500_SOCK_INIT) return rc_ok;
+  }
+  return rc_open_failed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::listen(socket_e the_socket)
+{
+  // Check preconditions: socket status must be INIT
+  if (status(the_socket) != W5500_SOCK_INIT)
+    return rc_invalid_status;
+
+  // Issue the LISTEN command and wait for completion
+  for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+  {
+    prv_command(the_socket, W5500_COMMAND_LISTEN);
+    if (status(the_socket) == W5500_SOCK_LISTEN) return rc_ok;
+  }
+  return rc_listen_failed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::connect(socket_e the_socket, const ipv4_address_t& the_ipAddr, uint16_t the_port)
+{
+  // Check preconditions: socket status must be INIT
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (status(the_socket) != W5500_SOCK_INIT)
+    return rc_invalid_status;
+
+  // Write IP address and port number to Sn_DIPR and Sn_DPORT respectively
+  the_ipAddr.set(the_socket);
+  write_Sn_R16(the_socket, W5500_Sn_DPORT, the_port);
+
+  // Clear previous CON and TIMEOUT event flag
+  set_flags(the_socket, W5500_IR_CON | W5500_IR_TIMEOUT);
+
+  // Issue the CONNECT command and wait for completion or timeout
+  prv_command(the_socket, W5500_COMMAND_CONNECT);
+  for (;;)
+  {
+    uint8_t snFlags = flags(the_socket);
+    if (snFlags & W5500_IR_CON)
+    {
+      // Reset signal bit
+      set_flags(the_socket, W5500_IR_CON);
+      // Wait for completion of connection
+      for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+        if (status(the_socket) == W5500_SOCK_ESTABLISHED) return rc_ok;
+      return rc_connect_failed;
+    }
+    else if (snFlags & W5500_IR_TIMEOUT)
+    {
+      // Reset signal bit
+      set_flags(the_socket, W5500_IR_TIMEOUT);
+      return rc_connect_timeout;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::disconnect(socket_e the_socket)
+{
+  // Check preconditions: if socket status is not ESTABLISHED, do nothing
+  if (status(the_socket) != W5500_SOCK_ESTABLISHED)
+    return rc_ok;
+
+  // Issue the DISCONNECT command and wait for completion or timeout
+  prv_command(the_socket, W5500_COMMAND_DISCON);
+  for (;;)
+  {
+    uint8_t snFlags = flags(the_socket);
+    if (snFlags & W5500_IR_DISCON)
+    {
+      // Reset signal bit
+      set_flags(the_socket, W5500_IR_DISCON);
+      // Wait for completion of disconnection
+      for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+        if (status(the_socket) == W5500_SOCK_CLOSED) return rc_ok;
+      return rc_disconnect_failed;
+    }
+    else if (snFlags & W5500_IR_TIMEOUT)
+    {
+      // Reset signal bit
+      set_flags(the_socket, W5500_IR_TIMEOUT);
+      return rc_disconnect_timeout;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::checkClientConn(socket_e the_socket)
+{
+  // Check for client connection (non blocking)
+  switch (status(the_socket))
+  {
+  case W5500_SOCK_LISTEN:
+    return rc_not_connected;
+
+  case W5500_SOCK_ESTABLISHED:
+    return rc_ok;
+
+  default:
+    return rc_invalid_status;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::waitClientConn(socket_e the_socket)
+{
+  // Wait for client connection (blocking)
+  retcode_e rc;
+  while ((rc = checkClientConn(the_socket)) == rc_not_connected);
+  return rc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::close(socket_e the_socket)
+{
+  // Check preconditions: if socket status is already CLOSED, do nothing
+  if (status(the_socket) == W5500_SOCK_CLOSED)
+    return rc_ok;
+
+  // Issue the CLOSE command and wait for completion
+  for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+  {
+    prv_command(the_socket, W5500_COMMAND_CLOSE);
+    if (status(the_socket) == W5500_SOCK_CLOSED)
+    {
+      // Clear any previous event flag
+      set_flags(the_socket, 0xFF);
+      return rc_ok;
+    }
+  }
+  return rc_close_failed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::send(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  // This function does not wait for the data to be sent: they are copied to
+  // tx memory and passed to a SEND command as soon as the previous one has
+  // completed. Use checkSendCompleted/waitSendCompleted to push them out.
+
+  // Check preconditions: socket status must be ESTABLISHED
+  if (status(the_socket) != W5500_SOCK_ESTABLISHED)
+    return 0;
+
+  return prv_txData(the_socket, the_buffer, the_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::checkSendCompleted(socket_e the_socket)
+{
+  // Check for completion of data transmission (non blocking).
+  // Data still queued in tx memory are passed to a new SEND command
+  // as soon as the previous one has completed.
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  shadow_t& sh = smy_shadow[the_socket];
+
+  uint8_t currFlags = flags(the_socket);
+  if (currFlags & W5500_IR_SEND_OK) sh.sendBusy = false;
+  if (!sh.sendBusy)
+  {
+    if (prv_commitSend(the_socket)) return rc_send_pending;
+    if (txSizePending(the_socket) == 0) return rc_ok;
+  }
+
+  if (currFlags & W5500_IR_TIMEOUT)
+    return rc_send_timeout;
+
+  // Check preconditions: socket status must be ESTABLISHED or CLOSE_WAIT
+  // (the peer has closed its side of the connection, but still receives)
+  uint8_t sockStatus = status(the_socket);
+  if ((sockStatus != W5500_SOCK_ESTABLISHED) && (sockStatus != W5500_SOCK_CLOSE_WAIT))
+    return rc_invalid_status;
+
+  return rc_send_pending;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::waitSendCompleted(socket_e the_socket)
+{
+  // Wait for completion of data transmission (blocking)
+  retcode_e rc;
+  while ((rc = checkSendCompleted(the_socket)) == rc_send_pending);
+  return rc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::receive(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  // Check preconditions: socket status must be ESTABLISHED,
+  // unless data are already known to be available
+  if (!prv_isValidSocket(the_socket))
+    return 0;
+  if (!smy_shadow[the_socket].rxAvail && (status(the_socket) != W5500_SOCK_ESTABLISHED))
+    return 0;
+
+  return prv_rxData(the_socket, the_buffer, the_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::checkReceivePending(socket_e the_socket)
+{
+  // Wait for received data (non blocking)
+
+  // Data already known to be available: no need to ask the chip
+  if (!prv_isValidSocket(the_socket))
+    return rc_invalid_socket;
+  if (smy_shadow[the_socket].rxAvail)
+    return rc_ok;
+
+  // Check preconditions: socket status must be ESTABLISHED
+  if (status(the_socket) != W5500_SOCK_ESTABLISHED)
+    return rc_invalid_status;
+
+  // Check status
+  uint8_t currFlags = flags(the_socket);
+  if ((currFlags & W5500_IR_RECV) && (rxSizePending(the_socket) != 0))
+    return rc_ok;
+
+  return rc_no_data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::retcode_e W5500::waitReceivePending(socket_e the_socket)
+{
+  // Wait for received data (blocking)
+  retcode_e rc;
+  while ((rc = checkReceivePending(the_socket)) == rc_no_data);
+  return rc;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Socket status inquiry functions
+
+uint8_t W5500::status(socket_e the_socket)
+{
+  uint8_t sockStatus = read_Sn_R8(the_socket, W5500_Sn_SR);
+
+  // Any change of status makes the shadow registers meaningless, except when
+  // the peer half-closes the connection: data already queued must still be sent
+  if (prv_isValidSocket(the_socket) && (sockStatus != smy_shadow[the_socket].status))
+  {
+    if ((smy_shadow[the_socket].status != W5500_SOCK_ESTABLISHED) || (sockStatus != W5500_SOCK_CLOSE_WAIT))
+      prv_invalidate(the_socket);
+    smy_shadow[the_socket].status = sockStatus;
+  }
+  return sockStatus;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint8_t W5500::flags(socket_e the_socket)
+{ return read_Sn_R8(the_socket, W5500_Sn_IR); }
+
+void W5500::set_flags(socket_e the_socket, uint8_t the_flags)
+{ write_Sn_R8(the_socket, W5500_Sn_IR, the_flags); }
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::txMemSize(socket_e the_socket)
+{ return prv_isValidSocket(the_socket) ? smy_bufSize : 0; }
+
+uint16_t W5500::txSizePending(socket_e the_socket)
+{
+  // Data not yet acknowledged by the peer, including those still queued
+  uint16_t txFree   = prv_readSize(the_socket, W5500_Sn_TX_FSR);
+  uint16_t txQueued = txSizeQueued(the_socket);
+  if (prv_isValidSocket(the_socket))
+    smy_shadow[the_socket].txFree = (txFree > txQueued ? txFree - txQueued : 0);
+  return txMemSize(the_socket) - txFree + txQueued;
+}
+
+uint16_t W5500::txSizeQueued(socket_e the_socket)
+{
+  // Data written to tx memory, but not yet passed to a SEND command
+  if (!prv_isValidSocket(the_socket)) return 0;
+  const shadow_t& sh = smy_shadow[the_socket];
+  return (sh.ptrValid ? sh.txWr - sh.txSent : 0);
+}
+
+uint16_t W5500::rxMemSize(socket_e the_socket)
+{ return prv_isValidSocket(the_socket) ? smy_bufSize : 0; }
+
+uint16_t W5500::rxSizePending(socket_e the_socket)
+{
+  uint16_t rxAvail = prv_readSize(the_socket, W5500_Sn_RX_RSR);
+  if (prv_isValidSocket(the_socket)) smy_shadow[the_socket].rxAvail = rxAvail;
+  return rxAvail;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool W5500::isOpen(socket_e the_socket)
+{ return !isClosed(the_socket); }
+
+bool W5500::isClosed(socket_e the_socket)
+{ return status(the_socket) == W5500_SOCK_CLOSED; }
+
+bool W5500::isConnected(socket_e the_socket)
+{ return (status(the_socket) == W5500_SOCK_ESTABLISHED); }
+
+bool W5500::canReceiveData(socket_e the_socket)
+{
+  // Check preconditions: socket status must be ESTABLISHED
+  if (status(the_socket) != W5500_SOCK_ESTABLISHED)
+    return false;
+  return (flags(the_socket) & W5500_IR_RECV);
+}
+
+bool W5500::canTransmitData(socket_e the_socket)
+{
+  // Here we do not check TX_Sn_FSR because it must be checked during the send process
+  return (status(the_socket) == W5500_SOCK_ESTABLISHED);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::localPort(socket_e the_socket)
+{ return read_Sn_R16(the_socket, W5500_Sn_PORT); }
+
+uint16_t W5500::remotePort(socket_e the_socket)
+{ return read_Sn_R16(the_socket, W5500_Sn_DPORT); }
+
+void W5500::setNoDelayedAck(socket_e the_socket)
+{ write_Sn_R8(the_socket, W5500_Sn_MR, read_Sn_R8(the_socket, W5500_Sn_MR) | W5500_ND); }
+
+////////////////////////////////////////////////////////////////////////////////
+// Utility functions for reading/writing registers
+
+void W5500::write_R8(uint16_t the_addr, uint8_t the_data)
+{ W5500Spi::write(W5500_BSB_COMMON, the_addr, the_data); }
+
+void W5500::write_R16(uint16_t the_addr, uint16_t the_data)
+{ W5500Spi::write16(W5500_BSB_COMMON, the_addr, the_data); }
+
+uint8_t W5500::read_R8(uint16_t the_addr)
+{ return W5500Spi::read(W5500_BSB_COMMON, the_addr); }
+
+uint16_t W5500::read_R16(uint16_t the_addr)
+{ return W5500Spi::read16(W5500_BSB_COMMON, the_addr); }
+
+void W5500::write_Sn_R8(socket_e the_socket, uint16_t the_addr, uint8_t the_data)
+{ if (prv_isValidSocket(the_socket)) W5500Spi::write(W5500_BSB_Sn_REG(the_socket), the_addr, the_data); }
+
+void W5500::write_Sn_R16(socket_e the_socket, uint16_t the_addr, uint16_t the_data)
+{ if (prv_isValidSocket(the_socket)) W5500Spi::write16(W5500_BSB_Sn_REG(the_socket), the_addr, the_data); }
+
+uint8_t W5500::read_Sn_R8(socket_e the_socket, uint16_t the_addr)
+{ return prv_isValidSocket(the_socket) ? W5500Spi::read(W5500_BSB_Sn_REG(the_socket), the_addr) : 0xFF; }
+
+uint16_t W5500::read_Sn_R16(socket_e the_socket, uint16_t the_addr)
+{ return prv_isValidSocket(the_socket) ? W5500Spi::read16(W5500_BSB_Sn_REG(the_socket), the_addr) : 0xFFFF; }
+
+void W5500::write_Sn_block(socket_e the_socket, uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size)
+{ if (prv_isValidSocket(the_socket)) W5500Spi::write(W5500_BSB_Sn_REG(the_socket), the_addr, the_buffer, the_size); }
+
+void W5500::read_Sn_block(socket_e the_socket, uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size)
+{
+  if (prv_isValidSocket(the_socket)) W5500Spi::read(W5500_BSB_Sn_REG(the_socket), the_addr, the_buffer, the_size);
+  else                               memset(the_buffer, 0xFF, the_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Private member functions
+
+bool W5500::prv_isValidSocket(socket_e the_socket)
+{ return (the_socket >= socket_begin) && (the_socket < socket_end); }
+
+void W5500::prv_invalidate(socket_e the_socket)
+{
+  if (!prv_isValidSocket(the_socket)) return;
+
+  shadow_t& sh = smy_shadow[the_socket];
+  sh.status   = W5500_SOCK_CLOSED;
+  sh.ptrValid = false;
+  sh.sendBusy = false;
+  sh.txFree   = 0;
+  sh.rxAvail  = 0;
+}
+
+void W5500::prv_reset()
+{
+  write_R8(W5500_MR, W5500_RST);
+  while (read_R8(W5500_MR) & W5500_RST);
+  for (uint8_t sn = socket_begin; sn < socket_end; ++sn)
+    prv_invalidate(socket_cast(sn));
+}
+
+void W5500::prv_command(socket_e the_socket, uint8_t the_command)
+{
+  write_Sn_R8(the_socket, W5500_Sn_CR, the_command);
+
+  // SEND and RECV only move the pointers, which are tracked by the caller
+  if ((the_command != W5500_COMMAND_SEND) && (the_command != W5500_COMMAND_RECV))
+    prv_invalidate(the_socket);
+}
+
+void W5500::prv_loadPointers(socket_e the_socket)
+{
+  shadow_t& sh = smy_shadow[the_socket];
+  if (sh.ptrValid) return;
+
+  sh.txWr     = read_Sn_R16(the_socket, W5500_Sn_TX_WR);
+  sh.txSent   = sh.txWr;
+  sh.rxRd     = read_Sn_R16(the_socket, W5500_Sn_RX_RD);
+  sh.ptrValid = true;
+}
+
+bool W5500::prv_commitSend(socket_e the_socket)
+{
+  // Pass queued data to a SEND command, unless the previous one is still in flight.
+  // Returns true if a SEND command has been issued.
+  shadow_t& sh = smy_shadow[the_socket];
+  if (!sh.ptrValid) return false;
+  if (sh.txWr == sh.txSent) return false;
+
+  // Only one SEND command can be in progress at any time
+  if (sh.sendBusy)
+  {
+    if (!(flags(the_socket) & W5500_IR_SEND_OK)) return false;
+    sh.sendBusy = false;
+  }
+
+  set_flags(the_socket, W5500_IR_SEND_OK);
+  write_Sn_R16(the_socket, W5500_Sn_TX_WR, sh.txWr);
+  prv_command(the_socket, W5500_COMMAND_SEND);
+  HttpTrace_EVENT(ev_send, the_socket, HttpTrace::sendArg(sh.txWr - sh.txSent));
+  sh.txSent   = sh.txWr;
+  sh.sendBusy = true;
+  return true;
+}
+
+uint16_t W5500::prv_readSize(socket_e the_socket, uint16_t the_addr)
+{
+  // Sn_TX_FSR and Sn_RX_RSR change while the chip sends and receives:
+  // as required by the datasheet, they are read until two reads match
+  uint16_t uSize = read_Sn_R16(the_socket, the_addr);
+  for (unsigned int uTry = 0; uTry < uMaxTry; ++uTry)
+  {
+    uint16_t uCheck = read_Sn_R16(the_socket, the_addr);
+    if (uCheck == uSize) break;
+    uSize = uCheck;
+  }
+  return uSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::prv_txData(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  // This function writes data to tx memory and returns the amount of data actually written
+  // The whole operation is performed in a single SPI transaction
+  W5500Spi::scope_t aScope;
+
+  if (!prv_isValidSocket(the_socket)) return 0;
+  shadow_t& sh = smy_shadow[the_socket];
+  prv_loadPointers(the_socket);
+
+  uint16_t writtenActually = 0;
+  while (the_size)
+  {
+    // Sn_TX_FSR is read only when the space known to be free has been used up.
+    // It does not account for queued data, which have not been passed to SEND yet.
+    if (sh.txFree == 0)
+    {
+      uint16_t txFree   = prv_readSize(the_socket, W5500_Sn_TX_FSR);
+      uint16_t txQueued = sh.txWr - sh.txSent;
+      sh.txFree = (txFree > txQueued ? txFree - txQueued : 0);
+      if (sh.txFree == 0) break;
+    }
+
+    // Copy this portion of bytes from buffer to tx memory, in a single frame:
+    // the chip wraps the write pointer around at the end of the buffer
+    uint16_t canWrite = (sh.txFree > the_size ? the_size : sh.txFree);
+    W5500Spi::write(W5500_BSB_Sn_TX(the_socket), sh.txWr, the_buffer, canWrite);
+    the_buffer += canWrite;
+
+    // Update counters and pointers
+    the_size        -= canWrite;
+    writtenActually += canWrite;
+    sh.txWr         += canWrite;
+    sh.txFree       -= canWrite;
+  }
+
+  // Send what has been written, unless a SEND is already in flight:
+  // in that case data stay queued until its completion
+  prv_commitSend(the_socket);
+  return writtenActually;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t W5500::prv_rxData(socket_e the_socket, uint8_t * the_buffer, uint16_t the_size)
+{
+  // This function reads data from rx memory and returns the amount of data actually read
+  // The whole operation is performed in a single SPI transaction
+  W5500Spi::scope_t aScope;
+
+  if (!prv_isValidSocket(the_socket)) return 0;
+  shadow_t& sh = smy_shadow[the_socket];
+  prv_loadPointers(the_socket);
+
+  uint16_t readActually = 0;
+  while (the_size)
+  {
+    // Sn_RX_RSR is read only when the data known to be available have been used up
+    if (sh.rxAvail == 0)
+    {
+      sh.rxAvail = prv_readSize(the_socket, W5500_Sn_RX_RSR);
+      if (sh.rxAvail == 0) return readActually;
+    }
+
+    // Copy this portion of bytes from rx memory to buffer, in a single frame
+    uint16_t canRead = (sh.rxAvail > the_size ? the_size : sh.rxAvail);
+    W5500Spi::read(W5500_BSB_Sn_RX(the_socket), sh.rxRd, the_buffer, canRead);
+    the_buffer += canRead;
+
+    // Update counters and pointers
+    the_size     -= canRead;
+    readActually += canRead;
+    sh.rxRd      += canRead;
+    sh.rxAvail   -= canRead;
+
+    // Signal completion of this portion of reading
+    set_flags(the_socket, W5500_IR_RECV | W5500_IR_TIMEOUT);
+    write_Sn_R16(the_socket, W5500_Sn_RX_RD, sh.rxRd);
+    prv_command(the_socket, W5500_COMMAND_RECV);
+  }
+
+  return readActually;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::mac_address_t::mac_address_t()
+{ W5500Spi::read(W5500_BSB_COMMON, W5500_SHAR0, my_addr, sizeof(my_addr)); }
+
+W5500::mac_address_t::mac_address_t(socket_e the_socket)
+{ W5500::read_Sn_block(the_socket, W5500_Sn_DHAR, my_addr, sizeof(my_addr)); }
+
+W5500::mac_address_t::mac_address_t(uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4, uint8_t a5)
+{
+  my_addr[0] = a0;
+  my_addr[1] = a1;
+  my_addr[2] = a2;
+  my_addr[3] = a3;
+  my_addr[4] = a4;
+  my_addr[5] = a5;
+}
+
+W5500::mac_address_t::mac_address_t(const uint8_t * the_mac)
+{ memcpy(my_addr, the_mac, sizeof(my_addr)); }
+
+void W5500::mac_address_t::set() const
+{ W5500Spi::write(W5500_BSB_COMMON, W5500_SHAR0, my_addr, sizeof(my_addr)); }
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+W5500::ipv4_address_t::ipv4_address_t()
+{ W5500Spi::read(W5500_BSB_COMMON, W5500_SIPR0, my_addr, sizeof(my_addr)); }
+
+W5500::ipv4_address_t::ipv4_address_t(socket_e the_socket)
+{ W5500::read_Sn_block(the_socket, W5500_Sn_DIPR, my_addr, sizeof(my_addr)); }
+
+W5500::ipv4_address_t::ipv4_address_t(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3)
+{
+  my_addr[0] = ip0;
+  my_addr[1] = ip1;
+  my_addr[2] = ip2;
+  my_addr[3] = ip3;
+}
+
+W5500::ipv4_address_t::ipv4_address_t(const uint8_t * the_ip)
+{ memcpy(my_addr, the_ip, sizeof(my_addr)); }
+
+void W5500::ipv4_address_t::set() const
+{ W5500Spi::write(W5500_BSB_COMMON, W5500_SIPR0, my_addr, sizeof(my_addr)); }
+
+void W5500::ipv4_address_t::set(socket_e the_socket) const
+{ W5500::write_Sn_block(the_socket, W5500_Sn_DIPR, my_addr, sizeof(my_addr)); }
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // #if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5500.h - Definition of W5500 driver
+//
+//  ----------------------
+//
+//  Same interface as the W5100 driver (see W5100.h), for the W5500 of the
+//  Ethernet shield 2 and of WIZnet modules: 8 sockets with 2KB buffers each,
+//  accessed with burst SPI frames.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef W5500_H
+#define W5500_H
+
+#include <Arduino.h>
+#include "W5500Defs.h"
+#include "W5500Spi.h"
+
+////////////////////////////////////////////////////////////////////////////////
+
+class W5500
+{
+public:
+  /////////////////////////////////////////////////////////
+  // Socket numbers
+  enum socket_e
+  {
+    socket_undefined = -1,
+    socket_begin = 0,
+    socket_0 = socket_begin,
+    socket_1,
+    socket_2,
+    socket_3,
+    socket_4,
+    socket_5,
+    socket_6,
+    socket_7,
+    socket_end
+  };
+
+  template<typename T>
+  static inline socket_e socket_cast(T u)
+  { return static_cast<socket_e>(u); }
+
+  /////////////////////////////////////////////////////////
+  // Return codes
+  enum retcode_e
+  {
+    rc_ok                 = 0,
+    rc_invalid_status     ,
+    rc_invalid_socket     ,
+    rc_invalid_port       ,
+    rc_open_failed        ,
+    rc_listen_failed      ,
+    rc_connect_failed     ,
+    rc_connect_timeout    ,
+    rc_disconnect_failed  ,
+    rc_disconnect_timeout ,
+    rc_not_connected      ,
+    rc_close_failed       ,
+    rc_no_data            ,
+    rc_send_pending       ,
+    rc_send_timeout       ,
+    rc_unknown
+  };
+
+  /////////////////////////////////////////////////////////
+  // Utility class for manipulation of MAC address
+  class mac_address_t
+  {
+  public:
+    // These constructors read a mac address from W5500 registers:
+    // the SHAR (Source Hardware Address), or the Sn_DHAR (Destination
+    // Hardware Address) of a socket
+    mac_address_t();
+    explicit mac_address_t(socket_e the_socket);
+
+    // These constructors store a mac address in the member variables,
+    // but do not write it to W5500. Use method "set" to write it.
+    mac_address_t(uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t a4, uint8_t a5);
+    explicit mac_address_t(const uint8_t * the_mac);
+
+  public:
+    // This method writes the mac address to SHAR
+    void              set() const;
+
+    // These methods return each single component of the MAC address
+    // stored in the member variable
+    uint8_t           a0 () const { return my_addr[0]; }
+    uint8_t           a1 () const { return my_addr[1]; }
+    uint8_t           a2 () const { return my_addr[2]; }
+    uint8_t           a3 () const { return my_addr[3]; }
+    uint8_t           a4 () const { return my_addr[4]; }
+    uint8_t           a5 () const { return my_addr[5]; }
+
+  private:
+    uint8_t           my_addr[6];
+  };
+
+  /////////////////////////////////////////////////////////
+  // Utility class for manipulation of IP address (IPV4)
+  class ipv4_address_t
+  {
+  public:
+    // These constructors read an IP address from W5500 registers:
+    // the SIPR (Source IP Address), or the Sn_DIPR (Destination IP
+    // Address) of a socket
+    ipv4_address_t();
+    explicit ipv4_address_t(socket_e the_socket);
+
+    // This constructors store an IP address in the member variable,
+    // but do not write it to W5500. Use method "set" to write it.
+    // The second form can be used directly with a IPAddress.raw_address()
+    ipv4_address_t(uint8_t ip0, uint8_t ip1, uint8_t ip2, uint8_t ip3);
+    explicit ipv4_address_t(const uint8_t * the_ip);
+
+  public:
+    // These methods write the IP address to SIPR, or to the Sn_DIPR of a socket
+    void              set() const;
+    void              set(socket_e the_socket) const;
+
+    // These methods return each single component of the IP address
+    // stored in the member variable
+    uint8_t           ip0 () const { return my_addr[0]; }
+    uint8_t           ip1 () const { return my_addr[1]; }
+    uint8_t           ip2 () const { return my_addr[2]; }
+    uint8_t           ip3 () const { return my_addr[3]; }
+
+  private:
+    uint8_t           my_addr[4];
+  };
+
+  /////////////////////////////////////////////////////////
+
+public:
+  ~W5500();
+
+public:
+  // Initialization and termination
+  static void         begin               (const mac_address_t& the_macAddr, const ipv4_address_t& the_ipAddr);
+  static void         terminate           ();
+
+public:
+  // Socket command functions
+  static retcode_e    open                (socket_e the_socket, uint16_t the_port);
+  static retcode_e    listen              (socket_e the_socket);
+  static retcode_e    connect             (socket_e the_socket, const ipv4_address_t& the_ipAddr, uint16_t the_port);
+  static retcode_e    disconnect          (socket_e the_socket);
+  static retcode_e    checkClientConn     (socket_e the_socket);
+  static retcode_e    waitClientConn      (socket_e the_socket);
+  static retcode_e    close               (socket_e the_socket);
+  static uint16_t     send                (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+  static retcode_e    checkSendCompleted  (socket_e the_socket);
+  static uint16_t     txSizeQueued        (socket_e the_socket);
+  static retcode_e    waitSendCompleted   (socket_e the_socket);
+  static retcode_e    waitSendSpace       (socket_e the_socket) { return checkSendCompleted(the_socket); } // The chip is polled
+  static uint16_t     receive             (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+  static retcode_e    checkReceivePending (socket_e the_socket);
+  static retcode_e    waitReceivePending  (socket_e the_socket);
+
+  // Socket status inquiry functions
+  static uint8_t      status              (socket_e the_socket);
+
+  static uint8_t      flags               (socket_e the_socket);
+  static void         set_flags           (socket_e the_socket, uint8_t the_flags);
+
+  static uint16_t     txMemSize           (socket_e the_socket);
+  static uint16_t     txSizePending       (socket_e the_socket);
+  static uint16_t     rxMemSize           (socket_e the_socket);
+  static uint16_t     rxSizePending       (socket_e the_socket);
+
+  static bool         isOpen              (socket_e the_socket);
+  static bool         isClosed            (socket_e the_socket);
+  static bool         isConnected         (socket_e the_socket);
+  static bool         canReceiveData      (socket_e the_socket);
+  static bool         canTransmitData     (socket_e the_socket);
+
+  static uint16_t     localPort           (socket_e the_socket);
+  static uint16_t     remotePort          (socket_e the_socket);
+
+  // Socket options; to be set before "open"
+  static void         setNoDelayedAck     (socket_e the_socket);
+
+  // Events: the chip is polled, so some socket may always need service
+  static bool         waitEvents          (uint16_t /*the_msTimeout*/) { return true; }
+
+public:
+  // Utility functions for reading/writing common registers
+  static void         write_R8            (uint16_t the_addr, uint8_t the_data );
+  static void         write_R16           (uint16_t the_addr, uint16_t the_data);
+  static uint8_t      read_R8             (uint16_t the_addr);
+  static uint16_t     read_R16            (uint16_t the_addr);
+
+  // Utility functions for reading/writing socket registers
+  static void         write_Sn_R8         (socket_e the_socket, uint16_t the_addr, uint8_t the_data );
+  static void         write_Sn_R16        (socket_e the_socket, uint16_t the_addr, uint16_t the_data);
+  static uint8_t      read_Sn_R8          (socket_e the_socket, uint16_t the_addr);
+  static uint16_t     read_Sn_R16         (socket_e the_socket, uint16_t the_addr);
+
+  // Block access to consecutive registers, performed in a single SPI frame
+  static void         write_Sn_block      (socket_e the_socket, uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size);
+  static void         read_Sn_block       (socket_e the_socket, uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size);
+
+  // Number of register or buffer accesses (i.e. SPI frames) since startup
+  static uint32_t     spiAccesses         () { return W5500Spi::accesses(); }
+
+  // Release of the SPI bus to another device in the middle of a transaction
+  static void         suspendBus          () { W5500Spi::suspend(); }
+  static void         resumeBus           () { W5500Spi::resume();  }
+
+private:
+  /////////////////////////////////////////////////////////
+  // Shadow of socket registers, as in the W5100 driver (see W5100.h)
+  struct shadow_t
+  {
+    uint8_t  status;      // Last Sn_SR read
+    bool     ptrValid;    // txWr and rxRd are valid
+    bool     sendBusy;    // A SEND has been issued and its SEND_OK not yet seen
+    uint16_t txWr;        // End of data written to tx memory
+    uint16_t txSent;      // Sn_TX_WR, i.e. end of data passed to SEND
+    uint16_t rxRd;        // Sn_RX_RD
+    uint16_t txFree;      // Lower bound of Sn_TX_FSR
+    uint16_t rxAvail;     // Lower bound of Sn_RX_RSR
+  };
+
+  static shadow_t     smy_shadow[socket_end];
+
+  // Size of the tx and rx buffers of each socket, set by "begin"
+  static const uint16_t smy_bufSize = 2048;
+
+  static bool         prv_isValidSocket   (socket_e the_socket);
+  static void         prv_invalidate      (socket_e the_socket);
+  static void         prv_command         (socket_e the_socket, uint8_t the_command);
+  static void         prv_loadPointers    (socket_e the_socket);
+  static bool         prv_commitSend      (socket_e the_socket);
+  static uint16_t     prv_readSize        (socket_e the_socket, uint16_t the_addr);
+  static void         prv_reset           ();
+
+private:
+  static uint16_t     prv_txData      (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+  static uint16_t     prv_rxData      (socket_e the_socket, uint8_t * the_buffer, uint16_t the_size);
+
+private:
+  W5500(); // An object of this class cannot be instantiated
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef W5500_H
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5500Defs.h - Definition of W5500 registers
+//
+//  ----------------------
+//
+//  IMPORTANT: Refer to WIZnet W5500 datasheet for a complete description
+//  of the chip and its operation.
+//
+//  The W5500 has the same programming model as the W5100 (see W5100Defs.h),
+//  with 8 sockets and 32KB memory for TX and RX buffers (16KB each, 2KB per
+//  socket after reset). Socket commands, interrupt flags and status values are
+//  the same as the W5100 ones.
+//
+//  Its memory is not a single address space: it is split in blocks, selected
+//  by the Block Select Bits (BSB) of the control byte of each SPI frame:
+//
+//    BSB 0x00       Common Registers
+//    BSB n*4 + 1    Socket n Registers
+//    BSB n*4 + 2    Socket n TX buffer
+//    BSB n*4 + 3    Socket n RX buffer
+//
+//  An SPI frame is made of the 16-bit offset in the block, the control byte
+//  and any number of data bytes (variable length data mode): the offset is
+//  incremented after each byte, and wraps around at the end of a TX or RX
+//  buffer, so that a whole buffer can be read or written in a single frame.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef W5500DEFS_H
+#define W5500DEFS_H
+
+////////////////////////////////////////////////////////////////////////////////
+// Control byte of SPI frames
+
+#define W5500_BSB_COMMON            0x00
+#define W5500_BSB_Sn_REG(n)         (((n) << 2) + 1)
+#define W5500_BSB_Sn_TX(n)          (((n) << 2) + 2)
+#define W5500_BSB_Sn_RX(n)          (((n) << 2) + 3)
+
+#define W5500_CTRL_BSB(bsb)         ((bsb) << 3)
+#define W5500_CTRL_READ             0x00
+#define W5500_CTRL_WRITE            0x04
+#define W5500_CTRL_VDM              0x00    // Variable length data mode (SS framed)
+
+////////////////////////////////////////////////////////////////////////////////
+// Common Registers
+
+#define W5500_MR                    0x0000  // Mode
+#define W5500_GAR0                  0x0001  // Gateway IP Address
+#define W5500_SUBR0                 0x0005  // Subnet Mask
+#define W5500_SHAR0                 0x0009  // Source Hardware Address
+#define W5500_SIPR0                 0x000F  // Source IP Address
+#define W5500_IR                    0x0015  // Interrupt
+#define W5500_IMR                   0x0016  // Interrupt Mask
+#define W5500_SIR                   0x0017  // Socket Interrupt
+#define W5500_SIMR                  0x0018  // Socket Interrupt Mask
+#define W5500_RTR                   0x0019  // Retry Time
+#define W5500_RCR                   0x001B  // Retry Count
+#define W5500_PHYCFGR               0x002E  // PHY Configuration
+#define W5500_VERSIONR              0x0039  // Chip version (0x04)
+
+#define W5500_RST                   0x80    // MR: software reset (automatically cleared after reset)
+#define W5500_PHY_LNK               0x01    // PHYCFGR: link up
+
+////////////////////////////////////////////////////////////////////////////////
+// Socket Registers (offsets in the register block of each socket)
+
+#define W5500_Sn_MR                 0x0000  // Mode
+#define W5500_Sn_CR                 0x0001  // Command
+#define W5500_Sn_IR                 0x0002  // Interrupt
+#define W5500_Sn_SR                 0x0003  // Status
+#define W5500_Sn_PORT               0x0004  // Source Port
+#define W5500_Sn_DHAR               0x0006  // Destination Hardware Address
+#define W5500_Sn_DIPR               0x000C  // Destination IP Address
+#define W5500_Sn_DPORT              0x0010  // Destination Port
+#define W5500_Sn_MSSR               0x0012  // Maximum Segment Size
+#define W5500_Sn_TOS                0x0015  // IP TOS
+#define W5500_Sn_TTL                0x0016  // IP TTL
+#define W5500_Sn_RXBUF_SIZE         0x001E  // Receive Buffer Size, in KB
+#define W5500_Sn_TXBUF_SIZE         0x001F  // Transmit Buffer Size, in KB
+#define W5500_Sn_TX_FSR             0x0020  // TX Free Size
+#define W5500_Sn_TX_RD              0x0022  // TX Read Pointer
+#define W5500_Sn_TX_WR              0x0024  // TX Write Pointer
+#define W5500_Sn_RX_RSR             0x0026  // RX Received Size
+#define W5500_Sn_RX_RD              0x0028  // RX Read Pointer
+#define W5500_Sn_RX_WR              0x002A  // RX Write Pointer
+#define W5500_Sn_IMR                0x002C  // Interrupt Mask
+#define W5500_Sn_KPALVTR            0x002F  // Keep alive timer
+
+// Sn_MR
+#define W5500_ND                    0x20    // Use No Delayed ACK (TCP only) (1:enable; 0:disable)
+#define W5500_PROTOCOL_TCP          0x01
+
+// Sn_CR
+#define W5500_COMMAND_OPEN          0x01
+#define W5500_COMMAND_LISTEN        0x02    // TCP only
+#define W5500_COMMAND_CONNECT       0x04    // TCP only
+#define W5500_COMMAND_DISCON        0x08    // TCP only
+#define W5500_COMMAND_CLOSE         0x10
+#define W5500_COMMAND_SEND          0x20
+#define W5500_COMMAND_SEND_KEEP     0x22    // TCP only
+#define W5500_COMMAND_RECV          0x40
+
+// Sn_IR
+#define W5500_IR_SEND_OK            0x10
+#define W5500_IR_TIMEOUT            0x08
+#define W5500_IR_RECV               0x04
+#define W5500_IR_DISCON             0x02
+#define W5500_IR_CON                0x01
+
+// Sn_SR
+#define W5500_SOCK_CLOSED           0x00
+#define W5500_SOCK_INIT             0x13
+#define W5500_SOCK_LISTEN           0x14
+#define W5500_SOCK_SYNSENT          0x15
+#define W5500_SOCK_SYNRECV          0x16
+#define W5500_SOCK_ESTABLISHED      0x17
+#define W5500_SOCK_FIN_WAIT         0x18
+#define W5500_SOCK_CLOSING          0x1A
+#define W5500_SOCK_TIME_WAIT        0x1B
+#define W5500_SOCK_CLOSE_WAIT       0x1C
+#define W5500_SOCK_LAST_ACK         0x1D
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef W5500DEFS_H
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5500Spi.cpp - Definition of SPI transport for W5500 driver
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Arduino.h"
+#include "../HttpSvrConfig.h"
+
+#if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
+
+#include "W5500Spi.h"
+#include "W5500Defs.h"
+#include "SPI.h"
+
+uint32_t W5500Spi::smy_accesses = 0;
+uint8_t  W5500Spi::smy_depth    = 0;
+
+////////////////////////////////////////////////////////////////////////////////
+// Initialization
+
+void W5500Spi::begin()
+{
+  SPI.begin();
+  prv_initSS();
+  prv_resetSS();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Bus ownership
+
+void W5500Spi::beginTransaction()
+{ if (smy_depth++ == 0) prv_acquireBus(); }
+
+void W5500Spi::endTransaction()
+{
+  if (!smy_depth) return;
+  if (--smy_depth == 0) prv_releaseBus();
+}
+
+void W5500Spi::suspend()
+{
+  // Let another device use the bus while a transaction is open:
+  // the transaction is resumed by "resume"
+  if (smy_depth) prv_releaseBus();
+}
+
+void W5500Spi::resume()
+{ if (smy_depth) prv_acquireBus(); }
+
+bool W5500Spi::inTransaction()
+{ return smy_depth != 0; }
+
+void W5500Spi::prv_acquireBus()
+{
+#ifdef SPI_HAS_TRANSACTION
+  SPI.beginTransaction(SPISettings(W5500_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+#else
+  // Older SPI libraries have no transactions: settings are shared with the SD library,
+  // so they are restored every time the W5500 takes the bus.
+  SPI.setBitOrder(MSBFIRST);
+  SPI.setDataMode(SPI_MODE0);
+  SPI.setClockDivider(SPI_CLOCK_DIV2);
+#endif
+}
+
+void W5500Spi::prv_releaseBus()
+{
+#ifdef SPI_HAS_TRANSACTION
+  SPI.endTransaction();
+#endif
+}
+
+void W5500Spi::prv_beginFrame(uint8_t the_block, uint16_t the_addr, uint8_t the_rw)
+{
+  ++smy_accesses;
+  prv_setSS();
+  SPI.transfer(the_addr >> 8);
+  SPI.transfer(the_addr & 0xFF);
+  SPI.transfer(W5500_CTRL_BSB(the_block) | the_rw | W5500_CTRL_VDM);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Register and buffer access
+
+void W5500Spi::write(uint8_t the_block, uint16_t the_addr, uint8_t the_data)
+{
+  scope_t aScope;
+  prv_beginFrame(the_block, the_addr, W5500_CTRL_WRITE);
+  SPI.transfer(the_data);
+  prv_resetSS();
+}
+
+void W5500Spi::write(uint8_t the_block, uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size)
+{
+  // A single frame for the whole block
+  if (!the_size) return;
+  scope_t aScope;
+  prv_beginFrame(the_block, the_addr, W5500_CTRL_WRITE);
+  for (; the_size; --the_size, ++the_buffer)
+    SPI.transfer(*the_buffer);
+  prv_resetSS();
+}
+
+void W5500Spi::write16(uint8_t the_block, uint16_t the_addr, uint16_t the_data)
+{
+  // 16 bit registers are written MSB first
+  uint8_t aData[2] = { static_cast<uint8_t>(the_data >> 8), static_cast<uint8_t>(the_data & 0xFF) };
+  write(the_block, the_addr, aData, 2);
+}
+
+uint8_t W5500Spi::read(uint8_t the_block, uint16_t the_addr)
+{
+  scope_t aScope;
+  prv_beginFrame(the_block, the_addr, W5500_CTRL_READ);
+  uint8_t d8 = SPI.transfer(0);
+  prv_resetSS();
+  return d8;
+}
+
+void W5500Spi::read(uint8_t the_block, uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size)
+{
+  // A single frame for the whole block
+  if (!the_size) return;
+  scope_t aScope;
+  prv_beginFrame(the_block, the_addr, W5500_CTRL_READ);
+  for (; the_size; --the_size, ++the_buffer)
+    *the_buffer = SPI.transfer(0);
+  prv_resetSS();
+}
+
+uint16_t W5500Spi::read16(uint8_t the_block, uint16_t the_addr)
+{
+  // 16 bit registers are read MSB first
+  uint8_t aData[2];
+  read(the_block, the_addr, aData, 2);
+  return (static_cast<uint16_t>(aData[0]) << 8) | aData[1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #if HTTPSVR_BACKEND == HTTPSVR_BACKEND_W5500
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  W5500Spi.h - Definition of SPI transport for W5500 driver
+//
+//  ----------------------
+//
+//  All SPI traffic to the W5500 goes through this class, as W5100Spi does for
+//  the W5100: chip select, bus settings and nested transactions are the same.
+//
+//  Unlike the W5100, the W5500 supports burst accesses: a frame is made of
+//  the address, a control byte selecting the block (common registers, or the
+//  registers, TX buffer or RX buffer of a socket, see W5500Defs.h) and any
+//  number of data bytes. A block of data is thus read or written with a single
+//  frame, i.e. 3 bytes of overhead instead of 3 for each byte.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef W5500SPI_H
+#define W5500SPI_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#ifndef W5500_SPI_CLOCK
+#  define W5500_SPI_CLOCK 33000000  // Guaranteed SPI clock of W5500 (the board may use a lower one)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+class W5500Spi
+{
+public:
+  // Initialization of SPI bus and chip select pin
+  static void         begin               ();
+
+  // Bus ownership
+  static void         beginTransaction    ();
+  static void         endTransaction      ();
+  static void         suspend             ();
+  static void         resume              ();
+  static bool         inTransaction       ();
+
+  // Register and buffer access; the_block is the BSB of the block
+  static void         write               (uint8_t the_block, uint16_t the_addr, uint8_t the_data);
+  static void         write               (uint8_t the_block, uint16_t the_addr, const uint8_t * the_buffer, uint16_t the_size);
+  static void         write16             (uint8_t the_block, uint16_t the_addr, uint16_t the_data);
+  static uint8_t      read                (uint8_t the_block, uint16_t the_addr);
+  static void         read                (uint8_t the_block, uint16_t the_addr, uint8_t * the_buffer, uint16_t the_size);
+  static uint16_t     read16              (uint8_t the_block, uint16_t the_addr);
+
+  // Number of SPI frames since startup
+  static uint32_t     accesses            () { return smy_accesses; }
+
+  // Utility class: the bus is owned by the W5500 for the lifetime of the object
+  class scope_t
+  {
+  public:
+    scope_t()  { beginTransaction(); }
+    ~scope_t() { endTransaction();   }
+  };
+
+private:
+  static void         prv_acquireBus      ();
+  static void         prv_releaseBus      ();
+  static void         prv_beginFrame      (uint8_t the_block, uint16_t the_addr, uint8_t the_rw);
+
+  static uint32_t     smy_accesses;
+  static uint8_t      smy_depth;
+
+private:
+  W5500Spi(); // An object of this class cannot be instantiated
+
+  // Chip select of W5500 (same pin as the W5100 on Arduino shields)
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(4); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(4); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(4); };
+#elif defined(__AVR_ATmega32U4__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(6); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(6); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(6); };
+#elif defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB646__) || defined(__AVR_AT90USB162__)
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(0); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(0); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(0); };
+#else
+  inline static void  prv_initSS    ()      { DDRB  |=  _BV(2); };
+  inline static void  prv_setSS     ()      { PORTB &= ~_BV(2); };
+  inline static void  prv_resetSS   ()      { PORTB |=  _BV(2); };
+#endif
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+#endif // #ifndef W5500SPI_H
@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+//  arena.h - Definition of class arena
+//
+//  The arena class template provides a fixed-size buffer from which scratch
+//  memory is taken by simply moving a pointer forward (bump allocation).
+//  Memory is given back either all at once (reset), or back to a previously
+//  taken mark (release), so that nested users can free what they took in
+//  reverse order. The highest amount of memory ever used is remembered, so
+//  that the size of the arena can be tuned.
+//
+//  Memory is returned without any alignment: the arena is meant for byte and
+//  char buffers.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef _EXTARENA_H_
+#define _EXTARENA_H_
+
+#include <stdint.h>
+
+namespace ext {
+///////////////////////////////////////////////////////////////////////////////
+
+template <uint16_t N>
+class arena
+{
+public:
+  typedef uint16_t mark_type;
+
+  arena() : my_used(0), my_peak(0), my_failures(0) {}
+
+public:
+  // Allocation: 0 is returned if there is not enough room left
+  uint8_t * alloc(uint16_t the_size)
+  {
+    if (the_size > N - my_used) { ++my_failures; return 0; }
+    uint8_t * p = my_buffer + my_used;
+    my_used += the_size;
+    if (my_used > my_peak) my_peak = my_used;
+    return p;
+  }
+  char * alloc_chars(uint16_t the_size) { return reinterpret_cast<char *>(alloc(the_size)); }
+
+  // Deallocation
+  mark_type mark    () const                { return my_used; }
+  void      release (mark_type the_mark)    { if (the_mark < my_used) my_used = the_mark; }
+  void      reset   ()                      { my_used = 0; }
+
+  // Statistics
+  uint16_t  capacity() const                { return N; }
+  uint16_t  used    () const                { return my_used; }
+  uint16_t  peak    () const                { return my_peak; }
+  uint16_t  failures() const                { return my_failures; }
+  void      resetPeak()                     { my_peak = my_used; my_failures = 0; }
+
+private:
+  arena(const arena<N>&);                   // Not copyable
+  arena<N>& operator=(const arena<N>&);
+
+private:
+  uint8_t   my_buffer[N];
+  uint16_t  my_used;
+  uint16_t  my_peak;
+  uint16_t  my_failures;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Utility class: everything taken from the arena during the lifetime
+// of the object is given back on destruction
+
+template <typename A>
+class arena_scope
+{
+public:
+  explicit arena_scope(A& the_arena) : my_arena(the_arena), my_mark(the_arena.mark()) {}
+  ~arena_scope() { my_arena.release(my_mark); }
+
+private:
+  arena_scope(const arena_scope<A>&);
+  arena_scope<A>& operator=(const arena_scope<A>&);
+
+private:
+  A&                      my_arena;
+  typename A::mark_type   my_mark;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+} // namespace ext
+
+#endif // #ifndef _EXTARENA_H_
@@ -16,6 +16,29 @@ extern "C" {
 
 extern uint16_t crcsum(const char* message, uint32_t length, uint16_t crc);
 
+/*
+* Streaming: crcupdate adds one byte to a CRC, so that a CRC can be computed
+* while a string is being scanned, e.g.
+*   uint16_t crc = CRC_INIT;
+*   for (p = s; *p && (*p != '?'); ++p) crc = crcupdate(crc, *p);
+* gives the same result as crcsum(s, p - s, CRC_INIT).
+*/
+extern uint16_t crcupdate(uint16_t crc, uint8_t ch);
+
+/*
+* Variants, whatever HTTPSVR_CRC16 is (for tests and benchmarks):
+* - crcsum_ram:    256-entry table in RAM (512 bytes of RAM on AVR)
+* - crcsum_flash:  the same table in flash, read with pgm_read_word
+* - crcsum_nibble: 16-entry table in flash (32 bytes), two lookups per byte
+* - crcsum_slice4: 4 bytes per step with 4 tables (2 KB of RAM); not on AVR
+*/
+extern uint16_t crcsum_ram(const char* message, uint32_t length, uint16_t crc);
+extern uint16_t crcsum_flash(const char* message, uint32_t length, uint16_t crc);
+extern uint16_t crcsum_nibble(const char* message, uint32_t length, uint16_t crc);
+#ifndef __AVR__
+extern uint16_t crcsum_slice4(const char* message, uint32_t length, uint16_t crc);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  sha1.cpp - Implementation of the SHA-1 hash function
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "sha1.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t local_rol(uint32_t the_value, uint8_t the_bits)
+{ return (the_value << the_bits) | (the_value >> (32 - the_bits)); }
+
+static void local_transform(sha1_ctx* ctx)
+{
+  // The message schedule is kept as a circular buffer of 16 words,
+  // instead of 80, to save RAM
+  uint32_t w[16];
+  for (uint8_t i = 0; i < 16; ++i)
+    w[i] = (static_cast<uint32_t>(ctx->block[4*i  ]) << 24) |
+           (static_cast<uint32_t>(ctx->block[4*i+1]) << 16) |
+           (static_cast<uint32_t>(ctx->block[4*i+2]) <<  8) |
+           (static_cast<uint32_t>(ctx->block[4*i+3])      );
+
+  uint32_t a = ctx->state[0];
+  uint32_t b = ctx->state[1];
+  uint32_t c = ctx->state[2];
+  uint32_t d = ctx->state[3];
+  uint32_t e = ctx->state[4];
+
+  for (uint8_t t = 0; t < 80; ++t)
+  {
+    if (t >= 16)
+      w[t & 15] = local_rol(w[(t+13) & 15] ^ w[(t+8) & 15] ^ w[(t+2) & 15] ^ w[t & 15], 1);
+
+    uint32_t f, k;
+    if      (t < 20) { f = (b & c) | (~b & d);          k = 0x5A827999; }
+    else if (t < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+    else if (t < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+    else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+    uint32_t temp = local_rol(a, 5) + f + e + k + w[t & 15];
+    e = d;
+    d = c;
+    c = local_rol(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  ctx->state[0] += a;
+  ctx->state[1] += b;
+  ctx->state[2] += c;
+  ctx->state[3] += d;
+  ctx->state[4] += e;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void sha1_init(sha1_ctx* ctx)
+{
+  ctx->state[0] = 0x67452301;
+  ctx->state[1] = 0xEFCDAB89;
+  ctx->state[2] = 0x98BADCFE;
+  ctx->state[3] = 0x10325476;
+  ctx->state[4] = 0xC3D2E1F0;
+  ctx->length   = 0;
+}
+
+void sha1_update(sha1_ctx* ctx, const uint8_t* data, uint16_t length)
+{
+  while (length--)
+  {
+    ctx->block[ctx->length++ & 63] = *data++;
+    if ((ctx->length & 63) == 0) local_transform(ctx);
+  }
+}
+
+void sha1_final(sha1_ctx* ctx, uint8_t digest[SHA1_DIGEST_SIZE])
+{
+  // Padding: a 1 bit, zeros up to 56 bytes modulo 64, then the length in bits
+  uint32_t bits = ctx->length << 3;
+  uint8_t  pad  = 0x80;
+  sha1_update(ctx, &pad, 1);
+  pad = 0;
+  while ((ctx->length & 63) != 56) sha1_update(ctx, &pad, 1);
+
+  uint8_t len[8] = { 0, 0, 0, 0,
+                     static_cast<uint8_t>(bits >> 24), static_cast<uint8_t>(bits >> 16),
+                     static_cast<uint8_t>(bits >>  8), static_cast<uint8_t>(bits      ) };
+  len[3] = static_cast<uint8_t>(ctx->length >> 29);
+  sha1_update(ctx, len, 8);
+
+  for (uint8_t i = 0; i < SHA1_DIGEST_SIZE; ++i)
+    digest[i] = static_cast<uint8_t>(ctx->state[i >> 2] >> (24 - 8 * (i & 3)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+//  sha1.h - Definition of the SHA-1 hash function
+//
+//  ----------------------
+//
+//  SHA-1 as specified in FIPS 180-4. It is computed incrementally: data are
+//  passed to sha1_update in any number of pieces, and only one 64-byte block
+//  is held at a time. It is used for the WebSocket handshake (RFC 6455), and
+//  must not be relied upon for security.
+//
+//  ----------------------
+//
+// This file is free software; you can redistribute it and/or modify
+// it under the terms of either the GNU General Public License version 2
+// or the GNU Lesser General Public License version 2.1, both as
+// published by the Free Software Foundation.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <Arduino.h>
+
+#define SHA1_DIGEST_SIZE 20
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+  uint32_t state[5];
+  uint32_t length;      /* Bytes hashed so far */
+  uint8_t  block[64];
+} sha1_ctx;
+
+extern void sha1_init  (sha1_ctx* ctx);
+extern void sha1_update(sha1_ctx* ctx, const uint8_t* data, uint16_t length);
+extern void sha1_final (sha1_ctx* ctx, uint8_t digest[SHA1_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif